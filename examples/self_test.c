@@ -1,6 +1,7 @@
 #include <limits.h>
 #include <float.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 extern int float_compare(float a, float b);
 extern int double_compare(double a, double b);
@@ -263,3 +264,18 @@ test(cutest_shall_compare_own_data_types_correctly)
   my_own_type_t gold = {1, "234", 5};
   assert_eq(gold, values);
 }
+
+test(cutest_shall_pass_the_test_names_as_they_are_to_a_fresh_process)
+{
+  const char* name[] = {"first_test", "a test; true"};
+  char** args = cutest_fresh_process_args("./self_test", name, 2, "last");
+  size_t n = 0;
+  while (NULL != args[n]) {
+    n++;
+  }
+  assert_eq("./self_test", args[0]);
+  assert_eq("first_test", args[n - 3]);
+  assert_eq("a test; true", args[n - 2]);
+  assert_eq("last", args[n - 1]);
+  free(args);
+}
@@ -18,21 +18,32 @@
 #    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #
 
-ifeq ("$(HAS_COV)","yes")
+# With a CUTEST_BUILD_DIR only the coverage variant, that cutest.mk
+# already builds for coverage, is reported on
+CUTEST_COVERAGE:=$(HAS_COV)
+ifneq ($(CUTEST_BUILD_DIR),)
+ifneq ($(CUTEST_VARIANT),coverage)
+CUTEST_COVERAGE:=no
+endif
+endif
+
+ifeq ("$(CUTEST_COVERAGE)","yes")
+ifeq ($(CUTEST_BUILD_DIR),)
 CUTEST_CFLAGS+=-fprofile-arcs -ftest-coverage
+endif
 CUTEST_COVERAGE_DIR?=.
 
 
 coverage.xml: check
-	$(Q)gcovr -r $(CUTEST_COVERAGE_DIR) -e 'cutest.c' -e '/usr.*' -e '.*_test.c' -e 'cutest.h' -e '.*_mocks.h' -e 'error.h' -e '.*_test_run.c' -x > $@
+	$(Q)gcovr -r $(CUTEST_COVERAGE_DIR) $(if $(CUTEST_BUILD_DIR),$(CUTEST_OUT_DIR)) -e 'cutest.c' -e '/usr.*' -e '.*_test.c' -e 'cutest.h' -e '.*_mocks.h' -e 'error.h' -e '.*_test_run.c' -x > $@
 
 .NOTPARALLEL: lines.cov
-lines.cov: $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
-	$(Q)gcovr -r $(CUTEST_COVERAGE_DIR) -e 'cutest.c' -e '/usr.*' -e '.*_test.c' -e '.*cutest.h' -e '.*_mocks.h' -e 'error.h' -e '.*_test_run.c' $(CUTEST_COVERAGE_EXCLUDE) | egrep -v '^File' | egrep -v '^-' | egrep -v '^Directory' | grep -v 'GCC Code' | grep -v '100%' | grep -v "\-\-\%" > $@; true
+lines.cov: $(CUTEST_RUNNERS)
+	$(Q)gcovr -r $(CUTEST_COVERAGE_DIR) $(if $(CUTEST_BUILD_DIR),$(CUTEST_OUT_DIR)) -e 'cutest.c' -e '/usr.*' -e '.*_test.c' -e '.*cutest.h' -e '.*_mocks.h' -e 'error.h' -e '.*_test_run.c' $(CUTEST_COVERAGE_EXCLUDE) | egrep -v '^File' | egrep -v '^-' | egrep -v '^Directory' | grep -v 'GCC Code' | grep -v '100%' | grep -v "\-\-\%" > $@; true
 
 .NOTPARALLEL: branches.cov
-branches.cov: $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
-	$(Q)gcovr -r $(CUTEST_COVERAGE_DIR) -e 'cutest.c' -e '/usr.*' -e '.*_test.c' -e '.*cutest.h'  -e '.*_mocks.h' -e 'error.h' -e '.*_test_run.c' $(CUTEST_COVERAGE_EXCLUDE) -b | egrep -v '^File' | egrep -v '^-' | egrep -v '^Directory' | grep -v 'GCC Code' | grep -v '100%' | grep -v "\-\-\%" > $@; true
+branches.cov: $(CUTEST_RUNNERS)
+	$(Q)gcovr -r $(CUTEST_COVERAGE_DIR) $(if $(CUTEST_BUILD_DIR),$(CUTEST_OUT_DIR)) -e 'cutest.c' -e '/usr.*' -e '.*_test.c' -e '.*cutest.h'  -e '.*_mocks.h' -e 'error.h' -e '.*_test_run.c' $(CUTEST_COVERAGE_EXCLUDE) -b | egrep -v '^File' | egrep -v '^-' | egrep -v '^Directory' | grep -v 'GCC Code' | grep -v '100%' | grep -v "\-\-\%" > $@; true
 
 output_coverage: lines.cov branches.cov
 	$(Q)test -s lines.cov && echo "Lines not covered:" >&2 && cat lines.cov >&2 && echo >&2; \
@@ -1,4 +1,6 @@
 #define _XOPEN_SOURCE
+#include <errno.h>
+#include <fcntl.h>
 #include <time.h>
 #include <math.h>
 #include <signal.h>
@@ -6,7 +8,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include "cutest.h"
 
@@ -24,6 +28,13 @@ typedef struct cutest_opts_s {
   int no_linefeed;
   int segfault_recovery;
   int print_tests;
+  int fail_fast;
+  int retries;
+  int shuffle;
+  unsigned int seed;
+  const char* bisect;
+  const char* batch;
+  const char* output_dir;
 } cutest_opts_t;
 static cutest_opts_t cutest_opts;
 
@@ -37,7 +48,9 @@ typedef struct cutest_stats_s {
   int fail_cnt;
   int error_cnt;
   int skip_cnt;
+  int flaky_cnt;
   char* skip_reason;
+  int flaky;
   float elapsed_time;
 } cutest_stats_t;
 
@@ -45,6 +58,7 @@ static int cutest_exit_code = EXIT_SUCCESS;
 static cutest_stats_t cutest_stats;
 static int cutest_assert_fail_cnt = 0;
 static int cutest_error_cnt = 0;
+static volatile sig_atomic_t cutest_stop_requested = 0;
 
 extern struct tm *localtime_r(const time_t *timep, struct tm *result);
 
@@ -161,9 +175,18 @@ static void cutest_segfault_handler(int s)
   }
 }
 
+static void cutest_stop_handler(int s)
+{
+  (void)s;
+  cutest_stop_requested = 1;
+}
+
 int cutest_test_name_argument_given(const char* test_name)
 {
   int i = 0;
+  if (0 != cutest_stop_requested) {
+    return 0;
+  }
   if (0 == cutest_tests_to_run.cnt) {
     return 1;
   }
@@ -178,14 +201,29 @@ int cutest_test_name_argument_given(const char* test_name)
 
 static void run_usage(const char* program_name)
 {
-  printf("USAGE: %s [-h] [-v|-l|-j|-n|-s|-p] <test-case-names-list>\n\n"
+  printf("USAGE: %s [-h] [-v|-l|-j|-n|-s|-p|-f|-r n|-b id|-o dir]\n"
+         "       [--shuffle[=seed] [--bisect name]] <test-case-names-list>\n\n"
          "  -h, --help              Show this help text\n"
          "  -v, --verbose           Run the tests in verbose mode\n"
          "  -l, --log-errors        Log errors (stderr) to %s.log\n"
          "  -j, --junit             Produce a JUnit output to %s.junit.xml\n"
          "  -n, --no-line-feed      Don't add linefeed to the last output row.\n"
          "  -s, --segfault-recovery Kepp running tests after an Error (crash).\n"
-         "  -p, --print-tests       Just print the test names in the suite.\n",
+         "  -p, --print-tests       Just print the test names in the suite.\n"
+         "  -f, --fail-fast         Stop after the first failing test, or when\n"
+         "                          signaled with SIGUSR1.\n"
+         "  -r, --retries <n>       Rerun a failing test up to <n> times in a\n"
+         "                          fresh process, and call it flaky if it\n"
+         "                          passes.\n"
+         "  --shuffle[=seed]        Run the tests in a random order, given by\n"
+         "                          the seed, to find tests that depend on\n"
+         "                          each other.\n"
+         "  --bisect <name>         Find the test that makes the named test\n"
+         "                          fail when run before it.\n"
+         "  -b, --batch <id>        Add .<id> to the log and JUnit file names,\n"
+         "                          when running a batch of the tests.\n"
+         "  -o, --output-dir <dir>  Write the log and JUnit files in <dir>\n"
+         "                          instead of next to the test suite source.\n",
          program_name,
          program_name,
          program_name);
@@ -230,6 +268,42 @@ static void handle_args(cutest_opts_t* opts, const char* suite_name,
       opts->print_tests = 1;
       continue;
     }
+    if ((0 == strcmp(argv[i], "-f")) ||
+        (0 == strcmp(argv[i], "--fail-fast"))) {
+      opts->fail_fast = 1;
+      continue;
+    }
+    if (((0 == strcmp(argv[i], "-r")) ||
+         (0 == strcmp(argv[i], "--retries"))) && (i + 1 < argc)) {
+      opts->retries = atoi(argv[++i]);
+      continue;
+    }
+    if (0 == strcmp(argv[i], "--shuffle")) {
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      opts->shuffle = 1;
+      opts->seed = (unsigned int)(now.tv_sec ^ now.tv_usec);
+      continue;
+    }
+    if (0 == strncmp(argv[i], "--shuffle=", strlen("--shuffle="))) {
+      opts->shuffle = 1;
+      opts->seed = strtoul(argv[i] + strlen("--shuffle="), NULL, 10);
+      continue;
+    }
+    if ((0 == strcmp(argv[i], "--bisect")) && (i + 1 < argc)) {
+      opts->bisect = argv[++i];
+      continue;
+    }
+    if (((0 == strcmp(argv[i], "-b")) ||
+         (0 == strcmp(argv[i], "--batch"))) && (i + 1 < argc)) {
+      opts->batch = argv[++i];
+      continue;
+    }
+    if (((0 == strcmp(argv[i], "-o")) ||
+         (0 == strcmp(argv[i], "--output-dir"))) && (i + 1 < argc)) {
+      opts->output_dir = argv[++i];
+      continue;
+    }
 
     strcpy(cutest_tests_to_run.test_name[cutest_tests_to_run.cnt++], argv[i]);
   }
@@ -240,6 +314,10 @@ int cutest_startup(int argc, char* argv[], const char* suite_name,
 {
   memset(&cutest_tests_to_run, 0, sizeof(cutest_tests_to_run));
   memset(&cutest_opts, 0, sizeof(cutest_opts));
+#ifdef CUTEST_OUTPUT_DIR
+  /* Made in a build directory, the reports are written there by default */
+  cutest_opts.output_dir = CUTEST_OUTPUT_DIR;
+#endif
 
   handle_args(&cutest_opts, suite_name, argc, argv);
 
@@ -251,8 +329,17 @@ int cutest_startup(int argc, char* argv[], const char* suite_name,
     signal(SIGSEGV, cutest_segfault_handler);
   }
 
+  /*
+   * The cutest_work tool signals all running suites to stop after their
+   * current test when a test in some other suite has failed.
+   */
+  cutest_stop_requested = 0;
+  if (1 == cutest_opts.fail_fast) {
+    signal(SIGUSR1, cutest_stop_handler);
+  }
+
   if (1 == cutest_opts.junit) {
-    memset(junit_report, 0, sizeof(junit_report) * test_cnt);
+    memset(junit_report, 0, sizeof(*junit_report) * test_cnt);
   }
 
   return cutest_opts.print_tests;
@@ -296,6 +383,10 @@ void verbose_verdict(cutest_stats_t* stats, const char* name,
   if (NULL != stats->skip_reason) {
     printf("[SKIP]: %s\n", name);
   }
+  else if (0 != stats->flaky) {
+    printf("[FLAKY]: %s\n", name);
+    printf("%s", stats->current_error_output);
+  }
   else if (error_cnt != 0) {
     printf("[ERROR]: %s\n", name);
     printf("%s", stats->current_error_output);
@@ -314,6 +405,9 @@ void simple_verdict(cutest_stats_t* stats, int error_cnt, int fail_cnt)
   if (NULL != stats->skip_reason) {
     printf("S");
   }
+  else if (0 != stats->flaky) {
+    printf("f");
+  }
   else if (error_cnt != 0) {
     printf("E");
   }
@@ -342,11 +436,18 @@ void append_output_to_junit_report(cutest_junit_report_t* junit_report,
                                    cutest_stats_t* stats, const char* name)
 {
   junit_report->name = name;
+  junit_report->time = stats->elapsed_time;
 
   if (NULL != stats->skip_reason) {
     junit_report->verdict = CUTEST_TEST_SKIPPED;
     junit_report->message = NULL;
   }
+  else if (0 != stats->flaky) {
+    junit_report->verdict = (0 != cutest_error_cnt) ?
+      CUTEST_TEST_FLAKY_ERROR : CUTEST_TEST_FLAKY_FAILURE;
+    junit_report->message = malloc(strlen(stats->current_error_output) + 1);
+    strcpy(junit_report->message, stats->current_error_output);
+  }
   else if (0 != cutest_error_cnt) {
     junit_report->verdict = CUTEST_TEST_ERROR;
     junit_report->message = malloc(strlen(stats->current_error_output));
@@ -364,17 +465,235 @@ void append_output_to_junit_report(cutest_junit_report_t* junit_report,
 
 }
 
+char** cutest_fresh_process_args(const char* prog_name, const char** name,
+                                 size_t cnt, const char* last)
+{
+  /*
+   * The arguments of a new runner running the given tests, and then the
+   * last one, in the same order as in this runner, also when shuffled. The
+   * options naming the output files are passed on. The seed is kept right
+   * after the arguments, so freeing the arguments frees it too.
+   */
+  const size_t arg_cnt = cnt + 7;
+  char** args = malloc(arg_cnt * sizeof(char*) + 32);
+  char* seed = NULL;
+  size_t n = 0;
+  size_t i;
+
+  if (NULL == args) {
+    return NULL;
+  }
+  seed = (char*)&args[arg_cnt];
+  args[n++] = (char*)prog_name;
+  if (1 == cutest_opts.shuffle) {
+    sprintf(seed, "--shuffle=%u", cutest_opts.seed);
+    args[n++] = seed;
+  }
+  if (NULL != cutest_opts.batch) {
+    args[n++] = "-b";
+    args[n++] = (char*)cutest_opts.batch;
+  }
+  if (NULL != cutest_opts.output_dir) {
+    args[n++] = "-o";
+    args[n++] = (char*)cutest_opts.output_dir;
+  }
+  for (i = 0; i < cnt; i++) {
+    args[n++] = (char*)name[i];
+  }
+  args[n++] = (char*)last;
+  args[n] = NULL;
+  return args;
+}
+
+static int cutest_passes_in_fresh_process(const char* prog_name,
+                                          const char** name, size_t cnt,
+                                          const char* last)
+{
+  /*
+   * Run the given tests, and then the last one, in a new runner with its
+   * output thrown away. It is not started through a shell, so the names
+   * reach it as they are.
+   */
+  char** args = cutest_fresh_process_args(prog_name, name, cnt, last);
+  int status = 0;
+  pid_t pid;
+
+  if (NULL == args) {
+    fprintf(stderr, "ERROR: Out of memory while running tests again\n");
+    return 0;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  if (0 == (pid = fork())) {
+    const int fd = open("/dev/null", O_WRONLY);
+    if (-1 != fd) {
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+    execv(args[0], args);
+    _exit(EXIT_FAILURE);
+  }
+  free(args);
+  if (-1 == pid) {
+    return 0;
+  }
+  while ((-1 == waitpid(pid, &status, 0)) && (EINTR == errno)) {
+    /* Interrupted by the signal asking to stop, the runner still ends */
+  }
+  return (WIFEXITED(status) && (EXIT_SUCCESS == WEXITSTATUS(status)));
+}
+
+static int cutest_passes_on_retry(const char* name, const char* prog_name)
+{
+  /*
+   * Run the failing test alone in a fresh process, so that no state
+   * left behind by the failing run can make it pass or fail again.
+   */
+  int i;
+
+  for (i = 0; i < cutest_opts.retries; i++) {
+    if ((0 != cutest_stop_requested) ||
+        (1 == cutest_passes_in_fresh_process(prog_name, NULL, 0, name))) {
+      return (0 == cutest_stop_requested);
+    }
+  }
+  return 0;
+}
+
+static unsigned int cutest_random(unsigned int* state)
+{
+  /* xorshift32, to get the same order from a seed on every host */
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void cutest_shuffle_tests(size_t* order, size_t test_cnt,
+                                 unsigned int seed)
+{
+  unsigned int state = (0x9e3779b9U == seed) ? 1 : seed ^ 0x9e3779b9U;
+  size_t i;
+
+  for (i = test_cnt; i > 1; i--) {
+    const size_t j = cutest_random(&state) % i;
+    const size_t tmp = order[i - 1];
+    order[i - 1] = order[j];
+    order[j] = tmp;
+  }
+}
+
+static int cutest_bisect(const size_t* order,
+                         const cutest_test_case_t* test_case,
+                         size_t test_cnt, const char* prog_name)
+{
+  /*
+   * Split the tests that are run before the failing test in halves, and
+   * keep the half that still makes it fail, until only one is left.
+   */
+  const char* victim = cutest_opts.bisect;
+  const char** name = malloc((test_cnt + 1) * sizeof(char*));
+  char shuffle[32] = "";
+  size_t cnt = 0;
+  size_t lo = 0;
+  size_t hi = 0;
+
+  if (NULL == name) {
+    fprintf(stderr, "ERROR: Out of memory while bisecting\n");
+    return EXIT_FAILURE;
+  }
+  while ((cnt < test_cnt) &&
+         (0 != strcmp(victim, test_case[order[cnt]].name))) {
+    name[cnt] = test_case[order[cnt]].name;
+    cnt++;
+  }
+  if (cnt == test_cnt) {
+    fprintf(stderr, "ERROR: There is no test named '%s'\n", victim);
+    free(name);
+    return EXIT_FAILURE;
+  }
+
+  if (0 == cutest_passes_in_fresh_process(prog_name, NULL, 0, victim)) {
+    printf("%s fails on its own\n", victim);
+    free(name);
+    return EXIT_FAILURE;
+  }
+  if (1 == cutest_passes_in_fresh_process(prog_name, name, cnt, victim)) {
+    printf("%s passes after the %zu tests before it\n", victim, cnt);
+    free(name);
+    return EXIT_SUCCESS;
+  }
+
+  hi = cnt;
+  while (hi - lo > 1) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (0 == cutest_passes_in_fresh_process(prog_name, &name[lo], mid - lo,
+                                            victim)) {
+      hi = mid;
+    }
+    else if (0 == cutest_passes_in_fresh_process(prog_name, &name[mid],
+                                                 hi - mid, victim)) {
+      lo = mid;
+    }
+    else {
+      break; /* It takes tests from both halves to make it fail */
+    }
+  }
+
+  if (1 == hi - lo) {
+    if (1 == cutest_opts.shuffle) {
+      sprintf(shuffle, " --shuffle=%u", cutest_opts.seed);
+    }
+    printf("%s fails when run after %s, reproduce with:\n"
+           "  %s%s %s %s\n", victim, name[lo], prog_name, shuffle, name[lo],
+           victim);
+  }
+  else {
+    printf("%s fails when run after all of these %zu tests:\n", victim,
+           hi - lo);
+    for (; lo < hi; lo++) {
+      printf("  %s\n", name[lo]);
+    }
+  }
+  free(name);
+  return EXIT_FAILURE;
+}
+
+void cutest_order_tests(size_t* order, const cutest_test_case_t* test_case,
+                        size_t test_cnt, const char* prog_name)
+{
+  size_t i;
+
+  for (i = 0; i < test_cnt; i++) {
+    order[i] = i;
+  }
+  if (1 == cutest_opts.shuffle) {
+    printf("Shuffled with --shuffle=%u\n", cutest_opts.seed);
+    cutest_shuffle_tests(order, test_cnt, cutest_opts.seed);
+  }
+  if (NULL != cutest_opts.bisect) {
+    exit(cutest_bisect(order, test_case, test_cnt, prog_name));
+  }
+}
+
 void cutest_execute_test(cutest_junit_report_t* junit_report,
                          void (*func)(), const char *name,
                          int do_mock, const char *prog_name)
 {
+  struct timeval start;
+  struct timeval stop;
+
   cutest_stats.current_error_output[0] = 0;
   cutest_stats.skip_reason = NULL;
+  cutest_stats.flaky = 0;
 
   if (1 == do_mock) {
     cutest_set_mocks_to_original_functions();
   }
 
+  gettimeofday(&start, NULL);
+
   if ((0 == cutest_opts.segfault_recovery) || (!setjmp(buf))) {
 
     func(); /* Call the test case function this is probably good step-into */
@@ -385,17 +704,37 @@ void cutest_execute_test(cutest_junit_report_t* junit_report,
     cutest_error_cnt++;
   }
 
+  gettimeofday(&stop, NULL);
+  cutest_stats.elapsed_time = (stop.tv_sec - start.tv_sec) +
+    (stop.tv_usec - start.tv_usec) / 1000000.0;
+
+  if (((0 != cutest_assert_fail_cnt) || (0 != cutest_error_cnt)) &&
+      (0 != cutest_opts.retries)) {
+    cutest_stats.flaky = cutest_passes_on_retry(name, prog_name);
+  }
+
   output_test_verdict_to_screen(cutest_opts.verbose, &cutest_stats,
                                 name, cutest_error_cnt,
                                 cutest_assert_fail_cnt);
 
-  if (cutest_assert_fail_cnt != 0) {
+  if (((cutest_assert_fail_cnt != 0) || (cutest_error_cnt != 0)) &&
+      (0 == cutest_stats.flaky)) {
     cutest_exit_code = EXIT_FAILURE;
   }
 
+  if ((1 == cutest_opts.fail_fast) && (0 == cutest_stats.flaky) &&
+      ((0 != cutest_assert_fail_cnt) || (0 != cutest_error_cnt))) {
+    cutest_stop_requested = 1;
+  }
+
   cutest_stats.test_cnt++;
-  cutest_stats.fail_cnt += (cutest_assert_fail_cnt != 0);
-  cutest_stats.error_cnt += (cutest_error_cnt != 0 );
+  if (0 != cutest_stats.flaky) {
+    cutest_stats.flaky_cnt++;
+  }
+  else {
+    cutest_stats.fail_cnt += (cutest_assert_fail_cnt != 0);
+    cutest_stats.error_cnt += (cutest_error_cnt != 0 );
+  }
 
   if (1 == cutest_opts.junit) {
     append_output_to_junit_report(junit_report, &cutest_stats, name);
@@ -413,8 +752,8 @@ void cutest_append_junit_node(FILE* stream, const char* design_under_test,
                               cutest_junit_report_t* junit_report)
 {
   fprintf(stream,
-          "    <testcase classname=\"%s\" name=\"%s\">\n",
-          design_under_test, junit_report->name);
+          "    <testcase classname=\"%s\" name=\"%s\" time=\"%f\">\n",
+          design_under_test, junit_report->name, junit_report->time);
 
   switch (junit_report->verdict) {
   case CUTEST_TEST_SKIPPED:
@@ -435,6 +774,20 @@ void cutest_append_junit_node(FILE* stream, const char* design_under_test,
             "       </failure>\n",
             junit_report->message);
     break;
+  case CUTEST_TEST_FLAKY_ERROR:
+    fprintf(stream,
+            "       <flakyError message=\"segfault\">\n"
+            "%s\n"
+            "       </flakyError>\n",
+            junit_report->message);
+    break;
+  case CUTEST_TEST_FLAKY_FAILURE:
+    fprintf(stream,
+            "       <flakyFailure message=\"test failure\">\n"
+            "%s\n"
+            "       </flakyFailure>\n",
+            junit_report->message);
+    break;
   default:
     break;
   }
@@ -476,6 +829,9 @@ void write_junit_report(const char* report_file_name,
           timestamp);
 
   for (i = 0; i < test_cnt; i++) {
+    if (NULL == junit_report[i].name) {
+      continue; /* Not run, e.g. not selected or stopped by --fail-fast */
+    }
     cutest_append_junit_node(stream, test_file_name, &junit_report[i]);
     if (NULL != junit_report[i].message) {
       free(junit_report[i].message);
@@ -489,17 +845,50 @@ void write_junit_report(const char* report_file_name,
   fclose(stream);
 }
 
+static void get_output_path(char* buf, const char* test_suite_file_name)
+{
+  /*
+   * The log and JUnit files are written next to the test suite source, or
+   * with the base name of the source in the output directory.
+   */
+  const char* base = strrchr(test_suite_file_name, '/');
+
+  if (NULL == cutest_opts.output_dir) {
+    strcpy(buf, test_suite_file_name);
+  }
+  else {
+    sprintf(buf, "%s/%s", cutest_opts.output_dir,
+            (NULL == base) ? test_suite_file_name : base + 1);
+  }
+}
+
 void write_log_file(const char* test_suite_file_name, const char* error_buf)
 {
-  const size_t dotpos =
-    strstr(test_suite_file_name, ".") - test_suite_file_name;
-  char* log_file_name = malloc(dotpos + 5);
+  char path[1024];
+  const char* base = NULL;
+  size_t dotpos = 0;
+  size_t batch_len = 0;
+  char* log_file_name = NULL;
   FILE* fd = NULL;
 
-  memset(log_file_name, 0, dotpos + 5);
+  get_output_path(path, test_suite_file_name);
+  /* Dots in the directory names are not part of the suffix */
+  base = strrchr(path, '/');
+  base = (NULL == base) ? path : base + 1;
+  dotpos = (NULL == strchr(base, '.')) ? strlen(path) :
+    (size_t)(strchr(base, '.') - path);
+  batch_len =
+    (NULL == cutest_opts.batch) ? 0 : strlen(cutest_opts.batch) + 1;
+  log_file_name = malloc(dotpos + batch_len + 5);
+
+  memset(log_file_name, 0, dotpos + batch_len + 5);
 
-  strncpy(log_file_name, test_suite_file_name, dotpos);
+  strncpy(log_file_name, path, dotpos);
   log_file_name[dotpos] = 0;
+  if (NULL != cutest_opts.batch) {
+    strcat(log_file_name, ".");
+    strcat(log_file_name, cutest_opts.batch);
+  }
   strcat(log_file_name, ".log");
 
   fd = fopen(log_file_name, "w");
@@ -520,6 +909,7 @@ int cutest_shutdown(const char* filename,
                      cutest_junit_report_t* junit_report, size_t test_cnt)
 {
   char junit_report_name[1024];
+  char path[1024];
   int i;
 
   if (0 == cutest_opts.verbose) {
@@ -542,18 +932,30 @@ int cutest_shutdown(const char* filename,
   }
   else {
     /* Print a simple summary. */
-    printf("%d passed, %d failed.\n",
-           cutest_stats.test_cnt - cutest_stats.fail_cnt,
-           cutest_stats.fail_cnt);
+    if (0 == cutest_stats.flaky_cnt) {
+      printf("%d passed, %d failed.\n",
+             cutest_stats.test_cnt - cutest_stats.fail_cnt,
+             cutest_stats.fail_cnt);
+    }
+    else {
+      printf("%d passed, %d failed, %d flaky.\n",
+             cutest_stats.test_cnt - cutest_stats.fail_cnt,
+             cutest_stats.fail_cnt, cutest_stats.flaky_cnt);
+    }
   }
 
 
   if (1 == cutest_opts.junit) {
     memset(junit_report_name, 0, sizeof(junit_report_name));
-
-    for (i = strlen(filename); i > 0; i--) {
-      if ('.' == filename[i]) {
-        strncpy(junit_report_name, filename, i);
+    get_output_path(path, filename);
+
+    for (i = strlen(path); i > 0; i--) {
+      if ('.' == path[i]) {
+        strncpy(junit_report_name, path, i);
+        if (NULL != cutest_opts.batch) {
+          strcat(junit_report_name, ".");
+          strcat(junit_report_name, cutest_opts.batch);
+        }
         strcat(junit_report_name, ".junit_report.xml");
         break;
       }
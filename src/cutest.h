@@ -300,11 +300,166 @@
  *   $ make check
  *   ...
  *
+ * Command line to run all test suites on at most 4 cores, and fewer
+ * when the host is busy with other things::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="-j 4 -a"
+ *   ...
+ *
+ * In a terminal ``make check`` shows the test run by every worker, how
+ * many tests have run and failed, and when it expects to be done.
+ *
+ * With ``CUTEST_RESULTS`` set to a directory, a test suite that passed
+ * is not run again by ``make check`` until its runner, how it is run or
+ * its environment changes. It is reported as ``[CACHED]`` instead. The
+ * data files the tests read are not known, so the cache is off by
+ * default, and the files must be listed to rerun the tests when they
+ * change. CI can keep the directory between runs. Command line to cache
+ * the results, and to run them all anyway::
+ *
+ *   $ make check CUTEST_RESULTS=cutest_results \
+ *     CUTEST_WORK_FLAGS="--cache-inputs data/a.bin:data/b.bin"
+ *   $ make check CUTEST_RESULTS=cutest_results CUTEST_WORK_FLAGS="--no-cache"
+ *   ...
+ *
+ * Command line to rebuild and rerun a test suite every time its source
+ * or test is saved, until stopped with Ctrl-C::
+ *
+ *   $ make watch
+ *   ...
+ *
+ * Command line to stop all test suites as soon as a test fails, the
+ * same flag can be given to a single test suite as well::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="--fail-fast"
+ *   $ ./foo_test --fail-fast
+ *   ...
+ *
+ * Command line to rerun a failing test up to two times in a fresh
+ * process, and report it as flaky if it passes, and to only run the
+ * tests that failed in the merged report of the last run::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="--retries 2 --junit all.junit_report.xml"
+ *   $ make check CUTEST_WORK_FLAGS="--rerun-failed --junit all.junit_report.xml"
+ *   $ ./foo_test --retries 2
+ *   ...
+ *
+ * Command line to run the tests of a suite in a random order, to find
+ * tests that depend on what others leave behind. The seed is printed,
+ * and giving it again gives the same order. If a test only fails in
+ * that order, ``--bisect`` finds the test that makes it fail::
+ *
+ *   $ ./foo_test --shuffle
+ *   Shuffled with --shuffle=1234
+ *   $ ./foo_test --shuffle=1234 --bisect test_that_failed
+ *   ...
+ *
+ * Command line to run the second out of four shards of all tests, on
+ * one of several CI hosts, balanced on the durations of an earlier run::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="--shard-index 2 --shard-count 4 --history ci.history"
+ *   ...
+ *
+ * Command line to merge the JUnit reports of all test suites in one
+ * file, with the time and worker of every test suite::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="--junit all.junit_report.xml"
+ *   ...
+ *
+ * Command line to write a timeline of the run, one track per worker, to
+ * open in Perfetto or ``chrome://tracing``::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="--trace check.json"
+ *   ...
+ *
+ * Command line to kill any test suite that uses more than 512 MB of
+ * memory or a minute of CPU time, instead of letting it drag the host
+ * down::
+ *
+ *   $ make check CUTEST_WORK_FLAGS="--limit-memory 512 --limit-cpu 60"
+ *   ...
+ *
+ * Command line to also run the test suites on two build boxes, each
+ * running an agent that connects to this host::
+ *
+ *   build1$ cutest/src/cutest_work --agent ci:4711 -j 8
+ *   build2$ cutest/src/cutest_work --agent ci:4711 -j 8
+ *   ci$ make check CUTEST_WORK_FLAGS="--listen :4711 --agents 2"
+ *   ...
+ *
  * Command line to run all tests with Valgrind memory leakage checks::
  *
  *   $ make valgrind
  *   ...
  *
+ * Command line to only run the test suites that have changed since they
+ * last passed the Valgrind checks::
+ *
+ *   $ make valgrind CUTEST_WORK_FLAGS="--changed-only valgrind.clean"
+ *   ...
+ *
+ * Command line to build and run all test suites with ``cutest_make``,
+ * a single process that knows every step from a design under test to
+ * a passing runner, and runs a test suite as soon as its runner is
+ * linked. It goes by the content of the files rather than their time
+ * stamps, kept in ``cutest_make.state``, so a file that is touched, or
+ * made again with the same content, does not make anything else::
+ *
+ *   $ make nativecheck
+ *   $ make nativecheck CUTEST_MAKE_FLAGS="-j 8"
+ *   ...
+ *
+ * Command line to keep every file that ``cutest_make`` makes in a cache
+ * directory, that can be shared by several checkouts, so that switching
+ * branches back and forth or a fresh checkout copies the files instead
+ * of making them again::
+ *
+ *   $ make nativecheck CUTEST_CACHE=~/.cache/cutest
+ *   ...
+ *
+ * Command line to make everything out of the source tree instead, with
+ * every variant (plain, ``sanitize``, ``coverage`` and ``valgrind``) in a
+ * directory of its own below ``CUTEST_BUILD_DIR``, so that the variants
+ * are made and run at the same time without overwriting each other::
+ *
+ *   $ make -j check sanitize coverage CUTEST_BUILD_DIR=build
+ *   ...
+ *
+ * Command line to link all test suites into one unity runner,
+ * ``cutest_unity/cutest_unity``, instead of one runner each. The main()
+ * of every test suite is renamed after the suite, so the suites do not
+ * clash. Called by its own name the unity runner runs all the test
+ * suites, or only the ones given by ``--suite``. ``make unitycheck``
+ * starts it a few times with a group of suites each, about as many
+ * groups as the workers take batches, instead of once per suite, and
+ * still reports every suite on its own. Big suites are not split in
+ * batches, and Valgrind and agents get one suite at a time through a
+ * link named after it::
+ *
+ *   $ make unitycheck
+ *   $ cutest_unity/cutest_unity --suite foo_test -v
+ *   ...
+ *
+ * Command line to make the calls of the designs under test go to the
+ * mock-ups by renaming symbols in their object files, with ``objcopy``,
+ * instead of rewriting the assembler output of the compiler with
+ * ``cutest_prox``. It needs ELF objects and the GNU binutils, but does
+ * not depend on how the compiler writes assembler. The test suites do
+ * not change::
+ *
+ *   $ make check CUTEST_MOCK_BACKEND=link
+ *   ...
+ *
+ * Command line to make the mock-ups from the debug information that the
+ * compiler writes to the object file of each design under test, instead
+ * of running ``cproto`` on the source files and their headers. The
+ * prototypes are then exactly the ones the compiler saw, and ``cproto``
+ * is neither needed nor built. It needs 64-bit little-endian ELF objects
+ * with DWARF, such as from GCC or Clang on x86-64 or AArch64::
+ *
+ *   $ make check CUTEST_PROTOTYPES=dwarf
+ *   ...
+ *
  * There are more examples available in the examples folder.
  *
  * Command line to remove your current cutest installation (clean-up)::
@@ -358,7 +513,15 @@
  *   this_test: other.c and_another.c
  *
  * And the dependency is handled in the ``cutest.mk`` file when it sets
- * up the ``this_test`` build target.
+ * up the ``this_test`` build target. For ``make nativecheck`` to link
+ * the same files, put them in a ``CUTEST_LINK_this_test`` variable::
+ *
+ *   CUTEST_LINK_this_test=other.c and_another.c
+ *
+ *   this_test: $(CUTEST_LINK_this_test)
+ *
+ * With a ``CUTEST_BUILD_DIR`` the runners are made in the directory of
+ * the variant, so the target is ``$(CUTEST_OUT_DIR)/this_test`` there.
  *
  * .. note:: This will build the ``other.c`` with the CUTEST_CFLAGS that
  *           might be a little bit harsher than you're used to, so you can
@@ -418,6 +581,11 @@
  * your design under test, along with mock-up versions of all functions
  * and other things that are used internally.
  *
+ * The mock-ups of the most common C library functions, like ``malloc()``
+ * and ``strcmp()``, are compiled only once, next to ``cutest.o``, and
+ * linked into every test-runner. You still control them from your test
+ * cases like any other mock-up.
+ *
  * To compile the test runner successfully you should never ever have
  * ``CUTEST_MOCK_MAIN`` defined to the compiler. They are used to
  * compile the *CUTest test runner* generator* and the *CUTest mock
@@ -428,7 +596,9 @@ typedef enum cutest_verdict_e {
   CUTEST_TEST_SKIPPED,
   CUTEST_TEST_ERROR,
   CUTEST_TEST_FAILED,
-  CUTEST_TEST_OK
+  CUTEST_TEST_OK,
+  CUTEST_TEST_FLAKY_ERROR, /* Passed when retried */
+  CUTEST_TEST_FLAKY_FAILURE
 } cutest_verdict_t;
 
 typedef struct cutest_junit_report_s {
@@ -438,15 +608,25 @@ typedef struct cutest_junit_report_s {
   float time;
 } cutest_junit_report_t;
 
+typedef struct cutest_test_case_s {
+  const char* name;
+  void (*func)();
+  int do_mock;
+} cutest_test_case_t;
+
 void cutest_increment_skips(char* reason);
 void cutest_increment_fails();
 int cutest_startup(int argc, char* argv[], const char* suite_name,
                    cutest_junit_report_t* junit_report, size_t test_cnt);
+void cutest_order_tests(size_t* order, const cutest_test_case_t* test_case,
+                        size_t test_cnt, const char* prog_name);
 void cutest_execute_test(cutest_junit_report_t* junit_report,
                          void (*func)(), const char *name,
                          int do_mock, const char *prog_name);
 int cutest_shutdown(const char* filename,
                     cutest_junit_report_t* junit_report, size_t test_cnt);
+char** cutest_fresh_process_args(const char* prog_name, const char** name,
+                                 size_t cnt, const char* last);
 /*
  * These functions are generated
  */
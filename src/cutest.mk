@@ -29,12 +29,12 @@ CUTEST_RUN=$(CUTEST_PATH)/cutest_run
 CUTEST_MOCK=$(CUTEST_PATH)/cutest_mock
 CUTEST_PROX=$(CUTEST_PATH)/cutest_prox
 CUTEST_WORK=$(CUTEST_PATH)/cutest_work
+CUTEST_MAKE=$(CUTEST_PATH)/cutest_make
 
-include $(CUTEST_PATH)/cproto.mk
+# The mock-ups of common C library functions, shared by all test suites
+CUTEST_LIBC=$(CUTEST_OBJ_DIR)/cutest_libc
 
-ifeq ($(MAKECMDGOALS),sanitize)
-	CC=clang
-endif
+include $(CUTEST_PATH)/cproto.mk
 
 ifneq (${Q},@)
 	V=-v
@@ -45,9 +45,95 @@ endif
 CUTEST_SRC_DIR ?=./
 CUTEST_TEST_DIR ?=./
 
+# Extra options to cutest_work, e.g. "-j 4 -m 512 -a"
+CUTEST_WORK_FLAGS ?=
+
+# Extra options to cutest_make, e.g. "-j 8"
+CUTEST_MAKE_FLAGS ?=
+
+# Where make nativecheck keeps every file it makes, by the hash of its
+# recipe and inputs, so that it is copied instead of made again after a
+# branch switch or in a fresh checkout. It can be shared by checkouts.
+CUTEST_CACHE ?=
+
 CUTEST_SRC_DIR:=$(abspath $(CUTEST_SRC_DIR))
 CUTEST_TEST_DIR:=$(abspath $(CUTEST_TEST_DIR))
 
+# Where cutest_mock gets the prototypes of the functions to mock from. By
+# default cproto reads them from the design under test and its headers. With
+# dwarf they are read from the debug information of the object file of the
+# design under test instead, and of cutest_libc.c, so cproto is not needed.
+CUTEST_PROTOTYPES ?=cproto
+ifeq ($(CUTEST_PROTOTYPES),dwarf)
+	CUTEST_PROTO_TOOL:=
+	CUTEST_PROTO_DEPS=$(CUTEST_LIBC)_mockables.o
+else
+	CUTEST_PROTO_TOOL=$(CPROTO)
+	CUTEST_PROTO_DEPS=$(CPROTO)
+endif
+
+# Where the test suites are made and run. By default everything is made
+# next to the test suites, and cutest.o next to cutest.c. With a build
+# directory, every variant (plain, sanitize, coverage and valgrind) is made
+# and run in a directory of its own below it instead, so that the variants
+# can be made at the same time, e.g. "make -j check sanitize coverage".
+CUTEST_BUILD_DIR ?=
+CUTEST_VARIANT ?=plain
+CUTEST_VARIANTS:=plain sanitize coverage valgrind
+ifneq ($(CUTEST_BUILD_DIR),)
+	CUTEST_OUT_DIR:=$(abspath $(CUTEST_BUILD_DIR))/$(CUTEST_VARIANT)
+	CUTEST_OBJ_DIR:=$(CUTEST_OUT_DIR)
+	ifeq ($(CUTEST_VARIANT),plain)
+		CUTEST_MATRIX:=yes
+	endif
+	ifeq ($(CUTEST_VARIANT),sanitize)
+		CUTEST_SANITIZE:=yes
+	endif
+else
+	CUTEST_OUT_DIR:=$(CUTEST_TEST_DIR)
+	CUTEST_OBJ_DIR:=$(CUTEST_PATH)
+	ifeq ($(MAKECMDGOALS),sanitize)
+		CUTEST_SANITIZE:=yes
+	endif
+endif
+
+ifeq ($(CUTEST_SANITIZE),yes)
+	CC=clang
+endif
+
+# The test suite runners, as made from the test suites
+CUTEST_RUNNERS=$(patsubst $(CUTEST_TEST_DIR)/%.c,$(CUTEST_OUT_DIR)/%,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
+
+# The unity runner has all the test suites linked into it, and is run as
+# any of them through a symbolic link named after the test suite
+CUTEST_UNITY_DIR=$(CUTEST_OUT_DIR)/cutest_unity
+CUTEST_UNITY=$(CUTEST_UNITY_DIR)/cutest_unity
+CUTEST_UNITY_RUNNERS=$(patsubst $(CUTEST_TEST_DIR)/%.c,$(CUTEST_UNITY_DIR)/%,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
+
+OBJCOPY ?=objcopy
+
+# How the calls of a design under test are made to go to the mock-ups. The
+# asm backend compiles the design under test to an assembler file and
+# rewrites its calls with cutest_prox. The link backend compiles it to an
+# object file and renames the symbols it calls in the object file instead,
+# which is faster and does not depend on how the compiler writes assembler,
+# but needs ELF objects and the GNU binutils. The test suites are the same.
+CUTEST_MOCK_BACKEND ?=asm
+ifeq ($(CUTEST_MOCK_BACKEND),link)
+	CUTEST_MOCKABLES=%_mockables.o
+	CUTEST_PROXIFIED=%_wrapped.o
+else
+	CUTEST_MOCKABLES=%_mockables.s
+	CUTEST_PROXIFIED=%_proxified.s
+endif
+
+# Where make check keeps the results of the test suites that passed, so
+# that they are not run again until something changes. Empty by default,
+# since the data files a test reads are only part of the key when given
+# with --cache-inputs. Set it, e.g. to $(CUTEST_OUT_DIR)/cutest_results,
+# and keep it between CI runs to opt in.
+CUTEST_RESULTS ?=
+
 PEDANTIC:=-pedantic -Wall
 # Some nice flags for compiling cutest-tests with good quality
 ifneq ($(findstring clang,$(CC)),clang)
@@ -56,28 +142,41 @@ else
 	CUTEST_CFLAGS?=
 endif
 
-HAS_VISIBILITY_HIDDEN:=$(shell $(CC) -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c -fvisibility=hidden 2>&1 >/dev/null && echo "yes")
+# The compiler feature probes are run once per compiler into a generated
+# makefile, since every (recursive) make parsing this file would otherwise
+# run them all again. It is remade when CC, or the compiler binary it
+# resolves to, changes.
+CUTEST_CONFIG:=$(CUTEST_OBJ_DIR)/cutest_config.mk
+CUTEST_CC_PATH:=$(realpath $(firstword $(wildcard $(firstword $(CC)) $(addsuffix /$(firstword $(CC)),$(subst :, ,$(PATH))))))
+CUTEST_CONFIG_KEY:=
+
+# Cleaning up does not need to know what the compiler can do
+ifeq ($(filter clean clean_cutest,$(MAKECMDGOALS)),)
+-include $(CUTEST_CONFIG)
+endif
+
+ifneq ("$(CUTEST_CONFIG_KEY)","$(CC) $(CUTEST_CC_PATH)")
+	CUTEST_CONFIG_FORCE:=cutest_config_force
+endif
+
 ifeq ("$(HAS_VISIBILITY_HIDDEN)","yes")
 	VISIBILITY_HIDDEN:=-fvisibility=hidden
 else
 	VISIBILITY_HIDDEN:=
 endif
 
-HAS_COV:=$(shell $(CC) -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c -fprofile-arcs 2>&1 >/dev/null && echo "yes")
 ifeq ("$(HAS_COV)","yes")
 	COV:=-fprofile-arcs -ftest-coverage
 else
 	COV:=
 endif
 
-HAS_NOPRAGMA:=$(shell $(CC) -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c -Wno-pragma 2>&1 >/dev/null && echo "yes")
 ifeq ("$(HAS_NOPRAGMA)","yes")
 	NOPRAGMA:=-Wno-pragma
 else
 	NOPRAGMA:=
 endif
 
-HAS_WEXTRA:=$(shell $(CC) -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c -Wextra 2>&1 >/dev/null && echo "yes")
 ifeq ("$(HAS_WEXTRA)","yes")
 	WEXTRA:=-Wextra
 else
@@ -85,7 +184,6 @@ else
 endif
 
 VARIADIC:=none
-HAS_VARIADIC:=$(shell $(CC) -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c -DVARIADIC=1 2>&1 >/dev/null && echo "yes")
 ifeq ("$(HAS_VARIADIC)","yes")
 	VARIADIC:=-D"VARIADIC=1"
 else
@@ -93,17 +191,14 @@ else
 endif
 
 STD:=none
-HAS_C11:=$(shell $(CC) -std=c11 -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c 2>&1 >/dev/null && echo "yes")
 ifeq ("$(HAS_C11)","yes")
 	STD:=-std=c11
 else
 	HAS_C11:=no
-	HAS_C99:=$(shell $(CC) -std=c99 -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c 2>&1 >/dev/null && echo "yes")
 	ifeq ("$(HAS_C99)","yes")
 		STD:=-std=c99
 	else
 		HAS_C99:=no
-		HAS_C90:=$(shell $(CC) -std=c90 -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c 2>&1 >/dev/null && echo "yes")
 		ifeq ("$(HAS_C90)","yes")
 			STD:=-std=c90
 		else
@@ -113,21 +208,45 @@ else
 	endif
 endif
 
-all:
-	$(Q)$(MAKE) -s -r --no-print-directory cutest_run && \
-	$(MAKE) -s -r --no-print-directory cutest_mock && \
-	$(MAKE) -s -r --no-print-directory cutest_prox && \
-	$(MAKE) -s -r --no-print-directory cutest_work
-
 # This makes valgrind work with long double values, should suffice for
 # most applications as well.
-HAS_LONGOPT:=$(shell $(CC) -o $(CUTEST_PATH)/empty $(CUTEST_PATH)/empty.c -mlong-double-64 2>&1 >/dev/null && echo "yes")
 ifeq ("$(HAS_LONGOPT)","yes")
 	LONG_DOUBLE_64:=-mlong-double-64
 else
 	LONG_DOUBLE_64:=
 endif
 
+all:
+	$(Q)$(MAKE) -s -r --no-print-directory cutest_run && \
+	$(MAKE) -s -r --no-print-directory cutest_mock && \
+	$(MAKE) -s -r --no-print-directory cutest_prox && \
+	$(MAKE) -s -r --no-print-directory cutest_work
+
+# A probe only passes if the compiler has nothing at all to say about it
+$(CUTEST_CONFIG): $(CUTEST_CC_PATH) $(CUTEST_PATH)/empty.c $(CUTEST_CONFIG_FORCE) | $(CUTEST_OBJ_DIR)
+	$(Q)probe() { \
+	  out=`$(CC) "$$@" -o $@.$$$$.empty $(CUTEST_PATH)/empty.c 2>&1 >/dev/null` && \
+	  [ -z "$$out" ] && echo "yes"; \
+	}; \
+	( echo "# Generated by cutest.mk for $(CC), do not edit"; \
+	  echo "CUTEST_CONFIG_KEY:=$(CC) $(CUTEST_CC_PATH)"; \
+	  echo "HAS_VISIBILITY_HIDDEN:=`probe -fvisibility=hidden`"; \
+	  echo "HAS_COV:=`probe -fprofile-arcs`"; \
+	  echo "HAS_NOPRAGMA:=`probe -Wno-pragma`"; \
+	  echo "HAS_WEXTRA:=`probe -Wextra`"; \
+	  echo "HAS_VARIADIC:=`probe -DVARIADIC=1`"; \
+	  echo "HAS_C11:=`probe -std=c11`"; \
+	  echo "HAS_C99:=`probe -std=c99`"; \
+	  echo "HAS_C90:=`probe -std=c90`"; \
+	  echo "HAS_LONGOPT:=`probe -mlong-double-64`"; \
+	) > $@.$$$$ && $(RM) $@.$$$$.empty && mv $@.$$$$ $@
+
+.PHONY: cutest_config_force
+cutest_config_force:
+
+$(sort $(CUTEST_OUT_DIR) $(CUTEST_OBJ_DIR) $(CUTEST_UNITY_DIR)):
+	$(Q)mkdir -p $@
+
 CUTEST_CFLAGS+=$(LONG_DOUBLE_64) $(STD) $(VARIADIC) $(WEXTRA) $(NOPRAGMA) $(PEDANTIC)
 
 ifneq (${LENIENT},0)
@@ -148,14 +267,18 @@ ifeq ($(findstring clang,$(CC)),clang)
 	CUTEST_CFLAGS+=-D"CUTEST_CLANG=1"
 endif
 
-ifeq ($(MAKECMDGOALS),sanitize)
+ifeq ($(CUTEST_SANITIZE),yes)
 	CUTEST_CFLAGS+=-fsanitize=address,leak,undefined -fno-omit-frame-pointer
 	ASAN_OPTIONS=detect_leaks=1
 	export ASAN_OPTIONS
 endif
 
-SOURCES=$(notdir $(filter-out %_test_run.c,$(filter-out %_test.c,$(wildcard $(CUTEST_SRC_DIR)/*.c))))
-EXPECTED_TEST_SUITES=$(sort $(notdir $(subst .c,_test.c,$(filter-out cutest.c,$(SOURCES)))))
+ifeq ($(CUTEST_VARIANT),coverage)
+	CUTEST_CFLAGS+=$(COV)
+endif
+
+SOURCES=$(notdir $(filter-out %_mocks.c,$(filter-out %_test_run.c,$(filter-out %_test.c,$(wildcard $(CUTEST_SRC_DIR)/*.c)))))
+EXPECTED_TEST_SUITES=$(sort $(notdir $(subst .c,_test.c,$(filter-out cutest.c cutest_libc.c,$(SOURCES)))))
 FOUND_TEST_SUITES=$(sort $(notdir $(wildcard $(CUTEST_TEST_DIR)/*_test.c)))
 MISSING_TEST_SUITES=$(filter-out $(FOUND_TEST_SUITES),$(EXPECTED_TEST_SUITES))
 MISSING_SOURCES=$(subst _test.c,.c,$(filter-out $(EXPECTED_TEST_SUITES),$(FOUND_TEST_SUITES)))
@@ -163,11 +286,13 @@ MISSING_SOURCES=$(subst _test.c,.c,$(filter-out $(EXPECTED_TEST_SUITES),$(FOUND_
 cutest_info:
 	@echo "Current path         : $(abspath .)"
 	@echo "Test-folder          : $(CUTEST_TEST_DIR)"
+	@echo "Build-folder         : $(CUTEST_OUT_DIR)"
 	@echo "Source-folder        : $(CUTEST_SRC_DIR)"
 	@echo "CUTest-path          : $(CUTEST_PATH)"
 	@echo "CUTest-CFLAGS        : $(CUTEST_CFLAGS)"
 	@echo "CC                   : $(CC) '$(findstring gcc,$(CC))'"
 	@echo "C-standard           : $(STD)"
+	@echo "Compiler features    : $(CUTEST_CONFIG)"
 	@echo "LTO                  : $(LTO)"
 	@echo "CLFAGS               : $(CUTEST_CFLAGS)"
 #	@echo "Installed cproto     : $(INSTALLED_CPROTO) $(INSTALLED_CPROTO_VER)"
@@ -179,8 +304,46 @@ cutest_info:
 	@echo "Missing sources      : $(MISSING_SOURCES)"
 	@echo "Missing test suites  : $(MISSING_TEST_SUITES)"
 
-$(CUTEST_PATH)/cutest.o: $(CUTEST_PATH)/cutest.c
-	$(Q)$(CC) -c $^ $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) -o $@
+# The recipes of the test suite runners, as functions of the target and what
+# it is made from, since cutest_make runs the very same recipes. Every compile
+# step writes the headers it read to the target with a .d suffix, and every
+# generated file is only written if its content changed, so that nothing
+# made from it is made again for nothing.
+CUTEST_DEPS=-MMD -MP -MT $(1) -MF $(1).d
+cutest_update=if cmp -s $(1).tmp $(1); then rm -f $(1).tmp; else mv -f $(1).tmp $(1); fi
+CUTEST_CUTEST_O_RECIPE=$(CC) -c $(2) $(CUTEST_DEPS) $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) $(if $(CUTEST_BUILD_DIR),-D"CUTEST_OUTPUT_DIR=\"$(CUTEST_OUT_DIR)\"") -o $(1)
+CUTEST_MOCKABLES_S_RECIPE=$(CC) -S -fverbose-asm $(VISIBILITY_HIDDEN) -fno-inline -g -O0 -o $(1) -c $(2) $(CUTEST_DEPS) $(CUTEST_CFLAGS) $(CUTEST_IFLAGS) $(CUTEST_DEFINES) -D"static=" -D"inline=" -D"main=MAIN"
+CUTEST_MOCKABLES_O_RECIPE=$(CC) -o $(1) -c $(2)
+CUTEST_MOCKABLES_O_LINK_RECIPE=$(CC) $(VISIBILITY_HIDDEN) -fno-inline -g -O0 -o $(1) -c $(2) $(CUTEST_DEPS) $(CUTEST_CFLAGS) $(CUTEST_IFLAGS) $(CUTEST_DEFINES) -D"static=" -D"inline=" -D"main=MAIN"
+CUTEST_MOCKABLES_LST_RECIPE=(nm $(2) | sed 's/.* //g;s/^MAIN$$/main/' | grep -v '__stack_' | sort -u > $(1).tmp && grep 'gcc2_compiled.' >/dev/null $(1).tmp && sed -i 's/^_//g' $(1).tmp || true) && $(call cutest_update,$(1))
+CUTEST_PROXIFIED_S_RECIPE=$(CUTEST_PROX) $(2) > $(1).tmp && $(call cutest_update,$(1))
+CUTEST_WRAPPED_O_RECIPE=nm $(word 3,$(2)) | sed -n 's/^.* T cutest_//p' | cat - $(word 4,$(2)) | sort -u | grep -Fx -f $(word 2,$(2)) > $(1).mocked; \
+	objdump -t $(word 1,$(2)) | awk -f $(CUTEST_PATH)/cutest_wrap.awk $(1).mocked - > $(1).args && \
+	$(OBJCOPY) @$(1).args $(word 1,$(2)) $(1) && rm -f $(1).mocked $(1).args
+CUTEST_MOCK_PROTO=$(if $(filter dwarf,$(CUTEST_PROTOTYPES)),$(addprefix -d ,$(sort $(patsubst %.lst,%.o,$(1)) $(CUTEST_LIBC)_mockables.o)),$(CPROTO))
+CUTEST_MOCKS_H_RECIPE=$(CUTEST_MOCK) $(call CUTEST_MOCK_PROTO,$(word 2,$(2))) $(2) $(CUTEST_PATH) $(CUTEST_IFLAGS) > $(1).tmp && $(call cutest_update,$(1))
+CUTEST_MOCKS_C_RECIPE=$(CUTEST_MOCK) -c -l $(CUTEST_LIBC)_mocks.lst $(call CUTEST_MOCK_PROTO,$(word 2,$(2))) $(2) $(CUTEST_PATH) $(CUTEST_IFLAGS) > $(1).tmp && $(call cutest_update,$(1))
+CUTEST_LIBC_MOCKS_C_RECIPE=$(CUTEST_MOCK) -s $(call CUTEST_MOCK_PROTO,$(word 2,$(2))) $(2) $(CUTEST_PATH) $(CUTEST_IFLAGS) > $(1).tmp && $(call cutest_update,$(1))
+CUTEST_LIBC_MOCKS_LST_RECIPE=nm $(2) | sed -n 's/^.* T cutest_//p' | sort -u > $(1).tmp && $(call cutest_update,$(1))
+CUTEST_MOCKS_O_RECIPE=$(CC) -c $(2) $(CUTEST_DEPS) $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_TEST_DIR)) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) -o $(1)
+# The runner is compiled from several sources at once, in a rule that may have
+# :: entries too, so the headers of the test-suite are listed for the
+# test-runner program code instead, which is written even if it is the same,
+# to make the runner again.
+CUTEST_TEST_RUN_C_RECIPE=$(CC) -MM -MP -MT $(1) $(word 1,$(2)) $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_TEST_DIR)) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) > $(1).d && $(CUTEST_RUN) $(2) > $(1)
+CUTEST_TEST_RECIPE=$(CC) -o $(1) $(2) $(LTO) $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_TEST_DIR)) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) 3>&1 1>&2 2>&3 3>&-
+# A test suite is linked on its own into one object for the unity runner,
+# where its main() is renamed after the test suite and every other symbol
+# is made local, so that the test suites in the unity runner do not clash.
+CUTEST_UNITY_O_RECIPE=$(CC) -r -nostdlib -Wl,-d -o $(1).tmp $(2) $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_TEST_DIR)) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) 3>&1 1>&2 2>&3 3>&- && $(OBJCOPY) --redefine-sym main=cutest_unity_$(3) --keep-global-symbol=cutest_unity_$(3) $(1).tmp $(1) && rm -f $(1).tmp
+CUTEST_UNITY_RUN_C_RECIPE=$(CUTEST_RUN) --unity $(2) > $(1).tmp && $(call cutest_update,$(1))
+CUTEST_UNITY_RECIPE=$(CC) -o $(1) $(2) $(CUTEST_CFLAGS) $(CUTEST_DEFINES) 3>&1 1>&2 2>&3 3>&-
+
+# Quote a recipe to pass it on to cutest_make
+cutest_quote='$(subst ','\'',$(1))'
+
+$(CUTEST_OBJ_DIR)/cutest.o: $(CUTEST_PATH)/cutest.c | $(CUTEST_OBJ_DIR)
+	$(Q)$(call CUTEST_CUTEST_O_RECIPE,$@,$<)
 
 # Build a tool to generate a test suite runner.
 $(CUTEST_RUN):
@@ -198,59 +361,139 @@ $(CUTEST_PROX):
 $(CUTEST_WORK):
 	$(Q)$(MAKE) -s -r --no-print-directory -C $(CUTEST_PATH) cutest_work
 
-# Produce an object file to be processed to search for mockable functions
-.PRECIOUS: $(CUTEST_TEST_DIR)/%_mockables.o
-$(CUTEST_TEST_DIR)/%_mockables.o: $(CUTEST_SRC_DIR)/%.c
-	$(Q)$(CC) -o $@ -c $< $(CFLAGS) $(CUTEST_IFLAGS) -I$(CUTEST_SRC_DIR) $(CUTEST_DEFINES) $(VISIBILITY_HIDDEN) -fno-inline -g -D"inline="
+# Build a tool to build and run all test suites in one process.
+$(CUTEST_MAKE):
+	$(Q)$(MAKE) -s -r --no-print-directory -C $(CUTEST_PATH) cutest_make
 
-# Generate a list of all posible mockable functions
-.PRECIOUS: $(CUTEST_TEST_DIR)/%_mockables.lst
-$(CUTEST_TEST_DIR)/%_mockables.lst: $(CUTEST_TEST_DIR)/%_mockables.o
-	$(Q)nm $< | sed 's/.* //g' | grep -v '__stack_' | sort -u > $@ && \
-	grep 'gcc2_compiled.' >/dev/null $@ && sed -i 's/^_//g' $@ || true
+ifeq ($(CUTEST_MOCK_BACKEND),link)
+# Compile the design under test, this is the only time the compiler front end
+# sees it
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mockables.o
+$(CUTEST_OUT_DIR)/%_mockables.o: $(CUTEST_SRC_DIR)/%.c | $(CUTEST_OUT_DIR)
+	$(Q)$(call CUTEST_MOCKABLES_O_LINK_RECIPE,$@,$<)
+else
+# Generate an assembler file for later processing, this is the only time the
+# compiler front end sees the design under test
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mockables.s
+$(CUTEST_OUT_DIR)/%_mockables.s: $(CUTEST_SRC_DIR)/%.c | $(CUTEST_OUT_DIR)
+	$(Q)$(call CUTEST_MOCKABLES_S_RECIPE,$@,$<)
+
+# Assemble the very same assembler file to search for mockable functions
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mockables.o
+$(CUTEST_OUT_DIR)/%_mockables.o: $(CUTEST_OUT_DIR)/%_mockables.s
+	$(Q)$(call CUTEST_MOCKABLES_O_RECIPE,$@,$<)
+endif
 
-# Generate an assembler file for later processing
-.PRECIOUS: $(CUTEST_TEST_DIR)/%_mockables.s
-$(CUTEST_TEST_DIR)/%_mockables.s: $(CUTEST_SRC_DIR)/%.c
-	$(Q)$(CC) -S -fverbose-asm $(VISIBILITY_HIDDEN) -fno-inline -g -O0 \
-	-o $@ -c $^ $(CUTEST_CFLAGS) $(CUTEST_IFLAGS) $(CUTEST_DEFINES) -D"static=" -D"inline=" -D"main=MAIN"
+# Generate a list of all posible mockable functions, main() is renamed in the
+# assembler file so it is renamed back here
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mockables.lst
+$(CUTEST_OUT_DIR)/%_mockables.lst: $(CUTEST_OUT_DIR)/%_mockables.o
+	$(Q)$(call CUTEST_MOCKABLES_LST_RECIPE,$@,$<)
 
 # Generate an assembler output with all function calls replaced to cutest mocks/stubs
-.PRECIOUS: $(CUTEST_TEST_DIR)/%_proxified.s
-$(CUTEST_TEST_DIR)/%_proxified.s: $(CUTEST_TEST_DIR)/%_mockables.s $(CUTEST_TEST_DIR)/%_mockables.lst $(CUTEST_PROX)
-	$(Q)$(CUTEST_PROX) $< $(subst .s,.lst,$<) > $@
-
-.PRECIOUS: $(CUTEST_TEST_DIR)/%_mocks.h
-# Generate mocks from the call()-macro in a source-file.
-$(CUTEST_TEST_DIR)/%_mocks.h: $(CUTEST_SRC_DIR)/%.c $(CUTEST_TEST_DIR)/%_mockables.lst $(CUTEST_PATH)/cutest.h $(CUTEST_MOCK) $(CPROTO)
-	$(Q)$(CUTEST_MOCK) $(CPROTO) $(wordlist 1,2,$^) $(CUTEST_PATH) $(CUTEST_IFLAGS) > $@
-
-.PRECIOUS: $(CUTEST_TEST_DIR)/%_test_run.c
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_proxified.s
+$(CUTEST_OUT_DIR)/%_proxified.s: $(CUTEST_OUT_DIR)/%_mockables.s $(CUTEST_OUT_DIR)/%_mockables.lst $(CUTEST_PROX)
+	$(Q)$(call CUTEST_PROXIFIED_S_RECIPE,$@,$< $(subst .s,.lst,$<))
+
+# Rename the calls of the object file to go to the mock-ups instead. A called
+# function that is defined in the object file keeps a weak definition under
+# the name of its mock-up, that the mock-up overrides, and gets a new symbol
+# under its own name for the test cases that call it for real.
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_wrapped.o
+$(CUTEST_OUT_DIR)/%_wrapped.o: $(CUTEST_OUT_DIR)/%_mockables.o $(CUTEST_OUT_DIR)/%_mockables.lst $(CUTEST_OUT_DIR)/%_mocks.o $(CUTEST_LIBC)_mocks.lst $(CUTEST_PATH)/cutest_wrap.awk
+	$(Q)$(call CUTEST_WRAPPED_O_RECIPE,$@,$^)
+
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mocks.h
+# Generate mocks from the call()-macro in a source-file. The prototypes come
+# from the headers of the design under test as well, so the mocks are made
+# again when the design under test is compiled.
+$(CUTEST_OUT_DIR)/%_mocks.h: $(CUTEST_SRC_DIR)/%.c $(CUTEST_OUT_DIR)/%_mockables.lst $(CUTEST_PATH)/cutest.h $(CUTEST_MOCK) $(CUTEST_PROTO_DEPS) $(CUTEST_OUT_DIR)/$(CUTEST_MOCKABLES)
+	$(Q)$(call CUTEST_MOCKS_H_RECIPE,$@,$(wordlist 1,2,$^))
+
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mocks.c
+# Generate the mock-up implementations, kept out of the test-runner program
+# code so that they are not compiled again when the test-suite is edited
+$(CUTEST_OUT_DIR)/%_mocks.c: $(CUTEST_SRC_DIR)/%.c $(CUTEST_OUT_DIR)/%_mockables.lst $(CUTEST_PATH)/cutest.h $(CUTEST_MOCK) $(CUTEST_PROTO_DEPS) $(CUTEST_LIBC)_mocks.lst $(CUTEST_OUT_DIR)/$(CUTEST_MOCKABLES)
+	$(Q)$(call CUTEST_MOCKS_C_RECIPE,$@,$(wordlist 1,2,$^))
+
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_mocks.o
+$(CUTEST_OUT_DIR)/%_mocks.o: $(CUTEST_OUT_DIR)/%_mocks.c $(CUTEST_OUT_DIR)/%_mocks.h
+	$(Q)$(call CUTEST_MOCKS_O_RECIPE,$@,$<)
+
+# The shared C library mock-ups are made like the mock-ups of any design
+# under test, but only once, next to cutest.o
+.PRECIOUS: $(CUTEST_LIBC)_mockables.s $(CUTEST_LIBC)_mockables.o $(CUTEST_LIBC)_mockables.lst
+$(CUTEST_LIBC)_mockables.s: $(CUTEST_PATH)/cutest_libc.c | $(CUTEST_OBJ_DIR)
+	$(Q)$(call CUTEST_MOCKABLES_S_RECIPE,$@,$<)
+
+$(CUTEST_LIBC)_mockables.o: $(CUTEST_LIBC)_mockables.s
+	$(Q)$(call CUTEST_MOCKABLES_O_RECIPE,$@,$<)
+
+$(CUTEST_LIBC)_mockables.lst: $(CUTEST_LIBC)_mockables.o
+	$(Q)$(call CUTEST_MOCKABLES_LST_RECIPE,$@,$<)
+
+.PRECIOUS: $(CUTEST_LIBC)_mocks.h $(CUTEST_LIBC)_mocks.c $(CUTEST_LIBC)_mocks.o $(CUTEST_LIBC)_mocks.lst
+$(CUTEST_LIBC)_mocks.h: $(CUTEST_PATH)/cutest_libc.c $(CUTEST_LIBC)_mockables.lst $(CUTEST_PATH)/cutest.h $(CUTEST_MOCK) $(CUTEST_PROTO_DEPS)
+	$(Q)$(call CUTEST_MOCKS_H_RECIPE,$@,$(wordlist 1,2,$^))
+
+$(CUTEST_LIBC)_mocks.c: $(CUTEST_PATH)/cutest_libc.c $(CUTEST_LIBC)_mockables.lst $(CUTEST_PATH)/cutest.h $(CUTEST_MOCK) $(CUTEST_PROTO_DEPS)
+	$(Q)$(call CUTEST_LIBC_MOCKS_C_RECIPE,$@,$(wordlist 1,2,$^))
+
+$(CUTEST_LIBC)_mocks.o: $(CUTEST_LIBC)_mocks.c $(CUTEST_LIBC)_mocks.h
+	$(Q)$(call CUTEST_MOCKS_O_RECIPE,$@,$<)
+
+# The functions that the shared C library mock-ups implement
+$(CUTEST_LIBC)_mocks.lst: $(CUTEST_LIBC)_mocks.o
+	$(Q)$(call CUTEST_LIBC_MOCKS_LST_RECIPE,$@,$<)
+
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_test_run.c
 # Generate a test-runner program code from a test-source-file
-$(CUTEST_TEST_DIR)/%_test_run.c: $(CUTEST_TEST_DIR)/%_test.c $(CUTEST_TEST_DIR)/%_mocks.h $(CUTEST_PATH)/cutest.h $(CUTEST_RUN)
-	$(Q)$(CUTEST_RUN) $(wordlist 1,2,$^) > $@
+$(CUTEST_OUT_DIR)/%_test_run.c: $(CUTEST_TEST_DIR)/%_test.c $(CUTEST_OUT_DIR)/%_mocks.h $(CUTEST_PATH)/cutest.h $(CUTEST_RUN)
+	$(Q)$(call CUTEST_TEST_RUN_C_RECIPE,$@,$(wordlist 1,2,$^))
 
 # Compile a test-runner from the generate test-runner program code
-$(CUTEST_TEST_DIR)/%_test: $(CUTEST_TEST_DIR)/%_proxified.s $(CUTEST_TEST_DIR)/%_test_run.c $(CUTEST_PATH)/cutest.o
-	$(Q)$(CC) -o $@ $^ $(LTO) $(CUTEST_CFLAGS) -I$(CUTEST_PATH) -I$(abspath $(CUTEST_TEST_DIR)) -I$(abspath $(CUTEST_SRC_DIR)) $(CUTEST_IFLAGS) -DNDEBUG -D"inline=" $(CUTEST_DEFINES) 3>&1 1>&2 2>&3 3>&-
+$(CUTEST_OUT_DIR)/%_test: $(CUTEST_OUT_DIR)/$(CUTEST_PROXIFIED) $(CUTEST_OUT_DIR)/%_test_run.c $(CUTEST_OUT_DIR)/%_mocks.o $(CUTEST_OBJ_DIR)/cutest.o $(CUTEST_LIBC)_mocks.o
+	$(Q)$(call CUTEST_TEST_RECIPE,$@,$^)
+
+# Link a test suite, and the files in its CUTEST_LINK_<runner> variable, for
+# the unity runner
+.PRECIOUS: $(CUTEST_OUT_DIR)/%_test.unity.o
+$(CUTEST_OUT_DIR)/%_test.unity.o: $(CUTEST_OUT_DIR)/$(CUTEST_PROXIFIED) $(CUTEST_OUT_DIR)/%_test_run.c $(CUTEST_OUT_DIR)/%_mocks.o $(CUTEST_OBJ_DIR)/cutest.o $(CUTEST_LIBC)_mocks.o
+	$(Q)$(call CUTEST_UNITY_O_RECIPE,$@,$^ $(CUTEST_LINK_$(notdir $*)_test),$(notdir $*)_test)
+
+# Generate the main program of the unity runner, that runs its test suites
+# by their names
+$(CUTEST_UNITY_DIR)/cutest_unity_run.c: $(wildcard $(CUTEST_TEST_DIR)/*_test.c) $(CUTEST_RUN) | $(CUTEST_UNITY_DIR)
+	$(Q)$(call CUTEST_UNITY_RUN_C_RECIPE,$@,$(filter-out $(CUTEST_RUN),$^))
+
+$(CUTEST_UNITY): $(CUTEST_UNITY_DIR)/cutest_unity_run.c $(addsuffix .unity.o,$(CUTEST_RUNNERS))
+	$(Q)$(call CUTEST_UNITY_RECIPE,$@,$^)
+
+$(CUTEST_UNITY_DIR)/%_test: $(CUTEST_UNITY)
+	$(Q)ln -sf $(notdir $<) $@
+
+# The headers read by the compile steps, as the compiler found them
+ifeq ($(filter clean clean_cutest,$(MAKECMDGOALS)),)
+-include $(sort $(wildcard $(CUTEST_OBJ_DIR)/cutest.o.d $(CUTEST_LIBC)_*.d $(CUTEST_OUT_DIR)/*_mockables.s.d $(CUTEST_OUT_DIR)/*_mockables.o.d $(CUTEST_OUT_DIR)/*_mocks.o.d $(CUTEST_OUT_DIR)/*_test_run.c.d))
+endif
 
 # Print the CUTest manual
-$(CUTEST_TEST_DIR)/cutest_help.rst: $(CUTEST_PATH)/cutest.h
+$(CUTEST_OUT_DIR)/cutest_help.rst: $(CUTEST_PATH)/cutest.h
 	$(Q)grep -e '^ * ' $< | \
 	grep -v '*/' | \
 	grep -v -e '^  ' | \
 	sed -e 's/^ \* //g;s/^ \*//g' > $@
 
 # Output the CUTest manual as HTML
-$(CUTEST_TEST_DIR)/cutest_help.html: $(CUTEST_TEST_DIR)/cutest_help.rst
+$(CUTEST_OUT_DIR)/cutest_help.html: $(CUTEST_OUT_DIR)/cutest_help.rst
 	$(Q)rst2html $< > $@
 
 # Show the CUTest manual
-cutest_help: $(CUTEST_TEST_DIR)/cutest_help.rst
+cutest_help: $(CUTEST_OUT_DIR)/cutest_help.rst
 	$(Q)less $<
 
 # Produce a valgrind report
-$(CUTEST_TEST_DIR)/%_test.memcheck: $(CUTEST_TEST_DIR)/%_test
+$(CUTEST_OUT_DIR)/%_test.memcheck: $(CUTEST_OUT_DIR)/%_test
 	$(Q)valgrind -q --xml=yes --xml-file=$@ ./$< > /dev/null
 ifneq ($(MISSING_SOURCES),)
 	$(warning "Missing source(s) $(MISSING_SOURCES) - Did you delete the test?")
@@ -260,11 +503,11 @@ ifneq ($(MISSING_TEST_SUITES),)
 endif
 
 # If using CUTest without the cutest_work program to parallelize
-$(CUTEST_TEST_DIR)/%_test.junit_report.xml: $(CUTEST_TEST_DIR)/%_test
-	$(Q)$^ $V -j -s 1> $(subst _test,_test.stdout,$^) 2> $(subst _test,_test.stderr,$^)
+$(CUTEST_OUT_DIR)/%_test.junit_report.xml: $(CUTEST_OUT_DIR)/%_test
+	$(Q)$< $V -j -s 1> $<.stdout 2> $<.stderr
 
 # Run all test-suites on as many threads as needed gnu make
-makecheck:: $(subst .c,.junit_report.xml,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
+makecheck:: $(addsuffix .junit_report.xml,$(CUTEST_RUNNERS))
 ifneq ($(MISSING_SOURCES),)
 	$(warning "Missing source(s) $(MISSING_SOURCES) - Did you delete the test?")
 endif
@@ -274,21 +517,85 @@ endif
 	$(Q)echo
 
 # Run all test-suites on as many threads as needed using cutest_work
-check:: $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c)) $(CUTEST_WORK)
+check:: $(CUTEST_RUNNERS) $(CUTEST_WORK)
 ifneq ($(MISSING_SOURCES),)
 	$(warning "Missing source(s) $(MISSING_SOURCES) - Did you delete the test?")
 endif
 ifneq ($(MISSING_TEST_SUITES),)
 	$(warning "Missing test-suite(s) $(MISSING_TEST_SUITES) - Did you forget to write the test suites?")
 endif
-	$(Q)$(CUTEST_WORK) $V $(filter-out $(CUTEST_WORK),$^)
+	$(Q)$(CUTEST_WORK) $(if $(CUTEST_RESULTS),--results $(CUTEST_RESULTS)) $(CUTEST_WORK_FLAGS) $V $(filter-out $(CUTEST_WORK),$^)
 
+# Without a build directory the variants are made in the same place, one
+# at a time. With one, each variant is made by a make of its own, in its
+# own directory, once the tools they all use are made.
+ifeq ($(CUTEST_BUILD_DIR),)
 sanitize: check
+endif
+
+# Run all test-suites through the unity runner, which is linked once instead
+# of once per test-suite, and runs a few of them in every process it is
+# started as
+unitycheck: $(CUTEST_UNITY_RUNNERS) $(CUTEST_WORK)
+ifneq ($(MISSING_SOURCES),)
+	$(warning "Missing source(s) $(MISSING_SOURCES) - Did you delete the test?")
+endif
+ifneq ($(MISSING_TEST_SUITES),)
+	$(warning "Missing test-suite(s) $(MISSING_TEST_SUITES) - Did you forget to write the test suites?")
+endif
+	$(Q)$(CUTEST_WORK) $(if $(CUTEST_RESULTS),--results $(CUTEST_RESULTS)) --unity $(CUTEST_UNITY) $(CUTEST_WORK_FLAGS) $V $(filter-out $(CUTEST_WORK),$^)
+
+ifeq ($(CUTEST_MATRIX),yes)
+CUTEST_VARIANT_MAKEFILE:=$(abspath $(firstword $(MAKEFILE_LIST)))
+
+.PHONY: sanitize coverage
+sanitize coverage: $(CUTEST_WORK) $(CUTEST_RUN) $(CUTEST_MOCK) $(CUTEST_PROX) $(CUTEST_PROTO_TOOL)
+	$(Q)$(MAKE) -r --no-print-directory -f $(CUTEST_VARIANT_MAKEFILE) CUTEST_VARIANT=$@ check
+endif
+
+# Build and run all test-suites in one process, that knows every step of
+# every test-suite and runs a test-suite as soon as it is linked. Its graph
+# makes the mock-ups from the design under test and not from an object file,
+# so it always gets the prototypes from cproto.
+nativecheck: CUTEST_PROTOTYPES:=cproto
+nativecheck: $(CUTEST_MAKE) $(CUTEST_RUN) $(CUTEST_MOCK) $(CUTEST_PROX) $(CPROTO) $(CUTEST_LIBC)_mocks.o $(CUTEST_LIBC)_mocks.lst
+ifneq ($(MISSING_SOURCES),)
+	$(warning "Missing source(s) $(MISSING_SOURCES) - Did you delete the test?")
+endif
+ifneq ($(MISSING_TEST_SUITES),)
+	$(warning "Missing test-suite(s) $(MISSING_TEST_SUITES) - Did you forget to write the test suites?")
+endif
+	$(Q)$(CUTEST_MAKE) $(CUTEST_MAKE_FLAGS) $V \
+	--state $(CUTEST_OUT_DIR)/cutest_make.state --tools $(CUTEST_PATH) \
+	$(if $(CUTEST_BUILD_DIR),--build $(CUTEST_OUT_DIR)) \
+	--src $(CUTEST_SRC_DIR) --cproto $(CPROTO) \
+	$(if $(CUTEST_CC_PATH),--cc $(CUTEST_CC_PATH)) \
+	$(if $(CUTEST_CACHE),--cache $(CUTEST_CACHE)) \
+	--recipe cutest.o $(call cutest_quote,$(call CUTEST_CUTEST_O_RECIPE,%t,%1)) \
+	--recipe mockables.s $(call cutest_quote,$(call CUTEST_MOCKABLES_S_RECIPE,%t,%1)) \
+	--recipe mockables.o $(call cutest_quote,$(call CUTEST_MOCKABLES_O_RECIPE,%t,%1)) \
+	--recipe mockables.lst $(call cutest_quote,$(call CUTEST_MOCKABLES_LST_RECIPE,%t,%1)) \
+	--recipe proxified.s $(call cutest_quote,$(call CUTEST_PROXIFIED_S_RECIPE,%t,%1 %2)) \
+	--recipe mocks.h $(call cutest_quote,$(call CUTEST_MOCKS_H_RECIPE,%t,%1 %2)) \
+	--recipe mocks.c $(call cutest_quote,$(call CUTEST_MOCKS_C_RECIPE,%t,%1 %2)) \
+	--recipe mocks.o $(call cutest_quote,$(call CUTEST_MOCKS_O_RECIPE,%t,%1)) \
+	--recipe test_run.c $(call cutest_quote,$(call CUTEST_TEST_RUN_C_RECIPE,%t,%1 %2)) \
+	--recipe test $(call cutest_quote,$(call CUTEST_TEST_RECIPE,%t,%1 %2 %3 %4 %5 %x)) \
+	$(foreach s,$(notdir $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))),$(if $(CUTEST_LINK_$(s)),--link $(s) "$(CUTEST_LINK_$(s))")) \
+	$(wildcard $(CUTEST_TEST_DIR)/*_test.c)
+
+# Rerun the test-suites whose sources change, until interrupted
+watch:: $(CUTEST_RUNNERS) $(CUTEST_WORK)
+	$(Q)$(CUTEST_WORK) $(CUTEST_WORK_FLAGS) $V --watch $(CUTEST_SRC_DIR) --watch-tests $(CUTEST_TEST_DIR) --rebuild "$(MAKE) -s -r --no-print-directory -f $(abspath $(firstword $(MAKEFILE_LIST)))" $(filter-out $(CUTEST_WORK),$^)
 
 # Perform a memcheck on any test suite
-memcheck:: $(subst .c,.memcheck,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
+memcheck:: $(addsuffix .memcheck,$(CUTEST_RUNNERS))
 
-valgrind:: $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c)) $(CUTEST_PATH)/cutest_work
+ifeq ($(CUTEST_MATRIX),yes)
+valgrind:: $(CUTEST_WORK) $(CUTEST_RUN) $(CUTEST_MOCK) $(CUTEST_PROX) $(CUTEST_PROTO_TOOL)
+	$(Q)$(MAKE) -r --no-print-directory -f $(CUTEST_VARIANT_MAKEFILE) CUTEST_VARIANT=valgrind valgrind
+else
+valgrind:: $(CUTEST_RUNNERS) $(CUTEST_PATH)/cutest_work
 ifneq ($(MISSING_SOURCES),)
 	$(warning "Missing source(s) $(MISSING_SOURCES) - Did you delete the test?")
 endif
@@ -296,10 +603,11 @@ ifneq ($(MISSING_TEST_SUITES),)
 	$(warning "Missing test-suite(s) $(MISSING_TEST_SUITES) - Did you forget to write the test suites?")
 endif
 #	$(Q)$(CUTEST_PATH)/cutest_work -V $(addprefix $(CUTEST_TEST_DIR)/,$(filter-out $(CUTEST_PATH)/cutest_work,$^))
-	$(Q)$(CUTEST_PATH)/cutest_work -V $(filter-out $(CUTEST_PATH)/cutest_work,$^)
+	$(Q)$(CUTEST_PATH)/cutest_work $(CUTEST_WORK_FLAGS) -V $(filter-out $(CUTEST_PATH)/cutest_work,$^)
+endif
 
 # Run all test-suites on as many threads as needed and verify with valgrind
-makevalgrind:: $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
+makevalgrind:: $(CUTEST_RUNNERS)
 	@R=true; \
 	processors=`cat /proc/cpuinfo | grep processor | wc -l`; \
 	for i in $^; do \
@@ -314,46 +622,71 @@ makevalgrind:: $(subst .c,,$(wildcard $(CUTEST_TEST_DIR)/*_test.c))
 #
 # Dependencies described for test cases
 #
-$(CUTEST_TEST_DIR)/cutest_run_test:: helpers.c testcase.c
+# The extra files linked into a runner are kept in a CUTEST_LINK_<runner>
+# variable, which is passed on to cutest_make as well.
+#
+CUTEST_LINK_cutest_run_test=helpers.c testcase.c
+$(CUTEST_OUT_DIR)/cutest_run_test:: $(CUTEST_LINK_cutest_run_test)
+
+CUTEST_LINK_cutest_mock_test=helpers.c mockable.c arg.c dwarf.c
+$(CUTEST_OUT_DIR)/cutest_mock_test:: $(CUTEST_LINK_cutest_mock_test)
 
-$(CUTEST_TEST_DIR)/cutest_mock_test:: helpers.c mockable.c arg.c
+CUTEST_LINK_cutest_prox_test=helpers.c
+$(CUTEST_OUT_DIR)/cutest_prox_test:: $(CUTEST_LINK_cutest_prox_test)
 
-$(CUTEST_TEST_DIR)/cutest_prox_test:: helpers.c
+CUTEST_LINK_cutest_work_test=helpers.c net.c
+$(CUTEST_OUT_DIR)/cutest_work_test:: $(CUTEST_LINK_cutest_work_test)
 
-$(CUTEST_TEST_DIR)/cutest_work_test:: helpers.c
+CUTEST_LINK_cutest_make_test=helpers.c net.c
+$(CUTEST_OUT_DIR)/cutest_make_test:: $(CUTEST_LINK_cutest_make_test)
 
-$(CUTEST_TEST_DIR)/mockable_test:: arg.c list.c
+CUTEST_LINK_mockable_test=arg.c list.c
+$(CUTEST_OUT_DIR)/mockable_test:: $(CUTEST_LINK_mockable_test)
 
 clean_cutest:
 	$(Q)$(MAKE) -s -r --no-print-directory -C $(CUTEST_PATH) -f $(CUTEST_PATH)/Makefile clean
 
 clean::
-	$(Q)$(RM) -f $(CUTEST_TEST_DIR)/*_test_run.c \
+	$(Q)$(RM) -f $(CUTEST_OUT_DIR)/*_test_run.c \
 	$(CUTEST_PATH)/empty \
-	$(CUTEST_PATH)/cutest.o \
+	$(CUTEST_OBJ_DIR)/cutest.o \
+	$(CUTEST_OBJ_DIR)/cutest.o.d \
+	$(CUTEST_OUT_DIR)/*_mocks.*.tmp \
+	$(CUTEST_OUT_DIR)/*_mocks.o.d \
+	$(CUTEST_OUT_DIR)/*_test_run.c.d \
+	$(CUTEST_OUT_DIR)/*_test.unity.o \
+	$(CUTEST_LIBC)_mocks.* \
+	$(CUTEST_LIBC)_mockables.* \
+	$(CUTEST_CONFIG) \
 	$(CUTEST_TEST_DIR)/cutest_run \
 	$(CUTEST_TEST_DIR)/cutest_mock \
 	$(CUTEST_TEST_DIR)/cutest_prox \
 	$(CUTEST_TEST_DIR)/cutest_work \
+	$(CUTEST_TEST_DIR)/cutest_make \
+	$(CUTEST_OUT_DIR)/cutest_make.state \
 	$(CUTEST_TEST_DIR)/cutest_filt \
 	$(CUTEST_TEST_DIR)/cutest_filt.c \
-	$(CUTEST_TEST_DIR)/*_mocks.h \
-	$(CUTEST_TEST_DIR)/*.junit_report.xml \
+	$(CUTEST_OUT_DIR)/*_mocks.h \
+	$(CUTEST_OUT_DIR)/*_mocks.c \
+	$(CUTEST_OUT_DIR)/*_mocks.o \
+	$(CUTEST_OUT_DIR)/*.junit_report.xml \
 	$(CUTEST_SRC_DIR)/*.junit_report.xml \
 	$(CUTEST_SRC_DIR)/default.profraw \
-	$(CUTEST_TEST_DIR)/*.memcheck \
-	$(CUTEST_TEST_DIR)/*_test \
-	$(CUTEST_TEST_DIR)/*_test.stderr \
-	$(CUTEST_TEST_DIR)/*_test.stdout \
-	$(CUTEST_TEST_DIR)/*_test.exe \
+	$(CUTEST_OUT_DIR)/*.memcheck \
+	$(CUTEST_OUT_DIR)/*_test \
+	$(CUTEST_OUT_DIR)/*_test.stderr \
+	$(CUTEST_OUT_DIR)/*_test.stdout \
+	$(CUTEST_OUT_DIR)/*_test.exe \
 	$(CUTEST_TEST_DIR)/*.tu \
-	$(CUTEST_TEST_DIR)/*_mockables.* \
-	$(CUTEST_TEST_DIR)/*_proxified.* \
-	$(CUTEST_TEST_DIR)/cutest_help.rst \
-	$(CUTEST_TEST_DIR)/cutest_help.html \
+	$(CUTEST_OUT_DIR)/*_mockables.* \
+	$(CUTEST_OUT_DIR)/*_proxified.* \
+	$(CUTEST_OUT_DIR)/*_wrapped.* \
+	$(CUTEST_OUT_DIR)/cutest_help.rst \
+	$(CUTEST_OUT_DIR)/cutest_help.html \
 	$(CUTEST_TEST_DIR)/cutest_sources.lst \
 	$(CUTEST_TEST_DIR)/cutest_testsuites.lst \
-	$(CUTEST_TEST_DIR)/*_test.log \
+	$(CUTEST_OUT_DIR)/*_test.log \
+	$(CUTEST_OUT_DIR)/*_test.*.log \
 	$(CUTEST_TEST_DIR)/*~ \
 	$(CUTEST_PATH)/*.uaem \
 	$(CUTEST_SRC_DIR)/*.uaem \
@@ -362,4 +695,5 @@ clean::
 	$(CUTEST_PATH)/*.gcda \
 	$(CUTEST_SRC_DIR)/*.gcda \
 	$(CUTEST_TEST_DIR)/*.uaem && \
-	$(RM) -rf $(CUTEST_PATH)/.terminfo
+	$(RM) -rf $(CUTEST_PATH)/.terminfo $(CUTEST_RESULTS) $(CUTEST_UNITY_DIR) \
+	$(if $(CUTEST_BUILD_DIR),$(addprefix $(abspath $(CUTEST_BUILD_DIR))/,$(CUTEST_VARIANTS)))
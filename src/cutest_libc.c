@@ -0,0 +1,81 @@
+/*
+ * CUTest shared C library mock-ups
+ * ================================
+ *
+ * Nearly every design under test calls the same C library functions, so
+ * their mock-ups are generated and compiled once, from this file, into
+ * ``cutest_libc_mocks.o`` which is linked into every test suite runner.
+ * A test suite still has a mock control structure of its own for each
+ * of them, so they are used from the test cases just like any other
+ * mock-up.
+ *
+ * Only functions whose prototypes are the same no matter what feature
+ * test macros a design under test defines belong here. Any other
+ * function is mocked by each test suite on its own, as before.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef void (*cutest_libc_func_t)(void);
+
+cutest_libc_func_t cutest_libc[] = {
+  /* stdio.h */
+  (cutest_libc_func_t)printf,
+  (cutest_libc_func_t)fprintf,
+  (cutest_libc_func_t)sprintf,
+  (cutest_libc_func_t)puts,
+  (cutest_libc_func_t)fputs,
+  (cutest_libc_func_t)fputc,
+  (cutest_libc_func_t)putchar,
+  (cutest_libc_func_t)fopen,
+  (cutest_libc_func_t)fclose,
+  (cutest_libc_func_t)fread,
+  (cutest_libc_func_t)fwrite,
+  (cutest_libc_func_t)fgets,
+  (cutest_libc_func_t)fflush,
+  (cutest_libc_func_t)feof,
+  (cutest_libc_func_t)ferror,
+  (cutest_libc_func_t)remove,
+  (cutest_libc_func_t)rename,
+  (cutest_libc_func_t)perror,
+  /* stdlib.h */
+  (cutest_libc_func_t)malloc,
+  (cutest_libc_func_t)calloc,
+  (cutest_libc_func_t)realloc,
+  (cutest_libc_func_t)free,
+  (cutest_libc_func_t)exit,
+  (cutest_libc_func_t)abort,
+  (cutest_libc_func_t)atoi,
+  (cutest_libc_func_t)strtol,
+  (cutest_libc_func_t)strtoul,
+  (cutest_libc_func_t)strtod,
+  (cutest_libc_func_t)getenv,
+  (cutest_libc_func_t)qsort,
+  /* string.h */
+  (cutest_libc_func_t)strlen,
+  (cutest_libc_func_t)strcpy,
+  (cutest_libc_func_t)strncpy,
+  (cutest_libc_func_t)strcat,
+  (cutest_libc_func_t)strncat,
+  (cutest_libc_func_t)strcmp,
+  (cutest_libc_func_t)strncmp,
+  (cutest_libc_func_t)strchr,
+  (cutest_libc_func_t)strrchr,
+  (cutest_libc_func_t)strstr,
+  (cutest_libc_func_t)strcspn,
+  (cutest_libc_func_t)strspn,
+  (cutest_libc_func_t)memcmp,
+  (cutest_libc_func_t)memcpy,
+  (cutest_libc_func_t)memmove,
+  (cutest_libc_func_t)memset,
+  /* unistd.h and sys/stat.h */
+  (cutest_libc_func_t)close,
+  (cutest_libc_func_t)read,
+  (cutest_libc_func_t)write,
+  (cutest_libc_func_t)unlink,
+  (cutest_libc_func_t)access,
+  (cutest_libc_func_t)stat
+};
@@ -0,0 +1,1660 @@
+/*********************************************************************
+   ---    ____ ____ _____ ____ ____ _____   __  __ ____ __ __ ____ ---
+   ---   / __// / //_  _// __// __//_  _/  /  \/ // _ // //.'/ __/ ---
+   ---  / /_ / / /  / / / __//_  /  / /   / /\_/ //   //  <' / __/  ---
+   --- /___//___/  /_/ /___//___/  /_/   /_/  /_//_/_//_/\_\/___/  ---
+ *
+ * CUTest make
+ * ===========
+ *
+ * The ``cutest_make`` tool builds and runs all test suites in one go.
+ * It knows every step from a design under test and its test to a
+ * runner, and runs the steps of all test suites in parallel. A runner is
+ * run as soon as it is linked, while the others are still being built.
+ *
+ * Usage
+ * -----
+ *
+ * The ``nativecheck`` target in ``cutest.mk`` runs the tool for you, with
+ * the same recipes as ``make check`` uses. Extra options can be passed
+ * through the ``CUTEST_MAKE_FLAGS`` variable::
+ *
+ *  $ make nativecheck CUTEST_MAKE_FLAGS="-j 8"
+ *
+ * A step is only run when its recipe, or the content of anything it is
+ * made from, has changed since it was last run. The headers that a step
+ * includes are taken from the ``.d`` file that its recipe writes next to
+ * the target with ``-MMD``, as in ``cutest.mk``, and read again after
+ * every run. The mock-ups are made from the headers of the mockables.
+ * The content hashes are kept in the ``--state`` file, together with the
+ * time and size of every file, so only files that have been touched are
+ * hashed again. A step that makes the very same file as before does not
+ * make anything made from it run again.
+ *
+ * The steps that are ready to run are taken by any free worker, the
+ * latest step first, so the runners are linked and run as early as
+ * possible. Anything made from a failing step is not made, but the other
+ * test suites are.
+ *
+ * Given ``--cache DIR`` every file that is made is also kept in ``DIR``,
+ * named after its key, which is the hash of its recipe and the content
+ * of everything it is made from, the headers, the tools and the ``--cc``
+ * compiler included. A step whose key is found there is not run, the
+ * file is copied from the cache instead. This saves the steps that would
+ * run after a branch switch back and forth, or in a fresh checkout at
+ * the same path, since the timestamps and the state are gone but the
+ * content is the same. The ``.d`` file of a step is kept there too,
+ * named after the key without the headers, so a checkout that has not
+ * run the step yet knows which headers to hash. The cache can be shared
+ * by several checkouts, ``cutest.mk`` passes the ``CUTEST_CACHE``
+ * variable for it::
+ *
+ *  $ make nativecheck CUTEST_CACHE=~/.cache/cutest
+ *
+ * Given ``--build DIR`` everything is made in ``DIR`` instead of next
+ * to the test suites, and ``cutest.o`` and the shared C library mock-ups
+ * are taken from there too. ``cutest.mk`` passes the directory of the
+ * variant when ``CUTEST_BUILD_DIR`` is set.
+ *
+ * The extra files to link into a runner, that ``make`` gets from rules
+ * like ``foo_test:: bar.c``, are given with ``--link foo_test "bar.c"``.
+ * ``cutest.mk`` passes the ``CUTEST_LINK_foo_test`` variable for it.
+ *
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "cutest_make.h"
+#include "helpers.h"
+#include "net.h"
+
+#define DEFAULT_STATE "cutest_make.state"
+#define MAX_INPUTS 12
+#define RUNNER_INPUTS 5 /* proxified.s, test_run.c and three objects */
+#define STATE_LINE_LEN 8192
+#define TEST_SUFFIX "_test.c"
+
+/*
+ * The names of the steps, as given to --recipe, and what their targets
+ * are called after the name of the test suite.
+ */
+static const char* step_name[CUTEST_MAKE_STEPS] = {
+  "cutest.o", "mockables.s", "mockables.o", "mockables.lst", "proxified.s",
+  "mocks.h", "mocks.c", "mocks.o", "test_run.c", "test", "run"
+};
+
+static const char* step_suffix[CUTEST_MAKE_STEPS] = {
+  NULL, "_mockables.s", "_mockables.o", "_mockables.lst", "_proxified.s",
+  "_mocks.h", "_mocks.c", "_mocks.o", "_test_run.c", "_test", "_test.stdout"
+};
+
+/* A runner writes its verdicts to a file, which is printed when done */
+#define RUN_RECIPE "%1 %v -j -s 1> %t 2> %1.stderr"
+
+static void usage(const char* program_name)
+{
+  printf("USAGE: %s [-j N] [--state FILE] [--tools DIR] [--src DIR]\n"
+         "       [--build DIR] [--cproto PATH] [--cc PATH] [--cache DIR]\n"
+         "       [--recipe STEP CMD] [--link SUITE FILES]\n"
+         "       <-v|-n> suite1_test.c suite2_test.c .. suiteN_test.c\n\n"
+         "  -v  Be verbose, print the recipes and all test names\n"
+         "  -n  Only print the progress of the runners\n"
+         "  -j  Run at most N steps in parallel (default is one per core)\n"
+         "  --state FILE   Keep the content hashes in FILE (default is %s)\n"
+         "  --tools DIR    Where cutest.c and the cutest tools are\n"
+         "  --src DIR      Where the designs under test are\n"
+         "  --build DIR    Make everything in DIR (default is next to the\n"
+         "                 test suites, and cutest.o next to cutest.c)\n"
+         "  --cproto PATH  The cproto the mocks are made with\n"
+         "  --cc PATH      The compiler binary, to compile again if it changes\n"
+         "  --cache DIR    Keep every made file in DIR, to copy it from there\n"
+         "                 instead of making it again\n"
+         "  --recipe STEP CMD  The shell command that makes a step, where %%t is\n"
+         "                     the target, %%1 to %%9 the inputs and %%x the extra\n"
+         "                     files to link. The steps are cutest.o,\n"
+         "                     mockables.s, mockables.o, mockables.lst,\n"
+         "                     proxified.s, mocks.h, mocks.c, mocks.o,\n"
+         "                     test_run.c and test. The compiling ones may\n"
+         "                     list the headers they include in %%t.d\n"
+         "  --link SUITE FILES  Also link the space separated FILES into the\n"
+         "                      runner of SUITE\n\n",
+         program_name, DEFAULT_STATE);
+}
+
+static int get_number_of_cores()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  return sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  return 1;
+#endif
+}
+
+static long parse_number(const char* str)
+{
+  char* end = NULL;
+  long value = 0;
+
+  if (NULL == str) {
+    return -1;
+  }
+  value = strtol(str, &end, 10);
+  if ((end == str) || ('\0' != *end) || (value < 1)) {
+    return -1;
+  }
+  return value;
+}
+
+static int find_step(const char* name)
+{
+  int i;
+
+  for (i = 0; i < CUTEST_MAKE_RUN; i++) {
+    if (0 == strcmp(step_name[i], name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void handle_args(cutest_make_opts_t* opts, int argc, char* argv[])
+{
+  const char* program_name = argv[0];
+  int i;
+
+  memset(opts, 0, sizeof(*opts));
+  opts->state = DEFAULT_STATE;
+  opts->tools = ".";
+  opts->src = ".";
+  opts->recipe[CUTEST_MAKE_RUN] = RUN_RECIPE;
+
+  if (argc < 3) {
+    usage(program_name);
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 1; i < argc; i++) {
+    const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    const char* next = (i + 2 < argc) ? argv[i + 2] : NULL;
+
+    if ('-' != argv[i][0]) {
+      break;
+    }
+    if (0 == strcmp("-v", argv[i])) {
+      opts->verbose = 1;
+    }
+    else if (0 == strcmp("-n", argv[i])) {
+      opts->verbose = -1;
+    }
+    else if (0 == strcmp("-j", argv[i])) {
+      if (0 > (opts->jobs = parse_number(value))) {
+        fprintf(stderr, "ERROR: -j needs a positive number of workers\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--state", argv[i])) {
+      if (NULL == (opts->state = value)) {
+        fprintf(stderr, "ERROR: --state needs a file name\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--tools", argv[i])) {
+      if (NULL == (opts->tools = value)) {
+        fprintf(stderr, "ERROR: --tools needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--src", argv[i])) {
+      if (NULL == (opts->src = value)) {
+        fprintf(stderr, "ERROR: --src needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--build", argv[i])) {
+      if (NULL == (opts->build = value)) {
+        fprintf(stderr, "ERROR: --build needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--cproto", argv[i])) {
+      if (NULL == (opts->cproto = value)) {
+        fprintf(stderr, "ERROR: --cproto needs a path\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--cc", argv[i])) {
+      if (NULL == (opts->cc = value)) {
+        fprintf(stderr, "ERROR: --cc needs a path\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--cache", argv[i])) {
+      if (NULL == (opts->cache = value)) {
+        fprintf(stderr, "ERROR: --cache needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--recipe", argv[i])) {
+      const int step = (NULL != value) ? find_step(value) : -1;
+
+      if ((-1 == step) || (NULL == next)) {
+        fprintf(stderr, "ERROR: --recipe needs a step and a command\n");
+        exit(EXIT_FAILURE);
+      }
+      opts->recipe[step] = next;
+      i += 2;
+    }
+    else if (0 == strcmp("--link", argv[i])) {
+      if ((NULL == value) || (NULL == next)) {
+        fprintf(stderr, "ERROR: --link needs a test suite and files\n");
+        exit(EXIT_FAILURE);
+      }
+      if (CUTEST_MAKE_MAX_LINKS == opts->link_cnt) {
+        fprintf(stderr, "ERROR: --link can be given at most %d times\n",
+                CUTEST_MAKE_MAX_LINKS);
+        exit(EXIT_FAILURE);
+      }
+      opts->link_suite[opts->link_cnt] = value;
+      opts->link_files[opts->link_cnt] = next;
+      opts->link_cnt++;
+      i += 2;
+    }
+    else {
+      usage(program_name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  opts->first_suite = i;
+
+  if ((0 == opts->verbose) || (opts->first_suite >= argc)) {
+    usage(program_name);
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < CUTEST_MAKE_RUN; i++) {
+    if (NULL == opts->recipe[i]) {
+      fprintf(stderr, "ERROR: There is no --recipe for %s\n", step_name[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+static unsigned long get_path_hash(const char* path)
+{
+  /* FNV-1a, only to find the nodes by their paths */
+  unsigned long hash = 2166136261UL;
+
+  while ('\0' != *path) {
+    hash ^= (unsigned char)*path++;
+    hash = (hash * 16777619UL) & 0xffffffffUL;
+  }
+  return hash;
+}
+
+static void fold_hash(unsigned long long* value, const char* str)
+{
+  /* FNV-1a, with the terminating zero to keep the strings apart */
+  do {
+    *value ^= (unsigned char)*str;
+    *value *= 1099511628211ULL;
+  } while ('\0' != *str++);
+}
+
+static void delete_graph(cutest_make_graph_t* graph)
+{
+  int i;
+
+  for (i = 0; i < graph->cnt; i++) {
+    free(graph->node[i].path);
+    free(graph->node[i].input);
+    free(graph->node[i].dependent);
+    free(graph->node[i].header);
+  }
+  free(graph->node);
+  free(graph->index);
+  free(graph->ready);
+  free(graph);
+}
+
+static cutest_make_graph_t* new_graph()
+{
+  cutest_make_graph_t* graph = calloc(1, sizeof(cutest_make_graph_t));
+
+  if (NULL == graph) {
+    fprintf(stderr, "ERROR: Out of memory while allocating the graph\n");
+  }
+  return graph;
+}
+
+static int find_node(const cutest_make_graph_t* graph, const char* path)
+{
+  unsigned long i;
+
+  if (0 == graph->index_size) {
+    return -1;
+  }
+  i = get_path_hash(path) & (graph->index_size - 1);
+  while (-1 != graph->index[i]) {
+    if (0 == strcmp(graph->node[graph->index[i]].path, path)) {
+      return graph->index[i];
+    }
+    i = (i + 1) & (graph->index_size - 1);
+  }
+  return -1;
+}
+
+static int index_nodes(cutest_make_graph_t* graph)
+{
+  /* The index is kept at most half full, to keep the probes short */
+  const int size = (0 == graph->index_size) ? 64 : graph->index_size * 2;
+  int* index = malloc(size * sizeof(int));
+  int i;
+
+  if (NULL == index) {
+    fprintf(stderr, "ERROR: Out of memory while indexing the graph\n");
+    return -1;
+  }
+  for (i = 0; i < size; i++) {
+    index[i] = -1;
+  }
+  free(graph->index);
+  graph->index = index;
+  graph->index_size = size;
+
+  for (i = 0; i < graph->cnt; i++) {
+    unsigned long j = get_path_hash(graph->node[i].path) & (size - 1);
+
+    while (-1 != index[j]) {
+      j = (j + 1) & (size - 1);
+    }
+    index[j] = i;
+  }
+  return 0;
+}
+
+static int add_node(cutest_make_graph_t* graph, const char* path, int step)
+{
+  /* A node is only added once per path */
+  cutest_make_node_t* node = NULL;
+  int i = find_node(graph, path);
+
+  if (-1 != i) {
+    return i;
+  }
+  if (graph->cnt == graph->size) {
+    node = realloc(graph->node,
+                   (graph->size + 256) * sizeof(cutest_make_node_t));
+    if (NULL == node) {
+      fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", path);
+      return -1;
+    }
+    graph->node = node;
+    graph->size += 256;
+  }
+  node = &graph->node[graph->cnt];
+  memset(node, 0, sizeof(*node));
+  node->step = step;
+  node->deps = -1;
+  node->status = CUTEST_MAKE_WAITING;
+  if (NULL == (node->path = malloc(strlen(path) + 1))) {
+    fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", path);
+    return -1;
+  }
+  strcpy(node->path, path);
+  graph->cnt++;
+
+  if ((2 * graph->cnt > graph->index_size) && (0 != index_nodes(graph))) {
+    return -1;
+  }
+  if (-1 == find_node(graph, path)) {
+    /* Not re-indexed, so just put it in */
+    unsigned long j = get_path_hash(path) & (graph->index_size - 1);
+
+    while (-1 != graph->index[j]) {
+      j = (j + 1) & (graph->index_size - 1);
+    }
+    graph->index[j] = graph->cnt - 1;
+  }
+  return graph->cnt - 1;
+}
+
+static int add_dependent(cutest_make_node_t* node, int dependent)
+{
+  int* more = realloc(node->dependent,
+                      (node->dependent_cnt + 1) * sizeof(int));
+
+  if (NULL == more) {
+    fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", node->path);
+    return -1;
+  }
+  node->dependent = more;
+  node->dependent[node->dependent_cnt++] = dependent;
+  return 0;
+}
+
+static int add_target(cutest_make_graph_t* graph, const char* path, int step,
+                      const int* input, int input_cnt, int arg_cnt,
+                      const char* extra)
+{
+  /* A target made from the given nodes, the first arg_cnt are arguments */
+  int target = -1;
+  int i;
+
+  for (i = 0; i < input_cnt; i++) {
+    if (-1 == input[i]) {
+      return -1;
+    }
+  }
+  target = add_node(graph, path, step);
+  if ((-1 == target) || (NULL != graph->node[target].input)) {
+    return target; /* Already made from something */
+  }
+  graph->node[target].input = malloc(input_cnt * sizeof(int));
+  if (NULL == graph->node[target].input) {
+    fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", path);
+    return -1;
+  }
+  for (i = 0; i < input_cnt; i++) {
+    if (0 != add_dependent(&graph->node[input[i]], target)) {
+      return -1;
+    }
+    graph->node[target].input[i] = input[i];
+  }
+  graph->node[target].input_cnt = input_cnt;
+  graph->node[target].arg_cnt = arg_cnt;
+  graph->node[target].extra = extra;
+  return target;
+}
+
+static int add_file(cutest_make_graph_t* graph, const char* dir,
+                    const char* name)
+{
+  /* A file that is not made, such as a source or a tool */
+  char* path = malloc(((NULL != dir) ? strlen(dir) : 0) + strlen(name) + 2);
+  int retval = -1;
+
+  if (NULL == path) {
+    fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", name);
+    return -1;
+  }
+  if (NULL == dir) {
+    strcpy(path, name);
+  }
+  else {
+    sprintf(path, "%s/%s", dir, name);
+  }
+  retval = add_node(graph, path, CUTEST_MAKE_SOURCE);
+  free(path);
+  return retval;
+}
+
+static int add_extra_files(cutest_make_graph_t* graph, const char* files,
+                           int* input, int cnt)
+{
+  /* The space separated files to link into a runner */
+  char name[1024];
+
+  while ('\0' != *files) {
+    const size_t len = strcspn(files, " ");
+
+    if (len >= sizeof(name)) {
+      fprintf(stderr, "ERROR: The file name '%s' is too long\n", files);
+      return -1;
+    }
+    if (0 != len) {
+      if (MAX_INPUTS == cnt) {
+        fprintf(stderr, "ERROR: At most %d files can be linked\n",
+                MAX_INPUTS - RUNNER_INPUTS);
+        return -1;
+      }
+      strncpy(name, files, len);
+      name[len] = '\0';
+      if (-1 == (input[cnt++] = add_file(graph, NULL, name))) {
+        return -1;
+      }
+    }
+    files += len + (' ' == files[len]);
+  }
+  return cnt;
+}
+
+static int add_compiler(cutest_make_graph_t* graph,
+                        const cutest_make_opts_t* opts, int* input, int cnt)
+{
+  /* Whatever is compiled is compiled again by another compiler */
+  if (NULL != opts->cc) {
+    input[cnt++] = add_file(graph, NULL, opts->cc);
+  }
+  return cnt;
+}
+
+static const char* get_extra_files(const cutest_make_opts_t* opts,
+                                   const char* suite)
+{
+  int i;
+
+  for (i = 0; i < opts->link_cnt; i++) {
+    if (0 == strcmp(opts->link_suite[i], suite)) {
+      return opts->link_files[i];
+    }
+  }
+  return NULL;
+}
+
+static void get_target_path(char* buf, const char* build, const char* test,
+                            const char* suffix)
+{
+  /* foo_test.c is turned into foo<suffix>, next to it or in build */
+  const char* name = strrchr(test, '/');
+
+  if (NULL == build) {
+    sprintf(buf, "%.*s%s", (int)(strlen(test) - strlen(TEST_SUFFIX)), test,
+            suffix);
+    return;
+  }
+  name = (NULL == name) ? test : name + 1;
+  sprintf(buf, "%s/%.*s%s", build, (int)(strlen(name) - strlen(TEST_SUFFIX)),
+          name, suffix);
+}
+
+static const char* get_object_dir(const cutest_make_opts_t* opts)
+{
+  /* cutest.o and the shared C library mock-ups are made with the suites */
+  return (NULL == opts->build) ? opts->tools : opts->build;
+}
+
+static char* new_deps_name(const char* path)
+{
+  /* The recipes write the headers they include next to their targets */
+  char* name = malloc(strlen(path) + 3);
+
+  if (NULL == name) {
+    fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", path);
+    return NULL;
+  }
+  sprintf(name, "%s.d", path);
+  return name;
+}
+
+static int read_headers(cutest_make_graph_t* graph, int idx)
+{
+  /*
+   * The headers in the .d file that the recipe of the node, or of the
+   * node it takes them from, wrote the last time it ran. Only the first
+   * rule is read, not the empty ones that -MP adds after it. Without a
+   * file, as before the first run, there are no headers.
+   */
+  char buf[STATE_LINE_LEN];
+  char* name = NULL;
+  FILE* fd = NULL;
+  int* header = NULL;
+  int cnt = 0;
+  int more = 1;
+  int retval = 0;
+
+  if (-1 == graph->node[idx].deps) {
+    return 0;
+  }
+  if (NULL == (name = new_deps_name(graph->node[graph->node[idx].deps].path))) {
+    return -1;
+  }
+  fd = fopen(name, "r");
+  free(name);
+  while ((NULL != fd) && (0 == retval) && (1 == more) &&
+         (NULL != fgets(buf, sizeof(buf), fd))) {
+    char* pos = buf;
+
+    more = 0;
+    while ((0 == retval) && ('\0' != *(pos += strspn(pos, " \t\n")))) {
+      const size_t len = strcspn(pos, " \t\n");
+      char* word = pos;
+      int* bigger = NULL;
+
+      pos += len;
+      if ('\0' != *pos) {
+        *pos++ = '\0';
+      }
+      if (0 == strcmp(word, "\\")) {
+        more = 1; /* The rule goes on */
+        continue;
+      }
+      if (':' == word[len - 1]) {
+        continue; /* The target */
+      }
+      if (NULL == (bigger = realloc(header, (cnt + 1) * sizeof(int)))) {
+        fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", word);
+        retval = -1;
+        continue;
+      }
+      header = bigger;
+      if (-1 == (header[cnt++] = add_node(graph, word, CUTEST_MAKE_HEADER))) {
+        retval = -1;
+      }
+    }
+  }
+  if (NULL != fd) {
+    fclose(fd);
+  }
+  if (0 != retval) {
+    free(header);
+    return -1;
+  }
+  free(graph->node[idx].header);
+  graph->node[idx].header = header;
+  graph->node[idx].header_cnt = cnt;
+  return 0;
+}
+
+static int add_test_suite(cutest_make_graph_t* graph,
+                          const cutest_make_opts_t* opts, const char* test,
+                          int cutest_o)
+{
+  /*
+   * All the steps from a design under test and its test to a runner
+   * that has been run. The nodes of the files shared by all test suites,
+   * such as cutest.h and the tools, are only added once.
+   */
+  const char* name = strrchr(test, '/');
+  const size_t len = strlen(test);
+  const char* extra = NULL;
+  char* path = NULL;
+  int input[MAX_INPUTS];
+  int node[CUTEST_MAKE_STEPS];
+  int dut = -1;
+  int cnt = 0;
+  int retval = -1;
+
+  name = (NULL == name) ? test : name + 1;
+  if ((len <= strlen(TEST_SUFFIX)) ||
+      (0 != strcmp(&test[len - strlen(TEST_SUFFIX)], TEST_SUFFIX))) {
+    fprintf(stderr, "ERROR: '%s' is not a test suite\n", test);
+    return -1;
+  }
+  if (NULL == (path = malloc(strlen(opts->src) +
+                             ((NULL == opts->build) ? 0 : strlen(opts->build)) +
+                             len + 64))) {
+    fprintf(stderr, "ERROR: Out of memory while adding '%s'\n", test);
+    return -1;
+  }
+
+  sprintf(path, "%s/%.*s.c", opts->src,
+          (int)(strlen(name) - strlen(TEST_SUFFIX)), name);
+  if (-1 == (dut = add_node(graph, path, CUTEST_MAKE_SOURCE))) {
+    goto cleanup;
+  }
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_MOCKABLES_S]);
+  input[0] = dut;
+  cnt = add_compiler(graph, opts, input, 1);
+  node[CUTEST_MAKE_MOCKABLES_S] =
+    add_target(graph, path, CUTEST_MAKE_MOCKABLES_S, input, cnt, 1, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_MOCKABLES_O]);
+  input[0] = node[CUTEST_MAKE_MOCKABLES_S];
+  node[CUTEST_MAKE_MOCKABLES_O] =
+    add_target(graph, path, CUTEST_MAKE_MOCKABLES_O, input, 1, 1, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_MOCKABLES_LST]);
+  input[0] = node[CUTEST_MAKE_MOCKABLES_O];
+  node[CUTEST_MAKE_MOCKABLES_LST] =
+    add_target(graph, path, CUTEST_MAKE_MOCKABLES_LST, input, 1, 1, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_PROXIFIED_S]);
+  input[0] = node[CUTEST_MAKE_MOCKABLES_S];
+  input[1] = node[CUTEST_MAKE_MOCKABLES_LST];
+  input[2] = add_file(graph, opts->tools, "cutest_prox");
+  node[CUTEST_MAKE_PROXIFIED_S] =
+    add_target(graph, path, CUTEST_MAKE_PROXIFIED_S, input, 3, 2, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_MOCKS_H]);
+  input[0] = dut;
+  input[1] = node[CUTEST_MAKE_MOCKABLES_LST];
+  input[2] = add_file(graph, opts->tools, "cutest.h");
+  input[3] = add_file(graph, opts->tools, "cutest_mock");
+  cnt = 4;
+  if ((NULL != opts->cproto) && (NULL != strchr(opts->cproto, '/'))) {
+    input[cnt++] = add_file(graph, NULL, opts->cproto);
+  }
+  node[CUTEST_MAKE_MOCKS_H] =
+    add_target(graph, path, CUTEST_MAKE_MOCKS_H, input, cnt, 2, NULL);
+
+  /*
+   * The implementations are made from the same inputs as the header, and
+   * the list of the shared C library mock-ups
+   */
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_MOCKS_C]);
+  input[cnt++] = add_file(graph, get_object_dir(opts),
+                           "cutest_libc_mocks.lst");
+  node[CUTEST_MAKE_MOCKS_C] =
+    add_target(graph, path, CUTEST_MAKE_MOCKS_C, input, cnt, 2, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_MOCKS_O]);
+  input[0] = node[CUTEST_MAKE_MOCKS_C];
+  input[1] = node[CUTEST_MAKE_MOCKS_H];
+  cnt = add_compiler(graph, opts, input, 2);
+  node[CUTEST_MAKE_MOCKS_O] =
+    add_target(graph, path, CUTEST_MAKE_MOCKS_O, input, cnt, 1, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_TEST_RUN_C]);
+  input[0] = add_file(graph, NULL, test);
+  input[1] = node[CUTEST_MAKE_MOCKS_H];
+  input[2] = add_file(graph, opts->tools, "cutest.h");
+  input[3] = add_file(graph, opts->tools, "cutest_run");
+  node[CUTEST_MAKE_TEST_RUN_C] =
+    add_target(graph, path, CUTEST_MAKE_TEST_RUN_C, input, 4, 2, NULL);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_TEST]);
+  input[0] = node[CUTEST_MAKE_PROXIFIED_S];
+  input[1] = node[CUTEST_MAKE_TEST_RUN_C];
+  input[2] = node[CUTEST_MAKE_MOCKS_O];
+  input[3] = cutest_o;
+  input[4] = add_file(graph, get_object_dir(opts), "cutest_libc_mocks.o");
+  cnt = RUNNER_INPUTS;
+  extra = get_extra_files(opts, &path[strlen(path) - strlen(name) + 2]);
+  if ((NULL != extra) &&
+      (0 > (cnt = add_extra_files(graph, extra, input, cnt)))) {
+    goto cleanup;
+  }
+  node[CUTEST_MAKE_TEST] =
+    add_target(graph, path, CUTEST_MAKE_TEST, input, cnt, RUNNER_INPUTS,
+               extra);
+
+  get_target_path(path, opts->build, test, step_suffix[CUTEST_MAKE_RUN]);
+  input[0] = node[CUTEST_MAKE_TEST];
+  node[CUTEST_MAKE_RUN] =
+    add_target(graph, path, CUTEST_MAKE_RUN, input, 1, 1, NULL);
+
+  retval = (-1 == node[CUTEST_MAKE_RUN]) ? -1 : 0;
+
+  /*
+   * The compiling recipes list the headers they include, and the
+   * mock-ups are made from the headers of the design under test
+   */
+  if (0 == retval) {
+    graph->node[node[CUTEST_MAKE_MOCKABLES_S]].deps =
+      node[CUTEST_MAKE_MOCKABLES_S];
+    graph->node[node[CUTEST_MAKE_MOCKS_H]].deps = node[CUTEST_MAKE_MOCKABLES_S];
+    graph->node[node[CUTEST_MAKE_MOCKS_C]].deps = node[CUTEST_MAKE_MOCKABLES_S];
+    graph->node[node[CUTEST_MAKE_MOCKS_O]].deps = node[CUTEST_MAKE_MOCKS_O];
+    graph->node[node[CUTEST_MAKE_TEST_RUN_C]].deps =
+      node[CUTEST_MAKE_TEST_RUN_C];
+  }
+
+ cleanup:
+  free(path);
+  return retval;
+}
+
+static cutest_make_graph_t* new_test_suites(const cutest_make_opts_t* opts,
+                                            int argc, char* argv[])
+{
+  cutest_make_graph_t* graph = new_graph();
+  int input[3];
+  int cutest_o = -1;
+  int i;
+
+  if (NULL == graph) {
+    return NULL;
+  }
+  if ((-1 == (input[0] = add_file(graph, opts->tools, "cutest.c"))) ||
+      (-1 == (input[1] = add_file(graph, opts->tools, "cutest.h")))) {
+    delete_graph(graph);
+    return NULL;
+  }
+  {
+    char* path = malloc(strlen(get_object_dir(opts)) + 16);
+
+    if (NULL == path) {
+      fprintf(stderr, "ERROR: Out of memory while adding cutest.o\n");
+      delete_graph(graph);
+      return NULL;
+    }
+    sprintf(path, "%s/cutest.o", get_object_dir(opts));
+    cutest_o = add_target(graph, path, CUTEST_MAKE_CUTEST_O, input,
+                          add_compiler(graph, opts, input, 2), 1, NULL);
+    free(path);
+  }
+  if (-1 == cutest_o) {
+    delete_graph(graph);
+    return NULL;
+  }
+  graph->node[cutest_o].deps = cutest_o;
+  for (i = opts->first_suite; i < argc; i++) {
+    if (0 != add_test_suite(graph, opts, argv[i], cutest_o)) {
+      delete_graph(graph);
+      return NULL;
+    }
+  }
+  /*
+   * The headers are added when all the steps are there, so the state
+   * covers them too
+   */
+  for (i = 0; i < graph->cnt; i++) {
+    if (0 != read_headers(graph, i)) {
+      delete_graph(graph);
+      return NULL;
+    }
+  }
+  return graph;
+}
+
+static char* get_word(char* str, char* word)
+{
+  const size_t len = strcspn(str, " ");
+
+  if ((0 == len) || (NET_HASH_LEN <= len) || (' ' != str[len])) {
+    return NULL;
+  }
+  memcpy(word, str, len);
+  word[len] = '\0';
+  return &str[len + 1];
+}
+
+static void read_state(const char* file_name, cutest_make_graph_t* graph)
+{
+  /*
+   * Every row is the key of the recipe that made a file, or "-" for a
+   * source, the hash of its content, the time and size it had when it
+   * was hashed, and its path.
+   */
+  char buf[STATE_LINE_LEN];
+  FILE* fd = fopen(file_name, "r");
+
+  if (NULL == fd) {
+    return; /* Nothing has been made yet */
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    char key[NET_HASH_LEN];
+    char hash[NET_HASH_LEN];
+    char* pos = get_word(buf, key);
+    char* end = NULL;
+    long sec;
+    long nsec;
+    long size;
+    int i;
+
+    if ((NULL == pos) || (NULL == (pos = get_word(pos, hash)))) {
+      continue;
+    }
+    sec = strtol(pos, &end, 10);
+    nsec = strtol(end, &end, 10);
+    size = strtol(end, &end, 10);
+    if (' ' != *end) {
+      continue;
+    }
+    end[1 + strcspn(&end[1], "\n")] = '\0';
+    if (-1 == (i = find_node(graph, &end[1]))) {
+      continue;
+    }
+    strcpy(graph->node[i].old_key, key);
+    strcpy(graph->node[i].old_hash, hash);
+    graph->node[i].sec = sec;
+    graph->node[i].nsec = nsec;
+    graph->node[i].size = size;
+  }
+  fclose(fd);
+}
+
+static int write_state(const char* file_name,
+                       const cutest_make_graph_t* graph)
+{
+  /*
+   * A file that was not looked at this time keeps what it had, unless
+   * its recipe failed.
+   */
+  char* tmp_name = malloc(strlen(file_name) + 8);
+  FILE* fd = NULL;
+  int i;
+
+  if (NULL == tmp_name) {
+    fprintf(stderr, "ERROR: Out of memory while writing the state\n");
+    return -1;
+  }
+  sprintf(tmp_name, "%s.tmp", file_name);
+  if (NULL == (fd = fopen(tmp_name, "w"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", tmp_name);
+    free(tmp_name);
+    return -1;
+  }
+  for (i = 0; i < graph->cnt; i++) {
+    const cutest_make_node_t* node = &graph->node[i];
+
+    if ((CUTEST_MAKE_RUN == node->step) || ('\0' == node->old_hash[0])) {
+      continue;
+    }
+    fprintf(fd, "%s %s %ld %ld %ld %s\n",
+            ('\0' == node->old_key[0]) ? "-" : node->old_key, node->old_hash,
+            node->sec, node->nsec, node->size, node->path);
+  }
+  fclose(fd);
+  if (0 != rename(tmp_name, file_name)) {
+    fprintf(stderr, "ERROR: Could not write the state '%s'\n", file_name);
+    free(tmp_name);
+    return -1;
+  }
+  free(tmp_name);
+  return 0;
+}
+
+static int hash_node_file(cutest_make_node_t* node)
+{
+  /* A file that has the same time and size as last time is not read */
+  struct stat st;
+
+  if (0 != stat(node->path, &st)) {
+    return -1;
+  }
+  if (('\0' != node->old_hash[0]) && (node->sec == (long)st.st_mtim.tv_sec) &&
+      (node->nsec == (long)st.st_mtim.tv_nsec) &&
+      (node->size == (long)st.st_size)) {
+    strcpy(node->hash, node->old_hash);
+    return 0;
+  }
+  if (0 != get_file_hash(node->hash, node->path)) {
+    return -1;
+  }
+  node->sec = st.st_mtim.tv_sec;
+  node->nsec = st.st_mtim.tv_nsec;
+  node->size = st.st_size;
+  return 0;
+}
+
+static int copy_file(const char* from, const char* to)
+{
+  /*
+   * The copy is written to a file of its own and renamed in place, since
+   * other checkouts may use the same cache at the same time.
+   */
+  struct stat st;
+  char* tmp_name = NULL;
+  FILE* in = NULL;
+  FILE* out = NULL;
+  int retval = -1;
+
+  if ((0 != stat(from, &st)) || (NULL == (in = fopen(from, "rb")))) {
+    return -1;
+  }
+  if (NULL == (tmp_name = malloc(strlen(to) + 16))) {
+    fclose(in);
+    return -1;
+  }
+  sprintf(tmp_name, "%s.%d", to, (int)getpid());
+  if (NULL != (out = fopen(tmp_name, "wb"))) {
+    retval = copy_bytes(in, out, (long)st.st_size);
+    if (0 != fclose(out)) {
+      retval = -1;
+    }
+    if ((0 == retval) && ((0 != chmod(tmp_name, st.st_mode & 0777)) ||
+                          (0 != rename(tmp_name, to)))) {
+      retval = -1;
+    }
+    if (0 != retval) {
+      unlink(tmp_name);
+    }
+  }
+  fclose(in);
+  free(tmp_name);
+  return retval;
+}
+
+static char* new_cache_path(const cutest_make_opts_t* opts,
+                            const cutest_make_node_t* node)
+{
+  /* Only the files that are made are kept, not what the runners say */
+  char* path = NULL;
+
+  if ((NULL == opts->cache) || (CUTEST_MAKE_SOURCE == node->step) ||
+      (CUTEST_MAKE_RUN == node->step) || ('\0' == node->key[0])) {
+    return NULL;
+  }
+  if (NULL == (path = malloc(strlen(opts->cache) + NET_HASH_LEN + 1))) {
+    return NULL;
+  }
+  sprintf(path, "%s/%s", opts->cache, node->key);
+  return path;
+}
+
+static int fetch_from_cache(const cutest_make_opts_t* opts,
+                            const cutest_make_node_t* node)
+{
+  /* Returns 1 if the file was made with the same key before */
+  char* path = new_cache_path(opts, node);
+  int retval = 0;
+
+  if (NULL == path) {
+    return 0;
+  }
+  if ((0 == access(path, R_OK)) && (0 == copy_file(path, node->path))) {
+    retval = 1;
+  }
+  free(path);
+  return retval;
+}
+
+static void store_in_cache(const cutest_make_opts_t* opts,
+                           const cutest_make_node_t* node)
+{
+  /* A cache that can not be written to only makes nothing faster */
+  char* path = new_cache_path(opts, node);
+
+  if (NULL == path) {
+    return;
+  }
+  if (0 != access(path, R_OK)) {
+    copy_file(node->path, path);
+  }
+  free(path);
+}
+
+static char* new_cached_deps_path(const cutest_make_opts_t* opts,
+                                  const cutest_make_node_t* node)
+{
+  /* The headers are kept by the input key, since the key depends on them */
+  char* path = NULL;
+
+  if ((NULL == opts->cache) || ('\0' == node->input_key[0])) {
+    return NULL;
+  }
+  if (NULL == (path = malloc(strlen(opts->cache) + NET_HASH_LEN + 3))) {
+    return NULL;
+  }
+  sprintf(path, "%s/%s.d", opts->cache, node->input_key);
+  return path;
+}
+
+static void fetch_headers_from_cache(const cutest_make_opts_t* opts,
+                                     const cutest_make_graph_t* graph, int idx)
+{
+  /*
+   * A step that has not run in this checkout has no .d file, so without
+   * the one in the cache its key would be made without the headers
+   */
+  const cutest_make_node_t* node = &graph->node[idx];
+  char* path = NULL;
+  char* name = NULL;
+
+  if ((idx != node->deps) ||
+      (NULL == (path = new_cached_deps_path(opts, node)))) {
+    return;
+  }
+  if ((NULL != (name = new_deps_name(node->path))) &&
+      (0 != access(name, F_OK))) {
+    copy_file(path, name);
+  }
+  free(name);
+  free(path);
+}
+
+static void store_headers_in_cache(const cutest_make_opts_t* opts,
+                                   const cutest_make_node_t* node)
+{
+  /* The latest list of headers replaces the one that is there */
+  char* path = new_cached_deps_path(opts, node);
+  char* name = NULL;
+
+  if (NULL == path) {
+    return;
+  }
+  if ((NULL != (name = new_deps_name(node->path))) &&
+      (0 == access(name, R_OK))) {
+    copy_file(name, path);
+  }
+  free(name);
+  free(path);
+}
+
+static char* new_command(const cutest_make_graph_t* graph,
+                         const cutest_make_opts_t* opts, int idx)
+{
+  /*
+   * The recipe of the node, with %t for the target, %1 to %9 for the
+   * arguments and %x for the extra files. %v is the verbosity of the
+   * runners and %% a percent sign.
+   */
+  const cutest_make_node_t* node = &graph->node[idx];
+  const char* recipe = opts->recipe[node->step];
+  const char* str = NULL;
+  size_t len = 0;
+  char* command = NULL;
+  int pass;
+
+  for (pass = 0; pass < 2; pass++) {
+    const char* c = recipe;
+
+    len = 0;
+    while ('\0' != *c) {
+      str = NULL;
+      if ('%' == c[0]) {
+        if ('t' == c[1]) {
+          str = node->path;
+        }
+        else if (('1' <= c[1]) && ('9' >= c[1])) {
+          str = (c[1] - '1' < node->arg_cnt) ?
+            graph->node[node->input[c[1] - '1']].path : "";
+        }
+        else if ('x' == c[1]) {
+          str = (NULL != node->extra) ? node->extra : "";
+        }
+        else if ('v' == c[1]) {
+          str = (1 == opts->verbose) ? "-v" : "-n";
+        }
+        else if ('%' == c[1]) {
+          str = "%";
+        }
+      }
+      if (NULL == str) {
+        if (1 == pass) {
+          command[len] = *c;
+        }
+        len++;
+        c++;
+        continue;
+      }
+      if (1 == pass) {
+        strcpy(&command[len], str);
+      }
+      len += strlen(str);
+      c += 2;
+    }
+    if ((0 == pass) && (NULL == (command = malloc(len + 1)))) {
+      fprintf(stderr, "ERROR: Out of memory while making '%s'\n", node->path);
+      return NULL;
+    }
+  }
+  command[len] = '\0';
+  return command;
+}
+
+static int get_key(char* key, const cutest_make_graph_t* graph,
+                   const char* command, int idx)
+{
+  /* The recipe, and the content of everything the node is made from */
+  const cutest_make_node_t* node = &graph->node[idx];
+  unsigned long long value = 14695981039346656037ULL;
+  int i;
+
+  fold_hash(&value, command);
+  for (i = 0; i < node->input_cnt; i++) {
+    fold_hash(&value, graph->node[node->input[i]].hash);
+  }
+  sprintf(key, "%016llx", value);
+  return 0;
+}
+
+static void fold_headers(cutest_make_graph_t* graph, int idx)
+{
+  /*
+   * The key of a node is its input key and the content of the headers
+   * its recipe included. A header that is gone has no content, which
+   * changes the key too.
+   */
+  cutest_make_node_t* node = &graph->node[idx];
+  unsigned long long value = 14695981039346656037ULL;
+  int i;
+
+  fold_hash(&value, node->input_key);
+  for (i = 0; i < node->header_cnt; i++) {
+    cutest_make_node_t* header = &graph->node[node->header[i]];
+
+    if ((CUTEST_MAKE_HEADER == header->step) && ('\0' == header->hash[0]) &&
+        (0 == hash_node_file(header))) {
+      strcpy(header->old_hash, header->hash);
+    }
+    fold_hash(&value, header->hash);
+  }
+  sprintf(node->key, "%016llx", value);
+}
+
+static int is_up_to_date(cutest_make_node_t* node)
+{
+  /*
+   * Made by the same recipe from the same content as last time, and the
+   * target still has the content it was made with.
+   */
+  char hash[NET_HASH_LEN];
+
+  if ((CUTEST_MAKE_RUN == node->step) || ('\0' == node->old_key[0]) ||
+      (0 != strcmp(node->key, node->old_key))) {
+    return 0;
+  }
+  strcpy(hash, node->old_hash);
+  if ((0 != hash_node_file(node)) || (0 != strcmp(node->hash, hash))) {
+    return 0;
+  }
+  return 1;
+}
+
+static void push_ready(cutest_make_graph_t* graph, int idx)
+{
+  /*
+   * The heap puts the latest step first, and the first test suite among
+   * those, so the runners are linked and run as early as possible.
+   */
+  int i = graph->ready_cnt++;
+
+  graph->node[idx].status = CUTEST_MAKE_READY;
+  while (i > 0) {
+    const int parent = (i - 1) / 2;
+    const cutest_make_node_t* node = &graph->node[graph->ready[parent]];
+
+    if ((node->step > graph->node[idx].step) ||
+        ((node->step == graph->node[idx].step) &&
+         (graph->ready[parent] < idx))) {
+      break;
+    }
+    graph->ready[i] = graph->ready[parent];
+    i = parent;
+  }
+  graph->ready[i] = idx;
+}
+
+static int is_before(const cutest_make_graph_t* graph, int a, int b)
+{
+  const cutest_make_node_t* node_a = &graph->node[a];
+  const cutest_make_node_t* node_b = &graph->node[b];
+
+  return ((node_a->step > node_b->step) ||
+          ((node_a->step == node_b->step) && (a < b)));
+}
+
+static int pop_ready(cutest_make_graph_t* graph)
+{
+  const int idx = graph->ready[0];
+  const int last = graph->ready[--graph->ready_cnt];
+  int i = 0;
+
+  while (2 * i + 1 < graph->ready_cnt) {
+    int child = 2 * i + 1;
+
+    if ((child + 1 < graph->ready_cnt) &&
+        is_before(graph, graph->ready[child + 1], graph->ready[child])) {
+      child++;
+    }
+    if (is_before(graph, last, graph->ready[child])) {
+      break;
+    }
+    graph->ready[i] = graph->ready[child];
+    i = child;
+  }
+  graph->ready[i] = last;
+  return idx;
+}
+
+static int start_graph(cutest_make_graph_t* graph)
+{
+  /* The files that are not made are done, if they are there */
+  int retval = 0;
+  int i;
+
+  if (NULL == (graph->ready = malloc(graph->cnt * sizeof(int)))) {
+    fprintf(stderr, "ERROR: Out of memory while starting the graph\n");
+    return -1;
+  }
+  for (i = 0; i < graph->cnt; i++) {
+    graph->node[i].waiting = graph->node[i].input_cnt;
+  }
+  for (i = 0; i < graph->cnt; i++) {
+    cutest_make_node_t* node = &graph->node[i];
+
+    if (CUTEST_MAKE_SOURCE != node->step) {
+      continue;
+    }
+    if (0 != hash_node_file(node)) {
+      fprintf(stderr, "ERROR: '%s' does not exist\n", node->path);
+      retval = 1;
+    }
+  }
+  return retval;
+}
+
+static void fail_node(cutest_make_graph_t* graph, int idx)
+{
+  /* Nothing made from a failing node is made */
+  cutest_make_node_t* node = &graph->node[idx];
+  int i;
+
+  if (CUTEST_MAKE_FAILED == node->status) {
+    return;
+  }
+  node->status = CUTEST_MAKE_FAILED;
+  node->old_key[0] = '\0';
+  for (i = 0; i < node->dependent_cnt; i++) {
+    fail_node(graph, node->dependent[i]);
+  }
+}
+
+static void finish_node(cutest_make_graph_t* graph, int idx, int status)
+{
+  cutest_make_node_t* node = &graph->node[idx];
+  int i;
+
+  if ((0 != status) ||
+      ((CUTEST_MAKE_SOURCE != node->step) && (CUTEST_MAKE_RUN != node->step) &&
+       (0 != hash_node_file(node)))) {
+    fail_node(graph, idx);
+    return;
+  }
+  node->status = CUTEST_MAKE_DONE;
+  strcpy(node->old_key, node->key);
+  strcpy(node->old_hash, node->hash);
+  for (i = 0; i < node->dependent_cnt; i++) {
+    cutest_make_node_t* dependent = &graph->node[node->dependent[i]];
+
+    if ((CUTEST_MAKE_WAITING == dependent->status) &&
+        (0 == --dependent->waiting)) {
+      push_ready(graph, node->dependent[i]);
+    }
+  }
+}
+
+static void release_sources(cutest_make_graph_t* graph)
+{
+  /* The files that are there let the first steps start */
+  int i;
+
+  for (i = 0; i < graph->cnt; i++) {
+    if (CUTEST_MAKE_SOURCE != graph->node[i].step) {
+      continue;
+    }
+    if ('\0' == graph->node[i].hash[0]) {
+      fail_node(graph, i);
+    }
+    else {
+      finish_node(graph, i, 0);
+    }
+  }
+}
+
+static void delete_pool(cutest_make_pool_t* pool)
+{
+  free(pool->pid);
+  free(pool->node);
+  free(pool);
+}
+
+static cutest_make_pool_t* new_pool(int workers)
+{
+  cutest_make_pool_t* pool = malloc(sizeof(cutest_make_pool_t));
+
+  if (NULL == pool) {
+    fprintf(stderr, "ERROR: Out of memory while allocating worker pool\n");
+    return NULL;
+  }
+  pool->workers = workers;
+  pool->running = 0;
+  pool->pid = calloc(workers, sizeof(pid_t));
+  pool->node = calloc(workers, sizeof(int));
+  if ((NULL == pool->pid) || (NULL == pool->node)) {
+    fprintf(stderr, "ERROR: Out of memory while allocating worker pool\n");
+    delete_pool(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+static pid_t spawn_command(const char* command)
+{
+  pid_t pid = fork();
+
+  if (0 > pid) {
+    fprintf(stderr, "ERROR: Failed to fork\n");
+    return -1;
+  }
+  if (0 == pid) {
+    execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+    fprintf(stderr, "ERROR: Unable to execute '%s'\n", command);
+    _exit(EXIT_FAILURE);
+  }
+  return pid;
+}
+
+static int start_node(cutest_make_pool_t* pool, cutest_make_graph_t* graph,
+                      const cutest_make_opts_t* opts, int idx)
+{
+  /*
+   * Returns 1 if the node is up to date, 0 if it was started, or -1 if
+   * it could not be started.
+   */
+  cutest_make_node_t* node = NULL;
+  char* command = new_command(graph, opts, idx);
+  int slot = 0;
+
+  if (NULL == command) {
+    return -1;
+  }
+  get_key(graph->node[idx].input_key, graph, command, idx);
+  fetch_headers_from_cache(opts, graph, idx);
+  if (0 != read_headers(graph, idx)) {
+    free(command);
+    return -1;
+  }
+  node = &graph->node[idx];
+  fold_headers(graph, idx);
+  if ((1 == is_up_to_date(node)) || (1 == fetch_from_cache(opts, node))) {
+    free(command);
+    return 1;
+  }
+  if (1 == opts->verbose) {
+    puts(command);
+    fflush(stdout);
+  }
+  while ((slot < pool->workers) && (0 != pool->pid[slot])) {
+    slot++;
+  }
+  if ((slot == pool->workers) ||
+      (0 > (pool->pid[slot] = spawn_command(command)))) {
+    if (slot < pool->workers) {
+      pool->pid[slot] = 0;
+    }
+    free(command);
+    return -1;
+  }
+  pool->node[slot] = idx;
+  pool->running++;
+  node->status = CUTEST_MAKE_RUNNING;
+  free(command);
+  return 0;
+}
+
+static int wait_for_node(cutest_make_pool_t* pool, int* status)
+{
+  /* Returns the node that finished, or -1 on error */
+  int wstatus = 0;
+  pid_t pid = waitpid(-1, &wstatus, 0);
+  int slot;
+
+  if (0 > pid) {
+    fprintf(stderr, "ERROR: Lost track of the running steps\n");
+    return -1;
+  }
+  for (slot = 0; slot < pool->workers; slot++) {
+    if (pool->pid[slot] == pid) {
+      break;
+    }
+  }
+  if (slot == pool->workers) {
+    return wait_for_node(pool, status); /* Not one of ours */
+  }
+  pool->pid[slot] = 0;
+  pool->running--;
+  *status = (WIFEXITED(wstatus) && (0 == WEXITSTATUS(wstatus))) ? 0 : 1;
+  return pool->node[slot];
+}
+
+static void print_file(const char* file_name, FILE* out)
+{
+  char buf[4096];
+  size_t len = 0;
+  FILE* fd = fopen(file_name, "r");
+
+  if (NULL == fd) {
+    return;
+  }
+  while (0 < (len = fread(buf, 1, sizeof(buf), fd))) {
+    fwrite(buf, 1, len, out);
+  }
+  fclose(fd);
+  fflush(out);
+}
+
+static void print_run(const cutest_make_graph_t* graph, int idx, int status)
+{
+  /*
+   * The verdicts of a runner are printed when it is done, so they are
+   * not mixed up with the others. What it said on stderr is only
+   * printed if it failed.
+   */
+  const cutest_make_node_t* node = &graph->node[idx];
+  char* stderr_name = NULL;
+
+  print_file(node->path, stdout);
+  if (0 == status) {
+    return;
+  }
+  stderr_name = malloc(strlen(graph->node[node->input[0]].path) + 8);
+  if (NULL == stderr_name) {
+    return;
+  }
+  sprintf(stderr_name, "%s.stderr", graph->node[node->input[0]].path);
+  print_file(stderr_name, stderr);
+  free(stderr_name);
+}
+
+static int run_graph(cutest_make_pool_t* pool, cutest_make_graph_t* graph,
+                     const cutest_make_opts_t* opts)
+{
+  /* Returns the number of test suites that did not pass, or -1 */
+  int retval = 0;
+
+  while ((graph->ready_cnt > 0) || (pool->running > 0)) {
+    int status = 0;
+    int idx = 0;
+
+    while ((graph->ready_cnt > 0) && (pool->running < pool->workers)) {
+      idx = pop_ready(graph);
+      switch (start_node(pool, graph, opts, idx)) {
+      case 1:
+        finish_node(graph, idx, 0);
+        break;
+      case -1:
+        fail_node(graph, idx);
+        retval = -1;
+        break;
+      default:
+        break;
+      }
+    }
+    if (0 == pool->running) {
+      continue;
+    }
+    if (0 > (idx = wait_for_node(pool, &status))) {
+      return -1;
+    }
+    if (CUTEST_MAKE_RUN == graph->node[idx].step) {
+      print_run(graph, idx, status);
+    }
+    else if (0 != status) {
+      fprintf(stderr, "ERROR: Could not make '%s'\n", graph->node[idx].path);
+    }
+    else if (0 == read_headers(graph, idx)) {
+      /* What the recipe included this time is what it was made from */
+      fold_headers(graph, idx);
+      store_in_cache(opts, &graph->node[idx]);
+      store_headers_in_cache(opts, &graph->node[idx]);
+    }
+    else {
+      status = 1;
+      retval = -1;
+    }
+    finish_node(graph, idx, status);
+  }
+  return retval;
+}
+
+static int count_failed_runs(const cutest_make_graph_t* graph, int* runs)
+{
+  int failed = 0;
+  int i;
+
+  *runs = 0;
+  for (i = 0; i < graph->cnt; i++) {
+    if (CUTEST_MAKE_RUN != graph->node[i].step) {
+      continue;
+    }
+    (*runs)++;
+    if (CUTEST_MAKE_DONE != graph->node[i].status) {
+      failed++;
+    }
+  }
+  return failed;
+}
+
+int main(int argc, char* argv[])
+{
+  cutest_make_opts_t opts;
+  cutest_make_graph_t* graph = NULL;
+  cutest_make_pool_t* pool = NULL;
+  int failed = 0;
+  int runs = 0;
+  int retval = -1;
+
+  handle_args(&opts, argc, argv);
+
+  if ((NULL != opts.build) && (0 != mkdir(opts.build, 0755)) &&
+      (0 != access(opts.build, W_OK))) {
+    fprintf(stderr, "ERROR: Could not create the build directory '%s'\n",
+            opts.build);
+    return EXIT_FAILURE;
+  }
+  if ((NULL != opts.cache) && (0 != mkdir(opts.cache, 0755)) &&
+      (0 != access(opts.cache, W_OK))) {
+    fprintf(stderr, "ERROR: Could not create the cache '%s'\n", opts.cache);
+    return EXIT_FAILURE;
+  }
+  if (NULL == (graph = new_test_suites(&opts, argc, argv))) {
+    return EXIT_FAILURE;
+  }
+  read_state(opts.state, graph);
+
+  if ((0 > start_graph(graph)) ||
+      (NULL == (pool = new_pool((0 != opts.jobs) ? opts.jobs :
+                                get_number_of_cores())))) {
+    goto cleanup;
+  }
+  release_sources(graph);
+  retval = run_graph(pool, graph, &opts);
+  write_state(opts.state, graph);
+
+  failed = count_failed_runs(graph, &runs);
+  if (-1 == opts.verbose) {
+    puts("");
+  }
+  printf("Total: %d test suites, %d did not pass\n", runs, failed);
+  if ((0 == retval) && (0 != failed)) {
+    retval = 1;
+  }
+
+ cleanup:
+  if (NULL != pool) {
+    delete_pool(pool);
+  }
+  delete_graph(graph);
+
+  if (0 != retval) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#ifndef _CUTEST_MAKE_H_
+#define _CUTEST_MAKE_H_
+
+#include "net.h"
+
+/* The steps from a design under test and its test to a passing runner */
+#define CUTEST_MAKE_HEADER -2 /* A file that a recipe included */
+#define CUTEST_MAKE_SOURCE -1 /* A file that is not built */
+#define CUTEST_MAKE_CUTEST_O 0
+#define CUTEST_MAKE_MOCKABLES_S 1
+#define CUTEST_MAKE_MOCKABLES_O 2
+#define CUTEST_MAKE_MOCKABLES_LST 3
+#define CUTEST_MAKE_PROXIFIED_S 4
+#define CUTEST_MAKE_MOCKS_H 5
+#define CUTEST_MAKE_MOCKS_C 6
+#define CUTEST_MAKE_MOCKS_O 7
+#define CUTEST_MAKE_TEST_RUN_C 8
+#define CUTEST_MAKE_TEST 9 /* Link the runner */
+#define CUTEST_MAKE_RUN 10 /* Run the runner */
+#define CUTEST_MAKE_STEPS 11
+
+/* Where a node is on its way */
+#define CUTEST_MAKE_WAITING 0
+#define CUTEST_MAKE_READY 1
+#define CUTEST_MAKE_RUNNING 2
+#define CUTEST_MAKE_DONE 3
+#define CUTEST_MAKE_FAILED 4
+
+#define CUTEST_MAKE_MAX_LINKS 64
+
+typedef struct cutest_make_opts_s {
+  int verbose;
+  int jobs;
+  const char* state; /* The content hashes of the last build */
+  const char* tools; /* Where cutest.c and the cutest tools are */
+  const char* build; /* Where the files are made, or NULL for in place */
+  const char* src; /* Where the designs under test are */
+  const char* cproto;
+  const char* cc; /* The compiler binary, or NULL */
+  const char* cache; /* Where made files are kept by their keys, or NULL */
+  const char* recipe[CUTEST_MAKE_STEPS];
+  int link_cnt;
+  const char* link_suite[CUTEST_MAKE_MAX_LINKS];
+  const char* link_files[CUTEST_MAKE_MAX_LINKS]; /* Space separated */
+  int first_suite;
+} cutest_make_opts_t;
+
+typedef struct cutest_make_node_s {
+  int step;
+  char* path;
+  int* input; /* The nodes this one is made from */
+  int input_cnt;
+  int arg_cnt; /* The inputs given to the recipe, the rest are tools */
+  const char* extra; /* Extra files given to the recipe, or NULL */
+  int deps; /* The node whose .d file lists the headers, or -1 */
+  int* header; /* The headers the recipe included when it last ran */
+  int header_cnt;
+  int* dependent; /* The nodes made from this one */
+  int dependent_cnt;
+  int waiting; /* The inputs that are not done yet */
+  int status;
+  char hash[NET_HASH_LEN]; /* The content, when done */
+  char input_key[NET_HASH_LEN]; /* The recipe and the content of the inputs */
+  char key[NET_HASH_LEN]; /* The input key and the content of the headers */
+  char old_key[NET_HASH_LEN]; /* As in the last build */
+  char old_hash[NET_HASH_LEN];
+  long sec; /* When the content was last hashed */
+  long nsec;
+  long size;
+} cutest_make_node_t;
+
+typedef struct cutest_make_graph_s {
+  int cnt;
+  int size;
+  cutest_make_node_t* node;
+  int* index; /* Open addressing on the paths of the nodes */
+  int index_size;
+  int* ready; /* A heap of the nodes to make, the latest steps first */
+  int ready_cnt;
+} cutest_make_graph_t;
+
+typedef struct cutest_make_pool_s {
+  int workers;
+  int running;
+  pid_t* pid;
+  int* node;
+} cutest_make_pool_t;
+
+#endif
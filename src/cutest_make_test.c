@@ -0,0 +1,1662 @@
+#include "cutest.h"
+
+#include "cutest_make.h"
+
+#define m cutest_mock
+#define main MAIN
+
+static char* recipe_argv[] = {
+  "program_name",
+  "--recipe", "cutest.o", "cc -c %1 -o %t",
+  "--recipe", "mockables.s", "cc -S %1 -o %t",
+  "--recipe", "mockables.o", "cc -c %1 -o %t",
+  "--recipe", "mockables.lst", "nm %1 > %t",
+  "--recipe", "proxified.s", "prox %1 %2 > %t",
+  "--recipe", "mocks.h", "mock %1 %2 > %t",
+  "--recipe", "mocks.c", "mock -c %1 %2 > %t",
+  "--recipe", "mocks.o", "cc -c %1 -o %t",
+  "--recipe", "test_run.c", "run %1 %2 > %t",
+  "--recipe", "test", "cc -o %t %1 %2 %3 %4 %5 %x",
+  "-n", "foo_test.c"
+};
+
+static void set_recipes(cutest_make_opts_t* opts)
+{
+  int i;
+  for (i = 0; i < CUTEST_MAKE_RUN; i++) {
+    opts->recipe[i] = recipe_argv[3 + 3 * i];
+  }
+  opts->recipe[CUTEST_MAKE_RUN] = "%1 %v -j -s 1> %t 2> %1.stderr";
+}
+
+/*****************************************************************************
+ * usage()
+ */
+test(usage_shall_print_something)
+{
+  usage(0x1234);
+  assert_eq(1, m.printf.call_count);
+}
+
+/*****************************************************************************
+ * handle_args()
+ */
+test(handle_args_shall_output_usage_and_exit_if_too_few_arguments)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name"};
+  m.memset.func = memset;
+  handle_args(&opts, 1, argv);
+  assert_eq("program_name", m.usage.args.arg0);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_set_the_recipes_of_all_steps)
+{
+  cutest_make_opts_t opts;
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  m.find_step.func = find_step;
+  handle_args(&opts, 33, recipe_argv);
+  assert_eq(0, m.exit.call_count);
+  assert_eq("cc -c %1 -o %t", opts.recipe[CUTEST_MAKE_CUTEST_O]);
+  assert_eq("mock -c %1 %2 > %t", opts.recipe[CUTEST_MAKE_MOCKS_C]);
+  assert_eq("cc -o %t %1 %2 %3 %4 %5 %x", opts.recipe[CUTEST_MAKE_TEST]);
+  assert_eq("%1 %v -j -s 1> %t 2> %1.stderr", opts.recipe[CUTEST_MAKE_RUN]);
+  assert_eq(-1, opts.verbose);
+  assert_eq(32, opts.first_suite);
+  assert_eq("cutest_make.state", opts.state);
+}
+
+test(handle_args_shall_exit_if_a_recipe_is_missing)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "-n", "foo_test.c"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 3, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_exit_if_the_step_of_a_recipe_is_unknown)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "--recipe", "foo.o", "cc", "-n",
+                  "foo_test.c"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  m.find_step.retval = -1;
+  handle_args(&opts, 6, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_set_the_files_to_link_into_a_runner)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "--link", "foo_test", "a.c b.c",
+                  "--state", "make.state", "--tools", "cutest",
+                  "--src", "src", "--cproto", "/usr/bin/cproto",
+                  "-v", "foo_test.c"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 14, argv);
+  assert_eq(1, opts.link_cnt);
+  assert_eq("foo_test", opts.link_suite[0]);
+  assert_eq("a.c b.c", opts.link_files[0]);
+  assert_eq("make.state", opts.state);
+  assert_eq("cutest", opts.tools);
+  assert_eq("src", opts.src);
+  assert_eq("/usr/bin/cproto", opts.cproto);
+  assert_eq(1, opts.verbose);
+  assert_eq(13, opts.first_suite);
+}
+
+test(handle_args_shall_exit_if_j_is_not_a_number)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "-j", "many", "-n", "foo_test.c"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = -1;
+  handle_args(&opts, 5, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_set_the_compiler_and_the_cache)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "--cc", "/usr/bin/gcc", "--cache", "cache",
+                  "-n", "foo_test.c"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 7, argv);
+  assert_eq("/usr/bin/gcc", opts.cc);
+  assert_eq("cache", opts.cache);
+}
+
+test(handle_args_shall_set_the_build_directory)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "--build", "build/plain", "-n",
+                  "foo_test.c"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 5, argv);
+  assert_eq("build/plain", opts.build);
+}
+
+test(handle_args_shall_exit_if_the_build_directory_is_missing)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "-n", "--build"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 3, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_exit_if_the_cache_is_missing)
+{
+  cutest_make_opts_t opts;
+  char* argv[] = {"program_name", "-n", "--cache"};
+  m.memset.func = memset;
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 3, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+/*****************************************************************************
+ * find_step()
+ */
+module_test(find_step_shall_find_the_steps_that_have_recipes)
+{
+  assert_eq(CUTEST_MAKE_CUTEST_O, find_step("cutest.o"));
+  assert_eq(CUTEST_MAKE_MOCKS_H, find_step("mocks.h"));
+  assert_eq(CUTEST_MAKE_MOCKS_O, find_step("mocks.o"));
+  assert_eq(CUTEST_MAKE_TEST, find_step("test"));
+  assert_eq(-1, find_step("run"));
+}
+
+/*****************************************************************************
+ * parse_number()
+ */
+module_test(parse_number_shall_only_accept_positive_numbers)
+{
+  assert_eq(4, parse_number("4"));
+  assert_eq(-1, parse_number("0"));
+  assert_eq(-1, parse_number("4x"));
+  assert_eq(-1, parse_number(NULL));
+}
+
+/*****************************************************************************
+ * fold_hash()
+ */
+module_test(fold_hash_shall_keep_the_strings_apart)
+{
+  unsigned long long a = 14695981039346656037ULL;
+  unsigned long long b = 14695981039346656037ULL;
+  fold_hash(&a, "ab");
+  fold_hash(&a, "");
+  fold_hash(&b, "a");
+  fold_hash(&b, "b");
+  assert_eq(1, a != b);
+}
+
+/*****************************************************************************
+ * add_node(), find_node()
+ */
+test(new_graph_shall_output_an_error_if_out_of_memory)
+{
+  assert_eq(NULL, new_graph());
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq(stderr, m.fwrite.args.arg3);
+}
+
+module_test(add_node_shall_only_add_a_path_once)
+{
+  cutest_make_graph_t* graph = new_graph();
+  char path[32];
+  int i;
+  for (i = 0; i < 300; i++) {
+    sprintf(path, "file%d.c", i);
+    assert_eq(i, add_node(graph, path, CUTEST_MAKE_SOURCE));
+  }
+  assert_eq(300, graph->cnt);
+  assert_eq(1024, graph->index_size);
+  assert_eq(42, add_node(graph, "file42.c", CUTEST_MAKE_SOURCE));
+  assert_eq(299, find_node(graph, "file299.c"));
+  assert_eq(-1, find_node(graph, "file300.c"));
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * add_target()
+ */
+module_test(add_target_shall_make_the_target_a_dependent_of_its_inputs)
+{
+  cutest_make_graph_t* graph = new_graph();
+  int input[2];
+  int target;
+  input[0] = add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  input[1] = add_node(graph, "a.h", CUTEST_MAKE_SOURCE);
+  target = add_target(graph, "a.o", CUTEST_MAKE_CUTEST_O, input, 2, 1, NULL);
+  assert_eq(2, target);
+  assert_eq(2, graph->node[target].input_cnt);
+  assert_eq(1, graph->node[target].arg_cnt);
+  assert_eq(1, graph->node[0].dependent_cnt);
+  assert_eq(target, graph->node[1].dependent[0]);
+  delete_graph(graph);
+}
+
+module_test(add_target_shall_return_negative_1_if_an_input_is_missing)
+{
+  cutest_make_graph_t* graph = new_graph();
+  int input[1] = {-1};
+  assert_eq(-1, add_target(graph, "a.o", CUTEST_MAKE_CUTEST_O, input, 1, 1,
+                           NULL));
+  assert_eq(0, graph->cnt);
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * add_extra_files()
+ */
+module_test(add_extra_files_shall_add_every_file_once)
+{
+  cutest_make_graph_t* graph = new_graph();
+  int input[12];
+  assert_eq(5, add_extra_files(graph, "a.c  b.c", input, 3));
+  assert_eq(0, input[3]);
+  assert_eq(1, input[4]);
+  assert_eq("b.c", graph->node[1].path);
+  assert_eq(-1, add_extra_files(graph, "1 2 3 4 5 6 7 8 9", input, 4));
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * get_extra_files()
+ */
+test(get_extra_files_shall_find_the_files_of_a_test_suite)
+{
+  cutest_make_opts_t opts = {0};
+  opts.link_cnt = 2;
+  opts.link_suite[0] = "a_test";
+  opts.link_files[0] = "a.c";
+  opts.link_suite[1] = "b_test";
+  opts.link_files[1] = "b.c";
+  m.strcmp.func = strcmp;
+  assert_eq("b.c", get_extra_files(&opts, "b_test"));
+  assert_eq(NULL, get_extra_files(&opts, "c_test"));
+}
+
+/*****************************************************************************
+ * get_target_path()
+ */
+test(get_target_path_shall_name_the_target_after_the_test_suite)
+{
+  char buf[64];
+  m.strlen.func = strlen;
+  m.sprintf.func = sprintf;
+  get_target_path(buf, NULL, "test/foo_test.c", "_mocks.h");
+  assert_eq("test/foo_mocks.h", buf);
+}
+
+test(get_target_path_shall_put_the_target_in_the_build_directory)
+{
+  char buf[64];
+  m.strlen.func = strlen;
+  m.sprintf.func = sprintf;
+  m.strrchr.func = strrchr;
+  get_target_path(buf, "build/plain", "test/foo_test.c", "_mocks.h");
+  assert_eq("build/plain/foo_mocks.h", buf);
+  get_target_path(buf, "build/plain", "foo_test.c", "_test");
+  assert_eq("build/plain/foo_test", buf);
+}
+
+/*****************************************************************************
+ * get_object_dir()
+ */
+test(get_object_dir_shall_be_the_tools_without_a_build_directory)
+{
+  cutest_make_opts_t opts = {0};
+  opts.tools = "cutest";
+  assert_eq("cutest", get_object_dir(&opts));
+  opts.build = "build/plain";
+  assert_eq("build/plain", get_object_dir(&opts));
+}
+
+/*****************************************************************************
+ * read_headers()
+ */
+module_test(read_headers_shall_add_a_node_per_header_of_the_first_rule)
+{
+  cutest_make_graph_t* graph = new_graph();
+  FILE* fd = fopen("read_headers.s.d", "w");
+  int s;
+  fputs("read_headers.s: a.c a.h \\\n b.h\na.h:\n\nb.h:\n", fd);
+  fclose(fd);
+  s = add_node(graph, "read_headers.s", CUTEST_MAKE_MOCKABLES_S);
+  add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  graph->node[s].deps = s;
+  assert_eq(0, read_headers(graph, s));
+  unlink("read_headers.s.d");
+  assert_eq(3, graph->node[s].header_cnt);
+  assert_eq(1, graph->node[s].header[0]);
+  assert_eq(CUTEST_MAKE_SOURCE, graph->node[1].step);
+  assert_eq("b.h", graph->node[graph->node[s].header[2]].path);
+  assert_eq(CUTEST_MAKE_HEADER, graph->node[graph->node[s].header[2]].step);
+  assert_eq(4, graph->cnt);
+  delete_graph(graph);
+}
+
+module_test(read_headers_shall_take_the_headers_of_another_node)
+{
+  cutest_make_graph_t* graph = new_graph();
+  FILE* fd = fopen("read_headers.s.d", "w");
+  int s;
+  int h;
+  fputs("read_headers.s: a.c a.h\n", fd);
+  fclose(fd);
+  s = add_node(graph, "read_headers.s", CUTEST_MAKE_MOCKABLES_S);
+  h = add_node(graph, "read_headers_mocks.h", CUTEST_MAKE_MOCKS_H);
+  graph->node[h].deps = s;
+  assert_eq(0, read_headers(graph, h));
+  unlink("read_headers.s.d");
+  assert_eq(2, graph->node[h].header_cnt);
+  assert_eq(0, graph->node[s].header_cnt);
+  delete_graph(graph);
+}
+
+module_test(read_headers_shall_forget_the_headers_when_the_file_is_gone)
+{
+  cutest_make_graph_t* graph = new_graph();
+  int s = add_node(graph, "read_headers.s", CUTEST_MAKE_MOCKABLES_S);
+  graph->node[s].deps = s;
+  graph->node[s].header = malloc(sizeof(int));
+  graph->node[s].header_cnt = 1;
+  assert_eq(0, read_headers(graph, s));
+  assert_eq(0, graph->node[s].header_cnt);
+  assert_eq(NULL, graph->node[s].header);
+  delete_graph(graph);
+}
+
+module_test(read_headers_shall_do_nothing_without_a_file_to_take_them_from)
+{
+  cutest_make_graph_t* graph = new_graph();
+  int s = add_node(graph, "read_headers.o", CUTEST_MAKE_MOCKABLES_O);
+  assert_eq(0, read_headers(graph, s));
+  assert_eq(0, graph->node[s].header_cnt);
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * add_test_suite()
+ */
+module_test(add_test_suite_shall_add_all_steps_of_a_test_suite)
+{
+  cutest_make_graph_t* graph = new_graph();
+  cutest_make_opts_t opts = {0};
+  int input[1];
+  int cut_o;
+  int run;
+  opts.src = "src";
+  opts.tools = "cutest";
+  opts.cproto = "/usr/bin/cproto";
+  opts.link_cnt = 1;
+  opts.link_suite[0] = "foo_test";
+  opts.link_files[0] = "extra.c";
+  input[0] = add_node(graph, "cutest/cutest.c", CUTEST_MAKE_SOURCE);
+  cut_o = add_target(graph, "cutest/cutest.o", CUTEST_MAKE_CUTEST_O,
+                        input, 1, 1, NULL);
+  assert_eq(0, add_test_suite(graph, &opts, "test/foo_test.c", cut_o));
+  assert_eq(0, add_test_suite(graph, &opts, "test/bar_test.c", cut_o));
+  run = find_node(graph, "test/foo_test.stdout");
+  assert_eq(CUTEST_MAKE_RUN, graph->node[run].step);
+  assert_eq(find_node(graph, "test/foo_test"), graph->node[run].input[0]);
+  assert_eq(6, graph->node[graph->node[run].input[0]].input_cnt);
+  assert_eq(5, graph->node[graph->node[run].input[0]].arg_cnt);
+  assert_eq(find_node(graph, "cutest/cutest_libc_mocks.o"),
+            graph->node[graph->node[run].input[0]].input[4]);
+  assert_eq("extra.c", graph->node[graph->node[run].input[0]].extra);
+  assert_eq(CUTEST_MAKE_SOURCE,
+            graph->node[find_node(graph, "src/foo.c")].step);
+  assert_eq(CUTEST_MAKE_MOCKS_H,
+            graph->node[find_node(graph, "test/bar_mocks.h")].step);
+  assert_eq(CUTEST_MAKE_MOCKS_O,
+            graph->node[find_node(graph, "test/bar_mocks.o")].step);
+  assert_eq(find_node(graph, "test/foo_mockables.s"),
+            graph->node[find_node(graph, "test/foo_mocks.c")].deps);
+  assert_eq(find_node(graph, "test/foo_mocks.o"),
+            graph->node[find_node(graph, "test/foo_mocks.o")].deps);
+  assert_eq(-1, graph->node[find_node(graph, "test/foo_proxified.s")].deps);
+  assert_eq(2, graph->node[cut_o].dependent_cnt);
+  assert_eq(6, graph->node[find_node(graph, "cutest/cutest.h")].dependent_cnt);
+  assert_eq(2, graph->node[find_node(graph,
+                                     "cutest/cutest_libc_mocks.lst")].dependent_cnt);
+  delete_graph(graph);
+}
+
+module_test(add_test_suite_shall_compile_again_with_another_compiler)
+{
+  cutest_make_graph_t* graph = new_graph();
+  cutest_make_opts_t opts = {0};
+  int input[1];
+  int cut_o;
+  int cc;
+  opts.src = "src";
+  opts.tools = "cutest";
+  opts.cc = "/usr/bin/gcc";
+  input[0] = add_node(graph, "cutest/cutest.c", CUTEST_MAKE_SOURCE);
+  cut_o = add_target(graph, "cutest/cutest.o", CUTEST_MAKE_CUTEST_O,
+                     input, 1, 1, NULL);
+  assert_eq(0, add_test_suite(graph, &opts, "test/foo_test.c", cut_o));
+  cc = find_node(graph, "/usr/bin/gcc");
+  assert_eq(CUTEST_MAKE_SOURCE, graph->node[cc].step);
+  assert_eq(2, graph->node[cc].dependent_cnt);
+  assert_eq(cc, graph->node[find_node(graph, "test/foo_mockables.s")].input[1]);
+  assert_eq(cc, graph->node[find_node(graph, "test/foo_mocks.o")].input[2]);
+  delete_graph(graph);
+}
+
+module_test(add_test_suite_shall_make_everything_in_the_build_directory)
+{
+  cutest_make_graph_t* graph = new_graph();
+  cutest_make_opts_t opts = {0};
+  int input[1];
+  int cut_o;
+  int test;
+  opts.src = "src";
+  opts.tools = "cutest";
+  opts.build = "build/plain";
+  opts.link_cnt = 1;
+  opts.link_suite[0] = "foo_test";
+  opts.link_files[0] = "extra.c";
+  input[0] = add_node(graph, "cutest/cutest.c", CUTEST_MAKE_SOURCE);
+  cut_o = add_target(graph, "build/plain/cutest.o", CUTEST_MAKE_CUTEST_O,
+                     input, 1, 1, NULL);
+  assert_eq(0, add_test_suite(graph, &opts, "test/foo_test.c", cut_o));
+  test = find_node(graph, "build/plain/foo_test");
+  assert_eq(CUTEST_MAKE_TEST, graph->node[test].step);
+  assert_eq("extra.c", graph->node[test].extra);
+  assert_eq(find_node(graph, "build/plain/cutest_libc_mocks.o"),
+            graph->node[test].input[4]);
+  assert_eq(CUTEST_MAKE_RUN,
+            graph->node[find_node(graph, "build/plain/foo_test.stdout")].step);
+  assert_eq(CUTEST_MAKE_SOURCE,
+            graph->node[find_node(graph, "test/foo_test.c")].step);
+  assert_eq(-1, find_node(graph, "test/foo_mocks.h"));
+  delete_graph(graph);
+}
+
+module_test(add_test_suite_shall_return_negative_1_if_not_a_test_suite)
+{
+  cutest_make_graph_t* graph = new_graph();
+  cutest_make_opts_t opts = {0};
+  opts.src = "src";
+  opts.tools = "cutest";
+  assert_eq(-1, add_test_suite(graph, &opts, "test/foo.c", 0));
+  assert_eq(-1, add_test_suite(graph, &opts, "_test.c", 0));
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * new_test_suites()
+ */
+test(new_test_suites_shall_return_NULL_if_out_of_memory)
+{
+  cutest_make_opts_t opts = {0};
+  assert_eq(NULL, new_test_suites(&opts, 0, NULL));
+}
+
+test(new_test_suites_shall_add_every_test_suite)
+{
+  cutest_make_node_t node[2] = {{0}, {0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  char path[32];
+  char* argv[] = {"program_name", "-n", "a_test.c", "b_test.c"};
+  opts.tools = "cutest";
+  opts.first_suite = 2;
+  graph.node = node;
+  m.new_graph.retval = &graph;
+  m.malloc.retval = path;
+  m.add_target.retval = 1;
+  assert_eq(&graph, new_test_suites(&opts, 4, argv));
+  assert_eq(2, m.add_test_suite.call_count);
+  assert_eq("b_test.c", m.add_test_suite.args.arg2);
+  assert_eq(1, m.add_test_suite.args.arg3);
+  assert_eq(1, node[1].deps);
+}
+
+test(new_test_suites_shall_read_the_headers_of_every_node)
+{
+  cutest_make_node_t node[2] = {{0}, {0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  char path[32];
+  char* argv[] = {"program_name", "-n", "a_test.c"};
+  opts.tools = "cutest";
+  opts.first_suite = 2;
+  graph.cnt = 2;
+  graph.node = node;
+  m.new_graph.retval = &graph;
+  m.malloc.retval = path;
+  m.add_target.retval = 1;
+  assert_eq(&graph, new_test_suites(&opts, 3, argv));
+  assert_eq(2, m.read_headers.call_count);
+  assert_eq(1, m.read_headers.args.arg1);
+}
+
+test(new_test_suites_shall_return_NULL_if_the_headers_can_not_be_read)
+{
+  cutest_make_node_t node[2] = {{0}, {0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  char path[32];
+  char* argv[] = {"program_name", "-n", "a_test.c"};
+  opts.tools = "cutest";
+  opts.first_suite = 2;
+  graph.cnt = 2;
+  graph.node = node;
+  m.new_graph.retval = &graph;
+  m.malloc.retval = path;
+  m.add_target.retval = 1;
+  m.read_headers.retval = -1;
+  assert_eq(NULL, new_test_suites(&opts, 3, argv));
+  assert_eq(1, m.delete_graph.call_count);
+}
+
+test(new_test_suites_shall_return_NULL_if_a_test_suite_fails)
+{
+  cutest_make_node_t node[2] = {{0}, {0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  char path[32];
+  char* argv[] = {"program_name", "-n", "a_test.c", "b_test.c"};
+  opts.tools = "cutest";
+  opts.first_suite = 2;
+  graph.node = node;
+  m.new_graph.retval = &graph;
+  m.malloc.retval = path;
+  m.add_target.retval = 1;
+  m.add_test_suite.retval = -1;
+  assert_eq(NULL, new_test_suites(&opts, 4, argv));
+  assert_eq(1, m.add_test_suite.call_count);
+  assert_eq(1, m.delete_graph.call_count);
+}
+
+/*****************************************************************************
+ * get_word()
+ */
+module_test(get_word_shall_only_get_words_that_fit_a_hash)
+{
+  char buf[] = "0123456789abcdef - 1 2 3 a b.c\n";
+  char word[NET_HASH_LEN];
+  char* pos = get_word(buf, word);
+  assert_eq("0123456789abcdef", word);
+  assert_eq("- 1 2 3 a b.c\n", pos);
+  assert_eq(NULL, get_word("0123456789abcdef0 -", word));
+  assert_eq(NULL, get_word(&buf[16], word));
+  assert_eq(NULL, get_word("-", word));
+}
+
+/*****************************************************************************
+ * read_state(), write_state()
+ */
+test(read_state_shall_do_nothing_if_nothing_has_been_made)
+{
+  read_state("cutest_make.state", NULL);
+  assert_eq(0, m.fgets.call_count);
+}
+
+module_test(write_state_shall_write_what_read_state_reads)
+{
+  cutest_make_graph_t* graph = new_graph();
+  FILE* fd = NULL;
+  add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  add_node(graph, "a b.o", CUTEST_MAKE_CUTEST_O);
+  add_node(graph, "a_test.stdout", CUTEST_MAKE_RUN);
+  add_node(graph, "b.c", CUTEST_MAKE_SOURCE);
+  strcpy(graph->node[0].old_hash, "0123456789abcdef");
+  graph->node[0].sec = 1;
+  graph->node[0].nsec = 2;
+  graph->node[0].size = 3;
+  strcpy(graph->node[1].old_key, "fedcba9876543210");
+  strcpy(graph->node[1].old_hash, "00000000000000ff");
+  strcpy(graph->node[2].old_hash, "00000000000000ff");
+  assert_eq(0, write_state("write_state.state", graph));
+  fd = fopen("write_state.state", "a");
+  fputs("garbage\n", fd);
+  fclose(fd);
+  memset(graph->node, 0, 4 * sizeof(cutest_make_node_t) - 4 * sizeof(char*));
+  delete_graph(graph);
+
+  graph = new_graph();
+  add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  add_node(graph, "a b.o", CUTEST_MAKE_CUTEST_O);
+  read_state("write_state.state", graph);
+  unlink("write_state.state");
+  assert_eq("-", graph->node[0].old_key);
+  assert_eq("0123456789abcdef", graph->node[0].old_hash);
+  assert_eq(1, graph->node[0].sec);
+  assert_eq(2, graph->node[0].nsec);
+  assert_eq(3, graph->node[0].size);
+  assert_eq("fedcba9876543210", graph->node[1].old_key);
+  assert_eq("00000000000000ff", graph->node[1].old_hash);
+  delete_graph(graph);
+}
+
+test(write_state_shall_return_negative_1_if_the_file_can_not_be_opened)
+{
+  char tmp_name[32];
+  m.malloc.retval = tmp_name;
+  assert_eq(-1, write_state("cutest_make.state", NULL));
+  assert_eq(1, m.free.call_count);
+}
+
+/*****************************************************************************
+ * hash_node_file()
+ */
+test(hash_node_file_shall_return_negative_1_if_there_is_no_file)
+{
+  cutest_make_node_t node = {0};
+  node.path = "a.c";
+  m.stat.retval = -1;
+  assert_eq(-1, hash_node_file(&node));
+  assert_eq(0, m.get_file_hash.call_count);
+}
+
+static int stat_stub(const char* path, struct stat* st)
+{
+  (void)path;
+  memset(st, 0, sizeof(*st));
+  st->st_mtime = 1;
+  st->st_size = 3;
+  return 0;
+}
+
+test(hash_node_file_shall_not_read_a_file_that_is_not_touched)
+{
+  cutest_make_node_t node = {0};
+  node.path = "a.c";
+  node.sec = 1;
+  node.size = 3;
+  strcpy(node.old_hash, "0123456789abcdef");
+  m.stat.func = stat_stub;
+  m.strcpy.func = strcpy;
+  assert_eq(0, hash_node_file(&node));
+  assert_eq(0, m.get_file_hash.call_count);
+  assert_eq("0123456789abcdef", node.hash);
+}
+
+test(hash_node_file_shall_read_a_file_that_is_touched)
+{
+  cutest_make_node_t node = {0};
+  node.path = "a.c";
+  node.size = 4711;
+  strcpy(node.old_hash, "0123456789abcdef");
+  m.stat.func = stat_stub;
+  assert_eq(0, hash_node_file(&node));
+  assert_eq(1, m.get_file_hash.call_count);
+  assert_eq(1, node.sec);
+  assert_eq(3, node.size);
+}
+
+/*****************************************************************************
+ * new_command()
+ */
+module_test(new_command_shall_put_the_files_in_the_recipe)
+{
+  cutest_make_graph_t* graph = new_graph();
+  cutest_make_opts_t opts = {0};
+  int input[3];
+  int target;
+  char* command = NULL;
+  set_recipes(&opts);
+  opts.recipe[CUTEST_MAKE_TEST] = "cc -o %t %1 %2 %3 %x 100%% %q";
+  input[0] = add_node(graph, "a.s", CUTEST_MAKE_SOURCE);
+  input[1] = add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  input[2] = add_node(graph, "cutest.h", CUTEST_MAKE_SOURCE);
+  target = add_target(graph, "a_test", CUTEST_MAKE_TEST, input, 3, 2,
+                      "b.c c.c");
+  command = new_command(graph, &opts, target);
+  assert_eq("cc -o a_test a.s a.c  b.c c.c 100% %q", command);
+  free(command);
+  delete_graph(graph);
+}
+
+module_test(new_command_shall_give_the_runners_the_verbosity)
+{
+  cutest_make_graph_t* graph = new_graph();
+  cutest_make_opts_t opts = {0};
+  int input[1];
+  int target;
+  char* command = NULL;
+  set_recipes(&opts);
+  opts.verbose = 1;
+  input[0] = add_node(graph, "a_test", CUTEST_MAKE_SOURCE);
+  target = add_target(graph, "a_test.stdout", CUTEST_MAKE_RUN, input, 1, 1,
+                      NULL);
+  command = new_command(graph, &opts, target);
+  assert_eq("a_test -v -j -s 1> a_test.stdout 2> a_test.stderr", command);
+  free(command);
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * get_key()
+ */
+module_test(get_key_shall_depend_on_the_recipe_and_the_inputs)
+{
+  cutest_make_graph_t* graph = new_graph();
+  char key_a[NET_HASH_LEN];
+  char key_b[NET_HASH_LEN];
+  char key_c[NET_HASH_LEN];
+  int input[1];
+  int target;
+  input[0] = add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  target = add_target(graph, "a.o", CUTEST_MAKE_CUTEST_O, input, 1, 1, NULL);
+  strcpy(graph->node[input[0]].hash, "0123456789abcdef");
+  get_key(key_a, graph, "cc -c a.c -o a.o", target);
+  get_key(key_b, graph, "cc -O2 -c a.c -o a.o", target);
+  strcpy(graph->node[input[0]].hash, "0123456789abcdee");
+  get_key(key_c, graph, "cc -c a.c -o a.o", target);
+  assert_eq(16, strlen(key_a));
+  assert_eq(1, 0 != strcmp(key_a, key_b));
+  assert_eq(1, 0 != strcmp(key_a, key_c));
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * fold_headers()
+ */
+static void write_file(const char* file_name, const char* content)
+{
+  FILE* fd = fopen(file_name, "w");
+  fputs(content, fd);
+  fclose(fd);
+}
+
+static void get_header_key(char* key)
+{
+  /* The key of a step in a build of its own, as from a fresh state */
+  cutest_make_graph_t* graph = new_graph();
+  int s = add_node(graph, "fold_headers.s", CUTEST_MAKE_MOCKABLES_S);
+  graph->node[s].deps = s;
+  strcpy(graph->node[s].input_key, "0123456789abcdef");
+  read_headers(graph, s);
+  fold_headers(graph, s);
+  strcpy(key, graph->node[s].key);
+  delete_graph(graph);
+}
+
+module_test(fold_headers_shall_change_the_key_when_a_header_is_edited)
+{
+  char key_a[NET_HASH_LEN];
+  char key_b[NET_HASH_LEN];
+  char key_c[NET_HASH_LEN];
+  write_file("fold_headers.s.d", "fold_headers.s: fold_headers.h\n");
+  write_file("fold_headers.h", "#define A 1\n");
+  get_header_key(key_a);
+  get_header_key(key_b);
+  write_file("fold_headers.h", "#define A 2\n");
+  get_header_key(key_c);
+  unlink("fold_headers.s.d");
+  unlink("fold_headers.h");
+  assert_eq(key_a, key_b);
+  assert_eq(1, 0 != strcmp(key_a, key_c));
+  assert_eq(1, 0 != strcmp(key_a, "0123456789abcdef"));
+}
+
+module_test(fold_headers_shall_change_the_key_when_a_header_is_gone)
+{
+  char key_a[NET_HASH_LEN];
+  char key_b[NET_HASH_LEN];
+  write_file("fold_headers.s.d", "fold_headers.s: fold_headers.h\n");
+  write_file("fold_headers.h", "#define A 1\n");
+  get_header_key(key_a);
+  unlink("fold_headers.h");
+  get_header_key(key_b);
+  unlink("fold_headers.s.d");
+  assert_eq(1, 0 != strcmp(key_a, key_b));
+}
+
+/*****************************************************************************
+ * is_up_to_date()
+ */
+test(is_up_to_date_shall_never_consider_a_run_up_to_date)
+{
+  cutest_make_node_t node = {0};
+  node.step = CUTEST_MAKE_RUN;
+  assert_eq(0, is_up_to_date(&node));
+}
+
+test(is_up_to_date_shall_not_consider_a_new_key_up_to_date)
+{
+  cutest_make_node_t node = {0};
+  node.step = CUTEST_MAKE_TEST;
+  strcpy(node.key, "0123456789abcdef");
+  strcpy(node.old_key, "0123456789abcdee");
+  m.strcmp.func = strcmp;
+  assert_eq(0, is_up_to_date(&node));
+  assert_eq(0, m.hash_node_file.call_count);
+}
+
+static int hash_node_file_stub(cutest_make_node_t* node)
+{
+  strcpy(node->hash, "00000000000000ff");
+  return 0;
+}
+
+test(is_up_to_date_shall_only_consider_an_untouched_target_up_to_date)
+{
+  cutest_make_node_t node = {0};
+  node.step = CUTEST_MAKE_TEST;
+  strcpy(node.key, "0123456789abcdef");
+  strcpy(node.old_key, "0123456789abcdef");
+  strcpy(node.old_hash, "00000000000000ff");
+  m.strcmp.func = strcmp;
+  m.strcpy.func = strcpy;
+  m.hash_node_file.func = hash_node_file_stub;
+  assert_eq(1, is_up_to_date(&node));
+  strcpy(node.old_hash, "00000000000000fe");
+  assert_eq(0, is_up_to_date(&node));
+}
+
+/*****************************************************************************
+ * push_ready(), pop_ready()
+ */
+module_test(pop_ready_shall_pop_the_latest_step_of_the_first_suite_first)
+{
+  cutest_make_graph_t* graph = new_graph();
+  const int step[6] = {CUTEST_MAKE_MOCKABLES_S, CUTEST_MAKE_TEST,
+                       CUTEST_MAKE_MOCKABLES_S, CUTEST_MAKE_RUN,
+                       CUTEST_MAKE_CUTEST_O, CUTEST_MAKE_TEST};
+  char path[16];
+  int i;
+  for (i = 0; i < 6; i++) {
+    sprintf(path, "node%d", i);
+    add_node(graph, path, step[i]);
+  }
+  graph->ready = malloc(6 * sizeof(int));
+  for (i = 0; i < 6; i++) {
+    push_ready(graph, i);
+  }
+  assert_eq(CUTEST_MAKE_READY, graph->node[4].status);
+  assert_eq(3, pop_ready(graph));
+  assert_eq(1, pop_ready(graph));
+  assert_eq(5, pop_ready(graph));
+  assert_eq(0, pop_ready(graph));
+  assert_eq(2, pop_ready(graph));
+  assert_eq(4, pop_ready(graph));
+  assert_eq(0, graph->ready_cnt);
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * start_graph()
+ */
+test(start_graph_shall_return_negative_1_if_out_of_memory)
+{
+  cutest_make_graph_t graph = {0};
+  assert_eq(-1, start_graph(&graph));
+}
+
+test(start_graph_shall_hash_the_sources)
+{
+  int ready[3];
+  cutest_make_node_t node[3] = {{.step = CUTEST_MAKE_SOURCE},
+                                {.step = CUTEST_MAKE_CUTEST_O,
+                                 .input_cnt = 2},
+                                {.step = CUTEST_MAKE_SOURCE}};
+  cutest_make_graph_t graph = {0};
+  graph.cnt = 3;
+  graph.node = node;
+  m.malloc.retval = ready;
+  assert_eq(0, start_graph(&graph));
+  assert_eq(2, m.hash_node_file.call_count);
+  assert_eq(&node[2], m.hash_node_file.args.arg0);
+  assert_eq(2, node[1].waiting);
+}
+
+test(start_graph_shall_return_1_if_a_source_is_missing)
+{
+  int ready[1];
+  cutest_make_node_t node[1] = {{.step = CUTEST_MAKE_SOURCE, .path = "a.c"}};
+  cutest_make_graph_t graph = {0};
+  graph.cnt = 1;
+  graph.node = node;
+  m.malloc.retval = ready;
+  m.hash_node_file.retval = -1;
+  assert_eq(1, start_graph(&graph));
+}
+
+/*****************************************************************************
+ * finish_node(), fail_node(), release_sources()
+ */
+static cutest_make_graph_t* new_chain()
+{
+  /* a.c -> a.s -> a.o, and b.c -> a.o */
+  cutest_make_graph_t* graph = new_graph();
+  int input[2];
+  int s;
+  input[0] = add_node(graph, "a.c", CUTEST_MAKE_SOURCE);
+  s = add_target(graph, "a.s", CUTEST_MAKE_MOCKABLES_S, input, 1, 1, NULL);
+  input[0] = s;
+  input[1] = add_node(graph, "b.c", CUTEST_MAKE_SOURCE);
+  add_target(graph, "a.o", CUTEST_MAKE_MOCKABLES_O, input, 2, 1, NULL);
+  start_graph(graph);
+  return graph;
+}
+
+module_test(finish_node_shall_make_a_dependent_ready_when_all_inputs_are_done)
+{
+  cutest_make_graph_t* graph = new_chain();
+  strcpy(graph->node[0].hash, "0123456789abcdef");
+  strcpy(graph->node[2].hash, "0123456789abcdef");
+  release_sources(graph);
+  assert_eq(CUTEST_MAKE_DONE, graph->node[0].status);
+  assert_eq(CUTEST_MAKE_READY, graph->node[1].status);
+  assert_eq(CUTEST_MAKE_WAITING, graph->node[3].status);
+  assert_eq(1, graph->node[3].waiting);
+  assert_eq(1, graph->ready_cnt);
+  delete_graph(graph);
+}
+
+module_test(fail_node_shall_fail_everything_made_from_a_missing_source)
+{
+  cutest_make_graph_t* graph = new_chain();
+  strcpy(graph->node[0].hash, "0123456789abcdef");
+  strcpy(graph->node[3].old_key, "0123456789abcdef");
+  release_sources(graph);
+  assert_eq(CUTEST_MAKE_FAILED, graph->node[2].status);
+  assert_eq(CUTEST_MAKE_FAILED, graph->node[3].status);
+  assert_eq("", graph->node[3].old_key);
+  assert_eq(CUTEST_MAKE_READY, graph->node[1].status);
+  delete_graph(graph);
+}
+
+module_test(finish_node_shall_fail_a_node_whose_recipe_failed)
+{
+  cutest_make_graph_t* graph = new_chain();
+  finish_node(graph, 1, 1);
+  assert_eq(CUTEST_MAKE_FAILED, graph->node[1].status);
+  assert_eq(CUTEST_MAKE_FAILED, graph->node[3].status);
+  delete_graph(graph);
+}
+
+/*****************************************************************************
+ * new_pool()
+ */
+test(new_pool_shall_output_an_error_if_out_of_memory)
+{
+  assert_eq(NULL, new_pool(4));
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq(stderr, m.fwrite.args.arg3);
+}
+
+module_test(new_pool_shall_have_no_running_workers)
+{
+  cutest_make_pool_t* pool = new_pool(4);
+  assert_eq(4, pool->workers);
+  assert_eq(0, pool->running);
+  assert_eq(0, pool->pid[3]);
+  delete_pool(pool);
+}
+
+/*****************************************************************************
+ * spawn_command()
+ */
+test(spawn_command_shall_return_negative_1_if_fork_fails)
+{
+  m.fork.retval = -1;
+  assert_eq(-1, spawn_command("true"));
+}
+
+test(spawn_command_shall_run_the_command_in_a_shell)
+{
+  m.fork.retval = 0;
+  spawn_command("true");
+  assert_eq("/bin/sh", m.execl.args.arg0);
+  assert_eq(EXIT_FAILURE, m._exit.args.arg0);
+}
+
+test(spawn_command_shall_return_the_pid_of_the_shell)
+{
+  m.fork.retval = 4711;
+  assert_eq(4711, spawn_command("true"));
+  assert_eq(0, m.execl.call_count);
+}
+
+/*****************************************************************************
+ * copy_file()
+ */
+test(copy_file_shall_return_negative_1_if_the_file_can_not_be_read)
+{
+  assert_eq(-1, copy_file("from", "to"));
+  assert_eq(0, m.rename.call_count);
+}
+
+module_test(copy_file_shall_copy_the_content_and_the_mode)
+{
+  struct stat st;
+  char buf[16] = {0};
+  FILE* fd = fopen("cutest_make_test.from", "w");
+  fputs("content", fd);
+  fclose(fd);
+  chmod("cutest_make_test.from", 0750);
+  assert_eq(0, copy_file("cutest_make_test.from", "cutest_make_test.to"));
+  fd = fopen("cutest_make_test.to", "r");
+  fgets(buf, sizeof(buf), fd);
+  fclose(fd);
+  stat("cutest_make_test.to", &st);
+  unlink("cutest_make_test.from");
+  unlink("cutest_make_test.to");
+  assert_eq("content", buf);
+  assert_eq(0750, st.st_mode & 0777);
+}
+
+/*****************************************************************************
+ * new_cache_path()
+ */
+test(new_cache_path_shall_return_NULL_without_a_cache)
+{
+  cutest_make_node_t node = {.step = CUTEST_MAKE_MOCKS_H, .key = "1234"};
+  cutest_make_opts_t opts = {0};
+  assert_eq(NULL, new_cache_path(&opts, &node));
+}
+
+test(new_cache_path_shall_return_NULL_for_a_runner_run)
+{
+  cutest_make_node_t node = {.step = CUTEST_MAKE_RUN, .key = "1234"};
+  cutest_make_opts_t opts = {0};
+  opts.cache = "cache";
+  assert_eq(NULL, new_cache_path(&opts, &node));
+}
+
+test(new_cache_path_shall_name_the_file_after_the_key)
+{
+  char path[32];
+  cutest_make_node_t node = {.step = CUTEST_MAKE_MOCKS_H, .key = "1234"};
+  cutest_make_opts_t opts = {0};
+  opts.cache = "cache";
+  m.strlen.func = strlen;
+  m.sprintf.func = sprintf;
+  m.malloc.retval = path;
+  assert_eq(path, new_cache_path(&opts, &node));
+  assert_eq("cache/1234", path);
+}
+
+/*****************************************************************************
+ * fetch_from_cache()
+ */
+test(fetch_from_cache_shall_return_0_if_the_key_is_not_in_the_cache)
+{
+  char path[8];
+  cutest_make_node_t node = {0};
+  m.new_cache_path.retval = path;
+  m.access.retval = -1;
+  assert_eq(0, fetch_from_cache(NULL, &node));
+  assert_eq(0, m.copy_file.call_count);
+  assert_eq(path, m.free.args.arg0);
+}
+
+test(fetch_from_cache_shall_copy_the_file_from_the_cache)
+{
+  char path[8];
+  cutest_make_node_t node = {.path = "foo_mocks.h"};
+  m.new_cache_path.retval = path;
+  assert_eq(1, fetch_from_cache(NULL, &node));
+  assert_eq(path, m.copy_file.args.arg0);
+  assert_eq("foo_mocks.h", m.copy_file.args.arg1);
+}
+
+/*****************************************************************************
+ * store_in_cache()
+ */
+test(store_in_cache_shall_copy_the_file_to_the_cache)
+{
+  char path[8];
+  cutest_make_node_t node = {.path = "foo_mocks.h"};
+  m.new_cache_path.retval = path;
+  m.access.retval = -1;
+  store_in_cache(NULL, &node);
+  assert_eq("foo_mocks.h", m.copy_file.args.arg0);
+  assert_eq(path, m.copy_file.args.arg1);
+}
+
+test(store_in_cache_shall_not_copy_a_file_that_is_already_there)
+{
+  char path[8];
+  cutest_make_node_t node = {0};
+  m.new_cache_path.retval = path;
+  store_in_cache(NULL, &node);
+  assert_eq(0, m.copy_file.call_count);
+}
+
+/*****************************************************************************
+ * new_cached_deps_path()
+ */
+test(new_cached_deps_path_shall_return_NULL_without_a_cache)
+{
+  cutest_make_opts_t opts = {0};
+  cutest_make_node_t node = {0};
+  strcpy(node.input_key, "1234");
+  assert_eq(NULL, new_cached_deps_path(&opts, &node));
+}
+
+test(new_cached_deps_path_shall_name_the_file_after_the_input_key)
+{
+  char path[32];
+  cutest_make_opts_t opts = {0};
+  cutest_make_node_t node = {0};
+  opts.cache = "cache";
+  strcpy(node.key, "5678");
+  strcpy(node.input_key, "1234");
+  m.strlen.func = strlen;
+  m.sprintf.func = sprintf;
+  m.malloc.retval = path;
+  assert_eq(path, new_cached_deps_path(&opts, &node));
+  assert_eq("cache/1234.d", path);
+}
+
+/*****************************************************************************
+ * fetch_headers_from_cache()
+ */
+test(fetch_headers_from_cache_shall_copy_the_headers_for_a_fresh_checkout)
+{
+  char path[8];
+  char name[8];
+  cutest_make_node_t node[2] = {{0}, {.path = "foo_mocks.o", .deps = 1}};
+  cutest_make_graph_t graph = {0};
+  graph.node = node;
+  m.new_cached_deps_path.retval = path;
+  m.new_deps_name.retval = name;
+  m.access.retval = -1;
+  fetch_headers_from_cache(NULL, &graph, 1);
+  assert_eq(path, m.copy_file.args.arg0);
+  assert_eq(name, m.copy_file.args.arg1);
+}
+
+test(fetch_headers_from_cache_shall_keep_the_headers_of_the_checkout)
+{
+  char path[8];
+  char name[8];
+  cutest_make_node_t node[1] = {{.path = "foo_mocks.o", .deps = 0}};
+  cutest_make_graph_t graph = {0};
+  graph.node = node;
+  m.new_cached_deps_path.retval = path;
+  m.new_deps_name.retval = name;
+  fetch_headers_from_cache(NULL, &graph, 0);
+  assert_eq(0, m.copy_file.call_count);
+}
+
+test(fetch_headers_from_cache_shall_leave_the_headers_to_the_node_listing_them)
+{
+  cutest_make_node_t node[2] = {{0}, {.path = "foo_mocks.h", .deps = 0}};
+  cutest_make_graph_t graph = {0};
+  graph.node = node;
+  fetch_headers_from_cache(NULL, &graph, 1);
+  assert_eq(0, m.new_cached_deps_path.call_count);
+}
+
+/*****************************************************************************
+ * store_headers_in_cache()
+ */
+test(store_headers_in_cache_shall_copy_the_headers_to_the_cache)
+{
+  char path[8];
+  char name[8];
+  cutest_make_node_t node = {.path = "foo_mocks.o"};
+  m.new_cached_deps_path.retval = path;
+  m.new_deps_name.retval = name;
+  store_headers_in_cache(NULL, &node);
+  assert_eq("foo_mocks.o", m.new_deps_name.args.arg0);
+  assert_eq(name, m.copy_file.args.arg0);
+  assert_eq(path, m.copy_file.args.arg1);
+}
+
+test(store_headers_in_cache_shall_do_nothing_if_no_headers_were_listed)
+{
+  char path[8];
+  char name[8];
+  cutest_make_node_t node = {.path = "foo_mockables.lst"};
+  m.new_cached_deps_path.retval = path;
+  m.new_deps_name.retval = name;
+  m.access.retval = -1;
+  store_headers_in_cache(NULL, &node);
+  assert_eq(0, m.copy_file.call_count);
+  assert_eq(2, m.free.call_count);
+}
+
+/*****************************************************************************
+ * start_node()
+ */
+test(start_node_shall_not_run_a_node_that_is_up_to_date)
+{
+  char command[8];
+  cutest_make_node_t node[1] = {{0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  m.new_command.retval = command;
+  m.is_up_to_date.retval = 1;
+  assert_eq(1, start_node(NULL, &graph, &opts, 0));
+  assert_eq(0, m.spawn_command.call_count);
+  assert_eq(command, m.free.args.arg0);
+}
+
+test(start_node_shall_not_run_a_node_that_is_in_the_cache)
+{
+  char command[8];
+  cutest_make_node_t node[1] = {{0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  m.new_command.retval = command;
+  m.fetch_from_cache.retval = 1;
+  assert_eq(1, start_node(NULL, &graph, &opts, 0));
+  assert_eq(&node[0], m.fetch_from_cache.args.arg1);
+  assert_eq(0, m.spawn_command.call_count);
+}
+
+test(start_node_shall_run_a_node_in_a_free_slot)
+{
+  char command[8];
+  pid_t pid[2] = {4711, 0};
+  int slot_node[2] = {0, 0};
+  cutest_make_pool_t pool = {2, 1, pid, slot_node};
+  cutest_make_node_t node[2] = {{0}, {0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  m.new_command.retval = command;
+  m.spawn_command.retval = 4712;
+  assert_eq(0, start_node(&pool, &graph, &opts, 1));
+  assert_eq(4712, pid[1]);
+  assert_eq(1, slot_node[1]);
+  assert_eq(2, pool.running);
+  assert_eq(CUTEST_MAKE_RUNNING, node[1].status);
+  assert_eq(0, m.puts.call_count);
+}
+
+test(start_node_shall_print_the_command_if_verbose)
+{
+  char command[8] = "cc";
+  pid_t pid[1] = {0};
+  int slot_node[1] = {0};
+  cutest_make_pool_t pool = {1, 0, pid, slot_node};
+  cutest_make_node_t node[1] = {{0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  opts.verbose = 1;
+  m.new_command.retval = command;
+  m.spawn_command.retval = 4711;
+  assert_eq(0, start_node(&pool, &graph, &opts, 0));
+  assert_eq(command, m.puts.args.arg0);
+}
+
+test(start_node_shall_return_negative_1_if_the_command_can_not_be_run)
+{
+  char command[8];
+  pid_t pid[1] = {0};
+  int slot_node[1] = {0};
+  cutest_make_pool_t pool = {1, 0, pid, slot_node};
+  cutest_make_node_t node[1] = {{0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  m.new_command.retval = command;
+  m.spawn_command.retval = -1;
+  assert_eq(-1, start_node(&pool, &graph, &opts, 0));
+  assert_eq(0, pid[0]);
+  assert_eq(0, pool.running);
+}
+
+test(start_node_shall_return_negative_1_if_the_headers_can_not_be_read)
+{
+  char command[8];
+  cutest_make_node_t node[1] = {{0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  m.new_command.retval = command;
+  m.read_headers.retval = -1;
+  assert_eq(-1, start_node(NULL, &graph, &opts, 0));
+  assert_eq(0, m.fold_headers.call_count);
+  assert_eq(command, m.free.args.arg0);
+}
+
+test(start_node_shall_key_the_node_by_its_inputs_and_headers)
+{
+  char command[8];
+  cutest_make_node_t node[1] = {{0}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  m.new_command.retval = command;
+  m.is_up_to_date.retval = 1;
+  start_node(NULL, &graph, &opts, 0);
+  assert_eq(1, m.fetch_headers_from_cache.call_count);
+  assert_eq(&opts, m.fetch_headers_from_cache.args.arg0);
+  assert_eq(1, m.read_headers.call_count);
+  assert_eq(node[0].input_key, m.get_key.args.arg0);
+  assert_eq(1, m.fold_headers.call_count);
+  assert_eq(0, m.fold_headers.args.arg1);
+}
+
+/*****************************************************************************
+ * wait_for_node()
+ */
+test(wait_for_node_shall_return_negative_1_if_nothing_is_running)
+{
+  int status = 0;
+  m.waitpid.retval = -1;
+  assert_eq(-1, wait_for_node(NULL, &status));
+}
+
+test(wait_for_node_shall_return_the_node_that_finished)
+{
+  int status = 0;
+  pid_t pid[2] = {4711, 4712};
+  int slot_node[2] = {3, 5};
+  cutest_make_pool_t pool = {2, 2, pid, slot_node};
+  m.waitpid.retval = 4712;
+  assert_eq(5, wait_for_node(&pool, &status));
+  assert_eq(0, pid[1]);
+  assert_eq(1, pool.running);
+  assert_eq(0, status);
+}
+
+/*****************************************************************************
+ * print_run()
+ */
+test(print_run_shall_only_print_the_errors_of_a_failed_runner)
+{
+  char stderr_name[32];
+  int input[1] = {0};
+  cutest_make_node_t node[2] = {{.path = "a_test"},
+                                {.path = "a_test.stdout", .input = input}};
+  cutest_make_graph_t graph = {0};
+  graph.node = node;
+  m.strlen.func = strlen;
+  m.sprintf.func = sprintf;
+  print_run(&graph, 1, 0);
+  assert_eq(1, m.print_file.call_count);
+  assert_eq("a_test.stdout", m.print_file.args.arg0);
+  m.malloc.retval = stderr_name;
+  print_run(&graph, 1, 1);
+  assert_eq(3, m.print_file.call_count);
+  assert_eq("a_test.stderr", m.print_file.args.arg0);
+}
+
+/*****************************************************************************
+ * run_graph()
+ */
+test(run_graph_shall_return_0_when_there_is_nothing_to_make)
+{
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  assert_eq(0, run_graph(&pool, &graph, &opts));
+  assert_eq(0, m.wait_for_node.call_count);
+}
+
+static int pop_ready_stub(cutest_make_graph_t* graph)
+{
+  graph->ready_cnt--;
+  return 4;
+}
+
+test(run_graph_shall_fail_a_node_that_can_not_be_started)
+{
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  graph.ready_cnt = 1;
+  m.pop_ready.func = pop_ready_stub;
+  m.start_node.retval = -1;
+  assert_eq(-1, run_graph(&pool, &graph, &opts));
+  assert_eq(1, m.fail_node.call_count);
+  assert_eq(4, m.fail_node.args.arg1);
+}
+
+test(run_graph_shall_finish_a_node_that_is_up_to_date)
+{
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  graph.ready_cnt = 1;
+  m.pop_ready.func = pop_ready_stub;
+  m.start_node.retval = 1;
+  assert_eq(0, run_graph(&pool, &graph, &opts));
+  assert_eq(1, m.finish_node.call_count);
+  assert_eq(4, m.finish_node.args.arg1);
+  assert_eq(0, m.finish_node.args.arg2);
+}
+
+static int start_node_stub(cutest_make_pool_t* pool,
+                           cutest_make_graph_t* graph,
+                           const cutest_make_opts_t* opts, int idx)
+{
+  (void)graph;
+  (void)opts;
+  (void)idx;
+  pool->running++;
+  return 0;
+}
+
+static int wait_for_node_stub(cutest_make_pool_t* pool, int* status)
+{
+  pool->running--;
+  *status = 1;
+  return 0;
+}
+
+test(run_graph_shall_print_the_verdicts_of_a_runner)
+{
+  cutest_make_node_t node[1] = {{.step = CUTEST_MAKE_RUN}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  graph.ready_cnt = 1;
+  m.pop_ready.func = pop_ready_stub;
+  m.start_node.func = start_node_stub;
+  m.wait_for_node.func = wait_for_node_stub;
+  assert_eq(0, run_graph(&pool, &graph, &opts));
+  assert_eq(1, m.print_run.call_count);
+  assert_eq(1, m.print_run.args.arg2);
+  assert_eq(1, m.finish_node.args.arg2);
+}
+
+test(run_graph_shall_output_an_error_if_a_recipe_fails)
+{
+  cutest_make_node_t node[1] = {{.step = CUTEST_MAKE_TEST,
+                                 .path = "a_test"}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  graph.ready_cnt = 1;
+  m.pop_ready.func = pop_ready_stub;
+  m.start_node.func = start_node_stub;
+  m.wait_for_node.func = wait_for_node_stub;
+  assert_eq(0, run_graph(&pool, &graph, &opts));
+  assert_eq(0, m.print_run.call_count);
+  assert_eq(1, m.fprintf.call_count);
+}
+
+static int wait_for_node_made_stub(cutest_make_pool_t* pool, int* status)
+{
+  pool->running--;
+  *status = 0;
+  return 0;
+}
+
+test(run_graph_shall_store_a_made_file_in_the_cache)
+{
+  cutest_make_node_t node[1] = {{.step = CUTEST_MAKE_MOCKS_H}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  graph.ready_cnt = 1;
+  m.pop_ready.func = pop_ready_stub;
+  m.start_node.func = start_node_stub;
+  m.wait_for_node.func = wait_for_node_made_stub;
+  assert_eq(0, run_graph(&pool, &graph, &opts));
+  assert_eq(1, m.read_headers.call_count);
+  assert_eq(1, m.fold_headers.call_count);
+  assert_eq(1, m.store_in_cache.call_count);
+  assert_eq(&node[0], m.store_in_cache.args.arg1);
+  assert_eq(1, m.store_headers_in_cache.call_count);
+  assert_eq(&node[0], m.store_headers_in_cache.args.arg1);
+  assert_eq(0, m.finish_node.args.arg2);
+}
+
+test(run_graph_shall_fail_a_node_whose_headers_can_not_be_read_again)
+{
+  cutest_make_node_t node[1] = {{.step = CUTEST_MAKE_MOCKS_O}};
+  cutest_make_graph_t graph = {0};
+  cutest_make_pool_t pool = {1, 0, NULL, NULL};
+  cutest_make_opts_t opts = {0};
+  graph.node = node;
+  graph.ready_cnt = 1;
+  m.pop_ready.func = pop_ready_stub;
+  m.start_node.func = start_node_stub;
+  m.wait_for_node.func = wait_for_node_made_stub;
+  m.read_headers.retval = -1;
+  assert_eq(-1, run_graph(&pool, &graph, &opts));
+  assert_eq(0, m.store_in_cache.call_count);
+  assert_eq(1, m.finish_node.args.arg2);
+}
+
+/*****************************************************************************
+ * count_failed_runs()
+ */
+test(count_failed_runs_shall_count_the_runners_that_did_not_pass)
+{
+  cutest_make_node_t node[4] = {{.step = CUTEST_MAKE_RUN,
+                                 .status = CUTEST_MAKE_DONE},
+                                {.step = CUTEST_MAKE_TEST,
+                                 .status = CUTEST_MAKE_FAILED},
+                                {.step = CUTEST_MAKE_RUN,
+                                 .status = CUTEST_MAKE_FAILED},
+                                {.step = CUTEST_MAKE_RUN,
+                                 .status = CUTEST_MAKE_WAITING}};
+  cutest_make_graph_t graph = {0};
+  int runs = 0;
+  graph.cnt = 4;
+  graph.node = node;
+  assert_eq(2, count_failed_runs(&graph, &runs));
+  assert_eq(3, runs);
+}
+
+/*****************************************************************************
+ * main()
+ */
+static cutest_make_graph_t main_graph;
+static cutest_make_pool_t main_pool;
+
+test(main_shall_return_EXIT_FAILURE_if_the_graph_can_not_be_made)
+{
+  assert_eq(EXIT_FAILURE, main(3, 0x2));
+  assert_eq(1, m.handle_args.call_count);
+  assert_eq(0, m.read_state.call_count);
+}
+
+static void handle_args_cache_stub(cutest_make_opts_t* opts, int argc,
+                                   char* argv[])
+{
+  (void)argc;
+  (void)argv;
+  opts->build = NULL;
+  opts->cache = "cache";
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_cache_can_not_be_created)
+{
+  m.handle_args.func = handle_args_cache_stub;
+  m.mkdir.retval = -1;
+  m.access.retval = -1;
+  assert_eq(EXIT_FAILURE, main(3, 0x2));
+  assert_eq("cache", m.mkdir.args.arg0);
+  assert_eq(0, m.new_test_suites.call_count);
+}
+
+static void handle_args_build_stub(cutest_make_opts_t* opts, int argc,
+                                   char* argv[])
+{
+  (void)argc;
+  (void)argv;
+  opts->build = "build/plain";
+  opts->cache = NULL;
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_build_directory_can_not_be_created)
+{
+  m.handle_args.func = handle_args_build_stub;
+  m.mkdir.retval = -1;
+  m.access.retval = -1;
+  assert_eq(EXIT_FAILURE, main(3, 0x2));
+  assert_eq("build/plain", m.mkdir.args.arg0);
+  assert_eq(0, m.new_test_suites.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_graph_can_not_be_started)
+{
+  m.new_test_suites.retval = &main_graph;
+  m.start_graph.retval = -1;
+  assert_eq(EXIT_FAILURE, main(3, 0x2));
+  assert_eq(1, m.read_state.call_count);
+  assert_eq(0, m.run_graph.call_count);
+  assert_eq(1, m.delete_graph.call_count);
+}
+
+test(main_shall_make_everything_and_write_the_state)
+{
+  m.new_test_suites.retval = &main_graph;
+  m.new_pool.retval = &main_pool;
+  assert_eq(EXIT_SUCCESS, main(3, 0x2));
+  assert_eq(1, m.release_sources.call_count);
+  assert_eq(1, m.run_graph.call_count);
+  assert_eq(1, m.write_state.call_count);
+  assert_eq(&main_graph, m.write_state.args.arg1);
+  assert_eq(1, m.delete_pool.call_count);
+}
+
+static int count_failed_runs_stub(const cutest_make_graph_t* graph, int* runs)
+{
+  (void)graph;
+  *runs = 2;
+  return 1;
+}
+
+test(main_shall_return_EXIT_FAILURE_if_a_runner_did_not_pass)
+{
+  m.new_test_suites.retval = &main_graph;
+  m.new_pool.retval = &main_pool;
+  m.count_failed_runs.func = count_failed_runs_stub;
+  assert_eq(EXIT_FAILURE, main(3, 0x2));
+}
+
+static void handle_args_stub(cutest_make_opts_t* opts, int argc,
+                             char* argv[])
+{
+  (void)argc;
+  (void)argv;
+  opts->jobs = 0;
+}
+
+test(main_shall_use_one_worker_per_core_by_default)
+{
+  m.handle_args.func = handle_args_stub;
+  m.new_test_suites.retval = &main_graph;
+  m.get_number_of_cores.retval = 8;
+  main(3, 0x2);
+  assert_eq(8, m.new_pool.args.arg0);
+}
+
+#undef main
@@ -47,11 +47,34 @@
  *  $ ./cutest_mock design_under_test.c mockables.lst /path/to/cutest
  *
  * And it will scan the source-code for mockable functions and
- * output a header file-style text, containing everything needed to
- * test your code alongside with the ``cutest.h`` file.
+ * output a header file-style text, containing the declarations and
+ * the mock control structure needed to test your code alongside with
+ * the ``cutest.h`` file.
+ *
+ * The mock-up implementations are output to a C source file of their
+ * own, given the ``-c`` option, so that they are compiled once and not
+ * every time the test suite is edited::
+ *
+ *  $ ./cutest_mock -c design_under_test.c mockables.lst /path/to/cutest
+ *
+ * The mock-ups of the most common C library functions are shared by all
+ * test suites. They are made once from ``cutest_libc.c``, given the
+ * ``-s`` option, and the list of the functions they implement is given
+ * to every test suite with the ``-l`` option, so that the test suite
+ * only tells the shared mock-ups where its mock control structures are.
  *
  * The ``mockables.lst`` is produced by ``nm dut.o | sed 's/.* //g'``.
  *
+ * The prototypes can be read from the DWARF debug information of object
+ * files compiled with ``-g`` instead of from ``cproto``, given the ``-d``
+ * option once per object file, and then the path to ``cproto`` is left
+ * out. The object file of the design under test knows every function it
+ * defines or calls, and the one of ``cutest_libc.c`` the C library
+ * functions that the compiler may call in place of others::
+ *
+ *  $ ./cutest_mock -d dut.o -d cutest_libc.o design_under_test.c \
+ *    mockables.lst /path/to/cutest
+ *
  * However, if you use the ``Makefile`` targets specified in the
  * beginning of this document you will probably not need to run it
  * manually.
@@ -66,12 +89,16 @@
 #include "arg.h"
 #include "mockable.h"
 #include "helpers.h"
+#include "dwarf.h"
+
+#define MAX_DWARF_OBJECTS 8
 
 static void usage(const char* program_name)
 {
-  printf("USAGE: %s <path-to-cproto> <dut-source-file.c> <mockables.lst> <path-to-cutest>"
-         " [-I flags]\n",
-         program_name);
+  printf("USAGE: %s [-c [-l shared.lst]|-s] <path-to-cproto> <dut-source-file.c> <mockables.lst> <path-to-cutest>"
+         " [-I flags]\n"
+         "       %s [-c [-l shared.lst]|-s] -d <object-file> [-d ...] <dut-source-file.c> <mockables.lst> <path-to-cutest>\n",
+         program_name, program_name);
 }
 
 static size_t find_name_pos(const char* buf) {
@@ -942,6 +969,39 @@ static int execute_cproto(mockable_list_t* list, const char* cproto,
   return 1;
 }
 
+static void parse_dwarf_row(void* list, char* buf)
+{
+  /*
+   * main() is renamed to MAIN when the design under test is compiled, and
+   * is renamed back here just like in the list of mockables.
+   */
+  char* s = strstr(buf, "MAIN(");
+
+  if ((NULL != s) && ((s == buf) || (' ' == s[-1]) || ('*' == s[-1]))) {
+    memcpy(s, "main", 4);
+  }
+  parse_cproto_row(list, buf);
+}
+
+static int read_dwarf_prototypes(mockable_list_t* list, int object_cnt,
+                                 const char* object[])
+{
+  /*
+   * Read the prototypes from the debug information of every object file,
+   * the first prototype of a function is the one that is used.
+   */
+  int i;
+
+  for (i = 0; i < object_cnt; i++) {
+    if (0 != dwarf_prototypes(object[i], parse_dwarf_row, list)) {
+      fprintf(stderr, "ERROR: Unable to read the debug information of '%s'\n",
+              object[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
 static void print_function_args(arg_list_t* list) {
   /*
    * Helper to print each function prototype argument as a raw copy from the
@@ -965,10 +1025,11 @@ static void print_mock_control_struct_with_return_type(mockable_node_t* node)
    * Output a mock-control structure including the retval member (e.g. non-
    * void return types can be controlled via the mock-control structure).
    */
-  printf("  struct {\n"
+  printf("  struct cutest_mock_control_%s_s {\n"
          "    int call_count;\n"
          "    %s%s retval;\n"
          "    %s%s (*func)(",
+         node->symbol_name,
          (node->return_type.is_struct ? "struct " : ""),
          node->return_type.name,
          (node->return_type.is_struct ? "struct " : ""),
@@ -983,9 +1044,9 @@ static void print_mock_control_struct_with_void_type(mockable_node_t* node)
    * Output a mock-control structure without the retval member (for functions
    * that does not return anything).
    */
-  printf("  struct {\n"
+  printf("  struct cutest_mock_control_%s_s {\n"
          "    int call_count;\n"
-         "    void (*func)(");
+         "    void (*func)(", node->symbol_name);
   print_function_args(node->args);
   printf(");\n");
 }
@@ -1061,7 +1122,7 @@ static void print_mock_control_structs(mockable_list_t* list)
          " * Mock control structures, can be read or written from your tests.\n"
          " */\n"
          "\n"
-         "struct {\n\n"
+         "struct cutest_mock_control_s {\n\n"
          "  int keep_the_struct_with_contents_if_no_mocks_generated;\n"
          "\n");
   for (node = list->first; NULL != node; node = node->next) {
@@ -1073,7 +1134,9 @@ static void print_mock_control_structs(mockable_list_t* list)
       printf("\n");
     }
   }
-  printf("} cutest_mock;\n"
+  printf("};\n"
+         "\n"
+         "extern struct cutest_mock_control_s cutest_mock;\n"
          "\n");
 }
 
@@ -1413,13 +1476,134 @@ static void print_mock_implementations(mockable_list_t* list)
          "\n");
 
   for (node = list->first; NULL != node; node = node->next) {
-    if (0 == node->legit) {
+    if ((0 == node->legit) || (1 == node->shared)) {
       continue;
     }
     print_mock_implementation(node);
   }
 }
 
+static void mark_shared_mockables(mockable_list_t* list,
+                                  mockable_list_t* shared_list)
+{
+  /*
+   * The mock-ups of the functions in the shared list are linked from the
+   * shared C library mock-ups, which only use the mock control structure
+   * of the test suite. A function only counts as shared if the test suite
+   * has a mock control structure for it.
+   */
+  mockable_node_t* node;
+
+  for (node = shared_list->first; NULL != node; node = node->next) {
+    mockable_node_t* mockable = symbol_is_in_list(list, node->symbol_name);
+
+    if ((NULL != mockable) && (1 == mockable->legit)) {
+      mockable->shared = 1;
+      node->legit = 1;
+    }
+  }
+}
+
+static void print_shared_mock_control(mockable_node_t* node)
+{
+  if (0 == node->legit) {
+    printf("struct cutest_mock_shared_%s_s* cutest_mock_shared_%s = NULL;\n",
+           node->symbol_name, node->symbol_name);
+    return;
+  }
+  printf("struct cutest_mock_shared_%s_s* cutest_mock_shared_%s =\n"
+         "  (struct cutest_mock_shared_%s_s*)&cutest_mock.%s;\n",
+         node->symbol_name, node->symbol_name, node->symbol_name,
+         node->symbol_name);
+}
+
+static void print_shared_mock_controls(mockable_list_t* shared_list)
+{
+  mockable_node_t* node = NULL;
+
+  printf("/*\n"
+         " * Where the shared C library mock-ups find their mock control\n"
+         " * structures, or NULL if they are not used by this test suite.\n"
+         " */\n"
+         "\n");
+
+  for (node = shared_list->first; NULL != node; node = node->next) {
+    print_shared_mock_control(node);
+  }
+  printf("\n");
+}
+
+static void print_shared_mock_implementation(mockable_node_t* node)
+{
+  /*
+   * A shared mock-up is the same as the mock-up of a single test suite,
+   * but its mock control structure is the one of the test suite that it
+   * is linked into, reached through a pointer.
+   */
+  printf("struct cutest_mock_shared_%s_s {\n"
+         "  struct cutest_mock_control_%s_s %s;\n"
+         "};\n"
+         "\n"
+         "extern struct cutest_mock_shared_%s_s* cutest_mock_shared_%s;\n"
+         "\n"
+         "#define cutest_mock (*cutest_mock_shared_%s)\n",
+         node->symbol_name, node->symbol_name, node->symbol_name,
+         node->symbol_name, node->symbol_name, node->symbol_name);
+  print_mock_implementation(node);
+  printf("#undef cutest_mock\n"
+         "\n");
+}
+
+static void print_shared_mock_implementations(mockable_list_t* list)
+{
+  mockable_node_t* node = NULL;
+
+  printf("/*\n"
+         " * Mock-up implementations shared by all test suites.\n"
+         " */\n"
+         "\n");
+
+  for (node = list->first; NULL != node; node = node->next) {
+    if (0 == node->legit) {
+      continue;
+    }
+    print_shared_mock_implementation(node);
+  }
+}
+
+static void print_mocks_source_prologue(const char* filename)
+{
+  /*
+   * The mock-up implementations are compiled in the same way as the test
+   * suite runner includes the mocks header file, but only once.
+   */
+  const char* name = strrchr(filename, '/');
+
+  name = (NULL == name) ? filename : name + 1;
+  printf("#define _XOPEN_SOURCE\n"
+         "#include <stdlib.h>\n"
+         "#include <stdio.h>\n"
+         "#include <string.h>\n"
+         "\n"
+         "#define main MAIN /* To make sure we can test main() */\n"
+         "#define inline\n"
+         "#include \"%.*s_mocks.h\"\n"
+         "\n",
+         (int)(strlen(name) - strlen(".c")), name);
+}
+
+static void print_mock_control_struct_definition()
+{
+  printf("struct cutest_mock_control_s cutest_mock;\n"
+         "\n");
+}
+
+static void print_mocks_source_epilogue()
+{
+  printf("#undef inline\n"
+         "#undef main\n");
+}
+
 static void print_mock_func_module_test_assignment(mockable_node_t* node)
 {
   printf("  cutest_mock.%s.func = %s;\n",
@@ -1444,11 +1628,50 @@ static void print_mock_func_module_test_assignments(mockable_list_t* list)
 int main(int argc, char* argv[])
 {
   const char* program_name = argv[0];
-  const char* cproto = argv[1];
-  const char* filename = argv[2];
-  const char* nm_filename = argv[3];
-  const char* cutest_path = argv[4];
+  int source = 0;
+  int shared = 0;
+  const char* shared_filename = NULL;
+  const char* cproto = NULL;
+  const char* filename = NULL;
+  const char* nm_filename = NULL;
+  const char* cutest_path = NULL;
+  const char* object[MAX_DWARF_OBJECTS];
+  int object_cnt = 0;
+  int retval = 0;
   mockable_list_t* list = NULL;
+  mockable_list_t* shared_list = NULL;
+
+  /* The rest of the arguments are the same for the header and the source */
+  while ((argc > 1) && ('-' == argv[1][0])) {
+    if (0 == strcmp("-c", argv[1])) {
+      source = 1;
+    }
+    else if (0 == strcmp("-s", argv[1])) {
+      shared = 1;
+    }
+    else if ((0 == strcmp("-l", argv[1])) && (argc > 2)) {
+      shared_filename = argv[2];
+      argc--;
+      argv++;
+    }
+    else if ((0 == strcmp("-d", argv[1])) && (argc > 2) &&
+             (object_cnt < MAX_DWARF_OBJECTS)) {
+      object[object_cnt++] = argv[2];
+      argc--;
+      argv++;
+    }
+    else {
+      break;
+    }
+    argc--;
+    argv++;
+  }
+
+  /* The object files take the place of cproto on the command line */
+  if (0 < object_cnt) {
+    argc++;
+    argv--;
+  }
 
   if (argc < 5) {
     fprintf(stderr, "ERROR: Missing argument\n");
@@ -1456,6 +1679,15 @@ int main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
+  if ((NULL != shared_filename) && !file_exists(shared_filename)) {
+    return EXIT_FAILURE;
+  }
+
+  cproto = argv[1];
+  filename = argv[2];
+  nm_filename = argv[3];
+  cutest_path = argv[4];
+
   list = new_mockable_list();
   if (NULL == list) {
     return EXIT_FAILURE;
@@ -1463,22 +1695,51 @@ int main(int argc, char* argv[])
 
   get_mockables(list, nm_filename);
 
-  if (0 == execute_cproto(list, cproto, argc, argv)) {
+  if (0 < object_cnt) {
+    retval = read_dwarf_prototypes(list, object_cnt, object);
+  }
+  else {
+    retval = execute_cproto(list, cproto, argc, argv);
+  }
+  if (0 == retval) {
     delete_mockable_list(list);
     return EXIT_FAILURE;
   }
 
   printf("/*\n"
-         " * This file is generated by '%s %s %s %s'\n"
-         " */\n\n", program_name, filename, nm_filename, cutest_path);
-
-  copy_pre_processor_directives_from_dut(filename);
-  print_dut_declarations(list);
-  print_mock_declarations(list);
-  print_mock_control_structs(list);
-  print_mock_implementations(list);
-
-  print_mock_func_module_test_assignments(list);
+         " * This file is generated by '%s%s%s%s%s %s %s %s'\n"
+         " */\n\n", program_name, source ? " -c" : "", shared ? " -s" : "",
+         (NULL != shared_filename) ? " -l " : "",
+         (NULL != shared_filename) ? shared_filename : "", filename,
+         nm_filename, cutest_path);
+
+  if (shared) {
+    print_mocks_source_prologue(filename);
+    print_shared_mock_implementations(list);
+    print_mocks_source_epilogue();
+  }
+  else if (source) {
+    if ((NULL != shared_filename) &&
+        (NULL != (shared_list = new_mockable_list()))) {
+      get_mockables(shared_list, shared_filename);
+      mark_shared_mockables(list, shared_list);
+    }
+    print_mocks_source_prologue(filename);
+    print_mock_control_struct_definition();
+    print_mock_implementations(list);
+    if (NULL != shared_list) {
+      print_shared_mock_controls(shared_list);
+      delete_mockable_list(shared_list);
+    }
+    print_mock_func_module_test_assignments(list);
+    print_mocks_source_epilogue();
+  }
+  else {
+    copy_pre_processor_directives_from_dut(filename);
+    print_dut_declarations(list);
+    print_mock_declarations(list);
+    print_mock_control_structs(list);
+  }
 
   delete_mockable_list(list);
 
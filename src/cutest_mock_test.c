@@ -1405,6 +1405,54 @@ test(parse_cproto_row_shall_return_the_pointer_to_a_mockable_node)
   assert_eq(&node, parse_cproto_row(0x1234, 0x5678));
 }
 
+/*****************************************************************************
+ * parse_dwarf_row()
+ */
+
+test(parse_dwarf_row_shall_rename_MAIN_back_to_main)
+{
+  char buf[] = "int MAIN(int argc, char *argv[]);";
+  m.strstr.func = strstr;
+  m.memcpy.func = memcpy;
+  parse_dwarf_row((void*)0x1234, buf);
+  assert_eq("int main(int argc, char *argv[]);", buf);
+  assert_eq(1, m.parse_cproto_row.call_count);
+  assert_eq((void*)0x1234, m.parse_cproto_row.args.arg0);
+  assert_eq(buf, m.parse_cproto_row.args.arg1);
+}
+
+test(parse_dwarf_row_shall_not_rename_other_functions_ending_with_MAIN)
+{
+  char buf[] = "int GET_MAIN(void);";
+  m.strstr.func = strstr;
+  m.memcpy.func = memcpy;
+  parse_dwarf_row((void*)0x1234, buf);
+  assert_eq("int GET_MAIN(void);", buf);
+  assert_eq(1, m.parse_cproto_row.call_count);
+}
+
+/*****************************************************************************
+ * read_dwarf_prototypes()
+ */
+
+test(read_dwarf_prototypes_shall_read_every_object_file)
+{
+  const char* object[] = {"dut.o", "cutest_libc.o"};
+  assert_eq(1, read_dwarf_prototypes((mockable_list_t*)0x1234, 2, object));
+  assert_eq(2, m.dwarf_prototypes.call_count);
+  assert_eq("cutest_libc.o", m.dwarf_prototypes.args.arg0);
+  assert_eq((void*)0x1234, m.dwarf_prototypes.args.arg2);
+}
+
+test(read_dwarf_prototypes_shall_output_an_error_if_an_object_can_not_be_read)
+{
+  const char* object[] = {"dut.o", "cutest_libc.o"};
+  m.dwarf_prototypes.retval = -1;
+  assert_eq(0, read_dwarf_prototypes((mockable_list_t*)0x1234, 2, object));
+  assert_eq(1, m.dwarf_prototypes.call_count);
+  assert_eq(1, m.fprintf.call_count);
+}
+
 /*****************************************************************************
  * construct_cproto_command_line()
  */
@@ -2460,6 +2508,156 @@ test(print_mock_implementations_shall_print_and_traverse_the_list)
   assert_eq(3, m.print_mock_implementation.call_count);
 }
 
+test(print_mock_implementations_shall_skip_the_shared_mock_ups)
+{
+  mockable_list_t list;
+  mockable_node_t node[2];
+  memset(&list, 0, sizeof(list));
+  memset(node, 0, sizeof(node));
+  list.first = &node[0];
+  node[0].next = &node[1];
+  list.last = &node[1];
+
+  node[0].legit = node[1].legit = 1;
+  node[1].shared = 1;
+
+  print_mock_implementations(&list);
+  assert_eq(1, m.print_mock_implementation.call_count);
+  assert_eq(&node[0], m.print_mock_implementation.args.arg0);
+}
+
+/*****************************************************************************
+ * mark_shared_mockables()
+ */
+
+test(mark_shared_mockables_shall_mark_the_legit_mockables_in_the_shared_list)
+{
+  mockable_list_t list;
+  mockable_list_t shared_list;
+  mockable_node_t node;
+  mockable_node_t shared_node;
+  memset(&node, 0, sizeof(node));
+  memset(&shared_node, 0, sizeof(shared_node));
+  shared_list.first = &shared_node;
+  shared_node.symbol_name = "malloc";
+  node.legit = 1;
+  m.symbol_is_in_list.retval = &node;
+
+  mark_shared_mockables(&list, &shared_list);
+  assert_eq(&list, m.symbol_is_in_list.args.arg0);
+  assert_eq("malloc", m.symbol_is_in_list.args.arg1);
+  assert_eq(1, node.shared);
+  assert_eq(1, shared_node.legit);
+}
+
+test(mark_shared_mockables_shall_not_mark_mockables_that_are_not_legit)
+{
+  mockable_list_t list;
+  mockable_list_t shared_list;
+  mockable_node_t node;
+  mockable_node_t shared_node;
+  memset(&node, 0, sizeof(node));
+  memset(&shared_node, 0, sizeof(shared_node));
+  shared_list.first = &shared_node;
+  m.symbol_is_in_list.retval = &node;
+
+  mark_shared_mockables(&list, &shared_list);
+  assert_eq(0, node.shared);
+  assert_eq(0, shared_node.legit);
+}
+
+test(mark_shared_mockables_shall_not_mark_functions_the_dut_does_not_call)
+{
+  mockable_list_t list;
+  mockable_list_t shared_list;
+  mockable_node_t shared_node;
+  memset(&shared_node, 0, sizeof(shared_node));
+  shared_list.first = &shared_node;
+
+  mark_shared_mockables(&list, &shared_list);
+  assert_eq(0, shared_node.legit);
+}
+
+/*****************************************************************************
+ * print_shared_mock_control()
+ */
+
+test(print_shared_mock_control_shall_point_to_the_mock_control_structure)
+{
+  mockable_node_t node;
+  memset(&node, 0, sizeof(node));
+  node.legit = 1;
+  print_shared_mock_control(&node);
+  assert_eq(1, m.printf.call_count);
+  assert_eq("struct cutest_mock_shared_%s_s* cutest_mock_shared_%s =\n"
+            "  (struct cutest_mock_shared_%s_s*)&cutest_mock.%s;\n",
+            m.printf.args.arg0);
+}
+
+test(print_shared_mock_control_shall_point_to_NULL_if_not_used)
+{
+  mockable_node_t node;
+  memset(&node, 0, sizeof(node));
+  print_shared_mock_control(&node);
+  assert_eq(1, m.printf.call_count);
+  assert_eq("struct cutest_mock_shared_%s_s* cutest_mock_shared_%s = NULL;\n",
+            m.printf.args.arg0);
+}
+
+/*****************************************************************************
+ * print_shared_mock_controls()
+ */
+
+test(print_shared_mock_controls_shall_print_and_traverse_the_whole_list)
+{
+  mockable_list_t list;
+  mockable_node_t node[3];
+  memset(&list, 0, sizeof(list));
+  memset(node, 0, sizeof(node));
+  list.first = &node[0];
+  node[0].next = &node[1];
+  node[1].next = &node[2];
+  list.last = &node[2];
+
+  print_shared_mock_controls(&list);
+  assert_eq(3, m.print_shared_mock_control.call_count);
+}
+
+/*****************************************************************************
+ * print_shared_mock_implementation()
+ */
+
+test(print_shared_mock_implementation_shall_print_the_mock_implementation)
+{
+  mockable_node_t node;
+  memset(&node, 0, sizeof(node));
+  print_shared_mock_implementation(&node);
+  assert_eq(1, m.print_mock_implementation.call_count);
+  assert_eq(&node, m.print_mock_implementation.args.arg0);
+}
+
+/*****************************************************************************
+ * print_shared_mock_implementations()
+ */
+
+test(print_shared_mock_implementations_shall_print_the_legit_mockables)
+{
+  mockable_list_t list;
+  mockable_node_t node[3];
+  memset(&list, 0, sizeof(list));
+  memset(node, 0, sizeof(node));
+  list.first = &node[0];
+  node[0].next = &node[1];
+  node[1].next = &node[2];
+  list.last = &node[2];
+
+  node[0].legit = node[2].legit = 1;
+
+  print_shared_mock_implementations(&list);
+  assert_eq(2, m.print_shared_mock_implementation.call_count);
+  assert_eq(&node[2], m.print_shared_mock_implementation.args.arg0);
+}
+
 /*****************************************************************************
  * print_mock_func_module_test_assignment()
  */
@@ -2495,6 +2693,32 @@ test(print_mock_func_module_test_assignments_shall_print_and_traverse_list)
   assert_eq(3, m.print_mock_func_module_test_assignment.call_count);
 }
 
+/*****************************************************************************
+ * print_mocks_source_prologue()
+ */
+
+test(print_mocks_source_prologue_shall_include_the_mocks_header)
+{
+  print_mocks_source_prologue("src/dut.c");
+  assert_eq(1, m.printf.call_count);
+  assert_eq("src/dut.c", m.strrchr.args.arg0);
+  assert_eq('/', m.strrchr.args.arg1);
+}
+
+/*****************************************************************************
+ * print_mock_control_struct_definition()
+ */
+
+test(print_mock_control_struct_definition_shall_define_cutest_mock)
+{
+  print_mock_control_struct_definition();
+#ifdef CUTEST_GCC
+  assert_eq(1, m.puts.call_count);
+#else
+  assert_eq(1, m.printf.call_count);
+#endif
+}
+
 /*****************************************************************************
  * main()
  */
@@ -2523,6 +2747,7 @@ test(main_shall_return_EXIT_FAILURE_if_arguments_are_less_than_4) {
 
 test(main_shall_call_new_mockable_list_once) {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   main(5, argv);
   assert_eq(1, m.new_mockable_list.call_count);
 }
@@ -2530,12 +2755,14 @@ test(main_shall_call_new_mockable_list_once) {
 test(main_shall_return_EXIT_FAILURE_if_argument_list_could_not_be_created)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   assert_eq(EXIT_FAILURE, main(5, argv));
 }
 
 test(main_shall_get_mockables_from_the_nm_file)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   main(5, argv);
   assert_eq(1, m.get_mockables.call_count);
@@ -2546,6 +2773,7 @@ test(main_shall_get_mockables_from_the_nm_file)
 test(main_shall_execute_cproto_correctly)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   main(5, argv);
   assert_eq(1, m.execute_cproto.call_count);
@@ -2558,6 +2786,7 @@ test(main_shall_execute_cproto_correctly)
 test(main_shall_delete_mockables_list_if_cproto_fails)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 0;
   main(5, argv);
@@ -2568,14 +2797,42 @@ test(main_shall_delete_mockables_list_if_cproto_fails)
 test(main_shall_return_EXIT_FAILURE_if_cproto_fails)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 0;
   assert_eq(EXIT_FAILURE, main(5, argv));
 }
 
+test(main_shall_read_the_prototypes_from_the_object_files_if_given)
+{
+  char* argv[] = {"program_name", "-d", "dut.o", "-d", "cutest_libc.o",
+                  "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.new_mockable_list.retval = 0x1234;
+  m.read_dwarf_prototypes.retval = 1;
+  main(8, argv);
+  assert_eq(1, m.read_dwarf_prototypes.call_count);
+  assert_eq(0x1234, m.read_dwarf_prototypes.args.arg0);
+  assert_eq(2, m.read_dwarf_prototypes.args.arg1);
+  assert_eq(0, m.execute_cproto.call_count);
+  assert_eq("dut_src", m.copy_pre_processor_directives_from_dut.args.arg0);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_object_files_can_not_be_read)
+{
+  char* argv[] = {"program_name", "-d", "dut.o", "dut_src", "nm_filename",
+                  "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.new_mockable_list.retval = 0x1234;
+  m.read_dwarf_prototypes.retval = 0;
+  assert_eq(EXIT_FAILURE, main(6, argv));
+  assert_eq(1, m.delete_mockable_list.call_count);
+}
+
 test(main_shall_print_file_header)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
@@ -2585,6 +2842,7 @@ test(main_shall_print_file_header)
 test(main_shall_copy_pre_processor_directives)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
@@ -2595,6 +2853,7 @@ test(main_shall_copy_pre_processor_directives)
 test(main_shall_print_dut_declarations)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
@@ -2605,6 +2864,7 @@ test(main_shall_print_dut_declarations)
 test(main_shall_print_mock_declarations)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
@@ -2615,6 +2875,7 @@ test(main_shall_print_mock_declarations)
 test(main_shall_print_mock_control_structs)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
@@ -2622,28 +2883,120 @@ test(main_shall_print_mock_control_structs)
   assert_eq(0x1234, m.print_mock_control_structs.args.arg0);
 }
 
-test(main_shall_print_mock_implementations)
+test(main_shall_not_print_mock_implementations_in_the_header)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
+  assert_eq(0, m.print_mocks_source_prologue.call_count);
+  assert_eq(0, m.print_mock_implementations.call_count);
+  assert_eq(0, m.print_mock_func_module_test_assignments.call_count);
+}
+
+test(main_shall_print_mock_implementations_if_c_is_given)
+{
+  char* argv[] = {"program_name", "-c", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.new_mockable_list.retval = 0x1234;
+  m.execute_cproto.retval = 1;
+  main(6, argv);
+  assert_eq(1, m.print_mocks_source_prologue.call_count);
+  assert_eq("dut_src", m.print_mocks_source_prologue.args.arg0);
   assert_eq(1, m.print_mock_implementations.call_count);
   assert_eq(0x1234, m.print_mock_implementations.args.arg0);
+  assert_eq(1, m.print_mocks_source_epilogue.call_count);
+  assert_eq(0, m.print_dut_declarations.call_count);
+  assert_eq(0, m.print_mock_control_structs.call_count);
 }
 
-test(main_shall_print_mock_func_module_test_assignments)
+test(main_shall_print_mock_func_module_test_assignments_if_c_is_given)
 {
-  char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  char* argv[] = {"program_name", "-c", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
-  main(5, argv);
+  main(6, argv);
   assert_eq(1, m.print_mock_func_module_test_assignments.call_count);
 }
 
+test(main_shall_define_the_mock_control_structure_if_c_is_given)
+{
+  char* argv[] = {"program_name", "-c", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.new_mockable_list.retval = 0x1234;
+  m.execute_cproto.retval = 1;
+  main(6, argv);
+  assert_eq(1, m.print_mock_control_struct_definition.call_count);
+  assert_eq(0, m.print_shared_mock_controls.call_count);
+}
+
+test(main_shall_mark_the_shared_mockables_if_l_is_given)
+{
+  char* argv[] = {"program_name", "-c", "-l", "shared.lst", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.file_exists.retval = 1;
+  m.new_mockable_list.retval = 0x1234;
+  m.execute_cproto.retval = 1;
+  main(8, argv);
+  assert_eq(2, m.get_mockables.call_count);
+  assert_eq("shared.lst", m.get_mockables.args.arg1);
+  assert_eq(1, m.mark_shared_mockables.call_count);
+  assert_eq(1, m.print_shared_mock_controls.call_count);
+  assert_eq(1, m.print_mock_implementations.call_count);
+  assert_eq(2, m.delete_mockable_list.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_shared_list_is_missing)
+{
+  char* argv[] = {"program_name", "-c", "-l", "shared.lst", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  assert_eq(EXIT_FAILURE, main(8, argv));
+  assert_eq("shared.lst", m.file_exists.args.arg0);
+  assert_eq(0, m.new_mockable_list.call_count);
+}
+
+test(main_shall_print_the_shared_mock_implementations_if_s_is_given)
+{
+  char* argv[] = {"program_name", "-s", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.new_mockable_list.retval = 0x1234;
+  m.execute_cproto.retval = 1;
+  main(6, argv);
+  assert_eq(1, m.print_mocks_source_prologue.call_count);
+  assert_eq(1, m.print_shared_mock_implementations.call_count);
+  assert_eq(0x1234, m.print_shared_mock_implementations.args.arg0);
+  assert_eq(1, m.print_mocks_source_epilogue.call_count);
+  assert_eq(0, m.print_mock_control_struct_definition.call_count);
+  assert_eq(0, m.print_mock_implementations.call_count);
+  assert_eq(0, m.print_mock_control_structs.call_count);
+}
+
+test(main_shall_pass_the_same_arguments_to_cproto_if_c_is_given)
+{
+  char* argv[] = {"program_name", "-c", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
+  m.new_mockable_list.retval = 0x1234;
+  main(6, argv);
+  assert_eq("nm_filename", m.get_mockables.args.arg1);
+  assert_eq("cproto", m.execute_cproto.args.arg1);
+  assert_eq(5, m.execute_cproto.args.arg2);
+  assert_eq(&argv[1], m.execute_cproto.args.arg3);
+}
+
+test(main_shall_call_usage_if_only_c_is_given)
+{
+  char* argv[] = {"program_name", "-c", "cproto", "dut_src", "nm_filename"};
+  m.strcmp.func = strcmp;
+  assert_eq(EXIT_FAILURE, main(5, argv));
+  assert_eq("program_name", m.usage.args.arg0);
+}
+
 test(main_shall_delete_mockable_list)
 {
   char* argv[] = {"program_name", "cproto", "dut_src", "nm_filename", "cutest_path"};
+  m.strcmp.func = strcmp;
   m.new_mockable_list.retval = 0x1234;
   m.execute_cproto.retval = 1;
   main(5, argv);
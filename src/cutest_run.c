@@ -38,12 +38,27 @@
  * beginning of this document you will probably not need to run it
  * manually.
  *
+ * Given ``--unity`` and several test suites it outputs the main program of
+ * a unity runner instead, that has all the test suites linked into it::
+ *
+ *  $ ./cutest_run --unity foo_test.c bar_test.c
+ *
+ * Every test suite is first linked on its own into one object, where its
+ * ``main()`` is renamed to ``cutest_unity_<suite>()`` and every other
+ * symbol is made local, so the designs under test, the mock-ups and the
+ * CUTest state of the test suites do not clash. A unity runner called by
+ * the name of a test suite, through a symbolic link, runs that test suite
+ * like its own runner would. Called by any other name it runs the test
+ * suites given by ``--suite <name>``, or all of them, one after the other.
+ *
  */
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define CHUNK_SIZE 1024
+#define UNITY_NAME_SIZE 256
 
 #include "testcase.h"
 #include "cutest_run.h"
@@ -51,8 +66,9 @@
 
 static void usage(const char* program_name)
 {
-  printf("USAGE: %s <test-c-source-file> <c-mock-header-file>\n",
-         program_name);
+  printf("USAGE: %s <test-c-source-file> <c-mock-header-file>\n"
+         "       %s --unity <test-c-source-file> ...\n",
+         program_name, program_name);
 }
 
 static void replace_last_parenthesis_with_0(char *buf, int start)
@@ -134,6 +150,11 @@ static void print_header(const char* program_name,
          test_source_file_name);
 }
 
+static void print_test_case_entry(const char* name, int reset_mocks)
+{
+  printf("  {\"%s\", cutest_%s, %d},\n", name, name, reset_mocks);
+}
+
 static void print_main_function_prologue(const char* test_source_file_name,
                                          const size_t test_cnt)
 {
@@ -141,21 +162,27 @@ static void print_main_function_prologue(const char* test_source_file_name,
   printf("int main(int argc, char* argv[])\n"
          "{\n"
          "  cutest_junit_report_t junit_report[%llu];\n"
+         "  size_t order[%llu];\n"
+         "  size_t i;\n"
          "  int just_print = cutest_startup(argc, argv, \"%s\", junit_report, %zu);\n\n",
          test_cnt_llu,
+         test_cnt_llu + 1,
          test_source_file_name,
          test_cnt);
 }
 
-static void print_test_case_executor(const char* name, size_t idx,
-                                     int reset_mocks)
+static void print_test_case_executor(size_t test_cnt)
 {
-  const unsigned long long int idx_llu = idx;
-  printf("  if (1 == cutest_test_name_argument_given(\"%s\")) {\n"
-         "    memset(&cutest_mock, 0, sizeof(cutest_mock));\n"
-         "    cutest_execute_test(&junit_report[%llu], cutest_%s, \"%s\", %d, argv[0]);\n"
+  const unsigned long long int test_cnt_llu = test_cnt;
+  printf("  cutest_order_tests(order, cutest_test_case, %llu, argv[0]);\n"
+         "  for (i = 0; i < sizeof(order) / sizeof(order[0]) - 1; i++) {\n"
+         "    const cutest_test_case_t* t = &cutest_test_case[order[i]];\n"
+         "    if (1 == cutest_test_name_argument_given(t->name)) {\n"
+         "      memset(&cutest_mock, 0, sizeof(cutest_mock));\n"
+         "      cutest_execute_test(&junit_report[order[i]], t->func, t->name, t->do_mock, argv[0]);\n"
+         "    }\n"
          "  }\n",
-         name, idx_llu, name, name, reset_mocks);
+         test_cnt_llu);
 }
 
 static void print_main_function_epilogue(const char* test_source_file_name,
@@ -205,14 +232,20 @@ static size_t parse_test_cases(testcase_list_t* list,
   return test_cnt;
 }
 
-static void print_test_case_executions(testcase_list_t* list)
+static void print_test_case_table(testcase_list_t* list)
 {
+  /*
+   * The tests are run from a table, in the order given by the runner,
+   * which is the order of the suite unless they are shuffled.
+   */
   testcase_node_t* node;
-  size_t idx = 0;
 
+  printf("static const cutest_test_case_t cutest_test_case[] = {\n");
   for (node = list->first; NULL != node; node = node->next) {
-    print_test_case_executor(node->testcase, idx++, node->reset);
+    print_test_case_entry(node->testcase, node->reset);
   }
+  printf("  {NULL, NULL, 0}\n"
+         "};\n\n");
 }
 
 static void print_test_names_printer(testcase_list_t* list)
@@ -227,13 +260,185 @@ static void print_test_names_printer(testcase_list_t* list)
          "  }\n");
 }
 
+static int get_unity_name(char* buf, const char* test_source_file_name)
+{
+  /*
+   * The main() of a test suite in a unity runner is named after the test
+   * suite, so the name must be usable in a C identifier.
+   */
+  const char* name = strrchr(test_source_file_name, '/');
+  size_t len = 0;
+  size_t i;
+
+  name = (NULL == name) ? test_source_file_name : name + 1;
+  len = strlen(name);
+  if ((len > 2) && (0 == strcmp(&name[len - 2], ".c"))) {
+    len -= 2;
+  }
+  for (i = 0; i < len; i++) {
+    if (!isalnum((unsigned char)name[i]) && ('_' != name[i])) {
+      break;
+    }
+  }
+  if ((0 == len) || (i != len) || (len >= UNITY_NAME_SIZE)) {
+    fprintf(stderr, "ERROR: '%s' can not be named in a unity runner\n",
+            test_source_file_name);
+    return -1;
+  }
+  sprintf(buf, "%.*s", (int)len, name);
+  return 0;
+}
+
+static void print_unity_main()
+{
+  printf("static int cutest_unity_run(const cutest_unity_suite_t* suite,\n"
+         "                            int argc, char* argv[], size_t dir_len)\n"
+         "{\n"
+         "  /*\n"
+         "   * The test suite is run as if by its own runner next to the unity\n"
+         "   * runner, and writes its reports there unless told otherwise\n"
+         "   */\n"
+         "  char** args = malloc(sizeof(char*) * (argc + 3));\n"
+         "  char* path = malloc(dir_len + strlen(suite->name) + 2);\n"
+         "  char* dir = malloc(dir_len + 2);\n"
+         "  int retval = EXIT_FAILURE;\n"
+         "  int i;\n"
+         "\n"
+         "  if ((NULL == args) || (NULL == path) || (NULL == dir)) {\n"
+         "    fprintf(stderr, \"ERROR: Out of memory running %%s\\n\", suite->name);\n"
+         "  }\n"
+         "  else {\n"
+         "    sprintf(path, \"%%.*s%%s\", (int)dir_len, argv[0], suite->name);\n"
+         "    sprintf(dir, \"%%.*s\", (0 == dir_len) ? 1 : (int)dir_len,\n"
+         "            (0 == dir_len) ? \".\" : argv[0]);\n"
+         "    args[0] = path;\n"
+         "    args[1] = \"--output-dir\";\n"
+         "    args[2] = dir;\n"
+         "    for (i = 1; i < argc; i++) {\n"
+         "      args[i + 2] = argv[i];\n"
+         "    }\n"
+         "    args[argc + 2] = NULL;\n"
+         "    retval = suite->main(argc + 2, args);\n"
+         "  }\n"
+         "  free(dir);\n"
+         "  free(path);\n"
+         "  free(args);\n"
+         "  return retval;\n"
+         "}\n"
+         "\n"
+         "int main(int argc, char* argv[])\n"
+         "{\n"
+         "  const char* name = strrchr(argv[0], '/');\n"
+         "  const size_t dir_len = (NULL == name) ? 0 : (size_t)(name - argv[0]) + 1;\n"
+         "  static int chosen[sizeof(cutest_unity_suite) / sizeof(cutest_unity_suite[0])];\n"
+         "  char** args = NULL;\n"
+         "  int cnt = 0;\n"
+         "  int any_chosen = 0;\n"
+         "  int retval = EXIT_SUCCESS;\n"
+         "  size_t i;\n"
+         "  int j;\n"
+         "\n"
+         "  for (i = 0; NULL != cutest_unity_suite[i].name; i++) {\n"
+         "    if (0 == strcmp(&argv[0][dir_len], cutest_unity_suite[i].name)) {\n"
+         "      return cutest_unity_run(&cutest_unity_suite[i], argc, argv, dir_len);\n"
+         "    }\n"
+         "  }\n"
+         "\n"
+         "  if (NULL == (args = malloc(sizeof(char*) * (argc + 1)))) {\n"
+         "    fprintf(stderr, \"ERROR: Out of memory\\n\");\n"
+         "    return EXIT_FAILURE;\n"
+         "  }\n"
+         "  args[cnt++] = argv[0];\n"
+         "  for (j = 1; j < argc; j++) {\n"
+         "    if ((0 != strcmp(argv[j], \"--suite\")) || (j + 1 == argc)) {\n"
+         "      args[cnt++] = argv[j];\n"
+         "      continue;\n"
+         "    }\n"
+         "    j++;\n"
+         "    for (i = 0; NULL != cutest_unity_suite[i].name; i++) {\n"
+         "      if (0 == strcmp(argv[j], cutest_unity_suite[i].name)) {\n"
+         "        break;\n"
+         "      }\n"
+         "    }\n"
+         "    if (NULL == cutest_unity_suite[i].name) {\n"
+         "      fprintf(stderr, \"ERROR: There is no test suite '%%s'\\n\", argv[j]);\n"
+         "      free(args);\n"
+         "      return EXIT_FAILURE;\n"
+         "    }\n"
+         "    chosen[i] = 1;\n"
+         "    any_chosen = 1;\n"
+         "  }\n"
+         "  args[cnt] = NULL;\n"
+         "\n"
+         "  for (i = 0; NULL != cutest_unity_suite[i].name; i++) {\n"
+         "    if (((0 == any_chosen) || (1 == chosen[i])) &&\n"
+         "        (EXIT_SUCCESS != cutest_unity_run(&cutest_unity_suite[i],\n"
+         "                                          cnt, args, dir_len))) {\n"
+         "      retval = EXIT_FAILURE;\n"
+         "    }\n"
+         "  }\n"
+         "  free(args);\n"
+         "  return retval;\n"
+         "}\n");
+}
+
+static int print_unity_runner(const char* program_name, int suite_cnt,
+                              char* test_source_file_name[])
+{
+  /*
+   * A unity runner only knows its test suites by the renamed main() of
+   * each, which is called with the arguments the runner was called with.
+   */
+  char name[UNITY_NAME_SIZE];
+  int i;
+
+  for (i = 0; i < suite_cnt; i++) {
+    if (0 != get_unity_name(name, test_source_file_name[i])) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("/*\n"
+         " * This file is generated by '%s --unity'.\n"
+         " *\n"
+         " * Compile this program, with the objects of the test suites, to get\n"
+         " * one runner of all the test suites.\n"
+         " *\n"
+         " */\n"
+         "\n"
+         "#include <stdlib.h>\n"
+         "#include <stdio.h>\n"
+         "#include <string.h>\n"
+         "\n"
+         "typedef struct cutest_unity_suite_s {\n"
+         "  const char* name;\n"
+         "  int (*main)(int argc, char* argv[]);\n"
+         "} cutest_unity_suite_t;\n"
+         "\n",
+         program_name);
+  for (i = 0; i < suite_cnt; i++) {
+    get_unity_name(name, test_source_file_name[i]);
+    printf("int cutest_unity_%s(int argc, char* argv[]);\n", name);
+  }
+  printf("\nstatic const cutest_unity_suite_t cutest_unity_suite[] = {\n");
+  for (i = 0; i < suite_cnt; i++) {
+    get_unity_name(name, test_source_file_name[i]);
+    printf("  {\"%s\", cutest_unity_%s},\n", name, name);
+  }
+  printf("  {NULL, NULL}\n"
+         "};\n\n");
+  print_unity_main();
+
+  return EXIT_SUCCESS;
+}
+
 /*
  * The test runner program
  * -----------------------
  *
  * The generated test runner program will inventory all the tests in
  * the specified suite and run them in the order that they appear in
- * the suite.
+ * the suite, or in a random order when given ``--shuffle``.
  *
  * The first thing that happens is the start-up process, then all
  * tests are run in isolation, followed by the Shutdown process.
@@ -251,6 +456,11 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
+  if (('-' == test_source_file_name[0]) &&
+      (0 == strcmp(test_source_file_name, "--unity"))) {
+    return print_unity_runner(program_name, argc - 2, &argv[2]);
+  }
+
   if (!file_exists(test_source_file_name) ||
       !file_exists(mock_header_file_name)) {
     return EXIT_FAILURE;
@@ -264,9 +474,10 @@ int main(int argc, char* argv[]) {
   test_cnt = parse_test_cases(list, test_source_file_name);
 
   print_header(program_name, test_source_file_name, mock_header_file_name);
+  print_test_case_table(list);
   print_main_function_prologue(test_source_file_name, test_cnt);
   print_test_names_printer(list);
-  print_test_case_executions(list);
+  print_test_case_executor(test_cnt);
   print_main_function_epilogue(test_source_file_name, test_cnt);
 
   delete_testcase_list(list);
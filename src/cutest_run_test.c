@@ -146,7 +146,16 @@ test(print_main_function_prologue_shall_print_something)
  */
 test(print_test_case_executor_shall_print_something)
 {
-  print_test_case_executor("foo", 1, 1);
+  print_test_case_executor(1);
+  assert_eq(1, m.printf.call_count);
+}
+
+/*****************************************************************************
+ * print_test_case_entry()
+ */
+test(print_test_case_entry_shall_print_something)
+{
+  print_test_case_entry("foo", 1);
   assert_eq(1, m.printf.call_count);
 }
 
@@ -293,9 +302,9 @@ test(parse_test_cases_shall_read_next_test_not_store_a_node_it_if_no_test)
 }
 
 /*****************************************************************************
- * print_test_case_executions()
+ * print_test_case_table()
  */
-test(print_test_executions_shall_traverse_the_list_of_testcases_and_print)
+test(print_test_case_table_shall_traverse_the_list_of_testcases_and_print)
 {
   testcase_list_t list;
   testcase_node_t node[3];
@@ -303,8 +312,8 @@ test(print_test_executions_shall_traverse_the_list_of_testcases_and_print)
   node[0].next = &node[1];
   node[1].next = &node[2];
   node[2].next = NULL;
-  print_test_case_executions(&list);
-  assert_eq(3, m.print_test_case_executor.call_count);
+  print_test_case_table(&list);
+  assert_eq(3, m.print_test_case_entry.call_count);
 }
 
 /*****************************************************************************
@@ -326,6 +335,42 @@ test(print_test_names_printer_shall_traverse_the_list_of_testcases_and_print)
 #endif
 }
 
+/*****************************************************************************
+ * get_unity_name()
+ */
+module_test(get_unity_name_shall_strip_the_path_and_the_suffix)
+{
+  char buf[UNITY_NAME_SIZE];
+  assert_eq(0, get_unity_name(buf, "some/path/foo_test.c"));
+  assert_eq("foo_test", buf);
+}
+
+module_test(get_unity_name_shall_reject_a_name_not_usable_in_an_identifier)
+{
+  char buf[UNITY_NAME_SIZE];
+  assert_eq(-1, get_unity_name(buf, "some/path/foo-bar_test.c"));
+}
+
+/*****************************************************************************
+ * print_unity_runner()
+ */
+test(print_unity_runner_shall_return_EXIT_FAILURE_if_a_name_is_rejected)
+{
+  char* names[] = {"a_test.c", "b_test.c"};
+  m.get_unity_name.retval = -1;
+  assert_eq(EXIT_FAILURE, print_unity_runner("program_name", 2, names));
+  assert_eq(1, m.get_unity_name.call_count);
+  assert_eq(0, m.print_unity_main.call_count);
+}
+
+test(print_unity_runner_shall_name_each_suite_and_print_the_main_function)
+{
+  char* names[] = {"a_test.c", "b_test.c"};
+  assert_eq(EXIT_SUCCESS, print_unity_runner("program_name", 2, names));
+  assert_eq(6, m.get_unity_name.call_count);
+  assert_eq(1, m.print_unity_main.call_count);
+}
+
 /*****************************************************************************
  * main()
  */
@@ -357,6 +402,18 @@ test(main_shall_return_EXIT_FAILURE_if_argument_count_is_not_3)
 }
 
 
+test(main_shall_print_a_unity_runner_if_given_unity)
+{
+  char* argv[] = {"program_name", "--unity", "a_test.c", "b_test.c"};
+  m.strcmp.func = strcmp;
+  m.print_unity_runner.retval = EXIT_SUCCESS;
+  assert_eq(EXIT_SUCCESS, main(4, argv));
+  assert_eq(1, m.print_unity_runner.call_count);
+  assert_eq(2, m.print_unity_runner.args.arg1);
+  assert_eq(&argv[2], m.print_unity_runner.args.arg2);
+  assert_eq(0, m.file_exists.call_count);
+}
+
 test(main_shall_check_if_test_source_file_name_exists)
 {
   char* argv[] = {"program_name", "test_file", "mock_file"};
@@ -460,14 +517,25 @@ test(main_shall_print_main_function_prologue)
   assert_eq(5678, m.print_main_function_prologue.args.arg1);
 }
 
-test(main_shall_print_test_case_executions)
+test(main_shall_print_the_test_case_table)
 {
   char* argv[] = {"program_name", "test_file", "mock_file"};
   m.file_exists.retval = 1;
   m.new_testcase_list.retval = 0x1234;
   main(3, argv);
-  assert_eq(1, m.print_test_case_executions.call_count);
-  assert_eq(0x1234, m.print_test_case_executions.args.arg0);
+  assert_eq(1, m.print_test_case_table.call_count);
+  assert_eq(0x1234, m.print_test_case_table.args.arg0);
+}
+
+test(main_shall_print_the_test_case_executor)
+{
+  char* argv[] = {"program_name", "test_file", "mock_file"};
+  m.file_exists.retval = 1;
+  m.new_testcase_list.retval = 0x1234;
+  m.parse_test_cases.retval = 5678;
+  main(3, argv);
+  assert_eq(1, m.print_test_case_executor.call_count);
+  assert_eq(5678, m.print_test_case_executor.args.arg0);
 }
 
 test(main_shall_print_main_function_epilogue)
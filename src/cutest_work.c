@@ -23,22 +23,301 @@
  * as many test suites in parallel as possible to provide as fast
  * feedback as possible.
  *
+ * Usage
+ * -----
+ *
+ * The ``check`` and ``valgrind`` targets in ``cutest.mk`` will run the
+ * tool for you, but you can pass extra options to it through the
+ * ``CUTEST_WORK_FLAGS`` variable::
+ *
+ *  $ make check CUTEST_WORK_FLAGS="-j 4 -m 512 -a"
+ *
+ * By default one test suite per core is run in parallel. The ``-j``
+ * option sets the number of workers explicitly. The ``-m`` option makes
+ * sure that every worker can get at least the given amount of MB of the
+ * memory that is available when the tool starts. The ``-a`` option
+ * makes the tool start fewer test suites when others are loading the
+ * host (load average and pressure stall information) and more again
+ * when the load drops.
+ *
+ * When ``make check`` is run in a terminal the tool shows what every
+ * worker is running, down to the test, with the number of tests run and
+ * failed so far and an ETA. The ETA is based on the ``--history`` when
+ * all test suites are in it, otherwise on the number of tests left. When
+ * the output is not a terminal, e.g. in CI, a line with the verdict of
+ * every test suite runner is printed as it finishes instead of the dots
+ * of all runners mixed up.
+ *
+ * Big test suites are split in batches of tests, which are run by
+ * separate runners of the test suite in parallel. This way one giant
+ * test suite does not keep one worker busy long after the others are
+ * done. The tests are listed using the ``-p`` option of the test suite
+ * and the batch size is picked to get a few batches per worker. The
+ * ``-t`` option sets the maximum number of tests per batch explicitly.
+ *
+ * When ``make check`` is spread over several CI hosts, give every host
+ * its own shard with ``--shard-index`` and the same ``--shard-count``,
+ * or set ``CUTEST_SHARD_INDEX`` and ``CUTEST_SHARD_COUNT``. All hosts
+ * compute the same partition of the tests. With ``--history`` the
+ * partition is balanced on the test suite durations in the given file,
+ * otherwise the test suites are spread by a hash of their names::
+ *
+ *  $ make check CUTEST_WORK_FLAGS="--shard-index 2 --shard-count 4 --history ci.history"
+ *
+ * The durations of the run are written to the history file, or with a
+ * ``.<shard-index>`` suffix when sharding, since all shards must read
+ * the same history. Concatenate the files of all shards for the next
+ * run. The log and JUnit files of test suites that are split between
+ * the shards get ``shard<index>`` in their names.
+ *
+ * The ``watch`` target in ``cutest.mk`` keeps the tool running with
+ * ``--watch``, and reruns a test suite as soon as its source, header or
+ * test is saved in ``CUTEST_SRC_DIR`` or ``CUTEST_TEST_DIR``. Only the
+ * runner of the changed test suite is rebuilt, by the ``--rebuild``
+ * command, so the verdicts are back about as fast as it compiles::
+ *
+ *  $ make watch
+ *
+ * With ``--fail-fast`` the tool stops queueing test suites as soon as
+ * one of them fails, prints the log of the failing suite right away and
+ * asks the test suites that are still running to stop after their
+ * current test. This is handy when iterating on a fix::
+ *
+ *  $ make check CUTEST_WORK_FLAGS="--fail-fast"
+ *
+ * A test that fails now and then should not fail the whole run, but it
+ * should not go unnoticed either. With ``--retries`` every runner runs a
+ * failing test again, alone in a fresh process, up to the given number
+ * of times. A test that passes on a retry is reported as flaky instead
+ * of failed, with a ``flakyFailure`` or ``flakyError`` of the first run
+ * in its JUnit report. The flaky tests are counted in the totals and in
+ * the merged report. After a run with ``--junit``, ``--rerun-failed``
+ * reads the merged report and only runs the tests that failed in it::
+ *
+ *  $ make check CUTEST_WORK_FLAGS="--retries 2 --junit all.junit_report.xml"
+ *  $ make check CUTEST_WORK_FLAGS="--rerun-failed --junit all.junit_report.xml"
+ *
+ * The merged report of a rerun only has the tests that were run again,
+ * so the next ``--rerun-failed`` only runs those that still fail. The
+ * history is not written by a rerun.
+ *
+ * With ``--unity`` and the unity runner that all the test suites are
+ * linked into, the whole test suites are run a few at a time in it, by
+ * ``--suite`` options, so only a few processes are started for them.
+ * Every suite still writes its own log and JUnit report, and the tool
+ * reports the verdicts of every suite, sharing the time of the process
+ * by the number of tests. This is what ``make unitycheck`` does::
+ *
+ *  $ make unitycheck CUTEST_WORK_FLAGS="-j 4"
+ *
+ * Every test suite runner writes its own JUnit report. With ``--junit``
+ * the tool also merges them into one report as the test suites finish,
+ * with the time every runner took and the worker that ran it. A line
+ * with the totals of all test suites is printed at the end::
+ *
+ *  $ make check CUTEST_WORK_FLAGS="--junit all.junit_report.xml"
+ *
+ * To see where the time goes, ``--trace`` writes a Chrome trace_event
+ * file that can be opened in Perfetto or ``chrome://tracing``. Every
+ * worker gets a track with a span per test suite runner, and a span per
+ * test inside it. The counters show how many runners were running and
+ * queued over time, so idle workers are easy to spot. The track of the
+ * worker that finished last, the critical path, is marked as such::
+ *
+ *  $ make check CUTEST_WORK_FLAGS="--trace check.json"
+ *
+ * A runaway test should not push the whole host into swap. The
+ * ``--limit-memory``, ``--limit-cpu`` and ``--limit-files`` options set
+ * resource limits (address space in MB, CPU seconds and open files) on
+ * every test suite runner. Address space limits do not mix well with
+ * Valgrind or sanitizers, so give ``--cgroup`` a cgroup v2 directory
+ * that is delegated to you to limit the actual memory use instead. Each
+ * worker then gets a child cgroup with the memory limit, no swap, and at
+ * most one core::
+ *
+ *  $ systemd-run --user --scope -p Delegate=yes make check \
+ *      CUTEST_WORK_FLAGS="--limit-memory 512 --cgroup /sys/fs/cgroup/..."
+ *
+ * A test suite runner that is killed for exceeding a limit is reported
+ * with the limit it exceeded, also in the merged JUnit report.
+ *
+ * The test suites can be spread over several build boxes too. Start the
+ * tool as an agent on every box with ``--agent`` and the address of the
+ * coordinator, which is ``make check`` with ``--listen`` and the number
+ * of agents to wait for. An address is ``host:port`` for TCP, or
+ * ``unix:<path>`` for a Unix socket, to try it all on one machine::
+ *
+ *  $ cutest_work --agent unix:/tmp/cutest.sock -j 2 &
+ *  $ cutest_work --agent unix:/tmp/cutest.sock -j 2 &
+ *  $ make check CUTEST_WORK_FLAGS="--listen unix:/tmp/cutest.sock --agents 2"
+ *
+ * An agent connects once per worker it has, and every connection is a
+ * worker slot of its own after the local ones. Runners are sent by the
+ * hash of their content and kept in the ``--cache`` directory of the
+ * agent, so they are only sent again when they are rebuilt. The agent
+ * runs them in a scratch directory and sends back their output, log and
+ * JUnit report, which then end up where a local runner would have put
+ * them. Hence the merged JUnit report, the trace and the history work
+ * the same. The runners must not need any other files on the agent, and
+ * the agent sets its own resource limits. Remote runners are not stopped
+ * by ``--fail-fast``, they are just not given more work. There is no
+ * authentication, so only listen on trusted networks.
+ *
+ * Valgrind is slow, so ``make valgrind`` splits the test suites in
+ * batches of as few tests as the workers allow, and runs every batch in
+ * a Valgrind process of its own. Valgrind writes the errors of a batch
+ * to a ``.valgrind.xml`` file next to its JUnit report, and the errors
+ * are added to the tests whose ``cutest_<test>`` function is in their
+ * stack, as JUnit errors. Leaks found at exit are reported on a test
+ * case named after the test suite. With ``--changed-only`` the tool
+ * writes the hashes of the runners that passed to the given file, and
+ * only runs the runners that have changed since the next time::
+ *
+ *  $ make valgrind CUTEST_WORK_FLAGS="--changed-only valgrind.clean"
+ *
+ * When ``CUTEST_RESULTS`` names a directory, ``make check`` gives it to
+ * ``--results`` to keep the test suites that passed. Every result is a
+ * file named by a hash of the runner, the options that change how it
+ * runs, the files given to ``--cache-inputs`` and a few environment
+ * variables, such as ``LD_PRELOAD`` and ``TZ``. A runner with a result is
+ * not run, but reported as ``[CACHED]``, and its duration is kept in the
+ * history. The results used the longest time ago are removed when there
+ * are more than ``--results-max``, and ``--no-cache`` runs everything.
+ * Tests that depend on anything else, such as the time or the network,
+ * should be run with ``--no-cache``::
+ *
+ *  $ make check CUTEST_RESULTS=cutest_results CUTEST_WORK_FLAGS="--no-cache"
+ *
  */
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
+#include <time.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <utime.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include "cutest_work.h"
 #include "helpers.h"
+#include "net.h"
+
+#define MAX_SUITE_ARGS 20
+
+/*
+ * A test suite runner can take at most 1024 test names as arguments, and
+ * starting a runner for just a few tests is not worth the while.
+ */
+#define MIN_TESTS_PER_BATCH 8
+#define MIN_VALGRIND_TESTS_PER_BATCH 1
+#define MAX_TESTS_PER_BATCH 1024
+#define BATCHES_PER_WORKER 4
+#define BATCH_NAME_LEN 32
+#define CGROUP_PATH_LEN 4096
+#define LIMIT_NAME_LEN 64
+
+/*
+ * Agents get one line per message and per runner argument. The runner
+ * itself is sent as a placeholder, since the agent runs it from its cache
+ * as ../<hash> inside a scratch directory.
+ */
+#define MESSAGE_LEN 4096
+#define RUNNER_ARG "@"
+#define RUNNER_PATH_LEN (3 + NET_HASH_LEN)
+#define DEFAULT_CACHE "cutest_cache"
+#define DEFAULT_RESULTS_MAX 1000
+#define RESULT_PATH_LEN 4096
+#define OUTPUT_NAME ".output"
+
+/*
+ * Valgrind writes its errors as XML next to the JUnit report, and makes
+ * the runner fail if it found any.
+ */
+#define MEMCHECK_SUFFIX ".valgrind.xml"
+#define MEMCHECK_EXIT_CODE "--error-exitcode=3"
+
+/*
+ * The status display is redrawn this often while the runners run, and
+ * its lines are cut to fit in a plain terminal.
+ */
+#define PROGRESS_INTERVAL_MS 200
+#define PROGRESS_WIDTH 79
+
+/*
+ * An editor saving a file, or a checkout, makes several events, so they
+ * are collected until it has been quiet for a while.
+ */
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+#define WATCH_QUIET_MS 100
+#define WATCH_PATH_LEN 4096
+
+/* Percentages of stalled time (avg10) where adaptive mode backs off */
+#define CPU_PRESSURE_THRESHOLD 50.0
+#define MEMORY_PRESSURE_THRESHOLD 10.0
+
+#define min(a,b) ((a < b) ? a : b)
 
 static void usage(const char* program_name)
 {
-  printf("USAGE: %s <-V|-v|-n> suite1 suite2 .. suiteN\n\n"
+  printf("USAGE: %s [-j N] [-m MB] [-t N] [-a] [--fail-fast] [--retries N]\n"
+         "       [--rerun-failed]\n"
+         "       [--shard-index I --shard-count N] [--history FILE]\n"
+         "       [--junit FILE] [--trace FILE] [--limit-memory MB]\n"
+         "       [--limit-cpu S] [--limit-files N] [--cgroup DIR]\n"
+         "       [--listen ADDR [--agents N]] [--changed-only FILE]\n"
+         "       [--watch DIR [--watch-tests DIR] [--rebuild CMD]]\n"
+         "       [--results DIR [--results-max N] [--cache-inputs FILES]]\n"
+         "       [--no-cache] [--unity RUNNER]\n"
+         "       <-V|-v|-n> suite1 suite2 .. suiteN\n"
+         "       %s --agent ADDR [-j N] [-m MB] [--cache DIR] [--limit-...]\n\n"
          "  -v  Be verbose naming all test names and pass/fail\n"
-         "  -n  No line-feed after non-verbos to get '.' from all suites on one line\n"
-         "  -V  Invoke the test suites through valgrind\n\n", program_name);
+         "  -n  Show the progress live on a terminal, else a line per runner\n"
+         "  -V  Invoke the test suites through valgrind\n"
+         "  -j  Run at most N test suites in parallel (default is one per core)\n"
+         "  -m  Only run as many workers as there are MB of available memory for\n"
+         "  -t  Run at most N tests per test suite runner (default is automatic)\n"
+         "  -a  Adapt the number of workers to the load and pressure of the host\n"
+         "  --fail-fast  Stop all test suites when the first test fails\n"
+         "  --retries N  Rerun a failing test up to N times, flaky if it passes\n"
+         "  --rerun-failed  Only run the tests that failed in the --junit FILE\n"
+         "  --shard-index I  Only run shard I (1..N), or set CUTEST_SHARD_INDEX\n"
+         "  --shard-count N  Split the tests in N shards, or set CUTEST_SHARD_COUNT\n"
+         "  --history FILE   Balance on, and record, test suite durations in FILE\n"
+         "  --junit FILE     Merge the JUnit reports of all test suites in FILE\n"
+         "  --trace FILE     Write a Chrome trace_event timeline of the run\n"
+         "  --limit-memory MB  Limit the memory of every test suite runner\n"
+         "  --limit-cpu S      Limit the CPU seconds of every test suite runner\n"
+         "  --limit-files N    Limit the open files of every test suite runner\n"
+         "  --cgroup DIR       Limit the memory and cores in child cgroups of DIR\n"
+         "  --listen ADDR  Also run test suites on agents connecting to ADDR\n"
+         "  --agents N     Wait for N agents before starting (default is 1)\n"
+         "  --agent ADDR   Run test suites for the coordinator at ADDR\n"
+         "  --cache DIR    Keep test suite runners in DIR (default is cutest_cache)\n"
+         "  --changed-only FILE  Only run the suites whose runner changed since\n"
+         "                       it last passed, as recorded in FILE\n"
+         "  --watch DIR    Keep running, and rerun the suites whose sources in DIR\n"
+         "                 change\n"
+         "  --watch-tests DIR  Also rerun the suites whose tests in DIR change\n"
+         "                     (default is the --watch DIR)\n"
+         "  --rebuild CMD  Run 'CMD suite' to rebuild a changed suite first\n"
+         "  --results DIR  Do not run the suites that passed before with the same\n"
+         "                 runner, inputs and environment, as cached in DIR\n"
+         "  --results-max N       Keep at most N results (default is 1000)\n"
+         "  --cache-inputs FILES  Colon separated files that the runners read\n"
+         "  --no-cache     Run all suites, even if --results is given\n"
+         "  --unity RUNNER  Run the whole suites a few at a time in RUNNER, the\n"
+         "                  unity runner that has them all linked into it\n\n"
+         "  ADDR is host:port for TCP, or unix:path for a Unix socket\n\n",
+         program_name, program_name);
 }
 
 static int get_number_of_cores()
@@ -50,12 +329,12 @@ static int get_number_of_cores()
 #endif
 }
 
-static int all_input_files_exist(int argc, char* argv[])
+static int all_input_files_exist(int first_suite, int argc, char* argv[])
 {
   int idx;
   int retval = 1;
 
-  for (idx = 2; idx < argc; idx++) {
+  for (idx = first_suite; idx < argc; idx++) {
     if (!file_exists(argv[idx])) {
       fprintf(stderr, "ERROR: '%s' does not exist\n", argv[idx]);
       retval = 0;
@@ -64,233 +343,3701 @@ static int all_input_files_exist(int argc, char* argv[])
   return retval;
 }
 
-static int run_test_suite(const char* executable_file_name, int verbose, int stderr_log)
+static long parse_number(const char* str)
 {
-  int valgrindlen = 0;
-  int retval = 0;
-  int optlen = 0;
-  char* command = NULL;
+  char* end = NULL;
+  long value = 0;
 
-  if (NULL == executable_file_name) {
-    fprintf(stderr, "ERROR: Internal error, suite executable is NULL pointer\n");
+  if (NULL == str) {
     return -1;
   }
-  if (0 == verbose) {
-    optlen = strlen(" -j -s");
-  }
-  else if (2 == verbose) {
-    optlen = strlen(" -v -j -s");
-    valgrindlen = strlen("valgrind --track-origins=yes -q ");
-  }
-  else {
-    optlen = strlen(" -? -j -s");
-  }
-  if (1 == stderr_log) {
-    optlen += strlen(" -l");
-  }
-  command = malloc(valgrindlen + strlen(executable_file_name) + optlen + 1);
-  if (NULL == command) {
-    fprintf(stderr, "ERROR: Out of memory while allocating suite command.\n");
+  value = strtol(str, &end, 10);
+  if ((end == str) || ('\0' != *end) || (value < 1)) {
     return -1;
   }
-  command[0] = 0;
-  if (2 == verbose) {
-    strcat(command, "valgrind --track-origins=yes -q ");
-  }
-  strcat(command, executable_file_name);
-  if (1 == verbose) {
-    strcat(command, " -v");
-  }
-  else if (2 == verbose) {
-    strcat(command, " -v");
-  }
-  else if (-1 == verbose) {
-    strcat(command, " -n");
-  }
-  strcat(command, " -j -s");
-  if (1 == stderr_log) {
-    strcat(command, " -l");
-  }
-
-  retval = system(command);
-
-  free(command);
-  return retval;
+  return value;
 }
 
-static int run_test_suites(int core_idx, int cores, int argc, char* argv[],
-                           int verbose, int stderr_log) {
-  int suite_idx = core_idx + 1;
-  int retval = 0;
+static void handle_env(cutest_work_opts_t* opts)
+{
+  /*
+   * CI systems usually tell each container which shard it is through
+   * the environment, command line options take precedence.
+   */
+  const char* index = getenv("CUTEST_SHARD_INDEX");
+  const char* count = getenv("CUTEST_SHARD_COUNT");
 
-  while (suite_idx < argc - 1) {
-    const int r = run_test_suite(argv[suite_idx + 1], verbose, stderr_log);
-    if (-1 == r) {
-      return -1;
-    }
-    retval |= r;
-    suite_idx += cores;
+  if ((NULL != index) && (0 > (opts->shard_index = parse_number(index)))) {
+    fprintf(stderr, "ERROR: CUTEST_SHARD_INDEX needs a positive number\n");
+    exit(EXIT_FAILURE);
+  }
+  if ((NULL != count) && (0 > (opts->shard_count = parse_number(count)))) {
+    fprintf(stderr, "ERROR: CUTEST_SHARD_COUNT needs a positive number\n");
+    exit(EXIT_FAILURE);
   }
-
-  return retval;
 }
 
-#define min(a,b) ((a < b) ? a : b)
-
-static int handle_args(int argc, char* argv[]) {
-  int verbose = 0;
+static void handle_args(cutest_work_opts_t* opts, int argc, char* argv[])
+{
   const char* program_name = argv[0];
+  int no_cache = 0;
+  int i;
+
+  memset(opts, 0, sizeof(*opts));
+  handle_env(opts);
+  opts->results_max = DEFAULT_RESULTS_MAX;
 
   if (argc < 3) {
     usage(program_name);
     exit(EXIT_FAILURE);
   }
 
-  if (0 == strcmp("-v", argv[1])) {
-    verbose = 1;
+  for (i = 1; i < argc; i++) {
+    const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if ('-' != argv[i][0]) {
+      break;
+    }
+    if (0 == strcmp("-v", argv[i])) {
+      opts->verbose = 1;
+    }
+    else if (0 == strcmp("-n", argv[i])) {
+      opts->verbose = -1;
+    }
+    else if (0 == strcmp("-V", argv[i])) {
+      opts->verbose = 2;
+    }
+    else if (0 == strcmp("-a", argv[i])) {
+      opts->adaptive = 1;
+    }
+    else if (0 == strcmp("--fail-fast", argv[i])) {
+      opts->fail_fast = 1;
+    }
+    else if (0 == strcmp("--rerun-failed", argv[i])) {
+      opts->rerun_failed = 1;
+    }
+    else if (0 == strcmp("--retries", argv[i])) {
+      if (0 > parse_number(value)) {
+        fprintf(stderr, "ERROR: --retries needs a positive number of retries\n");
+        exit(EXIT_FAILURE);
+      }
+      opts->retries = value;
+      i++;
+    }
+    else if (0 == strcmp("-j", argv[i])) {
+      if (0 > (opts->jobs = parse_number(value))) {
+        fprintf(stderr, "ERROR: -j needs a positive number of workers\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("-t", argv[i])) {
+      if (0 > (opts->tests_per_batch = parse_number(value))) {
+        fprintf(stderr, "ERROR: -t needs a positive number of tests\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("-m", argv[i])) {
+      if (0 > (opts->mem_per_worker = parse_number(value))) {
+        fprintf(stderr, "ERROR: -m needs a positive number of MB\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--shard-index", argv[i])) {
+      if (0 > (opts->shard_index = parse_number(value))) {
+        fprintf(stderr, "ERROR: --shard-index needs a positive number\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--shard-count", argv[i])) {
+      if (0 > (opts->shard_count = parse_number(value))) {
+        fprintf(stderr, "ERROR: --shard-count needs a positive number\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--history", argv[i])) {
+      if (NULL == (opts->history = value)) {
+        fprintf(stderr, "ERROR: --history needs a file name\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--junit", argv[i])) {
+      if (NULL == (opts->junit = value)) {
+        fprintf(stderr, "ERROR: --junit needs a file name\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--trace", argv[i])) {
+      if (NULL == (opts->trace = value)) {
+        fprintf(stderr, "ERROR: --trace needs a file name\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--limit-memory", argv[i])) {
+      if (0 > (opts->limit_memory = parse_number(value))) {
+        fprintf(stderr, "ERROR: --limit-memory needs a positive number of MB\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--limit-cpu", argv[i])) {
+      if (0 > (opts->limit_cpu = parse_number(value))) {
+        fprintf(stderr, "ERROR: --limit-cpu needs a positive number of seconds\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--limit-files", argv[i])) {
+      if (0 > (opts->limit_files = parse_number(value))) {
+        fprintf(stderr, "ERROR: --limit-files needs a positive number of files\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--cgroup", argv[i])) {
+      if (NULL == (opts->cgroup = value)) {
+        fprintf(stderr, "ERROR: --cgroup needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--listen", argv[i])) {
+      if (NULL == (opts->listen_address = value)) {
+        fprintf(stderr, "ERROR: --listen needs an address\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--agents", argv[i])) {
+      if (0 > (opts->agents = parse_number(value))) {
+        fprintf(stderr, "ERROR: --agents needs a positive number of agents\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--agent", argv[i])) {
+      if (NULL == (opts->coordinator = value)) {
+        fprintf(stderr, "ERROR: --agent needs the address of the coordinator\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--changed-only", argv[i])) {
+      if (NULL == (opts->changed_only = value)) {
+        fprintf(stderr, "ERROR: --changed-only needs a file name\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--watch", argv[i])) {
+      if (NULL == (opts->watch = value)) {
+        fprintf(stderr, "ERROR: --watch needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--watch-tests", argv[i])) {
+      if (NULL == (opts->watch_tests = value)) {
+        fprintf(stderr, "ERROR: --watch-tests needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--rebuild", argv[i])) {
+      if (NULL == (opts->rebuild = value)) {
+        fprintf(stderr, "ERROR: --rebuild needs a command\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--results", argv[i])) {
+      if (NULL == (opts->results = value)) {
+        fprintf(stderr, "ERROR: --results needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--results-max", argv[i])) {
+      if (0 > (opts->results_max = parse_number(value))) {
+        fprintf(stderr, "ERROR: --results-max needs a positive number\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--cache-inputs", argv[i])) {
+      if (NULL == (opts->cache_inputs = value)) {
+        fprintf(stderr, "ERROR: --cache-inputs needs a list of files\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--unity", argv[i])) {
+      if (NULL == (opts->unity = value)) {
+        fprintf(stderr, "ERROR: --unity needs the unity runner\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (0 == strcmp("--no-cache", argv[i])) {
+      no_cache = 1;
+    }
+    else if (0 == strcmp("--cache", argv[i])) {
+      if (NULL == (opts->cache = value)) {
+        fprintf(stderr, "ERROR: --cache needs a directory\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else {
+      usage(program_name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  opts->first_suite = i;
+
+  /* The make file gives the results, but the user may not want them */
+  if (1 == no_cache) {
+    opts->results = NULL;
   }
-  else if (0 == strcmp("-n", argv[1])) {
-    verbose = -1;
+
+  /* An agent gets its test suites from the coordinator */
+  if (NULL != opts->coordinator) {
+    if (opts->first_suite < argc) {
+      usage(program_name);
+      exit(EXIT_FAILURE);
+    }
+    return;
   }
-  else if (0 == strcmp("-V", argv[1])) {
-    verbose = 2;
+  if ((NULL != opts->listen_address) && (0 == opts->agents)) {
+    opts->agents = 1;
   }
-  else {
+
+  if ((1 == opts->rerun_failed) && (NULL == opts->junit)) {
+    fprintf(stderr,
+            "ERROR: --rerun-failed needs the --junit report of the last run\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (((0 != opts->shard_index) || (0 != opts->shard_count)) &&
+      ((opts->shard_index < 1) || (opts->shard_index > opts->shard_count))) {
+    fprintf(stderr,
+            "ERROR: The shard index must be between 1 and the shard count\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if ((0 == opts->verbose) || (opts->first_suite >= argc)) {
     usage(program_name);
     exit(EXIT_FAILURE);
   }
 
-  if (0 == all_input_files_exist(argc, argv)) {
+  if (0 == all_input_files_exist(opts->first_suite, argc, argv)) {
     exit(EXIT_FAILURE);
   }
-  return verbose;
 }
 
-static void launch_child_processes(int allocated_cores, int argc,
-                                   char* argv[], int verbose)
+static long read_memory_available()
 {
-  int idx = 0;
-  pid_t pid[128];
+  /*
+   * Get the memory available for new processes in kB, without pushing
+   * the host into swap, or 0 if the kernel does not tell.
+   */
+  const char* key = "MemAvailable:";
+  char buf[256];
+  long kb = 0;
+  FILE* fd = fopen("/proc/meminfo", "r");
 
-  for (idx = 0; idx < allocated_cores; idx++) {
-    if (0 > (pid[idx] = fork())) {
-      fprintf(stderr, "ERROR: Failed to fork\n");
-      exit(EXIT_FAILURE);
+  if (NULL == fd) {
+    return 0;
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (0 == strncmp(buf, key, strlen(key))) {
+      kb = strtol(&buf[strlen(key)], NULL, 10);
+      break;
     }
-    else if (pid[idx] == 0) {
-      int r = run_test_suites(idx, allocated_cores, argc, argv, verbose, 1);
-      if (0 != r) {
-        r = EXIT_FAILURE;
-      }
-      else {
-        r = EXIT_SUCCESS;
-      }
-      exit(r);
+  }
+  fclose(fd);
+  return kb;
+}
+
+static double read_load_average()
+{
+  char buf[128];
+  double load = 0.0;
+  FILE* fd = fopen("/proc/loadavg", "r");
+
+  if (NULL == fd) {
+    return 0.0;
+  }
+  if (NULL != fgets(buf, sizeof(buf), fd)) {
+    load = strtod(buf, NULL);
+  }
+  fclose(fd);
+  return load;
+}
+
+static double read_pressure(const char* file_name)
+{
+  /*
+   * Get the share of time (in percent over the last 10 seconds) that
+   * some task was stalled on the resource, from the pressure stall
+   * information of the kernel. Older kernels does not have it, so
+   * there is no pressure to speak of then.
+   */
+  const char* key = "some avg10=";
+  char buf[256];
+  double pressure = 0.0;
+  FILE* fd = fopen(file_name, "r");
+
+  if (NULL == fd) {
+    return 0.0;
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (0 == strncmp(buf, key, strlen(key))) {
+      pressure = strtod(&buf[strlen(key)], NULL);
+      break;
     }
   }
+  fclose(fd);
+  return pressure;
 }
 
-static int slight_delay()
+static int get_number_of_workers(const cutest_work_opts_t* opts, int cores)
 {
-  int a = 0;
-  int i = 0;
+  int workers = (0 != opts->jobs) ? opts->jobs : cores;
 
-  for (i = 0; i < 10; i++) {
-    a += i * 2;
+  if (0 != opts->mem_per_worker) {
+    const long available = read_memory_available();
+    if (0 != available) {
+      const long affordable = available / (opts->mem_per_worker * 1024);
+      workers = min(workers, affordable);
+    }
   }
-  return a;
+  if (workers < 1) {
+    workers = 1;
+  }
+  return workers;
 }
 
-static int wait_for_child_processes(int allocated_cores, int verbose)
+static int get_worker_limit(const cutest_work_opts_t* opts,
+                            const cutest_work_pool_t* pool, int cores)
 {
-  int retval = 0;
+  /*
+   * In adaptive mode the load average tells how many cores others are
+   * busy with, our own running test suites are part of it so they are
+   * not counted as competition. When there are tasks stalling for the
+   * CPU or for memory no more test suites are started, and for memory
+   * the number of workers is halved to get out of trouble quickly.
+   */
+  int limit = pool->workers;
+  double others = 0.0;
 
-  while (allocated_cores > 0) {
-    int status = 0;
-    (void)waitpid(0, &status, 0);
-    --allocated_cores;
-    retval |= WEXITSTATUS(status);
+  if (0 == opts->adaptive) {
+    return limit;
   }
-  slight_delay();
-  if (-1 == verbose) {
-    puts("");
+
+  others = read_load_average() - pool->running;
+  if (others > 0.0) {
+    limit = min(limit, cores - (int)others);
+  }
+  if (read_pressure("/proc/pressure/cpu") >= CPU_PRESSURE_THRESHOLD) {
+    limit = min(limit, pool->running);
+  }
+  if (read_pressure("/proc/pressure/memory") >= MEMORY_PRESSURE_THRESHOLD) {
+    limit = min(limit, pool->running / 2);
+  }
+  if (limit < 1) {
+    limit = 1;
   }
+  return limit;
+}
 
-  return retval;
+static void delete_tests(cutest_work_suite_t* suite)
+{
+  int i;
+
+  for (i = 0; i < suite->test_cnt; i++) {
+    free(suite->test[i]);
+  }
+  free(suite->test);
+  suite->test = NULL;
+  suite->test_cnt = 0;
 }
 
-static void print_log(const char* suite_name)
+static int list_tests(cutest_work_suite_t* suite)
 {
-  const size_t log_name_len = strlen(suite_name) + strlen(".log") + 1;
-  char* log_name = malloc(log_name_len);
-  FILE *fd = NULL;
+  /*
+   * Ask the test suite for the names of its tests, one per line. A test
+   * suite that can not be listed completely is run as a whole instead.
+   */
+  const size_t command_len = strlen(suite->name) + strlen(" -p") + 1;
+  char* command = malloc(command_len);
   char buf[1024];
+  FILE* pd = NULL;
+  int size = 0;
+  int ok = 1;
 
-  if (NULL == log_name) {
-    fprintf(stderr, "ERROR: Out of memory while allocating log file name\n");
-    return;
+  if (NULL == command) {
+    fprintf(stderr, "ERROR: Out of memory while listing tests\n");
+    return -1;
   }
-  memset(log_name, 0, log_name_len);
-  strcpy(log_name, suite_name);
-  strcat(log_name, ".log");
+  sprintf(command, "%s -p", suite->name);
 
-  fd = fopen(log_name, "r");
-  if (NULL == fd) {
-    free(log_name);
-    return;
+  pd = popen(command, "r");
+  free(command);
+  if (NULL == pd) {
+    fprintf(stderr, "ERROR: Unable to list the tests in '%s'\n", suite->name);
+    return -1;
   }
-  while (NULL != fgets(buf, sizeof(buf), fd)) {
-    buf[strlen(buf)] = 0;
-    fputs(buf, stderr);
+
+  while (NULL != fgets(buf, sizeof(buf), pd)) {
+    buf[strcspn(buf, "\n")] = '\0';
+    if (suite->test_cnt == size) {
+      char** test = NULL;
+      size = (0 == size) ? 16 : size * 2;
+      if (NULL == (test = realloc(suite->test, size * sizeof(char*)))) {
+        ok = 0;
+        break;
+      }
+      suite->test = test;
+    }
+    if (NULL == (suite->test[suite->test_cnt] = strdup(buf))) {
+      ok = 0;
+      break;
+    }
+    suite->test_cnt++;
   }
-  fclose(fd);
-  unlink(log_name);
-  free(log_name);
+
+  if ((0 != pclose(pd)) || (0 == ok)) {
+    fprintf(stderr, "ERROR: Unable to list the tests in '%s'\n", suite->name);
+    delete_tests(suite);
+    return -1;
+  }
+  return suite->test_cnt;
 }
 
-static void print_logs(int argc, char* argv[])
+static void delete_test_suites(cutest_work_suite_t* suite, int suite_cnt)
 {
-  int suite_idx = 2;
+  int i;
 
-  while (suite_idx < argc) {
-    print_log(argv[suite_idx]);
-    suite_idx++;
+  for (i = 0; i < suite_cnt; i++) {
+    delete_tests(&suite[i]);
   }
+  free(suite);
 }
 
-static int launch_process(int argc, char* argv[], int verbose)
+static cutest_work_suite_t* new_test_suites(const cutest_work_opts_t* opts,
+                                            int list, int argc, char* argv[])
 {
-  int r = run_test_suites(0, 1, argc, argv, verbose, 0);
+  const int suite_cnt = argc - opts->first_suite;
+  cutest_work_suite_t* suite = calloc(suite_cnt, sizeof(cutest_work_suite_t));
+  int i;
 
-  if (-1 == verbose) {
-    puts("");
+  if (NULL == suite) {
+    fprintf(stderr, "ERROR: Out of memory while allocating test suites\n");
+    return NULL;
   }
-  return r;
+  for (i = 0; i < suite_cnt; i++) {
+    suite[i].name = argv[opts->first_suite + i];
+    if (1 == list) {
+      list_tests(&suite[i]);
+    }
+  }
+  return suite;
 }
 
-int main(int argc, char* argv[]) {
-  int verbose = 0;
-  const int cores = get_number_of_cores();
-  const int suites = argc - 1;
-  int retval = 0;
-  int allocated_cores = min(suites, cores);
+static const char* get_suite_name(const char* path)
+{
+  /*
+   * The test suites are known by their file names in the history and in
+   * the shards, since CI hosts may check out the code in other places.
+   */
+  const char* name = strrchr(path, '/');
+
+  return (NULL == name) ? path : name + 1;
+}
 
-  verbose = handle_args(argc, argv);
+static unsigned long get_hash(const char* str)
+{
+  /* FNV-1a, to get the same value on every host */
+  unsigned long hash = 2166136261UL;
 
-  if (allocated_cores > 1) {
-    launch_child_processes(allocated_cores, argc, argv, verbose);
-    retval = wait_for_child_processes(allocated_cores, verbose);
-    print_logs(argc, argv);
+  while ('\0' != *str) {
+    hash ^= (unsigned char)*str++;
+    hash = (hash * 16777619UL) & 0xffffffffUL;
   }
-  else {
-    retval = launch_process(argc, argv, verbose);
-    if (0 != retval) {
-      retval = EXIT_FAILURE;
+  return hash;
+}
+
+static void read_history(const char* file_name, cutest_work_suite_t* suite,
+                         int suite_cnt)
+{
+  /*
+   * Every row is the duration in seconds, the number of tests run and
+   * the name of a test suite. A test suite may have several rows, from
+   * the history of different shards.
+   */
+  char buf[1024];
+  FILE* fd = NULL;
+
+  if (NULL == file_name) {
+    return;
+  }
+  if (NULL == (fd = fopen(file_name, "r"))) {
+    return; /* No history recorded yet */
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    char* end = NULL;
+    char* name = NULL;
+    const double duration = strtod(buf, &end);
+    const long tests = strtol(end, &name, 10);
+    int i;
+
+    if ((end == buf) || (name == end) || (' ' != *name)) {
+      continue;
     }
-    else {
-      retval = EXIT_SUCCESS;
+    name++;
+    name[strcspn(name, "\n")] = '\0';
+    for (i = 0; i < suite_cnt; i++) {
+      if (0 == strcmp(name, get_suite_name(suite[i].name))) {
+        suite[i].duration += duration;
+        suite[i].duration_tests += tests;
+        break;
+      }
     }
   }
+  fclose(fd);
+}
 
-  return retval;
+static int write_history(const cutest_work_opts_t* opts,
+                         const cutest_work_suite_t* suite, int suite_cnt)
+{
+  /*
+   * All shards must balance on the same history, so a shard does not
+   * overwrite it. Concatenate the files from all shards to get the
+   * history for the next run.
+   */
+  char* file_name = malloc(strlen(opts->history) + 16 + 1);
+  FILE* fd = NULL;
+  int i;
+
+  if (NULL == file_name) {
+    fprintf(stderr, "ERROR: Out of memory while writing the history\n");
+    return -1;
+  }
+  if (opts->shard_count > 1) {
+    sprintf(file_name, "%s.%d", opts->history, opts->shard_index);
+  }
+  else {
+    sprintf(file_name, "%s", opts->history);
+  }
+
+  if (NULL == (fd = fopen(file_name, "w"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", file_name);
+    free(file_name);
+    return -1;
+  }
+  for (i = 0; i < suite_cnt; i++) {
+    if (1 == suite[i].cached) {
+      /* Not run, but it will be when it changes */
+      fprintf(fd, "%f %d %s\n", suite[i].duration, suite[i].duration_tests,
+              get_suite_name(suite[i].name));
+      continue;
+    }
+    if (CUTEST_WORK_RUN_NONE == suite[i].run) {
+      continue;
+    }
+    fprintf(fd, "%f %d %s\n", suite[i].elapsed, suite[i].elapsed_tests,
+            get_suite_name(suite[i].name));
+  }
+  fclose(fd);
+  free(file_name);
+  return 0;
+}
+
+static double get_suite_weight(const cutest_work_suite_t* suite)
+{
+  /*
+   * The expected duration of a test suite, or 0.0 if it is unknown.
+   * Tests may have been added or removed since the history was recorded
+   * so the average duration of a test is used when possible.
+   */
+  if ((0 != suite->duration_tests) && (0 != suite->test_cnt)) {
+    return suite->duration / suite->duration_tests * suite->test_cnt;
+  }
+  return suite->duration;
+}
+
+static int is_spread_by_test(const cutest_work_suite_t* suite,
+                             double fair_share)
+{
+  return ((get_suite_weight(suite) > fair_share) && (suite->test_cnt > 1));
+}
+
+static int compare_units(const void* a, const void* b)
+{
+  /* Heaviest first, and always in the same order on every host */
+  const cutest_work_unit_t* unit_a = a;
+  const cutest_work_unit_t* unit_b = b;
+  int retval = 0;
+
+  if (unit_a->weight > unit_b->weight) {
+    return -1;
+  }
+  if (unit_a->weight < unit_b->weight) {
+    return 1;
+  }
+  if (0 != (retval = strcmp(unit_a->name, unit_b->name))) {
+    return retval;
+  }
+  return unit_a->test - unit_b->test;
+}
+
+static void keep_tests_of_shard(cutest_work_suite_t* suite,
+                                const char* in_shard)
+{
+  int cnt = 0;
+  int i;
+
+  for (i = 0; i < suite->test_cnt; i++) {
+    if (1 == in_shard[i]) {
+      suite->test[cnt++] = suite->test[i];
+    }
+    else {
+      free(suite->test[i]);
+    }
+  }
+  suite->test_cnt = cnt;
+  suite->run = (0 == cnt) ? CUTEST_WORK_RUN_NONE : CUTEST_WORK_RUN_SOME;
+}
+
+static int shard_test_suites(const cutest_work_opts_t* opts,
+                             cutest_work_suite_t* suite, int suite_cnt)
+{
+  /*
+   * Every shard computes the same partition, so that all tests are run
+   * exactly once across the shards. Test suites with a known duration
+   * are handed out heaviest first, each to the shard with the least
+   * work so far. A test suite that is more than a fair share of a shard
+   * on its own is handed out test by test. Test suites without history
+   * go to the shard given by a hash of their name.
+   */
+  const int shard = opts->shard_index - 1;
+  cutest_work_unit_t* unit = NULL;
+  double* load = NULL;
+  char** in_shard = NULL;
+  double fair_share = 0.0;
+  int unit_cnt = 0;
+  int retval = -1;
+  int i;
+  int j;
+  int u = 0;
+
+  if (opts->shard_count < 2) {
+    return 0;
+  }
+
+  for (i = 0; i < suite_cnt; i++) {
+    fair_share += get_suite_weight(&suite[i]) / opts->shard_count;
+  }
+  for (i = 0; i < suite_cnt; i++) {
+    unit_cnt += is_spread_by_test(&suite[i], fair_share) ?
+      suite[i].test_cnt : 1;
+  }
+
+  unit = calloc(unit_cnt, sizeof(cutest_work_unit_t));
+  load = calloc(opts->shard_count, sizeof(double));
+  in_shard = calloc(suite_cnt, sizeof(char*));
+  if ((NULL == unit) || (NULL == load) || (NULL == in_shard)) {
+    fprintf(stderr, "ERROR: Out of memory while sharding test suites\n");
+    goto cleanup;
+  }
+
+  for (i = 0; i < suite_cnt; i++) {
+    const double weight = get_suite_weight(&suite[i]);
+
+    if (!is_spread_by_test(&suite[i], fair_share)) {
+      cutest_work_unit_t whole = {i, -1, get_suite_name(suite[i].name),
+                                  weight};
+      unit[u++] = whole;
+      continue;
+    }
+    if (NULL == (in_shard[i] = calloc(suite[i].test_cnt, sizeof(char)))) {
+      fprintf(stderr, "ERROR: Out of memory while sharding test suites\n");
+      goto cleanup;
+    }
+    for (j = 0; j < suite[i].test_cnt; j++) {
+      cutest_work_unit_t test = {i, j, get_suite_name(suite[i].name),
+                                 weight / suite[i].test_cnt};
+      unit[u++] = test;
+    }
+  }
+
+  qsort(unit, unit_cnt, sizeof(cutest_work_unit_t), compare_units);
+
+  for (u = 0; u < unit_cnt; u++) {
+    int target = 0;
+
+    if (0.0 == unit[u].weight) {
+      target = get_hash(unit[u].name) % opts->shard_count;
+    }
+    else {
+      for (j = 1; j < opts->shard_count; j++) {
+        if (load[j] < load[target]) {
+          target = j;
+        }
+      }
+      load[target] += unit[u].weight;
+    }
+
+    if (-1 != unit[u].test) {
+      in_shard[unit[u].suite][unit[u].test] = (target == shard);
+    }
+    else if (target != shard) {
+      suite[unit[u].suite].run = CUTEST_WORK_RUN_NONE;
+    }
+  }
+
+  for (i = 0; i < suite_cnt; i++) {
+    if (NULL != in_shard[i]) {
+      keep_tests_of_shard(&suite[i], in_shard[i]);
+    }
+  }
+  retval = 0;
+
+ cleanup:
+  if (NULL != in_shard) {
+    for (i = 0; i < suite_cnt; i++) {
+      free(in_shard[i]);
+    }
+  }
+  free(in_shard);
+  free(load);
+  free(unit);
+  return retval;
+}
+
+static int get_tests_per_batch(const cutest_work_opts_t* opts, int workers,
+                               const cutest_work_suite_t* suite,
+                               int suite_cnt)
+{
+  /*
+   * Aim for a few batches per worker, so that the workers that got the
+   * quick batches can pick up more while the slow ones finish. This way
+   * a giant test suite is shared by all workers instead of keeping one
+   * of them busy long after the others are done. Under Valgrind a single
+   * test may take longer than starting a runner for it.
+   */
+  const int batches = workers * BATCHES_PER_WORKER;
+  const int min_tests = (2 == opts->verbose) ?
+    MIN_VALGRIND_TESTS_PER_BATCH : MIN_TESTS_PER_BATCH;
+  int tests = 0;
+  int tests_per_batch = 0;
+  int i;
+
+  if (0 != opts->tests_per_batch) {
+    return min(opts->tests_per_batch, MAX_TESTS_PER_BATCH);
+  }
+  if (1 == workers) {
+    return 0; /* No use in splitting test suites for a single worker */
+  }
+  for (i = 0; i < suite_cnt; i++) {
+    if (CUTEST_WORK_RUN_NONE != suite[i].run) {
+      tests += suite[i].test_cnt;
+    }
+  }
+  tests_per_batch = (tests + batches - 1) / batches;
+  if (tests_per_batch < min_tests) {
+    tests_per_batch = min_tests;
+  }
+  return min(tests_per_batch, MAX_TESTS_PER_BATCH);
+}
+
+static int get_batch_size(const cutest_work_suite_t* suite,
+                          int tests_per_batch)
+{
+  /*
+   * A test suite that only runs some of its tests in this shard must be
+   * given their names, even if it is not split for the workers.
+   */
+  if ((0 == tests_per_batch) && (CUTEST_WORK_RUN_SOME == suite->run)) {
+    return MAX_TESTS_PER_BATCH;
+  }
+  return tests_per_batch;
+}
+
+static int get_number_of_batches(const cutest_work_suite_t* suite,
+                                 int tests_per_batch)
+{
+  const int batch_size = get_batch_size(suite, tests_per_batch);
+
+  if (CUTEST_WORK_RUN_NONE == suite->run) {
+    return 0;
+  }
+  if ((0 == batch_size) || (suite->test_cnt <= batch_size)) {
+    return 1;
+  }
+  return (suite->test_cnt + batch_size - 1) / batch_size;
+}
+
+static void delete_work_queue(cutest_work_queue_t* queue)
+{
+  free(queue->item);
+  free(queue);
+}
+
+static cutest_work_queue_t* new_work_queue(cutest_work_suite_t* suite,
+                                           int suite_cnt,
+                                           int tests_per_batch, int shard)
+{
+  /*
+   * Put every test suite of the shard in the queue, in batches of tests
+   * if they are big enough to be split.
+   */
+  cutest_work_queue_t* queue = malloc(sizeof(cutest_work_queue_t));
+  int idx = 0;
+  int i;
+
+  if (NULL == queue) {
+    fprintf(stderr, "ERROR: Out of memory while allocating work queue\n");
+    return NULL;
+  }
+  queue->cnt = 0;
+  for (i = 0; i < suite_cnt; i++) {
+    queue->cnt += get_number_of_batches(&suite[i], tests_per_batch);
+  }
+  if (NULL == (queue->item = calloc(queue->cnt, sizeof(cutest_work_item_t)))) {
+    fprintf(stderr, "ERROR: Out of memory while allocating work queue\n");
+    free(queue);
+    return NULL;
+  }
+
+  for (i = 0; i < suite_cnt; i++) {
+    const int batches = get_number_of_batches(&suite[i], tests_per_batch);
+    const int batch_size = get_batch_size(&suite[i], tests_per_batch);
+    int batch;
+
+    for (batch = 0; batch < batches; batch++) {
+      cutest_work_item_t* item = &queue->item[idx++];
+      item->suite = &suite[i];
+      item->shard = shard;
+      if ((1 == batches) && (CUTEST_WORK_RUN_ALL == suite[i].run)) {
+        item->batch = -1;
+        continue;
+      }
+      item->batch = batch;
+      item->first_test = batch * batch_size;
+      item->test_cnt = min(batch_size, suite[i].test_cnt - item->first_test);
+    }
+  }
+  return queue;
+}
+
+static int group_test_suites(cutest_work_queue_t* queue, int groups)
+{
+  /*
+   * Let the unity runner run the whole test suites that are next to each
+   * other in the queue a few at a time, in about as many processes as
+   * given, instead of one each. A batch is run on its own, since it is
+   * given the names of its tests. Returns the number of runners to start.
+   */
+  int whole = 0;
+  int size = 0;
+  int runs = 0;
+  int i;
+
+  for (i = 0; i < queue->cnt; i++) {
+    whole += (-1 == queue->item[i].batch);
+  }
+  size = (whole + groups - 1) / ((0 < groups) ? groups : 1);
+  for (i = 0; i < queue->cnt; i = i + 1 + queue->item[i].grouped) {
+    while ((-1 == queue->item[i].batch) &&
+           (queue->item[i].grouped + 1 < size) &&
+           (i + queue->item[i].grouped + 1 < queue->cnt) &&
+           (-1 == queue->item[i + queue->item[i].grouped + 1].batch)) {
+      queue->item[i].grouped++;
+    }
+    runs++;
+  }
+  return runs;
+}
+
+static void format_batch_name(char* buf, const cutest_work_item_t* item)
+{
+  /* Batches are told apart by the runners' log and JUnit file names */
+  if (0 == item->shard) {
+    sprintf(buf, "%d", item->batch);
+  }
+  else {
+    sprintf(buf, "shard%d.%d", item->shard, item->batch);
+  }
+}
+
+static char* new_report_name(const cutest_work_item_t* item,
+                             const char* prefix, const char* suffix)
+{
+  /* The suite name and the batch name, between the prefix and suffix */
+  char* name = malloc(strlen(prefix) + strlen(item->suite->name) +
+                      BATCH_NAME_LEN + strlen(suffix) + 2);
+  char batch_name[BATCH_NAME_LEN];
+
+  if (NULL == name) {
+    fprintf(stderr, "ERROR: Out of memory while allocating report name\n");
+    return NULL;
+  }
+  if (-1 == item->batch) {
+    sprintf(name, "%s%s%s", prefix, item->suite->name, suffix);
+  }
+  else {
+    format_batch_name(batch_name, item);
+    sprintf(name, "%s%s.%s%s", prefix, item->suite->name, batch_name,
+            suffix);
+  }
+  return name;
+}
+
+static int build_suite_argv(char* args[], const cutest_work_item_t* item,
+                            const cutest_work_opts_t* opts, int stderr_log,
+                            const char* batch_name, const char* memcheck)
+{
+  const int verbose = opts->verbose;
+  int cnt = 0;
+  int i;
+
+  if (2 == verbose) {
+    args[cnt++] = "valgrind";
+    args[cnt++] = "--track-origins=yes";
+    args[cnt++] = "-q";
+    args[cnt++] = MEMCHECK_EXIT_CODE;
+    if (NULL != memcheck) {
+      args[cnt++] = "--xml=yes";
+      args[cnt++] = (char*)memcheck;
+    }
+  }
+  if (0 == item->grouped) {
+    args[cnt++] = (char*)item->suite->name;
+  }
+  else {
+    args[cnt++] = (char*)opts->unity;
+    for (i = 0; i <= item->grouped; i++) {
+      args[cnt++] = "--suite";
+      args[cnt++] = (char*)get_suite_name(item[i].suite->name);
+    }
+  }
+  if ((1 == verbose) || (2 == verbose)) {
+    args[cnt++] = "-v";
+  }
+  else if (-1 == verbose) {
+    args[cnt++] = "-n";
+  }
+  args[cnt++] = "-j";
+  args[cnt++] = "-s";
+  if (1 == stderr_log) {
+    args[cnt++] = "-l";
+  }
+  if (1 == opts->fail_fast) {
+    args[cnt++] = "--fail-fast";
+  }
+  if (NULL != opts->retries) {
+    args[cnt++] = "--retries";
+    args[cnt++] = (char*)opts->retries;
+  }
+  if (-1 != item->batch) {
+    args[cnt++] = "-b";
+    args[cnt++] = (char*)batch_name;
+    for (i = 0; i < item->test_cnt; i++) {
+      args[cnt++] = item->suite->test[item->first_test + i];
+    }
+  }
+  args[cnt] = NULL;
+
+  return cnt;
+}
+
+static void get_cgroup_path(char* buf, const cutest_work_opts_t* opts,
+                            int slot, const char* file)
+{
+  /* Every worker slot has its own child cgroup */
+  sprintf(buf, "%s/worker%d%s", opts->cgroup, slot, file);
+}
+
+static int write_cgroup_file(const char* path, const char* value)
+{
+  /* The kernel may refuse a value when it is flushed, not when written */
+  FILE* fd = fopen(path, "w");
+
+  if (NULL == fd) {
+    return -1;
+  }
+  fputs(value, fd);
+  if (0 != fclose(fd)) {
+    return -1;
+  }
+  return 0;
+}
+
+static int setup_cgroups(const cutest_work_opts_t* opts)
+{
+  char path[CGROUP_PATH_LEN];
+
+  if (NULL == opts->cgroup) {
+    return 0;
+  }
+  /* Leave room for the file names in the child cgroups */
+  if (strlen(opts->cgroup) + 64 > sizeof(path)) {
+    fprintf(stderr, "ERROR: The cgroup path '%s' is too long\n", opts->cgroup);
+    return -1;
+  }
+  sprintf(path, "%s/cgroup.subtree_control", opts->cgroup);
+  if (0 != write_cgroup_file(path, "+memory +cpu")) {
+    fprintf(stderr, "ERROR: Could not enable the memory and cpu controllers "
+            "in '%s'\n", opts->cgroup);
+    return -1;
+  }
+  return 0;
+}
+
+static int prepare_cgroup(const cutest_work_opts_t* opts, int slot)
+{
+  /*
+   * Start every runner in a fresh cgroup, so that its memory events only
+   * tell about that runner.
+   */
+  char path[CGROUP_PATH_LEN];
+  char value[32];
+
+  if (NULL == opts->cgroup) {
+    return 0;
+  }
+  get_cgroup_path(path, opts, slot, "");
+  rmdir(path);
+  if (0 != mkdir(path, 0755)) {
+    fprintf(stderr, "ERROR: Could not create the cgroup '%s'\n", path);
+    return -1;
+  }
+  if (0 != opts->limit_memory) {
+    sprintf(value, "%ld", opts->limit_memory * 1024 * 1024);
+    get_cgroup_path(path, opts, slot, "/memory.max");
+    if (0 != write_cgroup_file(path, value)) {
+      fprintf(stderr, "ERROR: Could not limit the memory in '%s'\n", path);
+      return -1;
+    }
+    /* There is no swap controller without swap, that is fine too */
+    get_cgroup_path(path, opts, slot, "/memory.swap.max");
+    write_cgroup_file(path, "0");
+  }
+  get_cgroup_path(path, opts, slot, "/cpu.max");
+  if (0 != write_cgroup_file(path, "100000 100000")) {
+    fprintf(stderr, "ERROR: Could not limit the cores in '%s'\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+static void remove_cgroups(const cutest_work_opts_t* opts, int workers)
+{
+  char path[CGROUP_PATH_LEN];
+  int slot;
+
+  if (NULL == opts->cgroup) {
+    return;
+  }
+  for (slot = 0; slot < workers; slot++) {
+    get_cgroup_path(path, opts, slot, "");
+    rmdir(path);
+  }
+}
+
+static int set_limit(int resource, rlim_t soft, rlim_t hard)
+{
+  struct rlimit limit;
+
+  limit.rlim_cur = soft;
+  limit.rlim_max = hard;
+  return setrlimit(resource, &limit);
+}
+
+static int apply_limits(const cutest_work_opts_t* opts, int slot)
+{
+  /*
+   * Called in the child before the runner is executed. With a cgroup the
+   * memory is limited there instead of the address space. The CPU time
+   * soft limit sends SIGXCPU, and the hard limit a second later SIGKILL.
+   */
+  char path[CGROUP_PATH_LEN];
+  char pid[32];
+
+  if ((0 != opts->limit_memory) && (NULL == opts->cgroup) &&
+      (0 != set_limit(RLIMIT_AS, (rlim_t)opts->limit_memory * 1024 * 1024,
+                      (rlim_t)opts->limit_memory * 1024 * 1024))) {
+    return -1;
+  }
+  if ((0 != opts->limit_cpu) &&
+      (0 != set_limit(RLIMIT_CPU, opts->limit_cpu, opts->limit_cpu + 1))) {
+    return -1;
+  }
+  if ((0 != opts->limit_files) &&
+      (0 != set_limit(RLIMIT_NOFILE, opts->limit_files, opts->limit_files))) {
+    return -1;
+  }
+  if (NULL != opts->cgroup) {
+    sprintf(pid, "%d", (int)getpid());
+    get_cgroup_path(path, opts, slot, "/cgroup.procs");
+    if (0 != write_cgroup_file(path, pid)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int read_hello(int fd, int* slot, int* capacity)
+{
+  /*
+   * Every connection of an agent starts with HELLO <slot> <capacity>.
+   * The agent waits for a request after that, so nothing is lost in the
+   * buffer of the stream when it is closed.
+   */
+  FILE* in = fdopen(dup(fd), "r");
+  char line[MESSAGE_LEN];
+  char* end = NULL;
+  int retval = -1;
+
+  if (NULL == in) {
+    return -1;
+  }
+  if ((NULL != fgets(line, sizeof(line), in)) &&
+      (0 == strncmp("HELLO ", line, 6))) {
+    *slot = strtol(&line[6], &end, 10);
+    *capacity = strtol(end, NULL, 10);
+    if ((*slot >= 0) && (*capacity > *slot)) {
+      retval = 0;
+    }
+  }
+  fclose(in);
+  return retval;
+}
+
+static void close_agents(int* agent, int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    close(agent[i]);
+  }
+  free(agent);
+}
+
+static int* accept_agents(const cutest_work_opts_t* opts, int* cnt)
+{
+  /*
+   * An agent connects once per worker it has. The coordinator waits until
+   * all the agents and all their connections are in, every connection is
+   * then a worker slot of its own.
+   */
+  const int listener = net_listen(opts->listen_address);
+  int* agent = NULL;
+  int agents = 0;
+  int expected = 0;
+
+  *cnt = 0;
+  if (0 > listener) {
+    return NULL;
+  }
+  while ((agents < opts->agents) || (*cnt < expected)) {
+    const int fd = accept(listener, NULL, NULL);
+    int* grown = NULL;
+    int slot = 0;
+    int capacity = 0;
+
+    if (0 > fd) {
+      fprintf(stderr, "ERROR: Could not accept agents on '%s'\n",
+              opts->listen_address);
+      break;
+    }
+    if (0 != read_hello(fd, &slot, &capacity)) {
+      fprintf(stderr, "ERROR: Ignoring a connection that is not an agent\n");
+      close(fd);
+      continue;
+    }
+    if (NULL == (grown = realloc(agent, (*cnt + 1) * sizeof(int)))) {
+      fprintf(stderr, "ERROR: Out of memory while accepting agents\n");
+      close(fd);
+      break;
+    }
+    agent = grown;
+    agent[(*cnt)++] = fd;
+    if (0 == slot) {
+      agents++;
+      expected += capacity;
+    }
+  }
+  close(listener);
+
+  if ((agents < opts->agents) || (*cnt < expected)) {
+    close_agents(agent, *cnt);
+    *cnt = 0;
+    return NULL;
+  }
+  return agent;
+}
+
+static void send_run_request(FILE* out, const char* hash, char* args[],
+                             const char* runner)
+{
+  /* RUN <hash> <argc>, followed by one argument per line */
+  int argc = 0;
+  int i;
+
+  while (NULL != args[argc]) {
+    argc++;
+  }
+  fprintf(out, "RUN %s %d\n", hash, argc);
+  for (i = 0; i < argc; i++) {
+    fprintf(out, "%s\n", (runner == args[i]) ? RUNNER_ARG : args[i]);
+  }
+  fflush(out);
+}
+
+static int is_safe_file_name(const char* name)
+{
+  /* Agents may only write plain files next to the runners */
+  return (('\0' != name[0]) && ('.' != name[0]) &&
+          (NULL == strchr(name, '/')));
+}
+
+static char* new_dir_name(const char* path)
+{
+  /* The directory of a path, or "." if it has none */
+  const char* slash = strrchr(path, '/');
+  const size_t len = (NULL == slash) ? 0 : (size_t)(slash - path);
+  char* dir = malloc(len + 2);
+
+  if (NULL == dir) {
+    fprintf(stderr, "ERROR: Out of memory while naming the directory of "
+            "'%s'\n", path);
+    return NULL;
+  }
+  if (NULL == slash) {
+    strcpy(dir, ".");
+  }
+  else {
+    memcpy(dir, path, (0 == len) ? 1 : len); /* Or the root directory */
+    dir[(0 == len) ? 1 : len] = '\0';
+  }
+  return dir;
+}
+
+static int receive_file(FILE* in, const char* dir, const char* name,
+                        long size)
+{
+  /* The files are written in the directory of the runner */
+  char* path = NULL;
+  FILE* fd = NULL;
+  int retval = 0;
+
+  if (!is_safe_file_name(name)) {
+    fprintf(stderr, "ERROR: Refusing the file '%s' from an agent\n", name);
+    return -1;
+  }
+  if (NULL == (path = malloc(strlen(dir) + strlen(name) + 2))) {
+    fprintf(stderr, "ERROR: Out of memory while receiving '%s'\n", name);
+    return -1;
+  }
+  sprintf(path, "%s/%s", dir, name);
+  if (NULL == (fd = fopen(path, "wb"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", path);
+    free(path);
+    return -1;
+  }
+  retval = copy_bytes(in, fd, size);
+  if (0 != fclose(fd)) {
+    retval = -1;
+  }
+  free(path);
+  return retval;
+}
+
+static int handle_agent_message(FILE* in, FILE* out, char* line,
+                                const char* runner, const char* dir,
+                                int* code, int* sig)
+{
+  /*
+   * Returns 1 when the runner is done, 0 when more messages are expected
+   * and -1 if the agent makes no sense.
+   */
+  char* end = NULL;
+  long size = 0;
+
+  if (0 == strcmp("NEED\n", line)) {
+    return send_file(out, "BLOB", runner);
+  }
+  if (0 == strncmp("DONE ", line, 5)) {
+    *code = strtol(&line[5], &end, 10);
+    *sig = strtol(end, NULL, 10);
+    return 1;
+  }
+  if (NULL == (end = strrchr(line, ' '))) {
+    return -1;
+  }
+  size = strtol(end + 1, NULL, 10);
+  *end = '\0';
+  if (0 == strcmp("OUTPUT", line)) {
+    const int retval = copy_bytes(in, stdout, size);
+    fflush(stdout);
+    return retval;
+  }
+  if (0 == strncmp("FILE ", line, 5)) {
+    return receive_file(in, dir, &line[5], size);
+  }
+  return -1;
+}
+
+static int delegate_test_suite(char* args[], const char* runner, int agent)
+{
+  /*
+   * Runs in the child process of a remote worker slot, so that it is
+   * waited for just like a local test suite runner. The output, the log
+   * and the JUnit report of the runner end up here too. Returns the exit
+   * code of the runner, or dies by the same signal.
+   */
+  FILE* in = fdopen(dup(agent), "r");
+  FILE* out = fdopen(dup(agent), "w");
+  char* dir = NULL;
+  char hash[NET_HASH_LEN];
+  char line[MESSAGE_LEN];
+  int retval = 0;
+  int code = EXIT_FAILURE;
+  int sig = 0;
+
+  if ((NULL == in) || (NULL == out) || (0 != get_file_hash(hash, runner)) ||
+      (NULL == (dir = new_dir_name(runner)))) {
+    return EXIT_FAILURE;
+  }
+  send_run_request(out, hash, args, runner);
+  while ((0 == retval) && (NULL != fgets(line, sizeof(line), in))) {
+    retval = handle_agent_message(in, out, line, runner, dir, &code, &sig);
+  }
+  fclose(in);
+  fclose(out);
+  free(dir);
+
+  if (1 != retval) {
+    fprintf(stderr, "ERROR: Lost the agent running '%s'\n", runner);
+    return EXIT_FAILURE;
+  }
+  if (0 != sig) {
+    signal(sig, SIG_DFL);
+    raise(sig);
+  }
+  return code;
+}
+
+static void remove_junit_reports(const cutest_work_item_t* item)
+{
+  /*
+   * A test suite that the unity runner did not get to must not be judged
+   * by the report of an earlier run.
+   */
+  char* name = NULL;
+  int i;
+
+  for (i = 0; (0 != item->grouped) && (i <= item->grouped); i++) {
+    if (NULL != (name = new_report_name(&item[i], "", ".junit_report.xml"))) {
+      unlink(name);
+      free(name);
+    }
+  }
+}
+
+static pid_t spawn_test_suite(const cutest_work_item_t* item,
+                              const cutest_work_opts_t* opts, int stderr_log,
+                              int slot, int agent, int out)
+{
+  /* The runner writes its verdicts to out, or to stdout if it is -1 */
+  char** args = NULL;
+  char* memcheck = NULL;
+  char batch_name[BATCH_NAME_LEN];
+  pid_t pid = 0;
+
+  if (NULL == item) {
+    fprintf(stderr, "ERROR: Internal error, work item is NULL pointer\n");
+    return -1;
+  }
+
+  args = malloc((MAX_SUITE_ARGS + item->test_cnt + 2 * item->grouped) *
+                sizeof(char*));
+  if (NULL == args) {
+    fprintf(stderr, "ERROR: Out of memory while building suite arguments\n");
+    return -1;
+  }
+  if ((2 == opts->verbose) &&
+      (NULL == (memcheck = new_report_name(item, "--xml-file=",
+                                           MEMCHECK_SUFFIX)))) {
+    free(args);
+    return -1;
+  }
+  format_batch_name(batch_name, item);
+  build_suite_argv(args, item, opts, stderr_log, batch_name, memcheck);
+  remove_junit_reports(item);
+
+  if (0 > (pid = fork())) {
+    fprintf(stderr, "ERROR: Failed to fork\n");
+    free(memcheck);
+    free(args);
+    return -1;
+  }
+  else if ((0 == pid) && (-1 != out) && (0 > dup2(out, STDOUT_FILENO))) {
+    _exit(EXIT_FAILURE);
+  }
+  else if ((0 == pid) && (0 != agent)) {
+    /* The agent limits the runner, and it is not stopped by fail-fast */
+    signal(SIGUSR1, SIG_IGN);
+    _exit(delegate_test_suite(args, item->suite->name, agent));
+  }
+  else if (0 == pid) {
+    if (0 != apply_limits(opts, slot)) {
+      fprintf(stderr, "ERROR: Unable to limit the resources of '%s'\n",
+              item->suite->name);
+      _exit(EXIT_FAILURE);
+    }
+    execvp(args[0], args);
+    fprintf(stderr, "ERROR: Unable to execute '%s'\n", args[0]);
+    _exit(EXIT_FAILURE);
+  }
+
+  free(memcheck);
+  free(args);
+  return pid;
+}
+
+static double get_time()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void delete_worker_pool(cutest_work_pool_t* pool)
+{
+  free(pool->pid);
+  free(pool->item);
+  free(pool->started);
+  free(pool->agent);
+  free(pool->out);
+  free(pool->done);
+  free(pool->failed);
+  free(pool);
+}
+
+static cutest_work_pool_t* new_worker_pool(int workers)
+{
+  cutest_work_pool_t* pool = malloc(sizeof(cutest_work_pool_t));
+
+  if (NULL == pool) {
+    fprintf(stderr, "ERROR: Out of memory while allocating worker pool\n");
+    return NULL;
+  }
+  pool->workers = workers;
+  pool->running = 0;
+  pool->pid = calloc(workers, sizeof(pid_t));
+  pool->item = calloc(workers, sizeof(int));
+  pool->started = calloc(workers, sizeof(double));
+  pool->agent = NULL;
+  pool->out = NULL;
+  pool->done = NULL;
+  pool->failed = NULL;
+  if ((NULL == pool->pid) || (NULL == pool->item) ||
+      (NULL == pool->started)) {
+    fprintf(stderr, "ERROR: Out of memory while allocating worker pool\n");
+    delete_worker_pool(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+static int assign_agents(cutest_work_pool_t* pool, const int* agent, int cnt,
+                         int local)
+{
+  /*
+   * The local workers get the first slots, so small runs stay on this
+   * host. Agents that do not fit in the pool get nothing to do.
+   */
+  int slot;
+
+  if (0 == cnt) {
+    return 0;
+  }
+  if (NULL == (pool->agent = calloc(pool->workers, sizeof(int)))) {
+    fprintf(stderr, "ERROR: Out of memory while allocating worker pool\n");
+    return -1;
+  }
+  for (slot = local; (slot < pool->workers) && (slot - local < cnt); slot++) {
+    pool->agent[slot] = agent[slot - local];
+  }
+  return 0;
+}
+
+static int watch_worker_pool(cutest_work_pool_t* pool)
+{
+  /* Read the verdicts of the runners instead of letting them print them */
+  int slot;
+
+  pool->out = malloc(pool->workers * sizeof(int));
+  pool->done = calloc(pool->workers, sizeof(int));
+  pool->failed = calloc(pool->workers, sizeof(int));
+  if ((NULL == pool->out) || (NULL == pool->done) || (NULL == pool->failed)) {
+    fprintf(stderr, "ERROR: Out of memory while allocating worker pool\n");
+    return -1;
+  }
+  for (slot = 0; slot < pool->workers; slot++) {
+    pool->out[slot] = -1;
+  }
+  return 0;
+}
+
+static int open_output(cutest_work_pool_t* pool, int slot, int* out)
+{
+  /*
+   * A pipe for the verdicts of the runner in the slot, where the runner
+   * gets the write end. Nothing is read when the pool is not watched.
+   */
+  int fd[2];
+
+  *out = -1;
+  if (NULL == pool->out) {
+    return 0;
+  }
+  if (0 != pipe(fd)) {
+    fprintf(stderr, "ERROR: Could not create a pipe for a runner\n");
+    return -1;
+  }
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+  pool->out[slot] = fd[0];
+  pool->done[slot] = 0;
+  pool->failed[slot] = 0;
+  *out = fd[1];
+  return 0;
+}
+
+static void close_output(cutest_work_pool_t* pool, int slot)
+{
+  if ((NULL != pool->out) && (-1 != pool->out[slot])) {
+    close(pool->out[slot]);
+    pool->out[slot] = -1;
+  }
+}
+
+static int launch_test_suite(cutest_work_pool_t* pool,
+                             const cutest_work_queue_t* queue, int item_idx,
+                             const cutest_work_opts_t* opts)
+{
+  /* Other output of the runners would be mixed up with their verdicts */
+  const int stderr_log = ((pool->workers > 1) || (NULL != pool->out));
+  int agent = 0;
+  int slot = 0;
+  int out = -1;
+  pid_t pid = 0;
+
+  while ((slot < pool->workers) && (0 != pool->pid[slot])) {
+    slot++;
+  }
+  if (slot == pool->workers) {
+    fprintf(stderr, "ERROR: Internal error, no free worker\n");
+    return -1;
+  }
+
+  if (NULL != pool->agent) {
+    agent = pool->agent[slot];
+  }
+  if (((0 == agent) && (0 != prepare_cgroup(opts, slot))) ||
+      (0 != open_output(pool, slot, &out))) {
+    return -1;
+  }
+  pid = spawn_test_suite(&queue->item[item_idx], opts, stderr_log, slot,
+                         agent, out);
+  if (-1 != out) {
+    close(out);
+  }
+  if (0 > pid) {
+    close_output(pool, slot);
+    return -1;
+  }
+
+  pool->pid[slot] = pid;
+  pool->item[slot] = item_idx;
+  pool->started[slot] = get_time();
+  pool->running++;
+
+  return slot;
+}
+
+static int wait_for_test_suite(cutest_work_pool_t* pool, int* status,
+                               int block)
+{
+  /*
+   * Reap a finished test suite and free its worker slot. Returns the
+   * slot, or -1 if no test suite has finished.
+   */
+  const pid_t pid = waitpid(-1, status, (1 == block) ? 0 : WNOHANG);
+  int slot;
+
+  if (0 >= pid) {
+    return -1;
+  }
+  for (slot = 0; slot < pool->workers; slot++) {
+    if (pid == pool->pid[slot]) {
+      pool->pid[slot] = 0;
+      pool->running--;
+      return slot;
+    }
+  }
+  return -1;
+}
+
+static void stop_test_suites(const cutest_work_pool_t* pool)
+{
+  /*
+   * Ask the running test suites to stop after their current test, they
+   * still write their reports and logs when they exit.
+   */
+  int slot;
+
+  for (slot = 0; slot < pool->workers; slot++) {
+    if (0 != pool->pid[slot]) {
+      kill(pool->pid[slot], SIGUSR1);
+    }
+  }
+}
+
+static void print_log(const cutest_work_item_t* item);
+
+static int get_item_test_cnt(const cutest_work_item_t* item)
+{
+  return (-1 == item->batch) ? item->suite->test_cnt : item->test_cnt;
+}
+
+static double record_duration(const cutest_work_pool_t* pool,
+                              const cutest_work_queue_t* queue, int slot)
+{
+  const cutest_work_item_t* item = &queue->item[pool->item[slot]];
+  const double elapsed = get_time() - pool->started[slot];
+
+  item->suite->elapsed += elapsed;
+  item->suite->elapsed_tests += get_item_test_cnt(item);
+
+  return elapsed;
+}
+
+static int open_report(cutest_work_report_t* report, const char* file_name)
+{
+  memset(report, 0, sizeof(*report));
+  report->started = get_time();
+
+  if (NULL == file_name) {
+    return 0;
+  }
+  if (NULL == (report->junit = fopen(file_name, "w"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", file_name);
+    return -1;
+  }
+  fprintf(report->junit,
+          "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<testsuites>\n");
+  fflush(report->junit);
+  return 0;
+}
+
+static int is_report_line(const char* line, const char* tag)
+{
+  /* Only match the indented tags, not what the tests printed */
+  return (0 == strncmp(line, tag, strlen(tag)));
+}
+
+static FILE* open_junit_report(const cutest_work_item_t* item)
+{
+  /* Room for the suite name, a batch name and the report suffix */
+  const size_t report_name_len = strlen(item->suite->name) + BATCH_NAME_LEN +
+    strlen("..junit_report.xml") + 1;
+  char* report_name = malloc(report_name_len);
+  char batch_name[BATCH_NAME_LEN];
+  FILE* fd = NULL;
+
+  if (NULL == report_name) {
+    fprintf(stderr, "ERROR: Out of memory while allocating report name\n");
+    return NULL;
+  }
+  if (-1 == item->batch) {
+    sprintf(report_name, "%s.junit_report.xml", item->suite->name);
+  }
+  else {
+    format_batch_name(batch_name, item);
+    sprintf(report_name, "%s.%s.junit_report.xml", item->suite->name,
+            batch_name);
+  }
+
+  fd = fopen(report_name, "r");
+  free(report_name);
+  return fd;
+}
+
+static void get_name_attribute(char* buf, const char* line, size_t size)
+{
+  /* The name of a test suite or test case, or "" if there is none */
+  const char* name = strstr(line, " name=\"");
+  size_t len = 0;
+
+  buf[0] = '\0';
+  if (NULL == name) {
+    return;
+  }
+  name += strlen(" name=\"");
+  len = strcspn(name, "\"");
+  if (len < size) {
+    strncpy(buf, name, len);
+    buf[len] = '\0';
+  }
+}
+
+static int find_test_suite(const cutest_work_suite_t* suite, int suite_cnt,
+                           const char* name)
+{
+  int i;
+
+  for (i = 0; i < suite_cnt; i++) {
+    if (0 == strcmp(name, get_suite_name(suite[i].name))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int find_test(const cutest_work_suite_t* suite, const char* name)
+{
+  int i;
+
+  for (i = 0; i < suite->test_cnt; i++) {
+    if (0 == strcmp(name, suite->test[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void mark_failed_test(const cutest_work_suite_t* suite, char* failed,
+                             int* whole, const char* test)
+{
+  /*
+   * A runner that was killed is reported as a test named like the suite,
+   * and a suite that could not be listed can only be run as a whole.
+   */
+  const int idx = find_test(suite, test);
+
+  if (-1 != idx) {
+    failed[idx] = 1;
+  }
+  else if ((0 == suite->test_cnt) ||
+           (0 == strcmp(test, get_suite_name(suite->name)))) {
+    *whole = 1;
+  }
+}
+
+static int keep_failed_tests(const char* file_name, cutest_work_suite_t* suite,
+                             int suite_cnt)
+{
+  /*
+   * Only run the tests that failed, or had errors, according to the
+   * merged JUnit report of the last run. Tests that no longer exist, or
+   * that are in another shard, are left out.
+   */
+  char buf[1024];
+  char name[1024];
+  char test[1024] = "";
+  char** failed = NULL;
+  int* whole = NULL;
+  int current = -1;
+  int retval = -1;
+  FILE* fd = NULL;
+  int i;
+
+  if (NULL == (fd = fopen(file_name, "r"))) {
+    fprintf(stderr, "ERROR: Could not read the last run from '%s'\n",
+            file_name);
+    return -1;
+  }
+  failed = calloc(suite_cnt, sizeof(char*));
+  whole = calloc(suite_cnt, sizeof(int));
+  if ((NULL == failed) || (NULL == whole)) {
+    fprintf(stderr, "ERROR: Out of memory while reading the last run\n");
+    goto cleanup;
+  }
+  for (i = 0; i < suite_cnt; i++) {
+    if (NULL == (failed[i] = calloc(suite[i].test_cnt + 1, sizeof(char)))) {
+      fprintf(stderr, "ERROR: Out of memory while reading the last run\n");
+      goto cleanup;
+    }
+  }
+
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (is_report_line(buf, "  <testsuite ")) {
+      get_name_attribute(name, buf, sizeof(name));
+      current = find_test_suite(suite, suite_cnt, name);
+    }
+    else if (is_report_line(buf, "    <testcase ")) {
+      get_name_attribute(test, buf, sizeof(test));
+    }
+    else if ((-1 != current) &&
+             (is_report_line(buf, "       <failure ") ||
+              is_report_line(buf, "       <error "))) {
+      mark_failed_test(&suite[current], failed[current], &whole[current],
+                       test);
+    }
+  }
+
+  for (i = 0; i < suite_cnt; i++) {
+    if ((CUTEST_WORK_RUN_NONE != suite[i].run) && (0 == whole[i])) {
+      keep_tests_of_shard(&suite[i], failed[i]);
+    }
+  }
+  retval = 0;
+
+ cleanup:
+  if (NULL != failed) {
+    for (i = 0; i < suite_cnt; i++) {
+      free(failed[i]);
+    }
+  }
+  free(failed);
+  free(whole);
+  fclose(fd);
+  return retval;
+}
+
+static int skip_unchanged_suites(const char* file_name,
+                                 cutest_work_suite_t* suite, int suite_cnt)
+{
+  /*
+   * Every row is the hash of a runner that passed and the name of its
+   * test suite. A runner with the same hash now is not run again, which
+   * is a big saving under Valgrind.
+   */
+  char buf[1024];
+  char hash[NET_HASH_LEN];
+  FILE* fd = NULL;
+  int i;
+
+  if (NULL == (fd = fopen(file_name, "r"))) {
+    return 0; /* Nothing has passed yet */
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    char* name = strchr(buf, ' ');
+
+    if ((NULL == name) || (NET_HASH_LEN - 1 != name - buf)) {
+      continue;
+    }
+    *name++ = '\0';
+    name[strcspn(name, "\n")] = '\0';
+    i = find_test_suite(suite, suite_cnt, name);
+    if ((-1 == i) || (CUTEST_WORK_RUN_NONE == suite[i].run) ||
+        (0 != get_file_hash(hash, suite[i].name)) || (0 != strcmp(hash, buf))) {
+      continue;
+    }
+    suite[i].run = CUTEST_WORK_RUN_NONE;
+    suite[i].clean = 1;
+  }
+  fclose(fd);
+  return 0;
+}
+
+static int write_clean_suites(const char* file_name,
+                              const cutest_work_suite_t* suite, int suite_cnt)
+{
+  /* The runners that passed now, or that were not run since they had */
+  char hash[NET_HASH_LEN];
+  FILE* fd = NULL;
+  int i;
+
+  if (NULL == (fd = fopen(file_name, "w"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", file_name);
+    return -1;
+  }
+  for (i = 0; i < suite_cnt; i++) {
+    if ((0 == suite[i].clean) &&
+        ((CUTEST_WORK_RUN_ALL != suite[i].run) || (0 != suite[i].failed))) {
+      continue;
+    }
+    if (0 == get_file_hash(hash, suite[i].name)) {
+      fprintf(fd, "%s %s\n", hash, get_suite_name(suite[i].name));
+    }
+  }
+  fclose(fd);
+  return 0;
+}
+
+static void fold_hash(unsigned long long* value, const char* str)
+{
+  /* FNV-1a, with the terminating zero to keep the strings apart */
+  do {
+    *value ^= (unsigned char)*str;
+    *value *= 1099511628211ULL;
+  } while ('\0' != *str++);
+}
+
+static int get_result_key(char* key, const cutest_work_opts_t* opts,
+                          const cutest_work_suite_t* suite)
+{
+  /*
+   * A runner that passed will pass again, as long as it is the same
+   * runner, run the same way, on the same input files and with the same
+   * environment. Anything else it depends on is not known to the tool.
+   */
+  static const char* env[] = {"LD_PRELOAD", "LD_LIBRARY_PATH", "TZ", "LANG",
+                              "LC_ALL", "MALLOC_CHECK_", "MALLOC_PERTURB_",
+                              NULL};
+  unsigned long long value = 14695981039346656037ULL;
+  char hash[NET_HASH_LEN];
+  char buf[RESULT_PATH_LEN];
+  const char* input = opts->cache_inputs;
+  int i;
+
+  if (0 != get_file_hash(hash, suite->name)) {
+    return -1;
+  }
+  fold_hash(&value, hash);
+  fold_hash(&value, get_suite_name(suite->name));
+  sprintf(buf, "%d %s %ld %ld %ld", (2 == opts->verbose),
+          (NULL != opts->retries) ? opts->retries : "0", opts->limit_memory,
+          opts->limit_cpu, opts->limit_files);
+  fold_hash(&value, buf);
+
+  while ((NULL != input) && ('\0' != *input)) {
+    const size_t len = strcspn(input, ":");
+
+    if (len >= sizeof(buf)) {
+      fprintf(stderr, "ERROR: The cache input '%s' is too long\n", input);
+      return -1;
+    }
+    strncpy(buf, input, len);
+    buf[len] = '\0';
+    input += len + (':' == input[len]);
+    if ((0 != len) && (0 != get_file_hash(hash, buf))) {
+      return -1;
+    }
+    fold_hash(&value, (0 != len) ? hash : "");
+  }
+
+  for (i = 0; NULL != env[i]; i++) {
+    const char* str = getenv(env[i]);
+
+    fold_hash(&value, env[i]);
+    fold_hash(&value, (NULL != str) ? str : "");
+  }
+  sprintf(key, "%016llx", value);
+  return 0;
+}
+
+static void get_result_path(char* buf, const char* dir, const char* key)
+{
+  sprintf(buf, "%.*s/%s", RESULT_PATH_LEN - NET_HASH_LEN - 2, dir, key);
+}
+
+static int skip_cached_suites(const cutest_work_opts_t* opts,
+                              cutest_work_suite_t* suite, int suite_cnt)
+{
+  /*
+   * Every file in the results directory is named by the key of a runner
+   * that passed. Its time is touched when it is used again, so the ones
+   * evicted first are the ones not used for the longest time.
+   */
+  char key[NET_HASH_LEN];
+  char path[RESULT_PATH_LEN];
+  int i;
+
+  for (i = 0; i < suite_cnt; i++) {
+    if ((CUTEST_WORK_RUN_ALL != suite[i].run) ||
+        (0 != get_result_key(key, opts, &suite[i]))) {
+      continue;
+    }
+    get_result_path(path, opts->results, key);
+    if (0 != access(path, R_OK)) {
+      continue;
+    }
+    utime(path, NULL);
+    suite[i].run = CUTEST_WORK_RUN_NONE;
+    suite[i].cached = 1;
+    printf("[CACHED]: %s\n", get_suite_name(suite[i].name));
+  }
+  return 0;
+}
+
+static int compare_results(const void* a, const void* b)
+{
+  /* The most recently used first */
+  const cutest_work_result_t* result_a = a;
+  const cutest_work_result_t* result_b = b;
+
+  if (result_a->mtime != result_b->mtime) {
+    return (result_a->mtime < result_b->mtime) ? 1 : -1;
+  }
+  return strcmp(result_a->key, result_b->key);
+}
+
+static int evict_results(const char* dir_name, int max)
+{
+  char path[RESULT_PATH_LEN];
+  cutest_work_result_t* result = NULL;
+  struct dirent* entry = NULL;
+  struct stat st;
+  DIR* dir = NULL;
+  int cnt = 0;
+  int size = 0;
+  int i;
+
+  if (NULL == (dir = opendir(dir_name))) {
+    fprintf(stderr, "ERROR: Could not open the results '%s'\n", dir_name);
+    return -1;
+  }
+  while (NULL != (entry = readdir(dir))) {
+    if ((NET_HASH_LEN - 1 != strlen(entry->d_name)) ||
+        (NET_HASH_LEN - 1 != strspn(entry->d_name, "0123456789abcdef"))) {
+      continue; /* Not a result */
+    }
+    get_result_path(path, dir_name, entry->d_name);
+    if (0 != stat(path, &st)) {
+      continue;
+    }
+    if (cnt == size) {
+      cutest_work_result_t* more = realloc(result, (size + 64) * sizeof(cutest_work_result_t));
+
+      if (NULL == more) {
+        fprintf(stderr, "ERROR: Out of memory while evicting results\n");
+        free(result);
+        closedir(dir);
+        return -1;
+      }
+      result = more;
+      size += 64;
+    }
+    result[cnt].mtime = st.st_mtime;
+    strcpy(result[cnt].key, entry->d_name);
+    cnt++;
+  }
+  closedir(dir);
+
+  if (cnt > max) {
+    qsort(result, cnt, sizeof(cutest_work_result_t), compare_results);
+  }
+  for (i = max; i < cnt; i++) {
+    get_result_path(path, dir_name, result[i].key);
+    unlink(path);
+  }
+  free(result);
+  return 0;
+}
+
+static int write_cached_suites(const cutest_work_opts_t* opts,
+                               const cutest_work_suite_t* suite,
+                               int suite_cnt)
+{
+  /*
+   * A result holds the name of the test suite and what it took to run
+   * it, only to make the directory easier to look into.
+   */
+  char key[NET_HASH_LEN];
+  char path[RESULT_PATH_LEN];
+  FILE* fd = NULL;
+  int i;
+
+  if ((0 != mkdir(opts->results, 0755)) && (0 != access(opts->results, W_OK))) {
+    fprintf(stderr, "ERROR: Could not create the results '%s'\n",
+            opts->results);
+    return -1;
+  }
+  for (i = 0; i < suite_cnt; i++) {
+    if ((CUTEST_WORK_RUN_ALL != suite[i].run) || (0 != suite[i].failed) ||
+        (0 != get_result_key(key, opts, &suite[i]))) {
+      continue;
+    }
+    get_result_path(path, opts->results, key);
+    if (NULL == (fd = fopen(path, "w"))) {
+      fprintf(stderr, "ERROR: Could not open '%s' for writing\n", path);
+      continue;
+    }
+    fprintf(fd, "%s %d %f\n", get_suite_name(suite[i].name),
+            suite[i].elapsed_tests, suite[i].elapsed);
+    fclose(fd);
+  }
+  return evict_results(opts->results, opts->results_max);
+}
+
+static void get_xml_text(char* buf, const char* line, const char* tag,
+                         size_t size)
+{
+  /* The text after the tag on the line, or "" if it is not there */
+  const char* text = strstr(line, tag);
+  size_t len = 0;
+
+  buf[0] = '\0';
+  if (NULL == text) {
+    return;
+  }
+  text += strlen(tag);
+  len = strcspn(text, "<\n");
+  if (len >= size) {
+    len = size - 1;
+  }
+  strncpy(buf, text, len);
+  buf[len] = '\0';
+}
+
+static int find_test_frame(const cutest_work_item_t* item, const char* fn)
+{
+  /* Tests are the cutest_<name>() functions of the runner */
+  const int first = (-1 == item->batch) ? 0 : item->first_test;
+  const int cnt = (-1 == item->batch) ? item->suite->test_cnt : item->test_cnt;
+  int i;
+
+  if (0 != strncmp("cutest_", fn, strlen("cutest_"))) {
+    return -1;
+  }
+  for (i = first; i < first + cnt; i++) {
+    if (0 == strcmp(&fn[strlen("cutest_")], item->suite->test[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static cutest_work_memcheck_t* read_memcheck_errors(
+  const cutest_work_item_t* item, int* cnt)
+{
+  /*
+   * Every error in the Valgrind XML has the stack where it was found,
+   * and the test it was found in is one of the frames. Errors outside
+   * of the tests, or in suites that were not listed, are not known.
+   */
+  char* name = new_report_name(item, "", MEMCHECK_SUFFIX);
+  cutest_work_memcheck_t* error = NULL;
+  cutest_work_memcheck_t* current = NULL;
+  char buf[1024];
+  char fn[1024];
+  FILE* fd = NULL;
+  int size = 0;
+
+  *cnt = 0;
+  if (NULL == name) {
+    return NULL;
+  }
+  fd = fopen(name, "r");
+  free(name);
+  if (NULL == fd) {
+    return NULL;
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (NULL != strstr(buf, "<error>")) {
+      if (*cnt == size) {
+        cutest_work_memcheck_t* more = NULL;
+        size = (0 == size) ? 8 : size * 2;
+        if (NULL == (more = realloc(error, size * sizeof(*error)))) {
+          fprintf(stderr, "ERROR: Out of memory while reading Valgrind errors\n");
+          break;
+        }
+        error = more;
+      }
+      current = &error[(*cnt)++];
+      memset(current, 0, sizeof(*current));
+      current->test = -1;
+    }
+    else if (NULL != strstr(buf, "</error>")) {
+      current = NULL;
+    }
+    else if (NULL != current) {
+      if ('\0' == current->kind[0]) {
+        get_xml_text(current->kind, buf, "<kind>", sizeof(current->kind));
+      }
+      if ('\0' == current->what[0]) {
+        get_xml_text(current->what, buf, "<what>", sizeof(current->what));
+      }
+      if ('\0' == current->what[0]) {
+        get_xml_text(current->what, buf, "<text>", sizeof(current->what));
+      }
+      if (-1 == current->test) {
+        get_xml_text(fn, buf, "<fn>", sizeof(fn));
+        current->test = find_test_frame(item, fn);
+      }
+    }
+  }
+  fclose(fd);
+  return error;
+}
+
+static int count_memcheck_errors(const cutest_work_item_t* item,
+                                 const cutest_work_memcheck_t* error, int cnt,
+                                 const char* test)
+{
+  /* The errors found in the named test, or outside of the tests if NULL */
+  int retval = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if (-1 == error[i].test) {
+      retval += (NULL == test);
+    }
+    else if (NULL != test) {
+      retval += (0 == strcmp(test, item->suite->test[error[i].test]));
+    }
+  }
+  return retval;
+}
+
+static void write_memcheck_errors(FILE* fd, const cutest_work_item_t* item,
+                                  const cutest_work_memcheck_t* error,
+                                  int cnt, const char* test)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if (0 == count_memcheck_errors(item, &error[i], 1, test)) {
+      continue;
+    }
+    fprintf(fd,
+            "       <error message=\"valgrind: %s\">\n"
+            "%s\n"
+            "       </error>\n",
+            error[i].kind, error[i].what);
+  }
+}
+
+static void print_memcheck_errors(const cutest_work_item_t* item,
+                                  const cutest_work_memcheck_t* error,
+                                  int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if (-1 == error[i].test) {
+      fprintf(stderr, "ERROR: Valgrind: %s in '%s'\n", error[i].what,
+              item->suite->name);
+    }
+    else {
+      fprintf(stderr, "ERROR: Valgrind: %s in '%s' %s\n", error[i].what,
+              item->suite->name, item->suite->test[error[i].test]);
+    }
+  }
+}
+
+static void add_to_report(cutest_work_report_t* report,
+                          const cutest_work_item_t* item, int worker,
+                          double elapsed)
+{
+  /*
+   * Count the verdicts in the JUnit report of a finished runner and
+   * append its test cases to the merged report right away, so that it
+   * is useful even if the run is aborted. Under Valgrind the errors it
+   * found are added to the tests they were found in, as errors.
+   */
+  char batch_name[BATCH_NAME_LEN];
+  char buf[1024];
+  char test[1024] = "";
+  cutest_work_memcheck_t* memcheck = NULL;
+  int memcheck_cnt = 0;
+  int tests = 0;
+  int failures = 0;
+  int errors = 0;
+  int skipped = 0;
+  int flaky = 0;
+  int failed = 0;
+  int copy = 0;
+  FILE* fd = open_junit_report(item);
+
+  if (NULL == fd) {
+    return; /* The runner did not get far enough to write one */
+  }
+  if (1 == report->memcheck) {
+    memcheck = read_memcheck_errors(item, &memcheck_cnt);
+    print_memcheck_errors(item, memcheck, memcheck_cnt);
+  }
+  format_batch_name(batch_name, item);
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (is_report_line(buf, "    <testcase ")) {
+      get_name_attribute(test, buf, sizeof(test));
+      failed = 0;
+    }
+    failed += is_report_line(buf, "       <failure ");
+    failed += is_report_line(buf, "       <error ");
+    if (is_report_line(buf, "    </testcase>") && (0 == failed) &&
+        (0 != count_memcheck_errors(item, memcheck, memcheck_cnt, test))) {
+      errors++;
+    }
+    tests += is_report_line(buf, "    <testcase ");
+    failures += is_report_line(buf, "       <failure ");
+    errors += is_report_line(buf, "       <error ");
+    skipped += is_report_line(buf, "       <skipped/>");
+    flaky += is_report_line(buf, "       <flakyFailure ");
+    flaky += is_report_line(buf, "       <flakyError ");
+  }
+  if (0 != count_memcheck_errors(item, memcheck, memcheck_cnt, NULL)) {
+    tests++;
+    errors++;
+  }
+  report->tests += tests;
+  report->failures += failures;
+  report->errors += errors;
+  report->skipped += skipped;
+  report->flaky += flaky;
+
+  if (NULL == report->junit) {
+    free(memcheck);
+    fclose(fd);
+    return;
+  }
+  fprintf(report->junit,
+          "  <testsuite name=\"%s\"\n"
+          "             errors=\"%d\"\n"
+          "             tests=\"%d\"\n"
+          "             failures=\"%d\"\n"
+          "             skipped=\"%d\"\n"
+          "             time=\"%f\">\n"
+          "    <properties>\n"
+          "      <property name=\"worker\" value=\"%d\"/>\n",
+          get_suite_name(item->suite->name), errors, tests, failures,
+          skipped, elapsed, worker);
+  if (-1 != item->batch) {
+    fprintf(report->junit,
+            "      <property name=\"batch\" value=\"%s\"/>\n", batch_name);
+  }
+  if (0 != flaky) {
+    fprintf(report->junit,
+            "      <property name=\"flaky\" value=\"%d\"/>\n", flaky);
+  }
+  fprintf(report->junit,
+          "    </properties>\n");
+  rewind(fd);
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (is_report_line(buf, "    <testcase ")) {
+      get_name_attribute(test, buf, sizeof(test));
+      copy = 1;
+    }
+    else if (is_report_line(buf, "  </testsuite>")) {
+      copy = 0;
+    }
+    if ((1 == copy) && is_report_line(buf, "    </testcase>")) {
+      write_memcheck_errors(report->junit, item, memcheck, memcheck_cnt,
+                            test);
+    }
+    if (1 == copy) {
+      fputs(buf, report->junit);
+    }
+  }
+  if (0 != count_memcheck_errors(item, memcheck, memcheck_cnt, NULL)) {
+    fprintf(report->junit,
+            "    <testcase classname=\"%s\" name=\"%s\">\n",
+            item->suite->name, get_suite_name(item->suite->name));
+    write_memcheck_errors(report->junit, item, memcheck, memcheck_cnt, NULL);
+    fprintf(report->junit,
+            "    </testcase>\n");
+  }
+  fprintf(report->junit,
+          "  </testsuite>\n");
+  fflush(report->junit);
+  free(memcheck);
+  fclose(fd);
+}
+
+static long read_oom_kills(const cutest_work_opts_t* opts, int slot)
+{
+  const char* key = "oom_kill ";
+  char path[CGROUP_PATH_LEN];
+  char buf[256];
+  long kills = 0;
+  FILE* fd = NULL;
+
+  get_cgroup_path(path, opts, slot, "/memory.events");
+  if (NULL == (fd = fopen(path, "r"))) {
+    return 0;
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    if (0 == strncmp(buf, key, strlen(key))) {
+      kills = strtol(&buf[strlen(key)], NULL, 10);
+      break;
+    }
+  }
+  fclose(fd);
+  return kills;
+}
+
+static int get_exceeded_limit(char* buf, const cutest_work_opts_t* opts,
+                              int slot, int status)
+{
+  /*
+   * Tell which limit a runner was killed for, if any. Only the memory
+   * limit of a cgroup can be told apart from an ordinary crash, since a
+   * runner that runs out of address space just fails its allocations.
+   */
+  if ((NULL != opts->cgroup) && (0 != opts->limit_memory) &&
+      (0 < read_oom_kills(opts, slot))) {
+    sprintf(buf, "memory limit of %ld MB", opts->limit_memory);
+    return 1;
+  }
+  if ((0 != opts->limit_cpu) && WIFSIGNALED(status) &&
+      (SIGXCPU == WTERMSIG(status))) {
+    sprintf(buf, "CPU time limit of %ld s", opts->limit_cpu);
+    return 1;
+  }
+  return 0;
+}
+
+static void report_killed_suite(cutest_work_report_t* report,
+                                const cutest_work_item_t* item,
+                                const cutest_work_opts_t* opts, int worker,
+                                int status)
+{
+  /*
+   * A runner that was killed did not write any report of its own, so
+   * it is counted as one error in the merged report.
+   */
+  char limit[LIMIT_NAME_LEN];
+  char message[LIMIT_NAME_LEN + 32];
+
+  if (1 == get_exceeded_limit(limit, opts, worker, status)) {
+    sprintf(message, "killed for exceeding the %s", limit);
+  }
+  else if (WIFSIGNALED(status)) {
+    sprintf(message, "killed by signal %d", WTERMSIG(status));
+  }
+  else {
+    return; /* The runner reports its own failures */
+  }
+  fprintf(stderr, "ERROR: '%s' was %s\n", item->suite->name, message);
+
+  report->tests++;
+  report->errors++;
+  if (NULL == report->junit) {
+    return;
+  }
+  fprintf(report->junit,
+          "  <testsuite name=\"%s\"\n"
+          "             errors=\"1\"\n"
+          "             tests=\"1\"\n"
+          "             failures=\"0\"\n"
+          "             skipped=\"0\">\n"
+          "    <properties>\n"
+          "      <property name=\"worker\" value=\"%d\"/>\n"
+          "    </properties>\n"
+          "    <testcase classname=\"%s\" name=\"%s\">\n"
+          "       <error message=\"%s\"/>\n"
+          "    </testcase>\n"
+          "  </testsuite>\n",
+          get_suite_name(item->suite->name), worker, item->suite->name,
+          get_suite_name(item->suite->name), message);
+  fflush(report->junit);
+}
+
+static void close_report(cutest_work_report_t* report, int workers)
+{
+  if (NULL != report->junit) {
+    fprintf(report->junit,
+            "</testsuites>\n");
+    fclose(report->junit);
+    report->junit = NULL;
+  }
+  printf("Total: %d passed, %d failed, %d errors, %d skipped, %d flaky "
+         "in %.2f s on %d workers\n",
+         report->tests - report->failures - report->errors - report->skipped,
+         report->failures, report->errors, report->skipped, report->flaky,
+         get_time() - report->started, workers);
+}
+
+static int open_trace(cutest_work_trace_t* trace, const char* file_name)
+{
+  trace->fd = NULL;
+  trace->started = get_time();
+  trace->last_worker = 0;
+
+  if (NULL == file_name) {
+    return 0;
+  }
+  if (NULL == (trace->fd = fopen(file_name, "w"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", file_name);
+    return -1;
+  }
+  /* Every event after this one is written with a leading comma */
+  fprintf(trace->fd,
+          "{\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"cutest_work\"}}");
+  return 0;
+}
+
+static double get_trace_time(const cutest_work_trace_t* trace, double time)
+{
+  /* Microseconds since the start of the run */
+  return (time - trace->started) * 1000000.0;
+}
+
+static void trace_workers(cutest_work_trace_t* trace, int running,
+                          int queued)
+{
+  if (NULL == trace->fd) {
+    return;
+  }
+  fprintf(trace->fd,
+          ",\n{\"name\":\"workers\",\"ph\":\"C\",\"ts\":%.0f,\"pid\":1,"
+          "\"args\":{\"running\":%d,\"queued\":%d}}",
+          get_trace_time(trace, get_time()), running, queued);
+}
+
+static void trace_tests(cutest_work_trace_t* trace, FILE* fd, int worker,
+                        double ts)
+{
+  /*
+   * The runners only report how long every test took, so the tests are
+   * laid out back to back from the start of the runner.
+   */
+  char buf[1024];
+
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    const char* name = NULL;
+    const char* time = NULL;
+    double dur = 0.0;
+
+    if ((!is_report_line(buf, "    <testcase ")) ||
+        (NULL == (name = strstr(buf, " name=\""))) ||
+        (NULL == (time = strstr(buf, " time=\"")))) {
+      continue;
+    }
+    name += strlen(" name=\"");
+    dur = strtod(time + strlen(" time=\""), NULL) * 1000000.0;
+    fprintf(trace->fd,
+            ",\n{\"name\":\"%.*s\",\"cat\":\"test\",\"ph\":\"X\","
+            "\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,\"tid\":%d}",
+            (int)strcspn(name, "\""), name, ts, dur, worker);
+    ts += dur;
+  }
+}
+
+static void add_to_trace(cutest_work_trace_t* trace,
+                         const cutest_work_item_t* item, int worker,
+                         double started, double elapsed, int status)
+{
+  const double ts = get_trace_time(trace, started);
+  char batch_name[BATCH_NAME_LEN];
+  FILE* fd = NULL;
+
+  if (NULL == trace->fd) {
+    return;
+  }
+  trace->last_worker = worker;
+
+  /* Everything is queued from the start, so ts is the queue wait */
+  format_batch_name(batch_name, item);
+  fprintf(trace->fd,
+          ",\n{\"name\":\"%s\",\"cat\":\"suite\",\"ph\":\"X\","
+          "\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,\"tid\":%d,"
+          "\"args\":{\"status\":%d,\"queue_wait_us\":%.0f,"
+          "\"batch\":\"%s\"}}",
+          get_suite_name(item->suite->name), ts, elapsed * 1000000.0, worker,
+          status, ts, (-1 == item->batch) ? "" : batch_name);
+
+  if (NULL != (fd = open_junit_report(item))) {
+    trace_tests(trace, fd, worker, ts);
+    fclose(fd);
+  }
+}
+
+static void close_trace(cutest_work_trace_t* trace, int workers)
+{
+  int worker;
+
+  if (NULL == trace->fd) {
+    return;
+  }
+  for (worker = 0; worker < workers; worker++) {
+    fprintf(trace->fd,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%d,\"args\":{\"name\":\"worker %d%s\"}}",
+            worker, worker,
+            (worker == trace->last_worker) ? " (critical path)" : "");
+  }
+  fprintf(trace->fd,
+          "\n]}\n");
+  fclose(trace->fd);
+  trace->fd = NULL;
+}
+
+static int get_progress_mode(const cutest_work_opts_t* opts, int workers)
+{
+  /*
+   * The verdicts of several runners on one line do not tell much, so they
+   * are summed up in a live display on a terminal, or per runner in logs.
+   */
+  if (-1 != opts->verbose) {
+    return CUTEST_WORK_PROGRESS_NONE;
+  }
+  if (1 == isatty(STDOUT_FILENO)) {
+    return CUTEST_WORK_PROGRESS_LIVE;
+  }
+  if (workers > 1) {
+    return CUTEST_WORK_PROGRESS_LINES;
+  }
+  return CUTEST_WORK_PROGRESS_NONE;
+}
+
+static double get_test_weight(const cutest_work_suite_t* suite)
+{
+  /* The expected duration of one test in the suite, or 0.0 if unknown */
+  if (0 == suite->duration_tests) {
+    return 0.0;
+  }
+  return suite->duration / suite->duration_tests;
+}
+
+static void open_progress(cutest_work_progress_t* progress, int mode,
+                          const cutest_work_queue_t* queue)
+{
+  /*
+   * The ETA is based on the history when all the test suites are in it,
+   * otherwise every test is expected to take as long.
+   */
+  int known = 1;
+  int i;
+
+  memset(progress, 0, sizeof(*progress));
+  progress->mode = mode;
+  progress->started = get_time();
+  for (i = 0; i < queue->cnt; i++) {
+    const cutest_work_item_t* item = &queue->item[i];
+
+    progress->tests += get_item_test_cnt(item);
+    progress->expected +=
+      get_test_weight(item->suite) * get_item_test_cnt(item);
+    known = known && (0 != item->suite->duration_tests);
+  }
+  if (0 == known) {
+    progress->expected = 0.0;
+  }
+}
+
+static int read_verdicts(cutest_work_progress_t* progress,
+                         cutest_work_pool_t* pool,
+                         const cutest_work_queue_t* queue, int slot)
+{
+  /*
+   * Count the verdicts the runner in the slot has printed so far. Returns
+   * 1 when the runner has closed its output, 0 otherwise.
+   */
+  const cutest_work_suite_t* suite = queue->item[pool->item[slot]].suite;
+  char buf[256];
+  ssize_t len = 0;
+  ssize_t i;
+
+  if (-1 == pool->out[slot]) {
+    return 1;
+  }
+  while (0 < (len = read(pool->out[slot], buf, sizeof(buf)))) {
+    for (i = 0; i < len; i++) {
+      if (NULL == strchr(".fSEF", buf[i])) {
+        continue;
+      }
+      pool->done[slot]++;
+      progress->done++;
+      progress->expected_done += get_test_weight(suite);
+      if (('E' == buf[i]) || ('F' == buf[i])) {
+        pool->failed[slot]++;
+        progress->failed++;
+      }
+    }
+  }
+  if (0 == len) {
+    close_output(pool, slot);
+    return 1;
+  }
+  return 0;
+}
+
+static void format_duration(char* buf, double seconds)
+{
+  const long s = (long)(seconds + 0.5);
+
+  sprintf(buf, "%ld:%02ld", s / 60, s % 60);
+}
+
+static void get_eta(char* buf, const cutest_work_progress_t* progress,
+                    double elapsed)
+{
+  double remaining = 0.0;
+
+  if (0.0 != progress->expected) {
+    if (0.0 == progress->expected_done) {
+      strcpy(buf, "-:--");
+      return;
+    }
+    remaining = elapsed * (progress->expected - progress->expected_done) /
+      progress->expected_done;
+  }
+  else if (0 != progress->done) {
+    remaining = elapsed * (progress->tests - progress->done) / progress->done;
+  }
+  else {
+    strcpy(buf, "-:--");
+    return;
+  }
+  format_duration(buf, (remaining < 0.0) ? 0.0 : remaining);
+}
+
+static void print_progress_line(const char* line)
+{
+  /* Erase what was drawn on the line before, and do not wrap */
+  printf("\033[K%.*s\n", PROGRESS_WIDTH, line);
+}
+
+static void clear_progress(cutest_work_progress_t* progress)
+{
+  if (0 == progress->lines) {
+    return;
+  }
+  printf("\033[%dA\033[J", progress->lines);
+  fflush(stdout);
+  progress->lines = 0;
+}
+
+static void draw_progress(cutest_work_progress_t* progress,
+                          const cutest_work_pool_t* pool,
+                          const cutest_work_queue_t* queue)
+{
+  /* A line per worker with what it runs, and one with the totals */
+  const double elapsed = get_time() - progress->started;
+  char batch_name[BATCH_NAME_LEN];
+  char line[1024];
+  char spent[32];
+  char eta[32];
+  int slot;
+
+  if (0 != progress->lines) {
+    printf("\033[%dA", progress->lines);
+  }
+  for (slot = 0; slot < pool->workers; slot++) {
+    const cutest_work_item_t* item = &queue->item[pool->item[slot]];
+    const int test = item->first_test + pool->done[slot];
+
+    if (0 == pool->pid[slot]) {
+      sprintf(line, "worker %d: -", slot);
+    }
+    else {
+      format_batch_name(batch_name, item);
+      sprintf(line, "worker %d: %.200s%s%s %.200s", slot,
+              get_suite_name(item->suite->name),
+              (-1 == item->batch) ? "" : ".",
+              (-1 == item->batch) ? "" : batch_name,
+              ((0 != item->suite->test_cnt) &&
+               (pool->done[slot] < get_item_test_cnt(item))) ?
+              item->suite->test[test] : "");
+    }
+    print_progress_line(line);
+  }
+  format_duration(spent, elapsed);
+  get_eta(eta, progress, elapsed);
+  sprintf(line, "%d/%d tests, %d failed, %s elapsed, ETA %s",
+          progress->done, progress->tests, progress->failed, spent, eta);
+  print_progress_line(line);
+  fflush(stdout);
+  progress->lines = pool->workers + 1;
+}
+
+static void watch_test_suites(cutest_work_progress_t* progress,
+                              cutest_work_pool_t* pool,
+                              const cutest_work_queue_t* queue, int throttled)
+{
+  /*
+   * Read the verdicts of the runners and keep the display up to date
+   * until one of them is done. A throttled run only waits for a second,
+   * since the host might calm down before that.
+   */
+  const double until = get_time() + 1.0;
+  struct pollfd* fd = malloc(pool->workers * sizeof(struct pollfd));
+  int done = 0;
+
+  if (NULL == fd) {
+    fprintf(stderr, "ERROR: Out of memory while reading the runners\n");
+    return;
+  }
+  while (0 == done) {
+    int cnt = 0;
+    int slot;
+
+    for (slot = 0; slot < pool->workers; slot++) {
+      if (-1 != pool->out[slot]) {
+        fd[cnt].fd = pool->out[slot];
+        fd[cnt].events = POLLIN;
+        fd[cnt].revents = 0;
+        cnt++;
+      }
+    }
+    /* Without any output left the runners are about to be reaped */
+    poll(fd, cnt, PROGRESS_INTERVAL_MS);
+    done = (0 == cnt) || ((1 == throttled) && (get_time() > until));
+    for (slot = 0; slot < pool->workers; slot++) {
+      if ((0 != pool->pid[slot]) && (1 == read_verdicts(progress, pool,
+                                                        queue, slot))) {
+        done = 1;
+      }
+    }
+    if (CUTEST_WORK_PROGRESS_LIVE == progress->mode) {
+      draw_progress(progress, pool, queue);
+    }
+  }
+  free(fd);
+}
+
+static void print_verdict_line(const cutest_work_item_t* item, int status,
+                               int tests, int failed, double elapsed)
+{
+  char batch_name[BATCH_NAME_LEN];
+
+  format_batch_name(batch_name, item);
+  printf("[%s]: %s%s%s %d tests, %d failed in %.2f s\n",
+         (0 == status) ? "PASS" : "FAIL", get_suite_name(item->suite->name),
+         (-1 == item->batch) ? "" : ".",
+         (-1 == item->batch) ? "" : batch_name, tests, failed, elapsed);
+  fflush(stdout);
+}
+
+static void finish_progress(cutest_work_progress_t* progress,
+                            cutest_work_pool_t* pool,
+                            const cutest_work_queue_t* queue, int slot,
+                            int status, double elapsed)
+{
+  /*
+   * Count what is left of the verdicts of a finished runner. The display
+   * is taken down, since other messages may follow, and redrawn later.
+   */
+  const cutest_work_item_t* item = &queue->item[pool->item[slot]];
+
+  if (NULL == pool->out) {
+    return;
+  }
+  read_verdicts(progress, pool, queue, slot);
+  close_output(pool, slot);
+  if (CUTEST_WORK_PROGRESS_LIVE == progress->mode) {
+    clear_progress(progress);
+    return;
+  }
+  if (0 == item->grouped) {
+    print_verdict_line(item, status, pool->done[slot], pool->failed[slot],
+                       elapsed);
+  }
+}
+
+static int count_failed_tests(const cutest_work_item_t* item, int* tests)
+{
+  /*
+   * The tests in the JUnit report of a test suite, and how many of them
+   * did not pass. Returns -1 if the test suite did not write a report.
+   */
+  FILE* fd = open_junit_report(item);
+  char buf[1024];
+  int failed = 0;
+
+  *tests = 0;
+  if (NULL == fd) {
+    return -1;
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    *tests += is_report_line(buf, "    <testcase ");
+    failed += is_report_line(buf, "       <failure ");
+    failed += is_report_line(buf, "       <error ");
+  }
+  fclose(fd);
+  return failed;
+}
+
+static int finish_unity_group(cutest_work_pool_t* pool,
+                              const cutest_work_queue_t* queue, int slot,
+                              int status, const cutest_work_opts_t* opts,
+                              cutest_work_report_t* report,
+                              cutest_work_trace_t* trace,
+                              cutest_work_progress_t* progress)
+{
+  /*
+   * The unity runner ran the test suites of the group one after the
+   * other, and each of them wrote a report of its own, so they are
+   * reported one by one. They share the time of the runner by their
+   * number of tests. A runner that was killed died in the first test
+   * suite without a report, or in the last one. Returns the index of the
+   * first test suite that did not pass, or -1 if they all passed.
+   */
+  cutest_work_item_t* item = &queue->item[pool->item[slot]];
+  const double elapsed = get_time() - pool->started[slot];
+  double started = pool->started[slot];
+  int first_failed = -1;
+  int died = !WIFSIGNALED(status); /* Or the one it died in is found */
+  int total = 0;
+  int tests = 0;
+  int i;
+
+  finish_progress(progress, pool, queue, slot, status, elapsed);
+  for (i = 0; i <= item->grouped; i++) {
+    count_failed_tests(&item[i], &tests);
+    total += tests;
+  }
+  for (i = 0; i <= item->grouped; i++) {
+    const int failed = count_failed_tests(&item[i], &tests);
+    const double share = (0 == total) ? elapsed / (item->grouped + 1) :
+      elapsed * tests / total;
+    int suite_status = (0 == failed) ? 0 : EXIT_FAILURE;
+    int killed = 0;
+
+    if ((0 == died) && ((-1 == failed) || (i == item->grouped))) {
+      killed = died = 1;
+      suite_status = status;
+    }
+    else if ((i == item->grouped) && (-1 == first_failed) && (0 != status)) {
+      suite_status = status; /* The runner failed after the last report */
+    }
+    item[i].suite->elapsed += share;
+    item[i].suite->elapsed_tests += tests;
+    if ((NULL != pool->out) &&
+        (CUTEST_WORK_PROGRESS_LIVE != progress->mode)) {
+      print_verdict_line(&item[i], suite_status, tests, (0 > failed) ? 0 :
+                         failed, share);
+    }
+    add_to_report(report, &item[i], slot, share);
+    add_to_trace(trace, &item[i], slot, started, share, suite_status);
+    started += share;
+    if (0 == suite_status) {
+      continue;
+    }
+    item[i].suite->failed = 1;
+    if (1 == killed) {
+      report_killed_suite(report, &item[i], opts, slot, status);
+    }
+    if (-1 == first_failed) {
+      first_failed = pool->item[slot] + i;
+    }
+  }
+  return first_failed;
+}
+
+static int run_test_suites(cutest_work_pool_t* pool,
+                           const cutest_work_queue_t* queue,
+                           const cutest_work_opts_t* opts, int cores,
+                           cutest_work_report_t* report,
+                           cutest_work_trace_t* trace,
+                           cutest_work_progress_t* progress)
+{
+  int item_idx = 0;
+  int retval = 0;
+
+  while ((item_idx < queue->cnt) || (pool->running > 0)) {
+    const int limit = get_worker_limit(opts, pool, cores);
+    double elapsed = 0.0;
+    int throttled = 0;
+    int status = 0;
+    int failed = -1;
+    int slot = 0;
+
+    while ((item_idx < queue->cnt) && (pool->running < limit)) {
+      if (0 > launch_test_suite(pool, queue, item_idx, opts)) {
+        retval = -1;
+        item_idx = queue->cnt;
+        break;
+      }
+      item_idx += 1 + queue->item[item_idx].grouped;
+    }
+
+    trace_workers(trace, pool->running, queue->cnt - item_idx);
+    if (0 == pool->running) {
+      continue;
+    }
+
+    /*
+     * A throttled run must not block until a test suite finish, since
+     * the host might calm down before that.
+     */
+    throttled = ((item_idx < queue->cnt) && (limit < pool->workers));
+    if (0 > (slot = wait_for_test_suite(pool, &status,
+                                        !throttled && (NULL == pool->out)))) {
+      if (NULL != pool->out) {
+        watch_test_suites(progress, pool, queue, throttled);
+      }
+      else if (1 == throttled) {
+        sleep(1);
+      }
+      continue;
+    }
+    if (0 != queue->item[pool->item[slot]].grouped) {
+      failed = finish_unity_group(pool, queue, slot, status, opts, report,
+                                  trace, progress);
+    }
+    else {
+      elapsed = record_duration(pool, queue, slot);
+      finish_progress(progress, pool, queue, slot, status, elapsed);
+      add_to_report(report, &queue->item[pool->item[slot]], slot, elapsed);
+      add_to_trace(trace, &queue->item[pool->item[slot]], slot,
+                   pool->started[slot], elapsed, status);
+      if (0 != status) {
+        failed = pool->item[slot];
+        queue->item[failed].suite->failed = 1;
+        report_killed_suite(report, &queue->item[failed], opts, slot, status);
+      }
+    }
+    trace_workers(trace, pool->running, queue->cnt - item_idx);
+    if (-1 == failed) {
+      continue;
+    }
+    if ((1 == opts->fail_fast) && (0 == retval)) {
+      print_log(&queue->item[failed]);
+      stop_test_suites(pool);
+      item_idx = queue->cnt;
+    }
+    if (-1 != retval) {
+      retval = 1;
+    }
+  }
+
+  return retval;
+}
+
+static void print_log(const cutest_work_item_t* item)
+{
+  /* Room for the suite name, a batch name and the .log suffix */
+  const size_t log_name_len =
+    strlen(item->suite->name) + BATCH_NAME_LEN + strlen("..log") + 1;
+  char* log_name = malloc(log_name_len);
+  char batch_name[BATCH_NAME_LEN];
+  FILE *fd = NULL;
+  char buf[1024];
+
+  if (NULL == log_name) {
+    fprintf(stderr, "ERROR: Out of memory while allocating log file name\n");
+    return;
+  }
+  if (-1 == item->batch) {
+    sprintf(log_name, "%s.log", item->suite->name);
+  }
+  else {
+    format_batch_name(batch_name, item);
+    sprintf(log_name, "%s.%s.log", item->suite->name, batch_name);
+  }
+
+  fd = fopen(log_name, "r");
+  if (NULL == fd) {
+    free(log_name);
+    return;
+  }
+  while (NULL != fgets(buf, sizeof(buf), fd)) {
+    buf[strlen(buf)] = 0;
+    fputs(buf, stderr);
+  }
+  fclose(fd);
+  unlink(log_name);
+  free(log_name);
+}
+
+static void print_logs(const cutest_work_queue_t* queue)
+{
+  int item_idx = 0;
+
+  while (item_idx < queue->cnt) {
+    print_log(&queue->item[item_idx]);
+    item_idx++;
+  }
+}
+
+static void free_args(char** args)
+{
+  int i = 0;
+
+  while (NULL != args[i]) {
+    free(args[i++]);
+  }
+  free(args);
+}
+
+static int add_arg(char** args, int* cnt, const char* arg)
+{
+  if (NULL == (args[*cnt] = malloc(strlen(arg) + 1))) {
+    fprintf(stderr, "ERROR: Out of memory while reading a request\n");
+    return -1;
+  }
+  strcpy(args[(*cnt)++], arg);
+  return 0;
+}
+
+static char** read_run_request(FILE* in, char* runner)
+{
+  /*
+   * Returns the arguments of the requested runner, with the runner in its
+   * place in the cache, or NULL when the coordinator is done.
+   */
+  char line[MESSAGE_LEN];
+  char hash[NET_HASH_LEN];
+  char** args = NULL;
+  char* end = NULL;
+  long argc = 0;
+  int has_runner = 0;
+  int cnt = 0;
+  int i;
+
+  if (NULL == fgets(line, sizeof(line), in)) {
+    return NULL;
+  }
+  if ((0 != strncmp("RUN ", line, 4)) ||
+      (NET_HASH_LEN - 1 != strspn(&line[4], "0123456789abcdef")) ||
+      (' ' != line[4 + NET_HASH_LEN - 1])) {
+    fprintf(stderr, "ERROR: Unexpected request from the coordinator\n");
+    return NULL;
+  }
+  memcpy(hash, &line[4], NET_HASH_LEN - 1);
+  hash[NET_HASH_LEN - 1] = '\0';
+  sprintf(runner, "../%s", hash);
+
+  argc = strtol(&line[4 + NET_HASH_LEN], &end, 10);
+  if ((argc < 1) || (argc > MAX_SUITE_ARGS + MAX_TESTS_PER_BATCH)) {
+    fprintf(stderr, "ERROR: Unexpected request from the coordinator\n");
+    return NULL;
+  }
+  /* Room for the output directory of the runner */
+  if (NULL == (args = calloc(argc + 3, sizeof(char*)))) {
+    fprintf(stderr, "ERROR: Out of memory while reading a request\n");
+    return NULL;
+  }
+  for (i = 0; i < argc; i++) {
+    int retval = 0;
+
+    if (NULL == fgets(line, sizeof(line), in)) {
+      free_args(args);
+      return NULL;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    if (0 == strncmp("--xml-file=", line, strlen("--xml-file="))) {
+      /* Valgrind writes its errors in the scratch directory too */
+      const char* base = strrchr(line, '/');
+      if (NULL != base) {
+        memmove(&line[strlen("--xml-file=")], base + 1, strlen(base));
+      }
+    }
+    if ((0 != strcmp(RUNNER_ARG, line)) || (1 == has_runner)) {
+      retval = add_arg(args, &cnt, line);
+    }
+    else {
+      /*
+       * The runner writes its log and JUnit report next to its source,
+       * which is a path on the coordinator.
+       */
+      has_runner = 1;
+      retval = ((0 != add_arg(args, &cnt, runner)) ||
+                (0 != add_arg(args, &cnt, "--output-dir")) ||
+                (0 != add_arg(args, &cnt, ".")));
+    }
+    if (0 != retval) {
+      free_args(args);
+      return NULL;
+    }
+  }
+  return args;
+}
+
+static int fetch_runner(FILE* in, FILE* out, const char* runner)
+{
+  /*
+   * Runners are kept by the hash of their content, so a rebuilt runner is
+   * fetched again. Other workers may fetch the same runner, so it is
+   * written to a file of its own and renamed in place.
+   */
+  char line[MESSAGE_LEN];
+  char tmp_name[RUNNER_PATH_LEN + 32];
+  FILE* fd = NULL;
+  int retval = 0;
+
+  if (0 == access(runner, X_OK)) {
+    return 0;
+  }
+  fputs("NEED\n", out);
+  fflush(out);
+  if ((NULL == fgets(line, sizeof(line), in)) ||
+      (0 != strncmp("BLOB ", line, 5))) {
+    return -1;
+  }
+  sprintf(tmp_name, "%s.%d", runner, (int)getpid());
+  if (NULL == (fd = fopen(tmp_name, "wb"))) {
+    fprintf(stderr, "ERROR: Could not open '%s' for writing\n", tmp_name);
+    return -1;
+  }
+  retval = copy_bytes(in, fd, strtol(&line[5], NULL, 10));
+  if (0 != fclose(fd)) {
+    retval = -1;
+  }
+  if ((0 == retval) &&
+      ((0 != chmod(tmp_name, 0755)) || (0 != rename(tmp_name, runner)))) {
+    retval = -1;
+  }
+  if (0 != retval) {
+    unlink(tmp_name);
+  }
+  return retval;
+}
+
+static int run_runner(char* args[], const cutest_work_opts_t* opts, int slot)
+{
+  /* Returns the wait status of the runner, or -1 if it did not start */
+  int status = 0;
+  pid_t pid = 0;
+
+  if (0 != prepare_cgroup(opts, slot)) {
+    return -1;
+  }
+  if (0 > (pid = fork())) {
+    fprintf(stderr, "ERROR: Failed to fork\n");
+    return -1;
+  }
+  else if (0 == pid) {
+    if ((NULL == freopen(OUTPUT_NAME, "w", stdout)) ||
+        (0 > dup2(STDOUT_FILENO, STDERR_FILENO))) {
+      _exit(EXIT_FAILURE);
+    }
+    if (0 != apply_limits(opts, slot)) {
+      fprintf(stderr, "ERROR: Unable to limit the resources of '%s'\n",
+              args[0]);
+      _exit(EXIT_FAILURE);
+    }
+    execvp(args[0], args);
+    fprintf(stderr, "ERROR: Unable to execute '%s'\n", args[0]);
+    _exit(EXIT_FAILURE);
+  }
+  if (pid != waitpid(pid, &status, 0)) {
+    return -1;
+  }
+  return status;
+}
+
+static void send_results(FILE* out, int status)
+{
+  /*
+   * The output of the runner, every file it wrote in the scratch
+   * directory and then how it ended.
+   */
+  char header[MESSAGE_LEN];
+  struct dirent* entry = NULL;
+  DIR* dir = NULL;
+
+  if (0 == send_file(out, "OUTPUT", OUTPUT_NAME)) {
+    unlink(OUTPUT_NAME);
+  }
+  if (NULL != (dir = opendir("."))) {
+    while (NULL != (entry = readdir(dir))) {
+      if (!is_safe_file_name(entry->d_name)) {
+        continue;
+      }
+      sprintf(header, "FILE %s", entry->d_name);
+      send_file(out, header, entry->d_name);
+      unlink(entry->d_name);
+    }
+    closedir(dir);
+  }
+  if (-1 == status) {
+    fprintf(out, "DONE %d 0\n", EXIT_FAILURE);
+  }
+  else {
+    fprintf(out, "DONE %d %d\n",
+            WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE,
+            WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+  }
+  fflush(out);
+}
+
+static int serve_coordinator(const cutest_work_opts_t* opts,
+                             const char* cache, int slot, int workers)
+{
+  /*
+   * One worker of an agent, with a connection of its own. The runners
+   * are run in a scratch directory inside the cache, so that the files
+   * they write are easy to find and send back.
+   */
+  const int fd = net_connect(opts->coordinator);
+  char work_dir[CGROUP_PATH_LEN];
+  char runner[RUNNER_PATH_LEN];
+  FILE* in = NULL;
+  FILE* out = NULL;
+  char** args = NULL;
+  int retval = -1;
+
+  if (0 > fd) {
+    return -1;
+  }
+  if (strlen(cache) + 64 > sizeof(work_dir)) {
+    fprintf(stderr, "ERROR: The cache path '%s' is too long\n", cache);
+    goto cleanup;
+  }
+  sprintf(work_dir, "%s/work%d.%d", cache, slot, (int)getpid());
+  if ((0 != mkdir(work_dir, 0755)) || (0 != chdir(work_dir))) {
+    fprintf(stderr, "ERROR: Could not use '%s' as scratch directory\n",
+            work_dir);
+    goto cleanup;
+  }
+  if ((NULL == (in = fdopen(dup(fd), "r"))) ||
+      (NULL == (out = fdopen(dup(fd), "w")))) {
+    fprintf(stderr, "ERROR: Could not talk to the coordinator\n");
+    goto cleanup;
+  }
+  fprintf(out, "HELLO %d %d\n", slot, workers);
+  fflush(out);
+
+  retval = 0;
+  while (NULL != (args = read_run_request(in, runner))) {
+    if (0 != fetch_runner(in, out, runner)) {
+      fprintf(stderr, "ERROR: Could not fetch the test suite runner '%s'\n",
+              runner);
+      free_args(args);
+      retval = -1;
+      break;
+    }
+    send_results(out, run_runner(args, opts, slot));
+    free_args(args);
+  }
+
+ cleanup:
+  if (NULL != in) {
+    fclose(in);
+  }
+  if (NULL != out) {
+    fclose(out);
+  }
+  if (0 == chdir("..")) {
+    rmdir(&work_dir[strlen(cache) + 1]);
+  }
+  close(fd);
+  return retval;
+}
+
+static int run_agent(const cutest_work_opts_t* opts, int cores)
+{
+  const int workers = get_number_of_workers(opts, cores);
+  const char* cache = (NULL != opts->cache) ? opts->cache : DEFAULT_CACHE;
+  int retval = 0;
+  int status = 0;
+  int slot;
+
+  if ((0 != mkdir(cache, 0755)) && (0 != access(cache, W_OK))) {
+    fprintf(stderr, "ERROR: Could not create the cache '%s'\n", cache);
+    return -1;
+  }
+  if (0 != setup_cgroups(opts)) {
+    return -1;
+  }
+  for (slot = 0; slot < workers; slot++) {
+    const pid_t pid = fork();
+    if (0 > pid) {
+      fprintf(stderr, "ERROR: Failed to fork\n");
+      retval = -1;
+      break;
+    }
+    else if (0 == pid) {
+      _exit((0 == serve_coordinator(opts, cache, slot, workers)) ?
+            EXIT_SUCCESS : EXIT_FAILURE);
+    }
+  }
+  while (0 < wait(&status)) {
+    if (!WIFEXITED(status) || (EXIT_SUCCESS != WEXITSTATUS(status))) {
+      retval = -1;
+    }
+  }
+  remove_cgroups(opts, workers);
+  return retval;
+}
+
+static int find_changed_suite(const char* file_name, int argc, char* argv[],
+                              int first_suite)
+{
+  /*
+   * The test suite that is built from a changed file, where foo.c, foo.h
+   * and foo_test.c all belong to foo_test. Returns its index in argv, or
+   * -1 if the file does not belong to any of the test suites.
+   */
+  const char* ext = strrchr(file_name, '.');
+  size_t len = 0;
+  int i;
+
+  if ((NULL == ext) || ((0 != strcmp(".c", ext)) && (0 != strcmp(".h", ext)))) {
+    return -1;
+  }
+  len = ext - file_name;
+  if ((len > strlen("_test")) &&
+      (0 == strncmp("_test", ext - strlen("_test"), strlen("_test")))) {
+    len -= strlen("_test");
+  }
+  for (i = first_suite; i < argc; i++) {
+    const char* name = get_suite_name(argv[i]);
+
+    if ((0 == strncmp(name, file_name, len)) &&
+        (0 == strcmp("_test", &name[len]))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int mark_changed_suites(int* changed, const char* buf, ssize_t len,
+                               int argc, char* argv[], int first_suite)
+{
+  /* Returns how many more test suites the inotify events in buf changed */
+  struct inotify_event event;
+  ssize_t pos = 0;
+  int cnt = 0;
+
+  while (pos + (ssize_t)sizeof(event) <= len) {
+    memcpy(&event, &buf[pos], sizeof(event));
+    if (0 != event.len) {
+      const int i = find_changed_suite(&buf[pos + sizeof(event)], argc, argv,
+                                       first_suite);
+      if ((-1 != i) && (0 == changed[i])) {
+        changed[i] = 1;
+        cnt++;
+      }
+    }
+    pos += sizeof(event) + event.len;
+  }
+  return cnt;
+}
+
+static int rerun_test_suite(const cutest_work_opts_t* opts, const char* name)
+{
+  /*
+   * Rebuild the runner of a changed test suite and run all of it right
+   * away. Returns the wait status of the runner, or -1 if it was not run.
+   */
+  cutest_work_suite_t suite = {NULL};
+  cutest_work_item_t item = {&suite, -1, 0, 0, 0, 0};
+  char* command = NULL;
+  int status = 0;
+  pid_t pid = 0;
+
+  suite.name = name;
+  if (NULL != opts->rebuild) {
+    if (NULL == (command = malloc(strlen(opts->rebuild) + strlen(name) + 2))) {
+      fprintf(stderr, "ERROR: Out of memory while rebuilding '%s'\n", name);
+      return -1;
+    }
+    sprintf(command, "%s %s", opts->rebuild, name);
+    status = system(command);
+    free(command);
+    if (0 != status) {
+      fprintf(stderr, "ERROR: Could not rebuild '%s'\n", name);
+      return -1;
+    }
+  }
+  if ((0 != prepare_cgroup(opts, 0)) ||
+      (0 > (pid = spawn_test_suite(&item, opts, 0, 0, 0, -1))) ||
+      (pid != waitpid(pid, &status, 0))) {
+    return -1;
+  }
+  if (-1 == opts->verbose) {
+    puts("");
+  }
+  return status;
+}
+
+static int watch_sources(const cutest_work_opts_t* opts, int argc,
+                         char* argv[])
+{
+  /*
+   * Rerun the test suites whose sources or tests change until stopped.
+   * The tests are in the source directory, unless told otherwise, since
+   * the runners may be built somewhere else.
+   */
+  char buf[sizeof(struct inotify_event) + WATCH_PATH_LEN];
+  const char* test_dir = (NULL != opts->watch_tests) ? opts->watch_tests :
+    opts->watch;
+  struct pollfd fd;
+  int* changed = NULL;
+  ssize_t len = 0;
+  int i;
+
+  fd.fd = inotify_init();
+  fd.events = POLLIN;
+  if ((0 > fd.fd) || (0 > inotify_add_watch(fd.fd, opts->watch, WATCH_EVENTS)) ||
+      (0 > inotify_add_watch(fd.fd, test_dir, WATCH_EVENTS))) {
+    fprintf(stderr, "ERROR: Could not watch '%s' and '%s' for changes\n",
+            opts->watch, test_dir);
+    if (0 <= fd.fd) {
+      close(fd.fd);
+    }
+    return -1;
+  }
+  if ((NULL == (changed = calloc(argc, sizeof(int)))) ||
+      (0 != setup_cgroups(opts))) {
+    fprintf(stderr, "ERROR: Unable to start watching for changes\n");
+    free(changed);
+    close(fd.fd);
+    return -1;
+  }
+
+  printf("Watching '%s' and '%s' for changes\n", opts->watch, test_dir);
+  fflush(stdout);
+  while (0 < (len = read(fd.fd, buf, sizeof(buf)))) {
+    int cnt = mark_changed_suites(changed, buf, len, argc, argv,
+                                  opts->first_suite);
+
+    while ((0 != cnt) && (0 < poll(&fd, 1, WATCH_QUIET_MS)) &&
+           (0 < (len = read(fd.fd, buf, sizeof(buf))))) {
+      cnt += mark_changed_suites(changed, buf, len, argc, argv,
+                                 opts->first_suite);
+    }
+    for (i = opts->first_suite; i < argc; i++) {
+      if (1 == changed[i]) {
+        changed[i] = 0;
+        rerun_test_suite(opts, argv[i]);
+      }
+    }
+  }
+
+  remove_cgroups(opts, 1);
+  free(changed);
+  close(fd.fd);
+  return -1; /* Only a failing read stops watching */
+}
+
+int main(int argc, char* argv[]) {
+  const int cores = get_number_of_cores();
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t* suites = NULL;
+  cutest_work_queue_t* queue = NULL;
+  cutest_work_pool_t* pool = NULL;
+  cutest_work_report_t report;
+  cutest_work_trace_t trace;
+  cutest_work_progress_t progress;
+  int* agent = NULL;
+  int agent_cnt = 0;
+  int suite_cnt = 0;
+  int workers = 0;
+  int runs = 0;
+  int local = 0;
+  int mode = CUTEST_WORK_PROGRESS_NONE;
+  int retval = -1;
+
+  handle_args(&opts, argc, argv);
+
+  if (NULL != opts.coordinator) {
+    return (0 == run_agent(&opts, cores)) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (NULL != opts.watch) {
+    return (0 == watch_sources(&opts, argc, argv)) ? EXIT_SUCCESS :
+      EXIT_FAILURE;
+  }
+
+  suite_cnt = argc - opts.first_suite;
+  local = get_number_of_workers(&opts, cores);
+  if ((NULL != opts.listen_address) &&
+      (NULL == (agent = accept_agents(&opts, &agent_cnt)))) {
+    return EXIT_FAILURE;
+  }
+  workers = local + agent_cnt;
+  mode = get_progress_mode(&opts, workers);
+
+  /*
+   * The tests are only listed when the suites may be split in batches,
+   * when their durations are recorded, when only the failed ones are run
+   * again, or when the live display shows the test being run.
+   */
+  suites = new_test_suites(&opts,
+                           ((workers > 1) && (NULL == opts.unity)) ||
+                           (0 != opts.tests_per_batch) ||
+                           (opts.shard_count > 1) || (NULL != opts.history) ||
+                           (1 == opts.rerun_failed) ||
+                           (CUTEST_WORK_PROGRESS_LIVE == mode),
+                           argc, argv);
+  if (NULL == suites) {
+    return EXIT_FAILURE;
+  }
+
+  read_history(opts.history, suites, suite_cnt);
+  if ((0 != shard_test_suites(&opts, suites, suite_cnt)) ||
+      ((1 == opts.rerun_failed) &&
+       (0 != keep_failed_tests(opts.junit, suites, suite_cnt))) ||
+      ((NULL != opts.changed_only) &&
+       (0 != skip_unchanged_suites(opts.changed_only, suites, suite_cnt))) ||
+      ((NULL != opts.results) &&
+       (0 != skip_cached_suites(&opts, suites, suite_cnt)))) {
+    goto cleanup;
+  }
+
+  queue = new_work_queue(suites, suite_cnt,
+                         ((NULL == opts.unity) || (0 != opts.tests_per_batch)) ?
+                         get_tests_per_batch(&opts, workers, suites,
+                                             suite_cnt) : 0,
+                         opts.shard_index);
+  if (NULL == queue) {
+    goto cleanup;
+  }
+
+  /*
+   * The unity runner does not split the test suites, but runs a few of
+   * them in every process. The agents and Valgrind get one at a time.
+   */
+  runs = queue->cnt;
+  if ((NULL != opts.unity) && (0 == agent_cnt) && (2 != opts.verbose)) {
+    runs = group_test_suites(queue, workers * BATCHES_PER_WORKER);
+  }
+  workers = min(workers, runs);
+  pool = new_worker_pool((0 == workers) ? 1 : workers);
+  if ((NULL == pool) || (0 != assign_agents(pool, agent, agent_cnt, local)) ||
+      ((CUTEST_WORK_PROGRESS_NONE != mode) && (0 != watch_worker_pool(pool)))) {
+    goto cleanup;
+  }
+
+  if ((0 != setup_cgroups(&opts)) || (0 != open_report(&report, opts.junit)) ||
+      (0 != open_trace(&trace, opts.trace))) {
+    goto cleanup;
+  }
+  report.memcheck = (2 == opts.verbose);
+  open_progress(&progress, mode, queue);
+
+  retval = run_test_suites(pool, queue, &opts, cores, &report, &trace,
+                           &progress);
+
+  if ((-1 == opts.verbose) && (CUTEST_WORK_PROGRESS_NONE == mode)) {
+    puts("");
+  }
+  if ((pool->workers > 1) || (NULL != pool->out)) {
+    print_logs(queue);
+  }
+  close_report(&report, pool->workers);
+  close_trace(&trace, pool->workers);
+  remove_cgroups(&opts, pool->workers);
+
+  /* Durations are not complete when stopped early, or only rerun */
+  if ((NULL != opts.history) && (-1 != retval) && (0 == opts.rerun_failed) &&
+      (NULL == opts.changed_only) && ((0 == retval) || (0 == opts.fail_fast))) {
+    write_history(&opts, suites, suite_cnt);
+  }
+  if ((NULL != opts.changed_only) && (-1 != retval) &&
+      ((0 == retval) || (0 == opts.fail_fast))) {
+    write_clean_suites(opts.changed_only, suites, suite_cnt);
+  }
+  if ((NULL != opts.results) && (-1 != retval) &&
+      ((0 == retval) || (0 == opts.fail_fast))) {
+    write_cached_suites(&opts, suites, suite_cnt);
+  }
+
+ cleanup:
+  if (NULL != pool) {
+    delete_worker_pool(pool);
+  }
+  if (NULL != queue) {
+    delete_work_queue(queue);
+  }
+  delete_test_suites(suites, suite_cnt);
+  close_agents(agent, agent_cnt);
+
+  if (0 != retval) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
 }
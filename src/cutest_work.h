@@ -0,0 +1,138 @@
+#ifndef _CUTEST_WORK_H_
+#define _CUTEST_WORK_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "net.h"
+
+/* What to run of a test suite in this shard */
+#define CUTEST_WORK_RUN_ALL 0
+#define CUTEST_WORK_RUN_SOME 1
+#define CUTEST_WORK_RUN_NONE 2
+
+/* How the progress of a run is shown */
+#define CUTEST_WORK_PROGRESS_NONE 0 /* The runners print their verdicts */
+#define CUTEST_WORK_PROGRESS_LIVE 1 /* A status display on the terminal */
+#define CUTEST_WORK_PROGRESS_LINES 2 /* A line per finished runner */
+
+typedef struct cutest_work_opts_s {
+  int verbose;
+  int jobs;
+  long mem_per_worker;
+  int adaptive;
+  int fail_fast;
+  const char* retries; /* Passed on to the runners as is */
+  int rerun_failed;
+  int tests_per_batch;
+  int shard_index;
+  int shard_count;
+  const char* history;
+  const char* junit;
+  const char* trace;
+  long limit_memory;
+  long limit_cpu;
+  long limit_files;
+  const char* cgroup;
+  const char* listen_address; /* Where the coordinator waits for agents */
+  int agents;
+  const char* coordinator; /* Where an agent connects to */
+  const char* cache;
+  const char* changed_only; /* The runners that passed last time */
+  const char* watch; /* The source directory to watch for changes */
+  const char* watch_tests; /* The test directory to watch, or NULL */
+  const char* rebuild; /* The command that rebuilds a runner, or NULL */
+  const char* results; /* The cache of the runners that passed, or NULL */
+  int results_max;
+  const char* cache_inputs; /* Colon separated files the runners read */
+  const char* unity; /* The unity runner of all the suites, or NULL */
+  int first_suite;
+} cutest_work_opts_t;
+
+typedef struct cutest_work_suite_s {
+  const char* name;
+  int test_cnt;
+  char** test;
+  int run;
+  double duration; /* Recorded in the history */
+  int duration_tests;
+  double elapsed; /* Measured in this run */
+  int elapsed_tests;
+  int failed;
+  int clean; /* The runner has not changed since it last passed */
+  int cached; /* Passed before with the same runner, inputs and environment */
+} cutest_work_suite_t;
+
+typedef struct cutest_work_unit_s {
+  int suite;
+  int test; /* -1 for the whole test suite */
+  const char* name;
+  double weight;
+} cutest_work_unit_t;
+
+typedef struct cutest_work_item_s {
+  cutest_work_suite_t* suite;
+  int batch; /* -1 when all the tests in the suite are run at once */
+  int first_test;
+  int test_cnt;
+  int shard;
+  int grouped; /* The items after it that the unity runner runs with it */
+} cutest_work_item_t;
+
+typedef struct cutest_work_queue_s {
+  int cnt;
+  cutest_work_item_t* item;
+} cutest_work_queue_t;
+
+typedef struct cutest_work_pool_s {
+  int workers;
+  int running;
+  pid_t* pid;
+  int* item;
+  double* started;
+  int* agent; /* The connection of every remote slot, or NULL if all local */
+  int* out; /* The output of the runner in every slot, or NULL if not read */
+  int* done; /* The tests the runner in every slot has run */
+  int* failed; /* The tests that did not pass in every slot */
+} cutest_work_pool_t;
+
+typedef struct cutest_work_report_s {
+  FILE* junit; /* The merged JUnit report, or NULL */
+  int tests;
+  int failures;
+  int errors;
+  int skipped;
+  int flaky; /* Passed when retried */
+  double started;
+  int memcheck; /* Merge the Valgrind errors of the runners */
+} cutest_work_report_t;
+
+typedef struct cutest_work_memcheck_s {
+  int test; /* The index of the test in the suite, or -1 if not known */
+  char kind[64];
+  char what[256];
+} cutest_work_memcheck_t;
+
+typedef struct cutest_work_progress_s {
+  int mode;
+  int tests; /* The tests in the work queue */
+  int done;
+  int failed;
+  double expected; /* The duration of the tests from the history, or 0.0 */
+  double expected_done; /* The part of it that has been run */
+  double started;
+  int lines; /* The height of the status display */
+} cutest_work_progress_t;
+
+typedef struct cutest_work_result_s {
+  time_t mtime; /* When the result was last used */
+  char key[NET_HASH_LEN]; /* The hash of the runner, its inputs and environment */
+} cutest_work_result_t;
+
+typedef struct cutest_work_trace_s {
+  FILE* fd; /* The Chrome trace_event file, or NULL */
+  double started;
+  int last_worker; /* The worker that finished last */
+} cutest_work_trace_t;
+
+#endif
@@ -1,5 +1,7 @@
 #include "cutest.h"
 
+#include "cutest_work.h"
+
 #define m cutest_mock
 #define main MAIN
 
@@ -39,15 +41,23 @@ test(get_number_of_cores_shall_return_the_number_of_cores_detected)
 test(all_input_files_exist_shall_call_file_exists_correct_number_of_times)
 {
   char* argv[5] = {"program_name", "-v", "suite1", "suite2", "suite3"};
-  all_input_files_exist(3 + 2, argv);
+  all_input_files_exist(2, 3 + 2, argv);
   assert_eq(3, m.file_exists.call_count);
 }
 
+test(all_input_files_exist_shall_start_at_the_first_suite)
+{
+  char* argv[5] = {"program_name", "-j", "4", "-v", "suite1"};
+  all_input_files_exist(4, 5, argv);
+  assert_eq(1, m.file_exists.call_count);
+  assert_eq("suite1", m.file_exists.args.arg0);
+}
+
 test(all_input_files_exist_shall_output_an_error_if_file_does_not_exist)
 {
   char* argv[5] = {"program_name", "-v", "suite1", "suite2", "suite3"};
   m.file_exists.retval = 0;
-  all_input_files_exist(3 + 2, argv);
+  all_input_files_exist(2, 3 + 2, argv);
   assert_eq(3, m.fprintf.call_count);
 }
 
@@ -55,175 +65,84 @@ test(all_input_files_exist_shall_return_1_if_all_files_exist)
 {
   char* argv[5] = {"program_name", "-v", "suite1", "suite2", "suite3"};
   m.file_exists.retval = 1;
-  assert_eq(1, all_input_files_exist(3 + 2, argv));
+  assert_eq(1, all_input_files_exist(2, 3 + 2, argv));
 }
 
 test(all_input_files_exist_shall_return_0_some_files_are_missing)
 {
   char* argv[5] = {"program_name", "-v", "suite1", "suite2", "suite3"};
   m.file_exists.retval = 0;
-  assert_eq(0, all_input_files_exist(3 + 2, argv));
+  assert_eq(0, all_input_files_exist(2, 3 + 2, argv));
 }
 
 /*****************************************************************************
- * run_test_suite()
+ * parse_number()
  */
-test(run_test_suite_shall_output_an_error_if_executable_name_is_null)
-{
-  run_test_suite(NULL, 0, 0);
-#ifdef CUTEST_GCC
-  assert_eq(1, m.fwrite.call_count);
-  assert_eq(stderr, m.fwrite.args.arg3);
-#else
-  assert_eq(1, m.fprintf.call_count);
-  assert_eq(stderr, m.fprintf.args.arg0);
-#endif
-}
-
-test(run_test_suite_shall_allocate_correct_amount_of_memory_for_cmd)
-{
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = buf;
-  run_test_suite("bogus_suite_runner", 0, 0);
-  assert_eq(1, m.malloc.call_count);
-  assert_eq(strlen("bogus_suite_runner -j -s") + 1, m.malloc.args.arg0);
-}
-
-test(run_test_suite_shall_allocate_correct_amount_of_memory_for_cmd_with_pfx)
-{
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = buf;
-  run_test_suite("bogus_suite_runner", 0, 0);
-  assert_eq(1, m.malloc.call_count);
-  assert_eq(strlen("bogus_suite_runner -j -s") + 1, m.malloc.args.arg0);
-}
-
-test(run_test_suite_shall_output_an_error_if_out_of_memory)
-{
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = NULL;
-  run_test_suite("bogus_suite_runner", 0, 0);
-#ifdef CUTEST_GCC
-  assert_eq(1, m.fwrite.call_count);
-  assert_eq(stderr, m.fwrite.args.arg3);
-#else
-  assert_eq(1, m.fprintf.call_count);
-  assert_eq(stderr, m.fprintf.args.arg0);
-#endif
-}
-
-
-test(run_test_suite_shall_allocate_correct_amount_of_memory_for_verbose_cmd)
-{
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = buf;
-  run_test_suite("bogus_suite_runner", 1, 0);
-  assert_eq(1, m.malloc.call_count);
-  assert_eq(strlen("bogus_suite_runner -v -j -s") + 1, m.malloc.args.arg0);
-}
-
-test(run_test_suite_shall_allocate_correct_amount_of_memory_for_logging_cmd)
-{
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = buf;
-  run_test_suite("bogus_suite_runner", 1, 1);
-  assert_eq(1, m.malloc.call_count);
-  assert_eq(strlen("bogus_suite_runner -v -j -s -l") + 1, m.malloc.args.arg0);
-}
-
-test(run_test_suite_shall_allocate_correct_amount_of_memory_for_valgrind_cmd)
-{
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = buf;
-  run_test_suite("bogus_suite_runner", 2, 0);
-  assert_eq(1, m.malloc.call_count);
-  assert_eq(strlen("valgrind --track-origins=yes -q bogus_suite_runner -v -j -s") + 1, m.malloc.args.arg0);
-}
-
-test(run_test_suite_shall_free_cmd)
+test(parse_number_shall_return_negative_1_if_there_is_no_number)
 {
-  char buf[1024];
-  memset(buf, 0, sizeof(buf));
-  m.strlen.func = strlen;
-  m.malloc.retval = buf;
-  run_test_suite("bogus_suite_runner", 0, 0);
-  assert_eq(1, m.free.call_count);
-  assert_eq(buf, m.free.args.arg0);
+  assert_eq(-1, parse_number(NULL));
 }
 
-char system_stub_arg[1024];
-int system_stub(const char* command) {
-  strcpy(system_stub_arg, command);
-  return 1234;
-}
-
-module_test(run_test_suite_shall_execute_correct_command)
+module_test(parse_number_shall_return_the_number)
 {
-  m.system.func = system_stub;
-  assert_eq(1234, run_test_suite("suite_runner", 0, 0))
-  assert_eq("suite_runner -j -s", system_stub_arg);
+  assert_eq(192, parse_number("192"));
 }
 
-module_test(run_test_suite_shall_execute_correct_command_verbose)
+module_test(parse_number_shall_return_negative_1_if_not_a_number)
 {
-  m.system.func = system_stub;
-  assert_eq(1234, run_test_suite("suite_runner", 1, 0))
-  assert_eq("suite_runner -v -j -s", system_stub_arg);
+  assert_eq(-1, parse_number("-v"));
+  assert_eq(-1, parse_number("12abc"));
 }
 
-module_test(run_test_suite_shall_execute_correct_command_no_line_feed)
+module_test(parse_number_shall_return_negative_1_if_not_positive)
 {
-  m.system.func = system_stub;
-  assert_eq(1234, run_test_suite("suite_runner", -1, 0))
-  assert_eq("suite_runner -n -j -s", system_stub_arg);
+  assert_eq(-1, parse_number("0"));
+  assert_eq(-1, parse_number("-3"));
 }
 
-module_test(run_test_suite_shall_execute_correct_command_logging)
+/*****************************************************************************
+ * handle_env()
+ */
+test(handle_env_shall_not_touch_the_shards_without_environment)
 {
-  m.system.func = system_stub;
-  assert_eq(1234, run_test_suite("suite_runner", -1, 1))
-  assert_eq("suite_runner -n -j -s -l", system_stub_arg);
+  cutest_work_opts_t opts = {0};
+  handle_env(&opts);
+  assert_eq(0, opts.shard_index);
+  assert_eq(0, opts.shard_count);
+  assert_eq(0, m.parse_number.call_count);
 }
 
-
-/*****************************************************************************
- * run_test_suites()
- */
-test(run_test_suites_shall_run_test_suite_for_every_suite)
+static char* getenv_stub(const char* name)
 {
-  char* argv[] = {"program", "-v", "suite1", "suite2"};
-  run_test_suites(0, 1, 4, argv, 123, 0);
-  assert_eq(2, m.run_test_suite.call_count);
-  assert_eq("suite2", m.run_test_suite.args.arg0);
-  assert_eq(123, m.run_test_suite.args.arg1);
+  if (0 == strcmp("CUTEST_SHARD_INDEX", name)) {
+    return "2";
+  }
+  if (0 == strcmp("CUTEST_SHARD_COUNT", name)) {
+    return "4";
+  }
+  return NULL;
 }
 
-test(run_test_suites_shall_run_test_suite_for_every_one_suite)
+test(handle_env_shall_set_the_shard_from_the_environment)
 {
-  char* argv[] = {"program", "-v", "suite1"};
-  run_test_suites(0, 1, 3, argv, 123, 0);
-  assert_eq(1, m.run_test_suite.call_count);
-  assert_eq("suite1", m.run_test_suite.args.arg0);
-  assert_eq(123, m.run_test_suite.args.arg1);
+  cutest_work_opts_t opts = {0};
+  m.getenv.func = getenv_stub;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  handle_env(&opts);
+  assert_eq(2, opts.shard_index);
+  assert_eq(4, opts.shard_count);
+  assert_eq(0, m.exit.call_count);
 }
 
-test(run_test_suites_shall_return_negative_1_if_run_test_suite_fails)
+test(handle_env_shall_exit_with_EXIT_FAILURE_if_the_shard_is_bad)
 {
-  char* argv[] = {"program", "-v", "suite1"};
-  m.run_test_suite.retval = -1;
-  assert_eq(-1, run_test_suites(0, 1, 3, argv, 123, 0));
+  cutest_work_opts_t opts = {0};
+  m.getenv.func = getenv_stub;
+  m.parse_number.retval = -1;
+  handle_env(&opts);
+  assert_eq(2, m.exit.call_count);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
 /*****************************************************************************
@@ -231,384 +150,5848 @@ test(run_test_suites_shall_return_negative_1_if_run_test_suite_fails)
  */
 test(handle_args_shall_call_usage_if_arg_count_is_off)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name"};
-  handle_args(1, argv);
-  assert_eq(1, m.usage.call_count);
+  handle_args(&opts, 1, argv);
+  assert_eq(2, m.usage.call_count);
   assert_eq("program_name", m.usage.args.arg0);
 }
 
 test(handle_args_shall_exit_with_EXIT_FAILURE_if_arg_count_is_off)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "-v"};
-  handle_args(2, argv);
+  m.strcmp.func = strcmp;
   m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 2, argv);
   assert_eq(2, m.exit.call_count);
   assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
 test(handle_args_shall_exit_with_EXIT_FAILURE_if_not_verbose_nor_nor_valgrind_no_line_feed)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "test_suite1", "test_suite2"};
-  handle_args(3, argv);
   m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 3, argv);
   assert_eq(1, m.exit.call_count);
   assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
 test(handle_args_shall_call_usage_if_not_verbose_nor_no_line_feed)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "test_suite1", "test_suite2"};
   m.strcmp.retval = 1;
-  handle_args(3, argv);
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 3, argv);
   assert_eq(1, m.usage.call_count);
 }
 
 test(handle_args_shall_exit_with_EXIT_FAILURE_if_test_suites_could_not_be_found)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "-v", "test_suite"};
-  handle_args(3, argv);
+  m.strcmp.func = strcmp;
   m.all_input_files_exist.retval = 0;
+  handle_args(&opts, 3, argv);
   assert_eq(1, m.exit.call_count);
   assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-test(handle_args_shall_return_1_if_verbose)
+test(handle_args_shall_set_verbose_to_1_if_verbose)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "-v", "test_suite"};
   m.strcmp.func = strcmp;
   m.all_input_files_exist.retval = 1;
-  assert_eq(1, handle_args(3, argv));
+  handle_args(&opts, 3, argv);
+  assert_eq(1, opts.verbose);
 }
 
-test(handle_args_shall_return_2_if_valgrind)
+test(handle_args_shall_set_verbose_to_2_if_valgrind)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "-V", "test_suite"};
   m.strcmp.func = strcmp;
   m.all_input_files_exist.retval = 1;
-  assert_eq(2, handle_args(3, argv));
+  handle_args(&opts, 3, argv);
+  assert_eq(2, opts.verbose);
 }
 
-test(handle_args_shall_return_negative_1_if_no_line_feed)
+test(handle_args_shall_set_verbose_to_negative_1_if_no_line_feed)
 {
+  cutest_work_opts_t opts = {0};
   char* argv[] = {"program_name", "-n", "test_suite"};
   m.strcmp.func = strcmp;
   m.all_input_files_exist.retval = 1;
-  assert_eq(-1, handle_args(3, argv));
+  handle_args(&opts, 3, argv);
+  assert_eq(-1, opts.verbose);
 }
 
-test(handle_args_shall_print_usage_if_none_of_the_nVv_flags_are_provided)
+test(handle_args_shall_set_the_index_of_the_first_suite)
 {
-  char* argv[] = {"program_name", "-?", "test_suite"};
-  m.strcmp.retval = 1;
-  handle_args(3, argv);
-  assert_eq(1, m.usage.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-n", "test_suite1", "test_suite2"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 4, argv);
+  assert_eq(2, opts.first_suite);
+  assert_eq(2, m.all_input_files_exist.args.arg0);
 }
 
-test(handle_args_shall_exit_with_EXIT_FAILURE_if_none_of_the_nVv_flags)
+test(handle_args_shall_set_the_number_of_jobs)
 {
-  char* argv[] = {"program_name", "-?", "test_suite"};
-  m.strcmp.retval = 1;
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-j", "192", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = 192;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("192", m.parse_number.args.arg0);
+  assert_eq(192, opts.jobs);
+  assert_eq(4, opts.first_suite);
+  assert_eq(0, m.exit.call_count);
+}
+
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_the_number_of_jobs_is_bad)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-j", "x", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = -1;
   m.all_input_files_exist.retval = 1;
-  handle_args(3, argv);
+  handle_args(&opts, 5, argv);
   assert_eq(1, m.exit.call_count);
-  assert_eq(EXIT_FAILURE, m.exit.call_count);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-/*****************************************************************************
- * launch_child_processes()
- */
-test(launch_child_processes_shall_fork_enough_times)
+test(handle_args_shall_set_the_memory_per_worker)
 {
-  launch_child_processes(8, 10, 0x1234, 0);
-  assert_eq(8, m.fork.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-m", "512", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = 512;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq(512, opts.mem_per_worker);
+  assert_eq(4, opts.first_suite);
 }
 
-test(launch_child_processes_shall_output_errors_if_fork_fails)
+test(handle_args_shall_not_read_beyond_the_arguments_for_a_value)
 {
-  m.fork.retval = -1;
-  launch_child_processes(8, 10, 0x1234, 0);
-#ifdef CUTEST_GCC
-  assert_eq(8, m.fwrite.call_count);
-#else
-  assert_eq(8, m.fprintf.call_count);
-#endif
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-v", "-m"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = -1;
+  handle_args(&opts, 3, argv);
+  assert_eq(NULL, m.parse_number.args.arg0);
 }
 
-test(launch_child_processes_shall_exit_with_EXIT_FAILURE_if_fork_fails)
+test(handle_args_shall_enable_adaptive_mode)
 {
-  m.fork.retval = -1;
-  launch_child_processes(8, 10, 0x1234, 0);
-  assert_eq(8, m.exit.call_count);
-  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-a", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 4, argv);
+  assert_eq(1, opts.adaptive);
+  assert_eq(0, m.exit.call_count);
 }
 
-test(launch_child_processes_shall_call_run_test_suites_for_each_fork)
+test(handle_args_shall_enable_fail_fast_mode)
 {
-  launch_child_processes(8, 10, 0x1234, 0);
-  assert_eq(8, m.run_test_suites.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--fail-fast", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 4, argv);
+  assert_eq(1, opts.fail_fast);
+  assert_eq(3, opts.first_suite);
+  assert_eq(0, m.exit.call_count);
 }
 
-test(launch_child_processes_shall_exit_with_EXIT_SUCCESS_from_run_test_suites)
+test(handle_args_shall_set_the_retries)
 {
-  m.run_test_suites.retval = 0;
-  launch_child_processes(8, 10, 0x1234, 0);
-  assert_eq(8, m.exit.call_count);
-  assert_eq(EXIT_SUCCESS, m.exit.args.arg0);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--retries", "2", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = 2;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("2", opts.retries);
+  assert_eq(4, opts.first_suite);
+  assert_eq(0, m.exit.call_count);
 }
 
-test(launch_child_processes_shall_exit_with_EXIT_FAILURE_from_run_test_suites)
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_the_retries_are_bad)
 {
-  m.run_test_suites.retval = 1234;
-  launch_child_processes(8, 10, 0x1234, 0);
-  assert_eq(8, m.exit.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--retries", "0", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = -1;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
   assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-/*****************************************************************************
- * slight_delay()
- */
-test(slight_delay_shall_perform_a_simple_mathematical_calculation_to_delay)
+test(handle_args_shall_rerun_the_failed_tests_of_the_merged_report)
 {
-  assert_eq(90, slight_delay());
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--rerun-failed", "--junit", "all.xml",
+                  "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 6, argv);
+  assert_eq(1, opts.rerun_failed);
+  assert_eq(5, opts.first_suite);
+  assert_eq(0, m.exit.call_count);
 }
 
-/*****************************************************************************
- * wait_for_child_processes()
- */
-test(wait_for_child_processes_shall_wait_for_all_child_processes_forked)
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_rerun_failed_has_no_report)
 {
-  wait_for_child_processes(8, 0);
-  assert_eq(8, m.waitpid.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--rerun-failed", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 4, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-test(wait_for_child_processes_shall_output_a_line_feed_if_not_verbose)
+test(handle_args_shall_set_the_tests_per_batch)
 {
-  wait_for_child_processes(8, -1);
-  assert_eq(1, m.puts.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-t", "100", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.retval = 100;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq(100, opts.tests_per_batch);
+  assert_eq(4, opts.first_suite);
 }
 
-test(wait_for_child_processes_shall_not_output_a_line_feed_if_verbose)
+test(handle_args_shall_read_the_environment_first)
 {
-  wait_for_child_processes(8, 1);
-  assert_eq(0, m.puts.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 3, argv);
+  assert_eq(1, m.handle_env.call_count);
+  assert_eq(&opts, m.handle_env.args.arg0);
 }
 
-pid_t waitpid_stub(pid_t pid, int* status, int options)
+test(handle_args_shall_set_the_shard)
 {
-  (void)pid;
-  (void)options;
-  *status = 1 << (m.waitpid.call_count - 1);
-  return 0;
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--shard-index", "2", "--shard-count", "4",
+                  "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 7, argv);
+  assert_eq(2, opts.shard_index);
+  assert_eq(4, opts.shard_count);
+  assert_eq(6, opts.first_suite);
+  assert_eq(0, m.exit.call_count);
 }
 
-test(wait_for_child_processes_shall_return_a_ored_status)
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_shard_is_out_of_range)
 {
-  m.waitpid.func = waitpid_stub;
-  assert_eq(EXIT_SUCCESS, wait_for_child_processes(3, 1));
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--shard-index", "5", "--shard-count", "4",
+                  "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 7, argv);
+  assert_eq(1, m.exit.call_count);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-/*****************************************************************************
- * print_log()
- */
-test(print_log_shall_allocate_correct_number_of_bytes_for_log_file_name)
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_shard_count_is_missing)
 {
-  m.strlen.func = strlen;
-  print_log("command");
-  assert_eq(1, m.malloc.call_count);
-  assert_eq(strlen("command.log") + 1, m.malloc.args.arg0);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--shard-index", "1", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq(1, m.exit.call_count);
 }
 
-test(print_log_shall_output_an_error_message_if_allocation_failed)
+test(handle_args_shall_set_the_history_file)
 {
-  print_log("command");
-#ifdef CUTEST_GCC
-  assert_eq(1, m.fwrite.call_count);
-  assert_eq(stderr, m.fwrite.args.arg3);
-#else
-  assert_eq(1, m.fprintf.call_count);
-  assert_eq(stderr, m.fprintf.args.arg0);
-#endif
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--history", "ci.history", "-v",
+                  "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("ci.history", opts.history);
+  assert_eq(4, opts.first_suite);
 }
 
-test(print_log_shall_append_log_suffix_to_suite_name)
+test(handle_args_shall_set_the_resource_limits)
 {
-  char buf[128];
-  m.memset.func = memset;
-  m.strcpy.func = strcpy;
-  m.strcat.func = strcat;
-  m.malloc.retval = buf;
-  print_log("suite_name");
-  assert_eq("suite_name.log", buf);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--limit-memory", "512", "--limit-cpu",
+                  "60", "--limit-files", "256", "--cgroup", "/cg", "-v",
+                  "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 11, argv);
+  assert_eq(512, opts.limit_memory);
+  assert_eq(60, opts.limit_cpu);
+  assert_eq(256, opts.limit_files);
+  assert_eq("/cg", opts.cgroup);
+  assert_eq(10, opts.first_suite);
 }
 
-test(print_log_shall_open_the_correct_file_for_reading)
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_a_limit_is_bad)
 {
-  char buf[128];
-  m.memset.func = memset;
-  m.strcpy.func = strcpy;
-  m.strcat.func = strcat;
-  m.malloc.retval = buf;
-  print_log("suite_name");
-  assert_eq(1, m.fopen.call_count);
-  assert_eq(buf, m.fopen.args.arg0);
-  assert_eq("r", m.fopen.args.arg1);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--limit-cpu", "0", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq(1, m.exit.call_count);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-test(print_log_shall_free_the_memory_if_a_file_could_not_be_opened)
+test(handle_args_shall_set_the_merged_junit_report)
 {
-  char buf[128];
-  m.memset.func = memset;
-  m.strcpy.func = strcpy;
-  m.strcat.func = strcat;
-  m.malloc.retval = buf;
-  print_log("suite_name");
-  assert_eq(1, m.free.call_count);
-  assert_eq(buf, m.free.args.arg0);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--junit", "all.xml", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("all.xml", opts.junit);
+  assert_eq(4, opts.first_suite);
 }
 
-static char* fgets_stub(char* s, int size, FILE *stream)
+test(handle_args_shall_set_the_trace_file)
 {
-  (void)stream;
-  (void)size;
-  if (m.fgets.call_count >= 2) {
-    return NULL;
-  }
-  return s;
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--trace", "check.json", "-v",
+                  "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("check.json", opts.trace);
+  assert_eq(4, opts.first_suite);
 }
 
-test(print_log_shall_fgets_all_lines_in_a_file_to_fputs)
+test(handle_args_shall_exit_if_junit_has_no_file_name)
 {
-  char buf[128];
-  m.memset.func = memset;
-  m.strcpy.func = strcpy;
-  m.strcat.func = strcat;
-  m.malloc.retval = buf;
-  m.fopen.retval = 0x1234;
-  m.fgets.func = fgets_stub;
-  print_log("suite_name");
-  assert_eq(2, m.fgets.call_count);
-  assert_eq(0x1234, m.fgets.args.arg2);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-v", "--junit"};
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 3, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-test(print_log_shall_fputs_all_lines_in_a_file_to_stderr)
+test(handle_args_shall_set_the_agents_of_the_coordinator)
 {
-  char buf[128];
-  m.memset.func = memset;
-  m.strcpy.func = strcpy;
-  m.strcat.func = strcat;
-  m.malloc.retval = buf;
-  m.fopen.retval = 0x1234;
-  m.fgets.func = fgets_stub;
-  print_log("suite_name");
-  assert_eq(1, m.fputs.call_count);
-  assert_eq(stderr, m.fputs.args.arg1);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--listen", "unix:/tmp/cutest.sock",
+                  "--agents", "3", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 7, argv);
+  assert_eq("unix:/tmp/cutest.sock", opts.listen_address);
+  assert_eq(3, opts.agents);
+  assert_eq(6, opts.first_suite);
 }
 
-/*****************************************************************************
- * print_logs()
- */
-test(print_logs_shall_call_print_log_for_every_suite)
+test(handle_args_shall_wait_for_one_agent_by_default)
 {
-  char* argv[5] = {"ignore", "ingore", "take0", "take1", "take2"};
-  print_logs(5, argv);
-  assert_eq(3, m.print_log.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--listen", ":4711", "-v", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq(1, opts.agents);
 }
 
-/*****************************************************************************
- * launch_process()
- */
-test(launch_process_shall_call_run_test_suites_to_launch_process)
+test(handle_args_shall_not_need_test_suites_for_an_agent)
 {
-  m.fprintf.func = fprintf;
-  char* argv[] = {"3", "4"};
-  launch_process(2, argv, 5);
-  assert_eq(1, m.run_test_suites.call_count);
-  assert_eq(0, m.run_test_suites.args.arg0);
-  assert_eq(1, m.run_test_suites.args.arg1);
-  assert_eq(2, m.run_test_suites.args.arg2);
-  assert_eq(argv, m.run_test_suites.args.arg3);
-  assert_eq(5, m.run_test_suites.args.arg4);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--agent", "build1:4711", "--cache",
+                  "/tmp/cache"};
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 5, argv);
+  assert_eq("build1:4711", opts.coordinator);
+  assert_eq("/tmp/cache", opts.cache);
+  assert_eq(0, m.exit.call_count);
+  assert_eq(0, m.all_input_files_exist.call_count);
 }
 
-test(launch_process_shall_add_an_extra_line_feed_if_not_no_linefeed)
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_an_agent_gets_test_suites)
 {
-  char* argv[] = {"3", "4"};
-  launch_process(2, argv, -1);
-  assert_eq(1, m.puts.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--agent", "build1:4711", "test_suite"};
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 4, argv);
+  assert_eq("program_name", m.usage.args.arg0);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-test(launch_process_shall_not_add_an_extra_line_feed_if_no_linefeed)
+test(handle_args_shall_set_the_file_of_the_runners_that_passed)
 {
-  char* argv[] = {"3", "4"};
-  launch_process(2, argv, 1);
-  assert_eq(0, m.puts.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--changed-only", "clean.txt", "-V",
+                  "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("clean.txt", opts.changed_only);
+  assert_eq(4, opts.first_suite);
 }
 
-test(launch_process_shall_return_the_return_value_from_run_test_suites)
+test(handle_args_shall_set_the_results_and_what_they_depend_on)
 {
-  char* argv[] = {"3", "4"};
-  m.run_test_suites.retval = 1234;
-  assert_eq(1234, launch_process(2, argv, 4));
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--results", "cutest_results",
+                  "--results-max", "10", "--cache-inputs", "a.bin:b.bin",
+                  "-n", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 9, argv);
+  assert_eq("cutest_results", opts.results);
+  assert_eq(10, opts.results_max);
+  assert_eq("a.bin:b.bin", opts.cache_inputs);
+  assert_eq(8, opts.first_suite);
 }
 
-/*****************************************************************************
- * main()
- */
-test(main_shall_call_handle_args_correctly)
+test(handle_args_shall_not_use_the_results_if_told_not_to)
 {
-  main(1, 0x2);
-  assert_eq(1, m.handle_args.call_count);
-  assert_eq(1, m.handle_args.args.arg0);
-  assert_eq(0x2, m.handle_args.args.arg1);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--no-cache", "--results", "cutest_results",
+                  "-n", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 6, argv);
+  assert_eq(NULL, opts.results);
+  assert_eq(1000, opts.results_max);
 }
 
-test(main_shall_get_the_number_of_cores_using_get_number_of_cores)
+test(handle_args_shall_exit_if_results_max_is_not_a_number)
 {
-  main(1, 0x2);
-  assert_eq(1, m.get_number_of_cores.call_count);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--results-max", "many", "-n", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.parse_number.func = parse_number;
+  m.strtol.func = strtol;
+  handle_args(&opts, 5, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
 }
 
-test(main_shall_call_launch_child_processes_if_allocated_cores_are_more_than_1)
+test(handle_args_shall_set_the_directory_to_watch_and_the_rebuild_command)
 {
-  m.get_number_of_cores.retval = 4;
-  m.handle_args.retval = 6;
-  main(4, 0x5);
-  assert_eq(1, m.launch_child_processes.call_count);
-  assert_eq(3, m.launch_child_processes.args.arg0);
-  assert_eq(4, m.launch_child_processes.args.arg1);
-  assert_eq(0x5, m.launch_child_processes.args.arg2);
-  assert_eq(6, m.launch_child_processes.args.arg3);
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--watch", "src", "--rebuild", "make",
+                  "-n", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 7, argv);
+  assert_eq("src", opts.watch);
+  assert_eq("make", opts.rebuild);
+  assert_eq(6, opts.first_suite);
+}
 
-  assert_eq(0, m.launch_process.call_count);
+test(handle_args_shall_set_the_test_directory_to_watch)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--watch", "src", "--watch-tests", "test",
+                  "-n", "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 7, argv);
+  assert_eq("src", opts.watch);
+  assert_eq("test", opts.watch_tests);
+  assert_eq(6, opts.first_suite);
 }
 
-test(main_shall_call_launch_processes_if_one_suite)
+test(handle_args_shall_exit_if_watch_tests_has_no_directory)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--watch-tests"};
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 2, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_set_the_unity_runner)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--unity", "cutest_unity", "-n",
+                  "test_suite"};
+  m.strcmp.func = strcmp;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 5, argv);
+  assert_eq("cutest_unity", opts.unity);
+  assert_eq(4, opts.first_suite);
+}
+
+test(handle_args_shall_exit_if_unity_has_no_runner)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--unity"};
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 2, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_exit_if_watch_has_no_directory)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "--watch"};
+  m.strcmp.func = strcmp;
+  handle_args(&opts, 2, argv);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+test(handle_args_shall_print_usage_if_none_of_the_nVv_flags_are_provided)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-?", "test_suite"};
+  m.strcmp.retval = 1;
+  handle_args(&opts, 3, argv);
+  assert_eq(2, m.usage.call_count);
+}
+
+test(handle_args_shall_exit_with_EXIT_FAILURE_if_none_of_the_nVv_flags)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program_name", "-?", "test_suite"};
+  m.strcmp.retval = 1;
+  m.all_input_files_exist.retval = 1;
+  handle_args(&opts, 3, argv);
+  assert_eq(2, m.exit.call_count);
+  assert_eq(EXIT_FAILURE, m.exit.args.arg0);
+}
+
+/*****************************************************************************
+ * read_memory_available()
+ */
+test(read_memory_available_shall_open_meminfo)
+{
+  read_memory_available();
+  assert_eq(1, m.fopen.call_count);
+  assert_eq("/proc/meminfo", m.fopen.args.arg0);
+}
+
+test(read_memory_available_shall_return_0_if_meminfo_is_missing)
+{
+  assert_eq(0, read_memory_available());
+}
+
+static char* fgets_meminfo_stub(char* s, int size, FILE* stream)
+{
+  (void)size;
+  (void)stream;
+  switch (m.fgets.call_count) {
+  case 1: strcpy(s, "MemTotal:       32768000 kB\n"); return s;
+  case 2: strcpy(s, "MemFree:         1024000 kB\n"); return s;
+  case 3: strcpy(s, "MemAvailable:    2048000 kB\n"); return s;
+  default: return NULL;
+  }
+}
+
+module_test(read_memory_available_shall_return_the_available_memory)
+{
+  m.fopen.func = NULL;
+  m.fopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_meminfo_stub;
+  m.fclose.func = NULL;
+  assert_eq(2048000, read_memory_available());
+  assert_eq(1, m.fclose.call_count);
+}
+
+/*****************************************************************************
+ * read_load_average()
+ */
+test(read_load_average_shall_open_loadavg)
+{
+  read_load_average();
+  assert_eq(1, m.fopen.call_count);
+  assert_eq("/proc/loadavg", m.fopen.args.arg0);
+}
+
+static char* fgets_loadavg_stub(char* s, int size, FILE* stream)
+{
+  (void)size;
+  (void)stream;
+  strcpy(s, "12.50 8.00 4.00 3/1024 4711\n");
+  return s;
+}
+
+module_test(read_load_average_shall_return_the_1_minute_load_average)
+{
+  m.fopen.func = NULL;
+  m.fopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_loadavg_stub;
+  m.fclose.func = NULL;
+  assert_eq(12.5, read_load_average());
+}
+
+/*****************************************************************************
+ * read_pressure()
+ */
+test(read_pressure_shall_open_the_pressure_file)
+{
+  read_pressure("/proc/pressure/memory");
+  assert_eq(1, m.fopen.call_count);
+  assert_eq("/proc/pressure/memory", m.fopen.args.arg0);
+}
+
+test(read_pressure_shall_return_0_if_there_is_no_pressure_information)
+{
+  assert_eq(0.0, read_pressure("/proc/pressure/memory"));
+}
+
+static char* fgets_pressure_stub(char* s, int size, FILE* stream)
+{
+  (void)size;
+  (void)stream;
+  switch (m.fgets.call_count) {
+  case 1: strcpy(s, "some avg10=23.50 avg60=10.00 avg300=1.00 total=1\n"); return s;
+  case 2: strcpy(s, "full avg10=12.00 avg60=5.00 avg300=0.50 total=1\n"); return s;
+  default: return NULL;
+  }
+}
+
+module_test(read_pressure_shall_return_the_10_second_some_average)
+{
+  m.fopen.func = NULL;
+  m.fopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_pressure_stub;
+  m.fclose.func = NULL;
+  assert_eq(23.5, read_pressure("/proc/pressure/cpu"));
+}
+
+/*****************************************************************************
+ * get_number_of_workers()
+ */
+test(get_number_of_workers_shall_use_one_worker_per_core_by_default)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(8, get_number_of_workers(&opts, 8));
+}
+
+test(get_number_of_workers_shall_use_the_number_of_jobs_if_given)
+{
+  cutest_work_opts_t opts = {0};
+  opts.jobs = 192;
+  assert_eq(192, get_number_of_workers(&opts, 8));
+}
+
+test(get_number_of_workers_shall_use_at_least_one_worker)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(1, get_number_of_workers(&opts, 0));
+}
+
+test(get_number_of_workers_shall_fit_the_workers_in_available_memory)
+{
+  cutest_work_opts_t opts = {0};
+  opts.mem_per_worker = 512;
+  m.read_memory_available.retval = 4 * 512 * 1024;
+  assert_eq(4, get_number_of_workers(&opts, 8));
+}
+
+test(get_number_of_workers_shall_ignore_memory_if_it_is_not_known)
+{
+  cutest_work_opts_t opts = {0};
+  opts.mem_per_worker = 512;
+  m.read_memory_available.retval = 0;
+  assert_eq(8, get_number_of_workers(&opts, 8));
+}
+
+test(get_number_of_workers_shall_not_read_memory_without_a_budget)
+{
+  cutest_work_opts_t opts = {0};
+  get_number_of_workers(&opts, 8);
+  assert_eq(0, m.read_memory_available.call_count);
+}
+
+/*****************************************************************************
+ * get_worker_limit()
+ */
+test(get_worker_limit_shall_return_all_workers_if_not_adaptive)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_pool_t pool = {8, 0, NULL, NULL, NULL, NULL};
+  assert_eq(8, get_worker_limit(&opts, &pool, 8));
+  assert_eq(0, m.read_load_average.call_count);
+}
+
+test(get_worker_limit_shall_return_all_workers_if_the_host_is_idle)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_pool_t pool = {8, 2, NULL, NULL, NULL, NULL};
+  opts.adaptive = 1;
+  m.read_load_average.retval = 2.0;
+  assert_eq(8, get_worker_limit(&opts, &pool, 8));
+}
+
+test(get_worker_limit_shall_leave_the_cores_others_are_using)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_pool_t pool = {8, 2, NULL, NULL, NULL, NULL};
+  opts.adaptive = 1;
+  m.read_load_average.retval = 7.0;
+  assert_eq(3, get_worker_limit(&opts, &pool, 8));
+}
+
+test(get_worker_limit_shall_use_at_least_one_worker)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_pool_t pool = {8, 0, NULL, NULL, NULL, NULL};
+  opts.adaptive = 1;
+  m.read_load_average.retval = 100.0;
+  assert_eq(1, get_worker_limit(&opts, &pool, 8));
+}
+
+static double read_pressure_cpu_stub(const char* file_name)
+{
+  return (0 == strcmp("/proc/pressure/cpu", file_name)) ? 60.0 : 0.0;
+}
+
+test(get_worker_limit_shall_not_grow_on_cpu_pressure)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_pool_t pool = {8, 5, NULL, NULL, NULL, NULL};
+  opts.adaptive = 1;
+  m.read_pressure.func = read_pressure_cpu_stub;
+  assert_eq(5, get_worker_limit(&opts, &pool, 8));
+}
+
+static double read_pressure_memory_stub(const char* file_name)
+{
+  return (0 == strcmp("/proc/pressure/memory", file_name)) ? 20.0 : 0.0;
+}
+
+test(get_worker_limit_shall_halve_the_workers_on_memory_pressure)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_pool_t pool = {8, 6, NULL, NULL, NULL, NULL};
+  opts.adaptive = 1;
+  m.read_pressure.func = read_pressure_memory_stub;
+  assert_eq(3, get_worker_limit(&opts, &pool, 8));
+}
+
+/*****************************************************************************
+ * delete_tests()
+ */
+test(delete_tests_shall_free_all_test_names)
+{
+  char* test[2] = {"test1", "test2"};
+  cutest_work_suite_t suite = {.name = "suite", .test_cnt = 2, .test = test};
+  delete_tests(&suite);
+  assert_eq(3, m.free.call_count);
+  assert_eq(test, m.free.args.arg0);
+  assert_eq(NULL, suite.test);
+  assert_eq(0, suite.test_cnt);
+}
+
+/*****************************************************************************
+ * list_tests()
+ */
+test(list_tests_shall_output_an_error_if_out_of_memory)
+{
+  cutest_work_suite_t suite = {.name = "./suite_test"};
+  assert_eq(-1, list_tests(&suite));
+  assert_eq(0, m.popen.call_count);
+#ifdef CUTEST_GCC
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq(stderr, m.fwrite.args.arg3);
+#else
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq(stderr, m.fprintf.args.arg0);
+#endif
+}
+
+test(list_tests_shall_ask_the_suite_to_print_its_tests)
+{
+  char command[128];
+  cutest_work_suite_t suite = {.name = "./suite_test"};
+  m.malloc.retval = command;
+  m.sprintf.func = sprintf;
+  list_tests(&suite);
+  assert_eq("./suite_test -p", command);
+  assert_eq(1, m.popen.call_count);
+  assert_eq(command, m.popen.args.arg0);
+  assert_eq("r", m.popen.args.arg1);
+}
+
+test(list_tests_shall_return_negative_1_if_the_suite_can_not_be_started)
+{
+  char command[128];
+  cutest_work_suite_t suite = {.name = "./suite_test"};
+  m.malloc.retval = command;
+  assert_eq(-1, list_tests(&suite));
+  assert_eq(0, m.fgets.call_count);
+}
+
+static char* fgets_test_name_stub(char* s, int size, FILE *stream)
+{
+  (void)stream;
+  if (m.fgets.call_count > 2) {
+    return NULL;
+  }
+  snprintf(s, size, "test%d\n", m.fgets.call_count);
+  return s;
+}
+
+test(list_tests_shall_store_the_name_of_every_test)
+{
+  char command[128];
+  char* test[16];
+  cutest_work_suite_t suite = {.name = "./suite_test"};
+  m.malloc.retval = command;
+  m.popen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_test_name_stub;
+  m.strcspn.func = strcspn;
+  m.realloc.retval = test;
+  m.strdup.func = strdup;
+  assert_eq(2, list_tests(&suite));
+  assert_eq(1, m.realloc.call_count);
+  assert_eq(test, suite.test);
+  assert_eq("test1", test[0]);
+  assert_eq("test2", test[1]);
+  assert_eq(0x1234, m.pclose.args.arg0);
+  free(test[0]);
+  free(test[1]);
+}
+
+test(list_tests_shall_discard_the_tests_if_out_of_memory)
+{
+  char command[128];
+  cutest_work_suite_t suite = {.name = "./suite_test"};
+  m.malloc.retval = command;
+  m.popen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_test_name_stub;
+  m.realloc.retval = NULL;
+  assert_eq(-1, list_tests(&suite));
+  assert_eq(1, m.delete_tests.call_count);
+  assert_eq(&suite, m.delete_tests.args.arg0);
+}
+
+test(list_tests_shall_discard_the_tests_if_the_suite_fails)
+{
+  char command[128];
+  cutest_work_suite_t suite = {.name = "./suite_test"};
+  m.malloc.retval = command;
+  m.popen.retval = (FILE*)0x1234;
+  m.pclose.retval = 1;
+  assert_eq(-1, list_tests(&suite));
+  assert_eq(1, m.delete_tests.call_count);
+}
+
+/*****************************************************************************
+ * delete_test_suites()
+ */
+test(delete_test_suites_shall_delete_the_tests_of_every_suite)
+{
+  cutest_work_suite_t suite[3];
+  delete_test_suites(suite, 3);
+  assert_eq(3, m.delete_tests.call_count);
+  assert_eq(&suite[2], m.delete_tests.args.arg0);
+  assert_eq(1, m.free.call_count);
+  assert_eq(suite, m.free.args.arg0);
+}
+
+/*****************************************************************************
+ * new_test_suites()
+ */
+test(new_test_suites_shall_return_null_if_out_of_memory)
+{
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program", "-v", "suite1"};
+  opts.first_suite = 2;
+  assert_eq(NULL, new_test_suites(&opts, 1, 3, argv));
+  assert_eq(0, m.list_tests.call_count);
+}
+
+test(new_test_suites_shall_name_every_suite)
+{
+  cutest_work_suite_t suite[2];
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program", "-v", "suite1", "suite2"};
+  opts.first_suite = 2;
+  m.calloc.retval = suite;
+  assert_eq(suite, new_test_suites(&opts, 0, 4, argv));
+  assert_eq(2, m.calloc.args.arg0);
+  assert_eq("suite1", suite[0].name);
+  assert_eq("suite2", suite[1].name);
+  assert_eq(0, m.list_tests.call_count);
+}
+
+test(new_test_suites_shall_list_the_tests_if_told_to)
+{
+  cutest_work_suite_t suite[2];
+  cutest_work_opts_t opts = {0};
+  char* argv[] = {"program", "-v", "suite1", "suite2"};
+  opts.first_suite = 2;
+  m.calloc.retval = suite;
+  new_test_suites(&opts, 1, 4, argv);
+  assert_eq(2, m.list_tests.call_count);
+  assert_eq(&suite[1], m.list_tests.args.arg0);
+}
+
+/*****************************************************************************
+ * get_suite_name()
+ */
+test(get_suite_name_shall_skip_the_directories)
+{
+  m.strrchr.func = strrchr;
+  assert_eq("foo_test", get_suite_name("/some/where/foo_test"));
+}
+
+test(get_suite_name_shall_return_a_plain_file_name_as_is)
+{
+  assert_eq("foo_test", get_suite_name("foo_test"));
+}
+
+/*****************************************************************************
+ * get_hash()
+ */
+test(get_hash_shall_be_the_same_on_every_host)
+{
+  assert_eq(0x811c9dc5UL, get_hash(""));
+  assert_eq(0xe40c292cUL, get_hash("a"));
+}
+
+/*****************************************************************************
+ * read_history()
+ */
+test(read_history_shall_not_open_a_file_if_no_history)
+{
+  read_history(NULL, NULL, 0);
+  assert_eq(0, m.fopen.call_count);
+}
+
+test(read_history_shall_open_the_history_for_reading)
+{
+  read_history("ci.history", NULL, 0);
+  assert_eq(1, m.fopen.call_count);
+  assert_eq("ci.history", m.fopen.args.arg0);
+  assert_eq("r", m.fopen.args.arg1);
+}
+
+static char* fgets_history_stub(char* s, int size, FILE *stream)
+{
+  const char* rows[] = {"1.5 10 foo_test\n",
+                        "garbage\n",
+                        "2.5 20 foo_test\n",
+                        "3.0 0 bar_test\n"};
+  (void)stream;
+  if (m.fgets.call_count > 4) {
+    return NULL;
+  }
+  snprintf(s, size, "%s", rows[m.fgets.call_count - 1]);
+  return s;
+}
+
+test(read_history_shall_add_up_the_rows_of_every_suite)
+{
+  cutest_work_suite_t suite[3] = {{.name = "./foo_test", .test_cnt = 10},
+                                  {.name = "./bar_test"},
+                                  {.name = "./baz_test"}};
+  m.fopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_history_stub;
+  m.strtod.func = strtod;
+  m.strtol.func = strtol;
+  m.strcspn.func = strcspn;
+  m.strcmp.func = strcmp;
+  m.get_suite_name.func = get_suite_name;
+  m.strrchr.func = strrchr;
+  read_history("ci.history", suite, 3);
+  assert_eq(4.0, suite[0].duration);
+  assert_eq(30, suite[0].duration_tests);
+  assert_eq(3.0, suite[1].duration);
+  assert_eq(0, suite[1].duration_tests);
+  assert_eq(0.0, suite[2].duration);
+  assert_eq(1, m.fclose.call_count);
+}
+
+/*****************************************************************************
+ * write_history()
+ */
+test(write_history_shall_output_an_error_if_out_of_memory)
+{
+  cutest_work_opts_t opts = {0};
+  opts.history = "ci.history";
+  assert_eq(-1, write_history(&opts, NULL, 0));
+  assert_eq(0, m.fopen.call_count);
+}
+
+test(write_history_shall_overwrite_the_history_if_not_sharding)
+{
+  char file_name[64];
+  cutest_work_opts_t opts = {0};
+  opts.history = "ci.history";
+  m.malloc.retval = file_name;
+  m.sprintf.func = sprintf;
+  write_history(&opts, NULL, 0);
+  assert_eq("ci.history", file_name);
+  assert_eq(file_name, m.fopen.args.arg0);
+  assert_eq("w", m.fopen.args.arg1);
+}
+
+test(write_history_shall_write_a_history_per_shard)
+{
+  char file_name[64];
+  cutest_work_opts_t opts = {0};
+  opts.history = "ci.history";
+  opts.shard_index = 2;
+  opts.shard_count = 4;
+  m.malloc.retval = file_name;
+  m.sprintf.func = sprintf;
+  write_history(&opts, NULL, 0);
+  assert_eq("ci.history.2", file_name);
+}
+
+test(write_history_shall_return_negative_1_if_file_can_not_be_opened)
+{
+  char file_name[64];
+  cutest_work_opts_t opts = {0};
+  opts.history = "ci.history";
+  m.malloc.retval = file_name;
+  assert_eq(-1, write_history(&opts, NULL, 0));
+  assert_eq(1, m.free.call_count);
+}
+
+test(write_history_shall_write_a_row_per_suite_that_was_run)
+{
+  char file_name[64];
+  cutest_work_suite_t suite[3] = {{.name = "a", .run = CUTEST_WORK_RUN_ALL},
+                                  {.name = "b", .run = CUTEST_WORK_RUN_NONE},
+                                  {.name = "c", .run = CUTEST_WORK_RUN_SOME}};
+  cutest_work_opts_t opts = {0};
+  opts.history = "ci.history";
+  m.malloc.retval = file_name;
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, write_history(&opts, suite, 3));
+  assert_eq(2, m.get_suite_name.call_count);
+  assert_eq("c", m.get_suite_name.args.arg0);
+  assert_eq(1, m.fclose.call_count);
+}
+
+test(write_history_shall_keep_the_durations_of_the_cached_suites)
+{
+  char file_name[64];
+  cutest_work_suite_t suite[1] = {{.name = "a", .run = CUTEST_WORK_RUN_NONE,
+                                   .cached = 1, .duration = 2.0,
+                                   .duration_tests = 4}};
+  cutest_work_opts_t opts = {0};
+  opts.history = "ci.history";
+  m.malloc.retval = file_name;
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, write_history(&opts, suite, 1));
+  assert_eq(1, m.get_suite_name.call_count);
+  assert_eq("a", m.get_suite_name.args.arg0);
+}
+
+/*****************************************************************************
+ * get_suite_weight()
+ */
+test(get_suite_weight_shall_scale_the_duration_per_test)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 30, .duration = 2.0,
+                               .duration_tests = 20};
+  assert_eq(3.0, get_suite_weight(&suite));
+}
+
+test(get_suite_weight_shall_use_the_duration_if_tests_are_unknown)
+{
+  cutest_work_suite_t suite = {.name = "a", .duration = 2.0,
+                               .duration_tests = 20};
+  assert_eq(2.0, get_suite_weight(&suite));
+}
+
+test(get_suite_weight_shall_be_0_without_history)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 30};
+  assert_eq(0.0, get_suite_weight(&suite));
+}
+
+/*****************************************************************************
+ * is_spread_by_test()
+ */
+test(is_spread_by_test_shall_spread_a_suite_heavier_than_a_fair_share)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 2};
+  m.get_suite_weight.retval = 10.0;
+  assert_eq(1, is_spread_by_test(&suite, 5.0));
+  assert_eq(0, is_spread_by_test(&suite, 10.0));
+}
+
+test(is_spread_by_test_shall_not_spread_a_single_test)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 1};
+  m.get_suite_weight.retval = 10.0;
+  assert_eq(0, is_spread_by_test(&suite, 5.0));
+}
+
+/*****************************************************************************
+ * compare_units()
+ */
+test(compare_units_shall_put_the_heaviest_unit_first)
+{
+  cutest_work_unit_t a = {0, -1, "a", 1.0};
+  cutest_work_unit_t b = {1, -1, "b", 2.0};
+  assert_eq(1, compare_units(&a, &b));
+  assert_eq(-1, compare_units(&b, &a));
+}
+
+test(compare_units_shall_order_equal_weights_by_name_and_test)
+{
+  cutest_work_unit_t a0 = {1, 0, "a", 1.0};
+  cutest_work_unit_t a1 = {1, 1, "a", 1.0};
+  cutest_work_unit_t b = {0, -1, "b", 1.0};
+  m.strcmp.func = strcmp;
+  assert_eq(1, compare_units(&a0, &b) < 0);
+  assert_eq(1, compare_units(&a1, &a0) > 0);
+}
+
+/*****************************************************************************
+ * keep_tests_of_shard()
+ */
+test(keep_tests_of_shard_shall_only_keep_the_tests_of_the_shard)
+{
+  char* test[3] = {"t0", "t1", "t2"};
+  char in_shard[3] = {0, 1, 1};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 3, .test = test};
+  keep_tests_of_shard(&suite, in_shard);
+  assert_eq(2, suite.test_cnt);
+  assert_eq("t1", test[0]);
+  assert_eq("t2", test[1]);
+  assert_eq(1, m.free.call_count);
+  assert_eq(CUTEST_WORK_RUN_SOME, suite.run);
+}
+
+test(keep_tests_of_shard_shall_not_run_a_suite_without_tests_in_shard)
+{
+  char* test[2] = {"t0", "t1"};
+  char in_shard[2] = {0, 0};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 2, .test = test};
+  keep_tests_of_shard(&suite, in_shard);
+  assert_eq(0, suite.test_cnt);
+  assert_eq(CUTEST_WORK_RUN_NONE, suite.run);
+}
+
+/*****************************************************************************
+ * shard_test_suites()
+ */
+test(shard_test_suites_shall_not_touch_the_suites_if_not_sharding)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(0, shard_test_suites(&opts, NULL, 0));
+  assert_eq(0, m.calloc.call_count);
+}
+
+test(shard_test_suites_shall_return_negative_1_if_out_of_memory)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a"}};
+  cutest_work_opts_t opts = {0};
+  opts.shard_index = 1;
+  opts.shard_count = 2;
+  assert_eq(-1, shard_test_suites(&opts, suite, 1));
+}
+
+module_test(shard_test_suites_shall_run_every_suite_in_one_shard_by_hash)
+{
+  cutest_work_suite_t shard1[3] = {{.name = "./a_test"},
+                                   {.name = "./b_test"},
+                                   {.name = "./c_test"}};
+  cutest_work_suite_t shard2[3] = {{.name = "./a_test"},
+                                   {.name = "./b_test"},
+                                   {.name = "./c_test"}};
+  cutest_work_opts_t opts = {0};
+  int i;
+  opts.shard_count = 2;
+  opts.shard_index = 1;
+  assert_eq(0, shard_test_suites(&opts, shard1, 3));
+  opts.shard_index = 2;
+  assert_eq(0, shard_test_suites(&opts, shard2, 3));
+  for (i = 0; i < 3; i++) {
+    assert_eq(1, ((CUTEST_WORK_RUN_ALL == shard1[i].run) +
+                  (CUTEST_WORK_RUN_ALL == shard2[i].run)));
+  }
+}
+
+module_test(shard_test_suites_shall_balance_the_suites_on_their_history)
+{
+  cutest_work_suite_t suite[3] = {{.name = "./a_test", .duration = 10.0},
+                                  {.name = "./b_test", .duration = 5.0},
+                                  {.name = "./c_test", .duration = 5.0}};
+  cutest_work_opts_t opts = {0};
+  opts.shard_count = 2;
+  opts.shard_index = 2;
+  assert_eq(0, shard_test_suites(&opts, suite, 3));
+  assert_eq(CUTEST_WORK_RUN_NONE, suite[0].run);
+  assert_eq(CUTEST_WORK_RUN_ALL, suite[1].run);
+  assert_eq(CUTEST_WORK_RUN_ALL, suite[2].run);
+}
+
+module_test(shard_test_suites_shall_spread_a_heavy_suite_test_by_test)
+{
+  char* test[4] = {strdup("t0"), strdup("t1"), strdup("t2"), strdup("t3")};
+  cutest_work_suite_t suite[2] = {{.name = "./a_test", .test_cnt = 4,
+                                   .test = test, .duration = 40.0,
+                                   .duration_tests = 4},
+                                  {.name = "./b_test", .duration = 10.0}};
+  cutest_work_opts_t opts = {0};
+  opts.shard_count = 2;
+  opts.shard_index = 2;
+  assert_eq(0, shard_test_suites(&opts, suite, 2));
+  assert_eq(CUTEST_WORK_RUN_SOME, suite[0].run);
+  assert_eq(2, suite[0].test_cnt);
+  assert_eq("t1", suite[0].test[0]);
+  assert_eq("t3", suite[0].test[1]);
+  assert_eq(CUTEST_WORK_RUN_NONE, suite[1].run);
+  free(test[0]);
+  free(test[1]);
+}
+
+/*****************************************************************************
+ * get_tests_per_batch()
+ */
+test(get_tests_per_batch_shall_use_the_number_of_tests_if_given)
+{
+  cutest_work_opts_t opts = {0};
+  opts.tests_per_batch = 100;
+  assert_eq(100, get_tests_per_batch(&opts, 8, NULL, 0));
+}
+
+test(get_tests_per_batch_shall_not_give_a_runner_more_tests_than_it_takes)
+{
+  cutest_work_opts_t opts = {0};
+  opts.tests_per_batch = 5000;
+  assert_eq(1024, get_tests_per_batch(&opts, 8, NULL, 0));
+}
+
+test(get_tests_per_batch_shall_not_split_suites_for_a_single_worker)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a", .test_cnt = 5000}};
+  cutest_work_opts_t opts = {0};
+  assert_eq(0, get_tests_per_batch(&opts, 1, suite, 1));
+}
+
+test(get_tests_per_batch_shall_aim_for_a_few_batches_per_worker)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 1000},
+                                  {.name = "b", .test_cnt = 600}};
+  cutest_work_opts_t opts = {0};
+  assert_eq(100, get_tests_per_batch(&opts, 4, suite, 2));
+}
+
+test(get_tests_per_batch_shall_not_make_too_small_batches)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 10},
+                                  {.name = "b", .test_cnt = 5}};
+  cutest_work_opts_t opts = {0};
+  assert_eq(8, get_tests_per_batch(&opts, 4, suite, 2));
+}
+
+test(get_tests_per_batch_shall_make_small_batches_under_valgrind)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 10},
+                                  {.name = "b", .test_cnt = 5}};
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 2;
+  assert_eq(1, get_tests_per_batch(&opts, 4, suite, 2));
+}
+
+test(get_tests_per_batch_shall_not_make_too_big_batches)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a", .test_cnt = 100000}};
+  cutest_work_opts_t opts = {0};
+  assert_eq(1024, get_tests_per_batch(&opts, 2, suite, 1));
+}
+
+test(get_tests_per_batch_shall_only_count_the_tests_run_in_the_shard)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 1000,
+                                   .run = CUTEST_WORK_RUN_NONE},
+                                  {.name = "b", .test_cnt = 600}};
+  cutest_work_opts_t opts = {0};
+  assert_eq(38, get_tests_per_batch(&opts, 4, suite, 2));
+}
+
+/*****************************************************************************
+ * get_batch_size()
+ */
+test(get_batch_size_shall_use_the_tests_per_batch)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 5000,
+                               .run = CUTEST_WORK_RUN_SOME};
+  assert_eq(10, get_batch_size(&suite, 10));
+}
+
+test(get_batch_size_shall_name_the_tests_of_a_suite_run_in_part)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 5000,
+                               .run = CUTEST_WORK_RUN_SOME};
+  assert_eq(1024, get_batch_size(&suite, 0));
+}
+
+test(get_batch_size_shall_not_split_a_suite_run_as_a_whole)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 5000};
+  assert_eq(0, get_batch_size(&suite, 0));
+}
+
+/*****************************************************************************
+ * get_number_of_batches()
+ */
+test(get_number_of_batches_shall_not_split_without_a_batch_size)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 5000};
+  assert_eq(1, get_number_of_batches(&suite, 0));
+}
+
+test(get_number_of_batches_shall_not_split_a_small_suite)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 10};
+  m.get_batch_size.retval = 10;
+  assert_eq(1, get_number_of_batches(&suite, 10));
+}
+
+test(get_number_of_batches_shall_make_room_for_all_tests)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 25};
+  m.get_batch_size.retval = 10;
+  assert_eq(3, get_number_of_batches(&suite, 10));
+}
+
+test(get_number_of_batches_shall_skip_a_suite_not_run_in_the_shard)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 25,
+                               .run = CUTEST_WORK_RUN_NONE};
+  m.get_batch_size.retval = 10;
+  assert_eq(0, get_number_of_batches(&suite, 10));
+}
+
+/*****************************************************************************
+ * delete_work_queue()
+ */
+test(delete_work_queue_shall_free_all_memory)
+{
+  cutest_work_queue_t queue = {0, (cutest_work_item_t*)0x1234};
+  delete_work_queue(&queue);
+  assert_eq(2, m.free.call_count);
+  assert_eq(&queue, m.free.args.arg0);
+}
+
+/*****************************************************************************
+ * new_work_queue()
+ */
+test(new_work_queue_shall_return_null_if_out_of_memory)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a", .test_cnt = 3}};
+  assert_eq(NULL, new_work_queue(suite, 1, 10, 0));
+  assert_eq(0, m.calloc.call_count);
+}
+
+test(new_work_queue_shall_free_the_queue_if_items_can_not_be_allocated)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a", .test_cnt = 3}};
+  cutest_work_queue_t queue;
+  m.malloc.retval = &queue;
+  m.get_number_of_batches.retval = 1;
+  assert_eq(NULL, new_work_queue(suite, 1, 10, 0));
+  assert_eq(1, m.free.call_count);
+  assert_eq(&queue, m.free.args.arg0);
+}
+
+test(new_work_queue_shall_put_small_suites_in_the_queue_as_a_whole)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 3},
+                                  {.name = "b", .test_cnt = 5}};
+  cutest_work_item_t item[2];
+  cutest_work_queue_t queue;
+  m.malloc.retval = &queue;
+  m.calloc.retval = item;
+  m.get_number_of_batches.retval = 1;
+  assert_eq(&queue, new_work_queue(suite, 2, 10, 0));
+  assert_eq(2, queue.cnt);
+  assert_eq(2, m.calloc.args.arg0);
+  assert_eq(&suite[0], item[0].suite);
+  assert_eq(&suite[1], item[1].suite);
+  assert_eq(-1, item[1].batch);
+}
+
+test(new_work_queue_shall_split_big_suites_in_batches)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a", .test_cnt = 25}};
+  cutest_work_item_t item[3];
+  cutest_work_queue_t queue;
+  m.malloc.retval = &queue;
+  m.calloc.retval = item;
+  m.get_number_of_batches.retval = 3;
+  m.get_batch_size.retval = 10;
+  new_work_queue(suite, 1, 10, 0);
+  assert_eq(3, queue.cnt);
+  assert_eq(0, item[0].batch);
+  assert_eq(0, item[0].first_test);
+  assert_eq(10, item[0].test_cnt);
+  assert_eq(2, item[2].batch);
+  assert_eq(20, item[2].first_test);
+  assert_eq(5, item[2].test_cnt);
+}
+
+test(new_work_queue_shall_name_the_tests_of_a_suite_run_in_part)
+{
+  cutest_work_suite_t suite[1] = {{.name = "a", .test_cnt = 3,
+                                   .run = CUTEST_WORK_RUN_SOME}};
+  cutest_work_item_t item[1];
+  cutest_work_queue_t queue;
+  m.malloc.retval = &queue;
+  m.calloc.retval = item;
+  m.get_number_of_batches.retval = 1;
+  m.get_batch_size.retval = 1024;
+  new_work_queue(suite, 1, 0, 2);
+  assert_eq(0, item[0].batch);
+  assert_eq(3, item[0].test_cnt);
+  assert_eq(2, item[0].shard);
+}
+
+/*****************************************************************************
+ * group_test_suites()
+ */
+module_test(group_test_suites_shall_run_a_few_whole_suites_per_runner)
+{
+  cutest_work_item_t item[5] = {{NULL, -1}, {NULL, -1}, {NULL, -1},
+                                {NULL, -1}, {NULL, -1}};
+  cutest_work_queue_t queue = {5, item};
+  assert_eq(2, group_test_suites(&queue, 2));
+  assert_eq(2, item[0].grouped);
+  assert_eq(1, item[3].grouped);
+}
+
+module_test(group_test_suites_shall_run_the_batches_on_their_own)
+{
+  cutest_work_item_t item[4] = {{NULL, -1}, {NULL, 0}, {NULL, 1},
+                                {NULL, -1}};
+  cutest_work_queue_t queue = {4, item};
+  assert_eq(4, group_test_suites(&queue, 1));
+  assert_eq(0, item[0].grouped);
+  assert_eq(0, item[1].grouped);
+  assert_eq(0, item[3].grouped);
+}
+
+/*****************************************************************************
+ * format_batch_name()
+ */
+test(format_batch_name_shall_use_the_batch_number)
+{
+  char buf[32];
+  cutest_work_item_t item = {NULL, 3, 0, 0, 0, 0};
+  m.sprintf.func = sprintf;
+  format_batch_name(buf, &item);
+  assert_eq("3", buf);
+}
+
+test(format_batch_name_shall_add_the_shard)
+{
+  char buf[32];
+  cutest_work_item_t item = {NULL, 3, 0, 0, 2, 0};
+  m.sprintf.func = sprintf;
+  format_batch_name(buf, &item);
+  assert_eq("shard2.3", buf);
+}
+
+/*****************************************************************************
+ * build_suite_argv()
+ */
+static cutest_work_suite_t runner_suite = {.name = "suite_runner"};
+static cutest_work_item_t runner_item = {&runner_suite, -1, 0, 0, 0, 0};
+
+module_test(build_suite_argv_shall_build_the_default_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  assert_eq(3, build_suite_argv(args, &runner_item, &opts, 0, "-1", NULL));
+  assert_eq("suite_runner", args[0]);
+  assert_eq("-j", args[1]);
+  assert_eq("-s", args[2]);
+  assert_eq(NULL, args[3]);
+}
+
+module_test(build_suite_argv_shall_build_a_verbose_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 1;
+  assert_eq(4, build_suite_argv(args, &runner_item, &opts, 0, "-1", NULL));
+  assert_eq("-v", args[1]);
+}
+
+module_test(build_suite_argv_shall_build_a_no_line_feed_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = -1;
+  assert_eq(4, build_suite_argv(args, &runner_item, &opts, 0, "-1", NULL));
+  assert_eq("-n", args[1]);
+}
+
+module_test(build_suite_argv_shall_build_a_logging_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = -1;
+  assert_eq(5, build_suite_argv(args, &runner_item, &opts, 1, "-1", NULL));
+  assert_eq("-l", args[4]);
+  assert_eq(NULL, args[5]);
+}
+
+module_test(build_suite_argv_shall_build_a_fail_fast_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 1;
+  opts.fail_fast = 1;
+  assert_eq(5, build_suite_argv(args, &runner_item, &opts, 0, "-1", NULL));
+  assert_eq("--fail-fast", args[4]);
+  assert_eq(NULL, args[5]);
+}
+
+module_test(build_suite_argv_shall_build_a_retrying_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 1;
+  opts.retries = "2";
+  assert_eq(6, build_suite_argv(args, &runner_item, &opts, 0, "-1", NULL));
+  assert_eq("--retries", args[4]);
+  assert_eq("2", args[5]);
+  assert_eq(NULL, args[6]);
+}
+
+module_test(build_suite_argv_shall_build_a_valgrind_command)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 2;
+  assert_eq(8, build_suite_argv(args, &runner_item, &opts, 0, "-1", NULL));
+  assert_eq("valgrind", args[0]);
+  assert_eq("--track-origins=yes", args[1]);
+  assert_eq("-q", args[2]);
+  assert_eq("--error-exitcode=3", args[3]);
+  assert_eq("suite_runner", args[4]);
+  assert_eq("-v", args[5]);
+}
+
+module_test(build_suite_argv_shall_write_the_valgrind_errors_as_xml)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 2;
+  assert_eq(10, build_suite_argv(args, &runner_item, &opts, 0, "-1",
+                                 "--xml-file=suite_runner.valgrind.xml"));
+  assert_eq("--xml=yes", args[4]);
+  assert_eq("--xml-file=suite_runner.valgrind.xml", args[5]);
+  assert_eq("suite_runner", args[6]);
+}
+
+module_test(build_suite_argv_shall_build_a_batch_command)
+{
+  char* args[16];
+  char* test[4] = {"test0", "test1", "test2", "test3"};
+  cutest_work_suite_t suite = {.name = "suite_runner", .test_cnt = 4,
+                               .test = test};
+  cutest_work_item_t item = {&suite, 1, 2, 2, 0, 0};
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 1;
+  assert_eq(8, build_suite_argv(args, &item, &opts, 0, "1", NULL));
+  assert_eq("-b", args[4]);
+  assert_eq("1", args[5]);
+  assert_eq("test2", args[6]);
+  assert_eq("test3", args[7]);
+  assert_eq(NULL, args[8]);
+}
+
+module_test(build_suite_argv_shall_name_the_suites_for_the_unity_runner)
+{
+  char* args[16];
+  cutest_work_suite_t suite[2] = {{.name = "dir/a_test"},
+                                  {.name = "dir/b_test"}};
+  cutest_work_item_t item[2] = {{&suite[0], -1, 0, 0, 0, 1},
+                                {&suite[1], -1, 0, 0, 0, 0}};
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 1;
+  opts.unity = "dir/cutest_unity";
+  assert_eq(8, build_suite_argv(args, item, &opts, 0, "-1", NULL));
+  assert_eq("dir/cutest_unity", args[0]);
+  assert_eq("--suite", args[1]);
+  assert_eq("a_test", args[2]);
+  assert_eq("--suite", args[3]);
+  assert_eq("b_test", args[4]);
+  assert_eq("-v", args[5]);
+}
+
+/*****************************************************************************
+ * read_hello()
+ */
+static const char** agent_rows = NULL;
+
+static char* fgets_agent_stub(char* s, int size, FILE *stream)
+{
+  (void)stream;
+  if (NULL == agent_rows[m.fgets.call_count - 1]) {
+    return NULL;
+  }
+  snprintf(s, size, "%s", agent_rows[m.fgets.call_count - 1]);
+  return s;
+}
+
+test(read_hello_shall_return_negative_1_if_the_connection_is_bad)
+{
+  int slot = 0;
+  int capacity = 0;
+  assert_eq(-1, read_hello(5, &slot, &capacity));
+  assert_eq(0, m.fgets.call_count);
+}
+
+test(read_hello_shall_read_the_slot_and_the_capacity_of_the_agent)
+{
+  const char* rows[] = {"HELLO 1 4\n", NULL};
+  int slot = 0;
+  int capacity = 0;
+  agent_rows = rows;
+  m.fdopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  m.strtol.func = strtol;
+  assert_eq(0, read_hello(5, &slot, &capacity));
+  assert_eq(1, slot);
+  assert_eq(4, capacity);
+  assert_eq(1, m.fclose.call_count);
+  assert_eq(0x1234, m.fclose.args.arg0);
+}
+
+test(read_hello_shall_return_negative_1_if_it_is_not_an_agent)
+{
+  const char* rows[] = {"GET / HTTP/1.0\n", NULL};
+  int slot = 0;
+  int capacity = 0;
+  agent_rows = rows;
+  m.fdopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  assert_eq(-1, read_hello(5, &slot, &capacity));
+  assert_eq(1, m.fclose.call_count);
+}
+
+test(read_hello_shall_return_negative_1_if_the_slot_is_beyond_the_capacity)
+{
+  const char* rows[] = {"HELLO 4 4\n", NULL};
+  int slot = 0;
+  int capacity = 0;
+  agent_rows = rows;
+  m.fdopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  m.strtol.func = strtol;
+  assert_eq(-1, read_hello(5, &slot, &capacity));
+}
+
+/*****************************************************************************
+ * close_agents()
+ */
+test(close_agents_shall_close_all_connections)
+{
+  int agent[2] = {5, 6};
+  close_agents(agent, 2);
+  assert_eq(2, m.close.call_count);
+  assert_eq(6, m.close.args.arg0);
+  assert_eq(agent, m.free.args.arg0);
+}
+
+/*****************************************************************************
+ * accept_agents()
+ */
+static int read_hello_stub(int fd, int* slot, int* capacity)
+{
+  /* One agent with two workers, after something else connected */
+  (void)fd;
+  if (1 == m.read_hello.call_count) {
+    return -1;
+  }
+  *slot = m.read_hello.call_count - 2;
+  *capacity = 2;
+  return 0;
+}
+
+test(accept_agents_shall_return_null_if_it_can_not_listen)
+{
+  cutest_work_opts_t opts = {0};
+  int cnt = 1;
+  opts.listen_address = ":4711";
+  m.net_listen.retval = -1;
+  assert_eq(NULL, accept_agents(&opts, &cnt));
+  assert_eq(":4711", m.net_listen.args.arg0);
+  assert_eq(0, cnt);
+  assert_eq(0, m.accept.call_count);
+}
+
+test(accept_agents_shall_wait_for_all_connections_of_all_agents)
+{
+  cutest_work_opts_t opts = {0};
+  int* agent = NULL;
+  int cnt = 0;
+  opts.agents = 1;
+  m.net_listen.retval = 3;
+  m.accept.retval = 5;
+  m.read_hello.func = read_hello_stub;
+  m.realloc.func = realloc;
+  agent = accept_agents(&opts, &cnt);
+  assert_eq(3, m.accept.call_count);
+  assert_eq(2, cnt);
+  assert_eq(5, agent[0]);
+  assert_eq(5, agent[1]);
+  assert_eq(3, m.close.args.arg0);
+  free(agent);
+}
+
+test(accept_agents_shall_close_connections_that_are_not_agents)
+{
+  cutest_work_opts_t opts = {0};
+  int cnt = 0;
+  opts.agents = 1;
+  m.net_listen.retval = 3;
+  m.accept.retval = 5;
+  m.read_hello.func = read_hello_stub;
+  m.realloc.func = realloc;
+  free(accept_agents(&opts, &cnt));
+  assert_eq(2, m.close.call_count);
+  assert_eq(3, m.close.args.arg0);
+}
+
+test(accept_agents_shall_return_null_if_an_agent_can_not_be_accepted)
+{
+  cutest_work_opts_t opts = {0};
+  int cnt = 0;
+  opts.agents = 1;
+  m.net_listen.retval = 3;
+  m.accept.retval = -1;
+  assert_eq(NULL, accept_agents(&opts, &cnt));
+  assert_eq(1, m.close.call_count);
+  assert_eq(3, m.close.args.arg0);
+  assert_eq(1, m.close_agents.call_count);
+}
+
+/*****************************************************************************
+ * send_run_request()
+ */
+module_test(send_run_request_shall_send_the_runner_as_a_placeholder)
+{
+  char runner[] = "./suite_test";
+  char* args[] = {"valgrind", runner, "-v", NULL};
+  char buf[128] = {0};
+  FILE* fd = tmpfile();
+  send_run_request(fd, "0123456789abcdef", args, runner);
+  rewind(fd);
+  fread(buf, 1, sizeof(buf) - 1, fd);
+  fclose(fd);
+  assert_eq("RUN 0123456789abcdef 3\nvalgrind\n@\n-v\n", buf);
+}
+
+/*****************************************************************************
+ * is_safe_file_name()
+ */
+module_test(is_safe_file_name_shall_accept_plain_file_names)
+{
+  assert_eq(1, is_safe_file_name("suite_test.junit_report.xml"));
+}
+
+module_test(is_safe_file_name_shall_refuse_paths_and_hidden_files)
+{
+  assert_eq(0, is_safe_file_name(""));
+  assert_eq(0, is_safe_file_name(".."));
+  assert_eq(0, is_safe_file_name(".bashrc"));
+  assert_eq(0, is_safe_file_name("../suite_test.log"));
+  assert_eq(0, is_safe_file_name("/tmp/suite_test.log"));
+}
+
+/*****************************************************************************
+ * new_dir_name()
+ */
+module_test(new_dir_name_shall_return_the_directory_of_the_path)
+{
+  char* dir = new_dir_name("tests/unit/suite_test");
+  assert_eq("tests/unit", dir);
+  free(dir);
+}
+
+module_test(new_dir_name_shall_return_the_current_directory_without_one)
+{
+  char* dir = new_dir_name("suite_test");
+  assert_eq(".", dir);
+  free(dir);
+}
+
+module_test(new_dir_name_shall_return_the_root_directory)
+{
+  char* dir = new_dir_name("/suite_test");
+  assert_eq("/", dir);
+  free(dir);
+}
+
+/*****************************************************************************
+ * receive_file()
+ */
+test(receive_file_shall_refuse_unsafe_file_names)
+{
+  assert_eq(-1, receive_file((FILE*)0x1234, ".", "../x", 42));
+  assert_eq(0, m.fopen.call_count);
+  assert_eq(0, m.copy_bytes.call_count);
+}
+
+test(receive_file_shall_copy_the_content_to_the_file)
+{
+  m.is_safe_file_name.retval = 1;
+  m.strlen.func = strlen;
+  m.malloc.func = malloc;
+  m.sprintf.func = sprintf;
+  m.fopen.retval = (FILE*)0x5678;
+  assert_eq(0, receive_file((FILE*)0x1234, "tests", "suite.log", 42));
+  assert_eq("suite.log", m.is_safe_file_name.args.arg0);
+  assert_eq("tests/suite.log", m.fopen.args.arg0);
+  assert_eq(0x1234, m.copy_bytes.args.arg0);
+  assert_eq(0x5678, m.copy_bytes.args.arg1);
+  assert_eq(42, m.copy_bytes.args.arg2);
+  assert_eq(0x5678, m.fclose.args.arg0);
+  free((char*)m.fopen.args.arg0);
+}
+
+test(receive_file_shall_return_negative_1_if_the_file_can_not_be_written)
+{
+  m.is_safe_file_name.retval = 1;
+  m.strlen.func = strlen;
+  m.malloc.func = malloc;
+  m.fopen.retval = (FILE*)0x5678;
+  m.fclose.retval = EOF;
+  m.free.func = free;
+  assert_eq(-1, receive_file((FILE*)0x1234, ".", "suite.log", 42));
+}
+
+/*****************************************************************************
+ * handle_agent_message()
+ */
+test(handle_agent_message_shall_send_the_runner_if_the_agent_needs_it)
+{
+  char line[] = "NEED\n";
+  int code = 0;
+  int sig = 0;
+  m.strcmp.func = strcmp;
+  assert_eq(0, handle_agent_message((FILE*)0x1234, (FILE*)0x5678, line,
+                                    "./suite_test", ".", &code, &sig));
+  assert_eq(1, m.send_file.call_count);
+  assert_eq(0x5678, m.send_file.args.arg0);
+  assert_eq("BLOB", m.send_file.args.arg1);
+  assert_eq("./suite_test", m.send_file.args.arg2);
+}
+
+test(handle_agent_message_shall_return_1_with_the_status_when_done)
+{
+  char line[] = "DONE 3 9\n";
+  int code = 0;
+  int sig = 0;
+  m.strcmp.func = strcmp;
+  m.strncmp.func = strncmp;
+  m.strtol.func = strtol;
+  assert_eq(1, handle_agent_message((FILE*)0x1234, (FILE*)0x5678, line,
+                                    "./suite_test", ".", &code, &sig));
+  assert_eq(3, code);
+  assert_eq(9, sig);
+}
+
+test(handle_agent_message_shall_copy_the_output_to_stdout)
+{
+  char line[] = "OUTPUT 12\n";
+  int code = 0;
+  int sig = 0;
+  m.strcmp.func = strcmp;
+  m.strncmp.func = strncmp;
+  m.strrchr.func = strrchr;
+  m.strtol.func = strtol;
+  assert_eq(0, handle_agent_message((FILE*)0x1234, (FILE*)0x5678, line,
+                                    "./suite_test", ".", &code, &sig));
+  assert_eq(0x1234, m.copy_bytes.args.arg0);
+  assert_eq(stdout, m.copy_bytes.args.arg1);
+  assert_eq(12, m.copy_bytes.args.arg2);
+}
+
+test(handle_agent_message_shall_receive_the_files_of_the_runner)
+{
+  char line[] = "FILE suite test.log 7\n";
+  int code = 0;
+  int sig = 0;
+  m.strcmp.func = strcmp;
+  m.strncmp.func = strncmp;
+  m.strrchr.func = strrchr;
+  m.strtol.func = strtol;
+  assert_eq(0, handle_agent_message((FILE*)0x1234, (FILE*)0x5678, line,
+                                    "./suite_test", ".", &code, &sig));
+  assert_eq(0x1234, m.receive_file.args.arg0);
+  assert_eq(".", m.receive_file.args.arg1);
+  assert_eq("suite test.log", m.receive_file.args.arg2);
+  assert_eq(7, m.receive_file.args.arg3);
+}
+
+test(handle_agent_message_shall_return_negative_1_for_anything_else)
+{
+  char line[] = "HELLO\n";
+  int code = 0;
+  int sig = 0;
+  m.strcmp.func = strcmp;
+  m.strncmp.func = strncmp;
+  m.strrchr.func = strrchr;
+  assert_eq(-1, handle_agent_message((FILE*)0x1234, (FILE*)0x5678, line,
+                                     "./suite_test", ".", &code, &sig));
+}
+
+/*****************************************************************************
+ * delegate_test_suite()
+ */
+static int handle_agent_message_exit_stub(FILE* in, FILE* out, char* line,
+                                          const char* runner,
+                                          const char* dir, int* code,
+                                          int* sig)
+{
+  (void)in;
+  (void)out;
+  (void)line;
+  (void)runner;
+  (void)dir;
+  *code = 3;
+  *sig = 0;
+  return 1;
+}
+
+static int handle_agent_message_kill_stub(FILE* in, FILE* out, char* line,
+                                          const char* runner,
+                                          const char* dir, int* code,
+                                          int* sig)
+{
+  (void)in;
+  (void)out;
+  (void)line;
+  (void)runner;
+  (void)dir;
+  *code = 0;
+  *sig = SIGXCPU;
+  return 1;
+}
+
+test(delegate_test_suite_shall_fail_if_the_runner_can_not_be_hashed)
+{
+  char* args[] = {"./suite_test", NULL};
+  m.fdopen.retval = (FILE*)0x1234;
+  m.get_file_hash.retval = -1;
+  assert_eq(EXIT_FAILURE, delegate_test_suite(args, args[0], 5));
+  assert_eq(0, m.send_run_request.call_count);
+}
+
+test(delegate_test_suite_shall_return_the_exit_code_of_the_runner)
+{
+  char* args[] = {"./suite_test", NULL};
+  char buf[16];
+  m.fdopen.retval = (FILE*)0x1234;
+  m.new_dir_name.retval = ".";
+  m.fgets.retval = buf;
+  m.handle_agent_message.func = handle_agent_message_exit_stub;
+  assert_eq(3, delegate_test_suite(args, args[0], 5));
+  assert_eq(1, m.send_run_request.call_count);
+  assert_eq(0x1234, m.send_run_request.args.arg0);
+  assert_eq(args, m.send_run_request.args.arg2);
+  assert_eq(args[0], m.send_run_request.args.arg3);
+  assert_eq(2, m.fclose.call_count);
+  assert_eq(0, m.raise.call_count);
+}
+
+test(delegate_test_suite_shall_die_by_the_signal_that_killed_the_runner)
+{
+  char* args[] = {"./suite_test", NULL};
+  char buf[16];
+  m.fdopen.retval = (FILE*)0x1234;
+  m.new_dir_name.retval = ".";
+  m.fgets.retval = buf;
+  m.handle_agent_message.func = handle_agent_message_kill_stub;
+  delegate_test_suite(args, args[0], 5);
+  assert_eq(SIGXCPU, m.raise.args.arg0);
+}
+
+test(delegate_test_suite_shall_fail_if_the_agent_is_lost)
+{
+  char* args[] = {"./suite_test", NULL};
+  m.fdopen.retval = (FILE*)0x1234;
+  m.new_dir_name.retval = ".";
+  assert_eq(EXIT_FAILURE, delegate_test_suite(args, args[0], 5));
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq(stderr, m.fprintf.args.arg0);
+}
+
+module_test(delegate_test_suite_shall_write_the_files_next_to_the_runner)
+{
+  char* args[] = {"delegate_runner/suite_test", NULL};
+  char buf[16] = "";
+  FILE* agent = NULL;
+  FILE* fd = NULL;
+  int sv[2];
+  mkdir("delegate_runner", 0755);
+  mkdir("delegate_agent", 0755);
+  fclose(fopen(args[0], "w"));
+  fd = fopen("delegate_agent/suite_test.log", "w");
+  fputs("hello", fd);
+  fclose(fd);
+  socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+  agent = fdopen(sv[1], "w");
+  send_file(agent, "FILE suite_test.log", "delegate_agent/suite_test.log");
+  fprintf(agent, "DONE 0 0\n");
+  fflush(agent);
+  assert_eq(0, delegate_test_suite(args, args[0], sv[0]));
+  assert_eq(-1, access("suite_test.log", F_OK));
+  assert_eq(0, access("delegate_runner/suite_test.log", F_OK));
+  fd = fopen("delegate_runner/suite_test.log", "r");
+  fgets(buf, sizeof(buf), fd);
+  fclose(fd);
+  assert_eq("hello", buf);
+  fclose(agent);
+  close(sv[0]);
+  unlink("delegate_runner/suite_test.log");
+  unlink(args[0]);
+  unlink("delegate_agent/suite_test.log");
+  rmdir("delegate_runner");
+  rmdir("delegate_agent");
+}
+
+/*****************************************************************************
+ * spawn_test_suite()
+ */
+test(spawn_test_suite_shall_output_an_error_if_item_is_null)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(-1, spawn_test_suite(NULL, &opts, 0, 0, 0, -1));
+#ifdef CUTEST_GCC
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq(stderr, m.fwrite.args.arg3);
+#else
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq(stderr, m.fprintf.args.arg0);
+#endif
+}
+
+test(spawn_test_suite_shall_return_negative_1_if_out_of_memory)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(-1, spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1));
+  assert_eq(0, m.build_suite_argv.call_count);
+  assert_eq(0, m.fork.call_count);
+}
+
+test(spawn_test_suite_shall_make_room_for_all_tests_in_the_batch)
+{
+  cutest_work_item_t item = {&runner_suite, 0, 0, 100, 0, 0};
+  cutest_work_opts_t opts = {0};
+  spawn_test_suite(&item, &opts, 0, 0, 0, -1);
+  assert_eq((MAX_SUITE_ARGS + 100) * sizeof(char*), m.malloc.args.arg0);
+}
+
+test(spawn_test_suite_shall_build_the_command_for_the_suite)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 1234;
+  spawn_test_suite(&runner_item, &opts, 1, 0, 0, -1);
+  assert_eq(1, m.build_suite_argv.call_count);
+  assert_eq(args, m.build_suite_argv.args.arg0);
+  assert_eq(&runner_item, m.build_suite_argv.args.arg1);
+  assert_eq(&opts, m.build_suite_argv.args.arg2);
+  assert_eq(1, m.build_suite_argv.args.arg3);
+}
+
+test(spawn_test_suite_shall_remove_the_old_reports_of_a_unity_group)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 1234;
+  spawn_test_suite(&runner_item, &opts, 1, 0, 0, -1);
+  assert_eq(1, m.remove_junit_reports.call_count);
+  assert_eq(&runner_item, m.remove_junit_reports.args.arg0);
+}
+
+test(remove_junit_reports_shall_remove_the_report_of_every_grouped_suite)
+{
+  cutest_work_item_t item[2] = {{&runner_suite, -1, 0, 0, 0, 1},
+                                {&runner_suite, -1, 0, 0, 0, 0}};
+  m.new_report_name.retval = "suite_runner.junit_report.xml";
+  remove_junit_reports(item);
+  assert_eq(2, m.unlink.call_count);
+  assert_eq("suite_runner.junit_report.xml", m.unlink.args.arg0);
+  assert_eq(&item[1], m.new_report_name.args.arg0);
+}
+
+test(remove_junit_reports_shall_leave_the_report_of_a_single_suite)
+{
+  remove_junit_reports(&runner_item);
+  assert_eq(0, m.new_report_name.call_count);
+}
+
+test(spawn_test_suite_shall_return_negative_1_if_fork_fails)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = -1;
+  assert_eq(-1, spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1));
+  assert_eq(0, m.execvp.call_count);
+  assert_eq(2, m.free.call_count); /* No Valgrind XML */
+  assert_eq(args, m.free.args.arg0);
+}
+
+test(spawn_test_suite_shall_return_the_pid_of_the_child)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 1234;
+  assert_eq(1234, spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1));
+  assert_eq(0, m.execvp.call_count);
+  assert_eq(2, m.free.call_count); /* No Valgrind XML */
+}
+
+test(spawn_test_suite_shall_execute_the_suite_in_the_child)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1);
+  assert_eq(1, m.execvp.call_count);
+  assert_eq(args, m.execvp.args.arg1);
+}
+
+test(spawn_test_suite_shall_limit_the_resources_of_the_child)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  spawn_test_suite(&runner_item, &opts, 0, 3, 0, -1);
+  assert_eq(1, m.apply_limits.call_count);
+  assert_eq(&opts, m.apply_limits.args.arg0);
+  assert_eq(3, m.apply_limits.args.arg1);
+}
+
+test(spawn_test_suite_shall_exit_the_child_if_the_limits_can_not_be_set)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  m.apply_limits.retval = -1;
+  spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1);
+  assert_eq(stderr, m.fprintf.args.arg0);
+  assert_eq(EXIT_FAILURE, m._exit.args.arg0);
+}
+
+test(spawn_test_suite_shall_not_limit_the_resources_of_the_parent)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 1234;
+  spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1);
+  assert_eq(0, m.apply_limits.call_count);
+}
+
+test(spawn_test_suite_shall_exit_the_child_if_the_suite_can_not_execute)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  m.execvp.retval = -1;
+  spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1);
+  assert_eq(1, m._exit.call_count);
+  assert_eq(EXIT_FAILURE, m._exit.args.arg0);
+}
+
+test(spawn_test_suite_shall_delegate_the_suite_to_the_agent_in_the_child)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  spawn_test_suite(&runner_item, &opts, 0, 1, 7, -1);
+  assert_eq(1, m.delegate_test_suite.call_count);
+  assert_eq(args, m.delegate_test_suite.args.arg0);
+  assert_eq(runner_item.suite->name, m.delegate_test_suite.args.arg1);
+  assert_eq(7, m.delegate_test_suite.args.arg2);
+}
+
+test(spawn_test_suite_shall_let_the_child_write_its_verdicts_to_out)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  spawn_test_suite(&runner_item, &opts, 0, 0, 0, 6);
+  assert_eq(1, m.dup2.call_count);
+  assert_eq(6, m.dup2.args.arg0);
+  assert_eq(STDOUT_FILENO, m.dup2.args.arg1);
+}
+
+test(spawn_test_suite_shall_let_the_child_write_to_stdout_by_default)
+{
+  char* args[16];
+  cutest_work_opts_t opts = {0};
+  m.malloc.retval = args;
+  m.fork.retval = 0;
+  spawn_test_suite(&runner_item, &opts, 0, 0, 0, -1);
+  assert_eq(0, m.dup2.call_count);
+}
+
+/*****************************************************************************
+ * get_cgroup_path()
+ */
+module_test(get_cgroup_path_shall_name_a_file_in_the_cgroup_of_the_worker)
+{
+  char buf[CGROUP_PATH_LEN];
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/sys/fs/cgroup/ci";
+  get_cgroup_path(buf, &opts, 3, "/memory.max");
+  assert_eq("/sys/fs/cgroup/ci/worker3/memory.max", buf);
+}
+
+/*****************************************************************************
+ * write_cgroup_file()
+ */
+test(write_cgroup_file_shall_return_negative_1_if_it_can_not_be_opened)
+{
+  assert_eq(-1, write_cgroup_file("/cg/memory.max", "1024"));
+  assert_eq("/cg/memory.max", m.fopen.args.arg0);
+  assert_eq("w", m.fopen.args.arg1);
+}
+
+test(write_cgroup_file_shall_return_negative_1_if_the_value_is_refused)
+{
+  m.fopen.retval = (FILE*)0x1234;
+  m.fclose.retval = EOF;
+  assert_eq(-1, write_cgroup_file("/cg/memory.max", "1024"));
+  assert_eq(1, m.fputs.call_count);
+  assert_eq("1024", m.fputs.args.arg0);
+}
+
+test(write_cgroup_file_shall_return_0_if_the_value_is_written)
+{
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, write_cgroup_file("/cg/memory.max", "1024"));
+}
+
+/*****************************************************************************
+ * setup_cgroups()
+ */
+test(setup_cgroups_shall_do_nothing_without_a_cgroup)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(0, setup_cgroups(&opts));
+  assert_eq(0, m.write_cgroup_file.call_count);
+}
+
+test(setup_cgroups_shall_enable_the_memory_and_cpu_controllers)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  m.sprintf.func = sprintf;
+  assert_eq(0, setup_cgroups(&opts));
+  assert_eq("/cg/cgroup.subtree_control", m.write_cgroup_file.args.arg0);
+  assert_eq("+memory +cpu", m.write_cgroup_file.args.arg1);
+}
+
+test(setup_cgroups_shall_return_negative_1_if_the_path_is_too_long)
+{
+  char cgroup[CGROUP_PATH_LEN];
+  cutest_work_opts_t opts = {0};
+  memset(cgroup, 'a', sizeof(cgroup) - 1);
+  cgroup[sizeof(cgroup) - 1] = 0;
+  opts.cgroup = cgroup;
+  m.strlen.func = strlen;
+  assert_eq(-1, setup_cgroups(&opts));
+  assert_eq(0, m.write_cgroup_file.call_count);
+}
+
+test(setup_cgroups_shall_return_negative_1_if_controllers_are_missing)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  m.write_cgroup_file.retval = -1;
+  assert_eq(-1, setup_cgroups(&opts));
+#ifdef CUTEST_GCC
+  assert_eq(1, m.fprintf.call_count);
+#endif
+  assert_eq(stderr, m.fprintf.args.arg0);
+}
+
+/*****************************************************************************
+ * prepare_cgroup()
+ */
+test(prepare_cgroup_shall_do_nothing_without_a_cgroup)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(0, prepare_cgroup(&opts, 0));
+  assert_eq(0, m.mkdir.call_count);
+}
+
+test(prepare_cgroup_shall_replace_the_cgroup_of_the_previous_runner)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  assert_eq(0, prepare_cgroup(&opts, 2));
+  assert_eq(1, m.rmdir.call_count);
+  assert_eq(1, m.mkdir.call_count);
+  assert_eq(2, m.get_cgroup_path.args.arg2);
+}
+
+test(prepare_cgroup_shall_return_negative_1_if_it_can_not_be_created)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  m.mkdir.retval = -1;
+  assert_eq(-1, prepare_cgroup(&opts, 0));
+  assert_eq(0, m.write_cgroup_file.call_count);
+}
+
+test(prepare_cgroup_shall_only_limit_the_cores_by_default)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  assert_eq(0, prepare_cgroup(&opts, 0));
+  assert_eq(1, m.write_cgroup_file.call_count);
+  assert_eq("/cpu.max", m.get_cgroup_path.args.arg3);
+  assert_eq("100000 100000", m.write_cgroup_file.args.arg1);
+}
+
+test(prepare_cgroup_shall_limit_the_memory_without_swap)
+{
+  char value[32];
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  opts.limit_memory = 512;
+  m.sprintf.func = sprintf;
+  assert_eq(0, prepare_cgroup(&opts, 0));
+  assert_eq(3, m.write_cgroup_file.call_count);
+  sprintf(value, "%ld", 512L * 1024 * 1024);
+  assert_eq(value, (char*)m.sprintf.args.arg0);
+}
+
+test(prepare_cgroup_shall_return_negative_1_if_the_memory_is_not_limited)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  opts.limit_memory = 512;
+  m.write_cgroup_file.retval = -1;
+  assert_eq(-1, prepare_cgroup(&opts, 0));
+  assert_eq(1, m.write_cgroup_file.call_count);
+}
+
+/*****************************************************************************
+ * remove_cgroups()
+ */
+test(remove_cgroups_shall_do_nothing_without_a_cgroup)
+{
+  cutest_work_opts_t opts = {0};
+  remove_cgroups(&opts, 4);
+  assert_eq(0, m.rmdir.call_count);
+}
+
+test(remove_cgroups_shall_remove_the_cgroup_of_every_worker)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  remove_cgroups(&opts, 4);
+  assert_eq(4, m.rmdir.call_count);
+  assert_eq(3, m.get_cgroup_path.args.arg2);
+}
+
+/*****************************************************************************
+ * apply_limits()
+ */
+test(apply_limits_shall_not_limit_anything_by_default)
+{
+  cutest_work_opts_t opts = {0};
+  assert_eq(0, apply_limits(&opts, 0));
+  assert_eq(0, m.set_limit.call_count);
+  assert_eq(0, m.write_cgroup_file.call_count);
+}
+
+test(apply_limits_shall_limit_the_address_space_without_a_cgroup)
+{
+  cutest_work_opts_t opts = {0};
+  opts.limit_memory = 512;
+  assert_eq(0, apply_limits(&opts, 0));
+  assert_eq(1, m.set_limit.call_count);
+  assert_eq(RLIMIT_AS, m.set_limit.args.arg0);
+  assert_eq((rlim_t)512 * 1024 * 1024, m.set_limit.args.arg1);
+  assert_eq((rlim_t)512 * 1024 * 1024, m.set_limit.args.arg2);
+}
+
+test(apply_limits_shall_join_the_cgroup_instead_of_limiting_address_space)
+{
+  cutest_work_opts_t opts = {0};
+  opts.limit_memory = 512;
+  opts.cgroup = "/cg";
+  assert_eq(0, apply_limits(&opts, 2));
+  assert_eq(0, m.set_limit.call_count);
+  assert_eq(1, m.write_cgroup_file.call_count);
+  assert_eq("/cgroup.procs", m.get_cgroup_path.args.arg3);
+  assert_eq(2, m.get_cgroup_path.args.arg2);
+}
+
+test(apply_limits_shall_kill_a_second_after_the_cpu_time_limit)
+{
+  cutest_work_opts_t opts = {0};
+  opts.limit_cpu = 60;
+  assert_eq(0, apply_limits(&opts, 0));
+  assert_eq(RLIMIT_CPU, m.set_limit.args.arg0);
+  assert_eq(60, m.set_limit.args.arg1);
+  assert_eq(61, m.set_limit.args.arg2);
+}
+
+test(apply_limits_shall_limit_the_open_files)
+{
+  cutest_work_opts_t opts = {0};
+  opts.limit_files = 256;
+  assert_eq(0, apply_limits(&opts, 0));
+  assert_eq(RLIMIT_NOFILE, m.set_limit.args.arg0);
+  assert_eq(256, m.set_limit.args.arg1);
+  assert_eq(256, m.set_limit.args.arg2);
+}
+
+test(apply_limits_shall_return_negative_1_if_a_limit_can_not_be_set)
+{
+  cutest_work_opts_t opts = {0};
+  opts.limit_files = 256;
+  m.set_limit.retval = -1;
+  assert_eq(-1, apply_limits(&opts, 0));
+}
+
+test(apply_limits_shall_return_negative_1_if_the_cgroup_can_not_be_joined)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  m.write_cgroup_file.retval = -1;
+  assert_eq(-1, apply_limits(&opts, 0));
+}
+
+/*****************************************************************************
+ * new_worker_pool()
+ */
+test(new_worker_pool_shall_return_null_if_out_of_memory)
+{
+  assert_eq(NULL, new_worker_pool(4));
+}
+
+test(new_worker_pool_shall_allocate_one_slot_per_worker)
+{
+  cutest_work_pool_t pool;
+  pid_t pid[192];
+  m.malloc.retval = &pool;
+  m.calloc.retval = pid;
+  assert_eq(&pool, new_worker_pool(192));
+  assert_eq(3, m.calloc.call_count);
+  assert_eq(192, m.calloc.args.arg0);
+  assert_eq(192, pool.workers);
+  assert_eq(0, pool.running);
+  assert_eq(NULL, pool.agent);
+}
+
+test(new_worker_pool_shall_delete_the_pool_if_slots_can_not_be_allocated)
+{
+  cutest_work_pool_t pool;
+  m.malloc.retval = &pool;
+  assert_eq(NULL, new_worker_pool(192));
+  assert_eq(1, m.delete_worker_pool.call_count);
+  assert_eq(&pool, m.delete_worker_pool.args.arg0);
+}
+
+/*****************************************************************************
+ * delete_worker_pool()
+ */
+test(delete_worker_pool_shall_free_all_memory)
+{
+  cutest_work_pool_t pool = {0, 0, (pid_t*)0x1234, (int*)0x5678,
+                             (double*)0x9abc, (int*)0xdef0, (int*)0x1111,
+                             (int*)0x2222, (int*)0x3333};
+  delete_worker_pool(&pool);
+  assert_eq(8, m.free.call_count);
+  assert_eq(&pool, m.free.args.arg0);
+}
+
+/*****************************************************************************
+ * assign_agents()
+ */
+test(assign_agents_shall_do_nothing_without_agents)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  assert_eq(0, assign_agents(&pool, NULL, 0, 2));
+  assert_eq(0, m.calloc.call_count);
+  assert_eq(NULL, pool.agent);
+}
+
+test(assign_agents_shall_give_the_agents_the_slots_after_the_local_ones)
+{
+  int agent[3] = {7, 8, 9};
+  cutest_work_pool_t pool = {4, 0, NULL, NULL, NULL, NULL};
+  m.calloc.func = calloc;
+  assert_eq(0, assign_agents(&pool, agent, 3, 2));
+  assert_eq(0, pool.agent[0]);
+  assert_eq(0, pool.agent[1]);
+  assert_eq(7, pool.agent[2]);
+  assert_eq(8, pool.agent[3]);
+  free(pool.agent);
+}
+
+test(assign_agents_shall_return_negative_1_if_out_of_memory)
+{
+  int agent[1] = {7};
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  assert_eq(-1, assign_agents(&pool, agent, 1, 1));
+}
+
+/*****************************************************************************
+ * launch_test_suite()
+ */
+test(launch_test_suite_shall_spawn_the_item_in_a_free_slot)
+{
+  pid_t pid[3] = {11, 0, 0};
+  int item[3] = {0, 0, 0};
+  double started[3] = {0.0, 0.0, 0.0};
+  cutest_work_pool_t pool = {3, 1, pid, item, started, NULL};
+  cutest_work_item_t items[2];
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  m.spawn_test_suite.retval = 4711;
+  assert_eq(1, launch_test_suite(&pool, &queue, 1, &opts));
+  assert_eq(&items[1], m.spawn_test_suite.args.arg0);
+  assert_eq(&opts, m.spawn_test_suite.args.arg1);
+  assert_eq(1, m.spawn_test_suite.args.arg2);
+  assert_eq(4711, pid[1]);
+  assert_eq(1, item[1]);
+  assert_eq(2, pool.running);
+}
+
+static int pipe_stub(int fd[2])
+{
+  fd[0] = 5;
+  fd[1] = 6;
+  return 0;
+}
+
+test(launch_test_suite_shall_give_the_runner_a_pipe_if_watched)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  int out[1] = {-1};
+  int done[1] = {3};
+  int failed[1] = {1};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL, out, done,
+                             failed};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.open_output.func = open_output;
+  m.pipe.func = pipe_stub;
+  m.spawn_test_suite.retval = 4711;
+  assert_eq(0, launch_test_suite(&pool, &queue, 0, &opts));
+  assert_eq(1, m.spawn_test_suite.args.arg2); /* Log to file */
+  assert_eq(6, m.spawn_test_suite.args.arg5);
+  assert_eq(1, m.close.call_count);
+  assert_eq(6, m.close.args.arg0);
+  assert_eq(5, out[0]);
+  assert_eq(0, done[0]);
+  assert_eq(0, failed[0]);
+}
+
+test(launch_test_suite_shall_record_when_the_item_was_started)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.spawn_test_suite.retval = 4711;
+  m.get_time.retval = 12.5;
+  launch_test_suite(&pool, &queue, 0, &opts);
+  assert_eq(12.5, started[0]);
+}
+
+test(launch_test_suite_shall_not_log_to_file_with_a_single_worker)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.spawn_test_suite.retval = 4711;
+  launch_test_suite(&pool, &queue, 0, &opts);
+  assert_eq(0, m.spawn_test_suite.args.arg2);
+}
+
+test(launch_test_suite_shall_return_negative_1_if_all_workers_are_busy)
+{
+  pid_t pid[2] = {11, 12};
+  int item[2] = {0, 0};
+  cutest_work_pool_t pool = {2, 2, pid, item, NULL, NULL};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  assert_eq(-1, launch_test_suite(&pool, &queue, 0, &opts));
+  assert_eq(0, m.spawn_test_suite.call_count);
+}
+
+test(launch_test_suite_shall_prepare_the_cgroup_of_the_slot)
+{
+  pid_t pid[2] = {11, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 1, pid, item, started, NULL};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.spawn_test_suite.retval = 4711;
+  launch_test_suite(&pool, &queue, 0, &opts);
+  assert_eq(1, m.prepare_cgroup.call_count);
+  assert_eq(1, m.prepare_cgroup.args.arg1);
+  assert_eq(1, m.spawn_test_suite.args.arg3);
+}
+
+test(launch_test_suite_shall_return_negative_1_if_cgroup_fails)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  cutest_work_pool_t pool = {1, 0, pid, item, NULL, NULL};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.prepare_cgroup.retval = -1;
+  assert_eq(-1, launch_test_suite(&pool, &queue, 0, &opts));
+  assert_eq(0, m.spawn_test_suite.call_count);
+}
+
+test(launch_test_suite_shall_return_negative_1_if_spawn_fails)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  cutest_work_pool_t pool = {2, 0, pid, item, NULL, NULL};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.spawn_test_suite.retval = -1;
+  assert_eq(-1, launch_test_suite(&pool, &queue, 0, &opts));
+  assert_eq(0, pool.running);
+}
+
+test(launch_test_suite_shall_let_the_agent_of_the_slot_run_the_item)
+{
+  pid_t pid[2] = {11, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  int agent[2] = {0, 7};
+  cutest_work_pool_t pool = {2, 1, pid, item, started, agent};
+  cutest_work_item_t items[1];
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  m.spawn_test_suite.retval = 4711;
+  assert_eq(1, launch_test_suite(&pool, &queue, 0, &opts));
+  assert_eq(0, m.prepare_cgroup.call_count);
+  assert_eq(7, m.spawn_test_suite.args.arg4);
+  assert_eq(4711, pid[1]);
+}
+
+/*****************************************************************************
+ * wait_for_test_suite()
+ */
+test(wait_for_test_suite_shall_block_if_told_to)
+{
+  cutest_work_pool_t pool = {0, 0, NULL, NULL, NULL, NULL};
+  int status;
+  wait_for_test_suite(&pool, &status, 1);
+  assert_eq(1, m.waitpid.call_count);
+  assert_eq(-1, m.waitpid.args.arg0);
+  assert_eq(&status, m.waitpid.args.arg1);
+  assert_eq(0, m.waitpid.args.arg2);
+}
+
+test(wait_for_test_suite_shall_not_block_if_told_not_to)
+{
+  cutest_work_pool_t pool = {0, 0, NULL, NULL, NULL, NULL};
+  int status;
+  wait_for_test_suite(&pool, &status, 0);
+  assert_eq(WNOHANG, m.waitpid.args.arg2);
+}
+
+test(wait_for_test_suite_shall_return_negative_1_if_nothing_finished)
+{
+  cutest_work_pool_t pool = {0, 0, NULL, NULL, NULL, NULL};
+  int status;
+  m.waitpid.retval = 0;
+  assert_eq(-1, wait_for_test_suite(&pool, &status, 0));
+}
+
+test(wait_for_test_suite_shall_free_the_slot_of_the_finished_suite)
+{
+  pid_t pid[3] = {11, 12, 13};
+  int item[3] = {2, 3, 4};
+  cutest_work_pool_t pool = {3, 3, pid, item, NULL, NULL};
+  int status;
+  m.waitpid.retval = 12;
+  assert_eq(1, wait_for_test_suite(&pool, &status, 1));
+  assert_eq(0, pid[1]);
+  assert_eq(2, pool.running);
+}
+
+/*****************************************************************************
+ * stop_test_suites()
+ */
+test(stop_test_suites_shall_signal_all_running_suites)
+{
+  pid_t pid[3] = {11, 0, 13};
+  int item[3] = {2, 0, 4};
+  cutest_work_pool_t pool = {3, 2, pid, item, NULL, NULL};
+  stop_test_suites(&pool);
+  assert_eq(2, m.kill.call_count);
+  assert_eq(13, m.kill.args.arg0);
+  assert_eq(SIGUSR1, m.kill.args.arg1);
+}
+
+/*****************************************************************************
+ * record_duration()
+ */
+test(record_duration_shall_add_the_time_of_a_batch_to_its_suite)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {10.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 100, .elapsed = 1.0,
+                               .elapsed_tests = 10};
+  cutest_work_item_t items[1] = {{&suite, 0, 10, 10, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  m.get_time.retval = 12.5;
+  m.get_item_test_cnt.func = get_item_test_cnt;
+  record_duration(&pool, &queue, 0);
+  assert_eq(3.5, suite.elapsed);
+  assert_eq(20, suite.elapsed_tests);
+}
+
+test(record_duration_shall_count_all_tests_of_a_whole_suite)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {10.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 100};
+  cutest_work_item_t items[1] = {{&suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  m.get_item_test_cnt.func = get_item_test_cnt;
+  record_duration(&pool, &queue, 0);
+  assert_eq(100, suite.elapsed_tests);
+}
+
+test(record_duration_shall_return_the_time_of_the_item)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {10.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 100};
+  cutest_work_item_t items[1] = {{&suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  m.get_time.retval = 12.5;
+  assert_eq(2.5, record_duration(&pool, &queue, 0));
+}
+
+/*****************************************************************************
+ * open_report()
+ */
+test(open_report_shall_not_open_a_file_if_no_junit_report)
+{
+  cutest_work_report_t report;
+  m.memset.func = memset;
+  m.get_time.retval = 5.0;
+  assert_eq(0, open_report(&report, NULL));
+  assert_eq(0, m.fopen.call_count);
+  assert_eq(NULL, report.junit);
+  assert_eq(5.0, report.started);
+}
+
+test(open_report_shall_return_negative_1_if_file_can_not_be_opened)
+{
+  cutest_work_report_t report;
+  assert_eq(-1, open_report(&report, "all.xml"));
+  assert_eq("all.xml", m.fopen.args.arg0);
+  assert_eq("w", m.fopen.args.arg1);
+}
+
+test(open_report_shall_write_the_start_of_the_merged_report_right_away)
+{
+  cutest_work_report_t report;
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, open_report(&report, "all.xml"));
+  assert_eq((FILE*)0x1234, report.junit);
+  assert_eq(1, m.fflush.call_count);
+  assert_eq((FILE*)0x1234, m.fflush.args.arg0);
+}
+
+/*****************************************************************************
+ * is_report_line()
+ */
+module_test(is_report_line_shall_only_match_the_tag_at_its_indentation)
+{
+  assert_eq(1, is_report_line("    <testcase name=\"a\">\n", "    <testcase "));
+  assert_eq(0, is_report_line("<testcase name=\"a\">\n", "    <testcase "));
+}
+
+/*****************************************************************************
+ * open_junit_report()
+ */
+static cutest_work_suite_t report_suite = {.name = "suite_name"};
+static cutest_work_item_t report_item = {&report_suite, -1, 0, 0, 0, 0};
+
+test(open_junit_report_shall_open_the_junit_report_of_the_suite)
+{
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.malloc.retval = buf;
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq((FILE*)0x1234, open_junit_report(&report_item));
+  assert_eq("suite_name.junit_report.xml", buf);
+  assert_eq(buf, m.fopen.args.arg0);
+  assert_eq("r", m.fopen.args.arg1);
+  assert_eq(1, m.free.call_count);
+}
+
+test(open_junit_report_shall_open_the_junit_report_of_the_batch)
+{
+  cutest_work_item_t item = {&report_suite, 3, 0, 0, 0, 0};
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.format_batch_name.func = format_batch_name;
+  m.malloc.retval = buf;
+  open_junit_report(&item);
+  assert_eq("suite_name.3.junit_report.xml", buf);
+}
+
+test(open_junit_report_shall_output_an_error_message_if_out_of_memory)
+{
+  assert_eq(NULL, open_junit_report(&report_item));
+  assert_eq(0, m.fopen.call_count);
+#ifdef CUTEST_GCC
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq(stderr, m.fwrite.args.arg3);
+#else
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq(stderr, m.fprintf.args.arg0);
+#endif
+}
+
+/*****************************************************************************
+ * add_to_report()
+ */
+static char* fgets_junit_stub(char* s, int size, FILE *stream)
+{
+  const char* rows[] = {"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n",
+                        "<testsuites>\n",
+                        "  <testsuite name=\"suite_name.c\"\n",
+                        "             timestamp=\"2026-10-18T12:00:00\">\n",
+                        "    <testcase classname=\"a\" name=\"b\" "
+                        "time=\"0.5\">\n",
+                        "    </testcase>\n",
+                        "    <testcase classname=\"a\" name=\"c\" "
+                        "time=\"0.25\">\n",
+                        "       <failure message=\"test failure\">\n",
+                        "<testcase printed by the test\n",
+                        "       </failure>\n",
+                        "    </testcase>\n",
+                        "    <testcase classname=\"a\" name=\"d\" "
+                        "time=\"0.0\">\n",
+                        "       <skipped/>\n",
+                        "    </testcase>\n",
+                        "  </testsuite>\n",
+                        "</testsuites>\n"};
+  static int row = 0;
+  (void)stream;
+  if (row == sizeof(rows) / sizeof(rows[0])) {
+    row = 0; /* Like a rewind() */
+    return NULL;
+  }
+  snprintf(s, size, "%s", rows[row++]);
+  return s;
+}
+
+test(add_to_report_shall_add_up_the_verdicts_of_the_suite)
+{
+  cutest_work_report_t report = {NULL, 1, 0, 0, 0, 0, 0.0};
+  m.is_report_line.func = is_report_line;
+  m.open_junit_report.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_junit_stub;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  add_to_report(&report, &report_item, 0, 1.0);
+  assert_eq(4, report.tests); /* 1 from before */
+  assert_eq(1, report.failures);
+  assert_eq(0, report.errors);
+  assert_eq(1, report.skipped);
+  assert_eq(1, m.fclose.call_count);
+  assert_eq(0, m.fputs.call_count);
+}
+
+test(add_to_report_shall_copy_the_test_cases_to_the_merged_report)
+{
+  cutest_work_report_t report = {(FILE*)0x5678, 0, 0, 0, 0, 0, 0.0};
+  m.is_report_line.func = is_report_line;
+  m.open_junit_report.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_junit_stub;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  add_to_report(&report, &report_item, 2, 1.0);
+  assert_eq(1, m.rewind.call_count);
+  assert_eq(10, m.fputs.call_count);
+  assert_eq((FILE*)0x5678, m.fputs.args.arg1);
+  assert_eq(1, m.fflush.call_count);
+  assert_eq(1, m.fclose.call_count);
+}
+
+test(add_to_report_shall_not_add_anything_if_there_is_no_junit_report)
+{
+  cutest_work_report_t report = {(FILE*)0x5678, 0, 0, 0, 0, 0, 0.0};
+  add_to_report(&report, &report_item, 0, 1.0);
+  assert_eq(&report_item, m.open_junit_report.args.arg0);
+  assert_eq(0, m.fgets.call_count);
+  assert_eq(0, m.fflush.call_count);
+}
+
+static char* fgets_flaky_stub(char* s, int size, FILE *stream)
+{
+  const char* rows[] = {"  <testsuite name=\"suite_name.c\"\n",
+                        "    <testcase classname=\"a\" name=\"b\" "
+                        "time=\"0.5\">\n",
+                        "       <flakyFailure message=\"test failure\">\n",
+                        "       </flakyFailure>\n",
+                        "    </testcase>\n",
+                        "    <testcase classname=\"a\" name=\"c\" "
+                        "time=\"0.5\">\n",
+                        "       <flakyError message=\"segfault\">\n",
+                        "       </flakyError>\n",
+                        "    </testcase>\n",
+                        "  </testsuite>\n"};
+  static int row = 0;
+  (void)stream;
+  if (row == sizeof(rows) / sizeof(rows[0])) {
+    row = 0;
+    return NULL;
+  }
+  snprintf(s, size, "%s", rows[row++]);
+  return s;
+}
+
+test(add_to_report_shall_count_the_flaky_tests_as_passed)
+{
+  cutest_work_report_t report = {NULL, 0, 0, 0, 0, 0, 0.0};
+  m.is_report_line.func = is_report_line;
+  m.open_junit_report.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_flaky_stub;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  add_to_report(&report, &report_item, 0, 1.0);
+  assert_eq(2, report.tests);
+  assert_eq(0, report.failures);
+  assert_eq(0, report.errors);
+  assert_eq(2, report.flaky);
+}
+
+/*****************************************************************************
+ * skip_unchanged_suites()
+ */
+test(skip_unchanged_suites_shall_run_everything_the_first_time)
+{
+  assert_eq(0, skip_unchanged_suites("clean.txt", NULL, 0));
+  assert_eq("clean.txt", m.fopen.args.arg0);
+  assert_eq(0, m.fgets.call_count);
+}
+
+module_test(skip_unchanged_suites_shall_only_skip_the_same_runners)
+{
+  cutest_work_suite_t suite[2] = {{.name = "skip_unchanged_a"},
+                                  {.name = "skip_unchanged_b"}};
+  char hash[NET_HASH_LEN];
+  FILE* fd = fopen("skip_unchanged_a", "w");
+  fputs("runner a", fd);
+  fclose(fd);
+  fd = fopen("skip_unchanged_b", "w");
+  fputs("runner b", fd);
+  fclose(fd);
+  get_file_hash(hash, "skip_unchanged_a");
+  fd = fopen("skip_unchanged.txt", "w");
+  fprintf(fd, "%s skip_unchanged_a\n", hash);
+  fprintf(fd, "%s skip_unchanged_b\n", hash);
+  fclose(fd);
+  assert_eq(0, skip_unchanged_suites("skip_unchanged.txt", suite, 2));
+  unlink("skip_unchanged_a");
+  unlink("skip_unchanged_b");
+  unlink("skip_unchanged.txt");
+  assert_eq(CUTEST_WORK_RUN_NONE, suite[0].run);
+  assert_eq(1, suite[0].clean);
+  assert_eq(CUTEST_WORK_RUN_ALL, suite[1].run);
+  assert_eq(0, suite[1].clean);
+}
+
+/*****************************************************************************
+ * write_clean_suites()
+ */
+test(write_clean_suites_shall_return_negative_1_if_file_can_not_be_opened)
+{
+  assert_eq(-1, write_clean_suites("clean.txt", NULL, 0));
+}
+
+test(write_clean_suites_shall_write_the_runners_that_passed)
+{
+  cutest_work_suite_t suite[4] = {{.name = "/src/a_test"},
+                                  {.name = "/src/b_test", .failed = 1},
+                                  {.name = "/src/c_test", .clean = 1,
+                                   .run = CUTEST_WORK_RUN_NONE},
+                                  {.name = "/src/d_test",
+                                   .run = CUTEST_WORK_RUN_SOME}};
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, write_clean_suites("clean.txt", suite, 4));
+  assert_eq(2, m.get_file_hash.call_count);
+  assert_eq("/src/c_test", m.get_file_hash.args.arg1);
+  assert_eq(1, m.fclose.call_count);
+}
+
+/*****************************************************************************
+ * fold_hash()
+ */
+module_test(fold_hash_shall_keep_the_strings_apart)
+{
+  unsigned long long a = 14695981039346656037ULL;
+  unsigned long long b = 14695981039346656037ULL;
+  fold_hash(&a, "ab");
+  fold_hash(&a, "");
+  fold_hash(&b, "a");
+  fold_hash(&b, "b");
+  assert_eq(1, a != b);
+}
+
+/*****************************************************************************
+ * get_result_key()
+ */
+static int get_file_hash_stub(char* hash, const char* file_name)
+{
+  strcpy(hash, file_name);
+  return 0;
+}
+
+static char* getenv_tz_stub(const char* name)
+{
+  return (0 == strcmp("TZ", name)) ? "UTC" : NULL;
+}
+
+test(get_result_key_shall_return_negative_1_if_the_runner_can_not_be_read)
+{
+  char key[NET_HASH_LEN];
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite = {.name = "a_test"};
+  m.get_file_hash.retval = -1;
+  assert_eq(-1, get_result_key(key, &opts, &suite));
+  assert_eq("a_test", m.get_file_hash.args.arg1);
+}
+
+test(get_result_key_shall_hash_the_inputs_of_the_runner)
+{
+  char key[NET_HASH_LEN];
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite = {.name = "a_test"};
+  opts.cache_inputs = "a.bin::b.bin";
+  m.get_file_hash.func = get_file_hash_stub;
+  m.get_suite_name.func = get_suite_name;
+  m.strrchr.func = strrchr;
+  m.fold_hash.func = fold_hash;
+  m.strcspn.func = strcspn;
+  m.strncpy.func = strncpy;
+  m.sprintf.func = sprintf;
+  assert_eq(0, get_result_key(key, &opts, &suite));
+  assert_eq(3, m.get_file_hash.call_count);
+  assert_eq("b.bin", m.get_file_hash.args.arg1);
+  assert_eq(16, strlen(key));
+}
+
+test(get_result_key_shall_depend_on_the_environment)
+{
+  char key_a[NET_HASH_LEN];
+  char key_b[NET_HASH_LEN];
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite = {.name = "a_test"};
+  m.get_file_hash.func = get_file_hash_stub;
+  m.get_suite_name.func = get_suite_name;
+  m.strrchr.func = strrchr;
+  m.fold_hash.func = fold_hash;
+  m.sprintf.func = sprintf;
+  assert_eq(0, get_result_key(key_a, &opts, &suite));
+  m.getenv.func = getenv_tz_stub;
+  assert_eq(0, get_result_key(key_b, &opts, &suite));
+  assert_eq(1, 0 != strcmp(key_a, key_b));
+}
+
+test(get_result_key_shall_depend_on_how_the_runner_is_run)
+{
+  char key_a[NET_HASH_LEN];
+  char key_b[NET_HASH_LEN];
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite = {.name = "a_test"};
+  m.get_file_hash.func = get_file_hash_stub;
+  m.get_suite_name.func = get_suite_name;
+  m.strrchr.func = strrchr;
+  m.fold_hash.func = fold_hash;
+  m.sprintf.func = sprintf;
+  assert_eq(0, get_result_key(key_a, &opts, &suite));
+  opts.verbose = 2;
+  assert_eq(0, get_result_key(key_b, &opts, &suite));
+  assert_eq(1, 0 != strcmp(key_a, key_b));
+}
+
+/*****************************************************************************
+ * skip_cached_suites()
+ */
+test(skip_cached_suites_shall_only_skip_the_suites_with_a_result)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite[3] = {{.name = "a_test"},
+                                  {.name = "b_test",
+                                   .run = CUTEST_WORK_RUN_SOME},
+                                  {.name = "c_test"}};
+  opts.results = "cutest_results";
+  m.access.retval = 0;
+  assert_eq(0, skip_cached_suites(&opts, suite, 3));
+  assert_eq(2, m.get_result_key.call_count);
+  assert_eq(2, m.utime.call_count);
+  assert_eq(CUTEST_WORK_RUN_NONE, suite[0].run);
+  assert_eq(1, suite[0].cached);
+  assert_eq(CUTEST_WORK_RUN_SOME, suite[1].run);
+  assert_eq(0, suite[1].cached);
+}
+
+test(skip_cached_suites_shall_run_the_suites_without_a_result)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite[1] = {{.name = "a_test"}};
+  opts.results = "cutest_results";
+  m.access.retval = -1;
+  assert_eq(0, skip_cached_suites(&opts, suite, 1));
+  assert_eq(0, m.utime.call_count);
+  assert_eq(CUTEST_WORK_RUN_ALL, suite[0].run);
+  assert_eq(0, suite[0].cached);
+}
+
+/*****************************************************************************
+ * evict_results()
+ */
+test(evict_results_shall_return_negative_1_if_the_directory_can_not_be_read)
+{
+  assert_eq(-1, evict_results("cutest_results", 10));
+}
+
+module_test(evict_results_shall_remove_the_results_used_the_longest_time_ago)
+{
+  struct utimbuf times = {0, 0};
+  const char* key[3] = {"0000000000000001", "0000000000000002",
+                        "0000000000000003"};
+  char path[64];
+  int i;
+  mkdir("evict_results", 0755);
+  for (i = 0; i < 3; i++) {
+    FILE* fd = NULL;
+    sprintf(path, "evict_results/%s", key[i]);
+    fd = fopen(path, "w");
+    fclose(fd);
+    times.actime = times.modtime = 1000 + i;
+    utime(path, &times);
+  }
+  fclose(fopen("evict_results/not_a_result", "w"));
+  assert_eq(0, evict_results("evict_results", 1));
+  assert_eq(-1, access("evict_results/0000000000000001", F_OK));
+  assert_eq(-1, access("evict_results/0000000000000002", F_OK));
+  assert_eq(0, access("evict_results/0000000000000003", F_OK));
+  assert_eq(0, access("evict_results/not_a_result", F_OK));
+  unlink("evict_results/0000000000000003");
+  unlink("evict_results/not_a_result");
+  rmdir("evict_results");
+}
+
+/*****************************************************************************
+ * write_cached_suites()
+ */
+test(write_cached_suites_shall_return_negative_1_if_there_is_no_directory)
+{
+  cutest_work_opts_t opts = {0};
+  opts.results = "cutest_results";
+  m.mkdir.retval = -1;
+  m.access.retval = -1;
+  assert_eq(-1, write_cached_suites(&opts, NULL, 0));
+  assert_eq(0, m.evict_results.call_count);
+}
+
+test(write_cached_suites_shall_write_the_suites_that_passed)
+{
+  cutest_work_opts_t opts = {0};
+  cutest_work_suite_t suite[4] = {{.name = "a_test"},
+                                  {.name = "b_test", .failed = 1},
+                                  {.name = "c_test", .cached = 1,
+                                   .run = CUTEST_WORK_RUN_NONE},
+                                  {.name = "d_test",
+                                   .run = CUTEST_WORK_RUN_SOME}};
+  opts.results = "cutest_results";
+  opts.results_max = 10;
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, write_cached_suites(&opts, suite, 4));
+  assert_eq(1, m.get_result_key.call_count);
+  assert_eq(&suite[0], m.get_result_key.args.arg2);
+  assert_eq(1, m.fclose.call_count);
+  assert_eq(1, m.evict_results.call_count);
+  assert_eq("cutest_results", m.evict_results.args.arg0);
+  assert_eq(10, m.evict_results.args.arg1);
+}
+
+/*****************************************************************************
+ * get_xml_text()
+ */
+module_test(get_xml_text_shall_get_the_text_of_a_tag)
+{
+  char buf[16];
+  get_xml_text(buf, "  <kind>InvalidRead</kind>\n", "<kind>", sizeof(buf));
+  assert_eq("InvalidRead", buf);
+  get_xml_text(buf, "  <what>Invalid read of size 4</what>\n", "<kind>",
+               sizeof(buf));
+  assert_eq("", buf);
+  get_xml_text(buf, "  <what>Invalid read of size 4</what>\n", "<what>",
+               sizeof(buf));
+  assert_eq("Invalid read of", buf);
+}
+
+/*****************************************************************************
+ * find_test_frame()
+ */
+module_test(find_test_frame_shall_find_the_test_of_the_batch)
+{
+  char* test[3] = {"t0", "t1", "t2"};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 3, .test = test};
+  cutest_work_item_t item = {&suite, 1, 1, 2, 0, 0};
+  assert_eq(2, find_test_frame(&item, "cutest_t2"));
+  assert_eq(-1, find_test_frame(&item, "cutest_t0"));
+  assert_eq(-1, find_test_frame(&item, "t1"));
+  assert_eq(-1, find_test_frame(&item, "cutest_execute_test"));
+}
+
+/*****************************************************************************
+ * read_memcheck_errors()
+ */
+test(read_memcheck_errors_shall_return_null_if_there_is_no_xml)
+{
+  char buf[128];
+  int cnt = 1;
+  m.malloc.retval = buf;
+  assert_eq(NULL, read_memcheck_errors(&report_item, &cnt));
+  assert_eq(0, cnt);
+}
+
+module_test(read_memcheck_errors_shall_find_the_test_of_every_error)
+{
+  const char* xml =
+    "<valgrindoutput>\n"
+    "<error>\n"
+    "  <kind>InvalidRead</kind>\n"
+    "  <what>Invalid read of size 4</what>\n"
+    "  <stack>\n"
+    "    <frame>\n"
+    "      <fn>dut</fn>\n"
+    "    </frame>\n"
+    "    <frame>\n"
+    "      <fn>cutest_t1</fn>\n"
+    "    </frame>\n"
+    "  </stack>\n"
+    "</error>\n"
+    "<error>\n"
+    "  <kind>Leak_DefinitelyLost</kind>\n"
+    "  <xwhat>\n"
+    "    <text>8 bytes are definitely lost</text>\n"
+    "  </xwhat>\n"
+    "  <stack>\n"
+    "    <frame>\n"
+    "      <fn>main</fn>\n"
+    "    </frame>\n"
+    "  </stack>\n"
+    "</error>\n"
+    "</valgrindoutput>\n";
+  char* test[2] = {"t0", "t1"};
+  cutest_work_suite_t suite = {.name = "read_memcheck", .test_cnt = 2,
+                               .test = test};
+  cutest_work_item_t item = {&suite, -1, 0, 0, 0, 0};
+  cutest_work_memcheck_t* error = NULL;
+  FILE* fd = fopen("read_memcheck.valgrind.xml", "w");
+  int cnt = 0;
+  fputs(xml, fd);
+  fclose(fd);
+  error = read_memcheck_errors(&item, &cnt);
+  unlink("read_memcheck.valgrind.xml");
+  assert_eq(2, cnt);
+  assert_eq(1, error[0].test);
+  assert_eq("InvalidRead", error[0].kind);
+  assert_eq("Invalid read of size 4", error[0].what);
+  assert_eq(-1, error[1].test);
+  assert_eq("8 bytes are definitely lost", error[1].what);
+  free(error);
+}
+
+/*****************************************************************************
+ * count_memcheck_errors()
+ */
+module_test(count_memcheck_errors_shall_count_the_errors_of_a_test)
+{
+  char* test[2] = {"t0", "t1"};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 2, .test = test};
+  cutest_work_item_t item = {&suite, -1, 0, 0, 0, 0};
+  cutest_work_memcheck_t error[3] = {{1, "", ""}, {-1, "", ""}, {1, "", ""}};
+  assert_eq(2, count_memcheck_errors(&item, error, 3, "t1"));
+  assert_eq(0, count_memcheck_errors(&item, error, 3, "t0"));
+  assert_eq(1, count_memcheck_errors(&item, error, 3, NULL));
+}
+
+/*****************************************************************************
+ * add_to_report() with Valgrind errors
+ */
+static cutest_work_memcheck_t* read_memcheck_errors_stub(
+  const cutest_work_item_t* item, int* cnt)
+{
+  static cutest_work_memcheck_t error[2] = {{0, "InvalidRead", "Invalid"},
+                                            {-1, "Leak", "Lost"}};
+  cutest_work_memcheck_t* copy = malloc(sizeof(error));
+  (void)item;
+  memcpy(copy, error, sizeof(error));
+  *cnt = 2;
+  return copy;
+}
+
+test(add_to_report_shall_add_the_valgrind_errors_to_the_tests)
+{
+  char* test[3] = {"b", "c", "d"};
+  cutest_work_suite_t suite = {.name = "suite_name", .test_cnt = 3,
+                               .test = test};
+  cutest_work_item_t item = {&suite, -1, 0, 0, 0, 0};
+  cutest_work_report_t report = {NULL, 0, 0, 0, 0, 0, 0.0, 1};
+  m.is_report_line.func = is_report_line;
+  m.open_junit_report.retval = (FILE*)0x1234;
+  m.read_memcheck_errors.func = read_memcheck_errors_stub;
+  m.count_memcheck_errors.func = count_memcheck_errors;
+  m.get_name_attribute.func = get_name_attribute;
+  m.fgets.func = fgets_junit_stub;
+  m.strstr.func = strstr;
+  m.strcspn.func = strcspn;
+  m.strncpy.func = strncpy;
+  m.strncmp.func = strncmp;
+  m.strcmp.func = strcmp;
+  m.strlen.func = strlen;
+  m.free.func = free;
+  add_to_report(&report, &item, 0, 1.0);
+  assert_eq(4, report.tests); /* The leak outside of the tests is one */
+  assert_eq(1, report.failures);
+  assert_eq(2, report.errors);
+  assert_eq(1, m.print_memcheck_errors.call_count);
+}
+
+/*****************************************************************************
+ * get_name_attribute()
+ */
+module_test(get_name_attribute_shall_get_the_name_of_a_test_case)
+{
+  char buf[16];
+  get_name_attribute(buf, "    <testcase classname=\"a\" name=\"b_c\">\n",
+                     sizeof(buf));
+  assert_eq("b_c", buf);
+}
+
+module_test(get_name_attribute_shall_get_an_empty_name_if_there_is_none)
+{
+  char buf[16];
+  get_name_attribute(buf, "    <testcase classname=\"a\">\n", sizeof(buf));
+  assert_eq("", buf);
+}
+
+module_test(get_name_attribute_shall_get_an_empty_name_if_it_is_too_long)
+{
+  char buf[4];
+  get_name_attribute(buf, "  <testsuite name=\"suite_test\"\n", sizeof(buf));
+  assert_eq("", buf);
+}
+
+/*****************************************************************************
+ * find_test_suite()
+ */
+test(find_test_suite_shall_find_a_suite_by_its_file_name)
+{
+  cutest_work_suite_t suite[2] = {{.name = "/src/a_test"},
+                                  {.name = "/src/b_test"}};
+  m.get_suite_name.func = get_suite_name;
+  m.strrchr.func = strrchr;
+  m.strcmp.func = strcmp;
+  assert_eq(1, find_test_suite(suite, 2, "b_test"));
+  assert_eq(-1, find_test_suite(suite, 2, "c_test"));
+}
+
+/*****************************************************************************
+ * find_test()
+ */
+test(find_test_shall_find_a_test_by_its_name)
+{
+  char* test[2] = {"t0", "t1"};
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 2, .test = test};
+  m.strcmp.func = strcmp;
+  assert_eq(1, find_test(&suite, "t1"));
+  assert_eq(-1, find_test(&suite, "t2"));
+}
+
+/*****************************************************************************
+ * mark_failed_test()
+ */
+test(mark_failed_test_shall_mark_a_listed_test)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 2};
+  char failed[2] = {0, 0};
+  int whole = 0;
+  m.find_test.retval = 1;
+  mark_failed_test(&suite, failed, &whole, "t1");
+  assert_eq(1, failed[1]);
+  assert_eq(0, whole);
+}
+
+test(mark_failed_test_shall_mark_the_whole_suite_if_it_was_killed)
+{
+  cutest_work_suite_t suite = {.name = "/src/a_test", .test_cnt = 2};
+  char failed[2] = {0, 0};
+  int whole = 0;
+  m.find_test.retval = -1;
+  m.get_suite_name.func = get_suite_name;
+  m.strrchr.func = strrchr;
+  m.strcmp.func = strcmp;
+  mark_failed_test(&suite, failed, &whole, "a_test");
+  assert_eq(1, whole);
+}
+
+test(mark_failed_test_shall_mark_the_whole_suite_if_it_was_not_listed)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 0};
+  int whole = 0;
+  m.find_test.retval = -1;
+  mark_failed_test(&suite, NULL, &whole, "t1");
+  assert_eq(1, whole);
+}
+
+test(mark_failed_test_shall_ignore_unknown_tests)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 2};
+  char failed[2] = {0, 0};
+  int whole = 0;
+  m.find_test.retval = -1;
+  m.strcmp.retval = 1;
+  mark_failed_test(&suite, failed, &whole, "t2");
+  assert_eq(0, failed[0]);
+  assert_eq(0, failed[1]);
+  assert_eq(0, whole);
+}
+
+/*****************************************************************************
+ * keep_failed_tests()
+ */
+test(keep_failed_tests_shall_return_negative_1_if_there_is_no_last_run)
+{
+  assert_eq(-1, keep_failed_tests("all.xml", NULL, 0));
+  assert_eq("all.xml", m.fopen.args.arg0);
+  assert_eq(0, m.fgets.call_count);
+}
+
+module_test(keep_failed_tests_shall_only_keep_the_failed_tests)
+{
+  const char* file_name = "keep_failed_tests.xml";
+  char* rows[] = {"<testsuites>\n",
+                  "  <testsuite name=\"a_test\"\n",
+                  "    <testcase classname=\"a\" name=\"t0\">\n",
+                  "    </testcase>\n",
+                  "    <testcase classname=\"a\" name=\"t1\">\n",
+                  "       <failure message=\"test failure\">\n",
+                  "       </failure>\n",
+                  "    </testcase>\n",
+                  "  </testsuite>\n",
+                  "  <testsuite name=\"b_test\"\n",
+                  "    <testcase classname=\"b\" name=\"t0\">\n",
+                  "    </testcase>\n",
+                  "  </testsuite>\n",
+                  "  <testsuite name=\"c_test\"\n",
+                  "    <testcase classname=\"c\" name=\"c_test\">\n",
+                  "       <error message=\"killed by signal 9\"/>\n",
+                  "    </testcase>\n",
+                  "  </testsuite>\n",
+                  "</testsuites>\n"};
+  char** a = malloc(2 * sizeof(char*));
+  char** b = malloc(1 * sizeof(char*));
+  char** c = malloc(1 * sizeof(char*));
+  cutest_work_suite_t suite[3] = {{.name = "/src/a_test", .test_cnt = 2,
+                                   .test = a},
+                                  {.name = "/src/b_test", .test_cnt = 1,
+                                   .test = b},
+                                  {.name = "/src/c_test", .test_cnt = 1,
+                                   .test = c}};
+  FILE* fd = fopen(file_name, "w");
+  size_t i;
+  for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+    fputs(rows[i], fd);
+  }
+  fclose(fd);
+  a[0] = strdup("t0");
+  a[1] = strdup("t1");
+  b[0] = strdup("t0");
+  c[0] = strdup("t0");
+
+  assert_eq(0, keep_failed_tests(file_name, suite, 3));
+  assert_eq(CUTEST_WORK_RUN_SOME, suite[0].run);
+  assert_eq(1, suite[0].test_cnt);
+  assert_eq("t1", suite[0].test[0]);
+  assert_eq(CUTEST_WORK_RUN_NONE, suite[1].run);
+  assert_eq(CUTEST_WORK_RUN_ALL, suite[2].run);
+  assert_eq(1, suite[2].test_cnt);
+
+  unlink(file_name);
+  free(a[0]);
+  free(a);
+  free(b);
+  free(c[0]);
+  free(c);
+}
+
+/*****************************************************************************
+ * open_trace()
+ */
+test(open_trace_shall_not_open_a_file_if_no_trace)
+{
+  cutest_work_trace_t trace;
+  m.get_time.retval = 5.0;
+  assert_eq(0, open_trace(&trace, NULL));
+  assert_eq(0, m.fopen.call_count);
+  assert_eq(NULL, trace.fd);
+  assert_eq(5.0, trace.started);
+}
+
+test(open_trace_shall_return_negative_1_if_file_can_not_be_opened)
+{
+  cutest_work_trace_t trace;
+  assert_eq(-1, open_trace(&trace, "check.json"));
+  assert_eq("check.json", m.fopen.args.arg0);
+  assert_eq("w", m.fopen.args.arg1);
+}
+
+test(open_trace_shall_start_the_list_of_trace_events)
+{
+  cutest_work_trace_t trace;
+  m.fopen.retval = (FILE*)0x1234;
+  assert_eq(0, open_trace(&trace, "check.json"));
+  assert_eq((FILE*)0x1234, trace.fd);
+#ifdef CUTEST_GCC
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq((FILE*)0x1234, m.fwrite.args.arg3);
+#else
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq((FILE*)0x1234, m.fprintf.args.arg0);
+#endif
+}
+
+/*****************************************************************************
+ * get_trace_time()
+ */
+test(get_trace_time_shall_return_microseconds_since_the_start)
+{
+  cutest_work_trace_t trace = {NULL, 10.0, 0};
+  assert_eq(2500000.0, get_trace_time(&trace, 12.5));
+}
+
+/*****************************************************************************
+ * trace_workers()
+ */
+test(trace_workers_shall_do_nothing_without_a_trace)
+{
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  trace_workers(&trace, 2, 5);
+  assert_eq(0, m.fprintf.call_count);
+}
+
+test(trace_workers_shall_count_the_running_and_queued_runners)
+{
+  cutest_work_trace_t trace = {(FILE*)0x1234, 0.0, 0};
+  trace_workers(&trace, 2, 5);
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq((FILE*)0x1234, m.fprintf.args.arg0);
+}
+
+/*****************************************************************************
+ * trace_tests()
+ */
+test(trace_tests_shall_add_a_span_for_every_test_case)
+{
+  cutest_work_trace_t trace = {(FILE*)0x5678, 0.0, 0};
+  m.is_report_line.func = is_report_line;
+  m.fgets.func = fgets_junit_stub;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.strstr.func = strstr;
+  m.strtod.func = strtod;
+  m.strcspn.func = strcspn;
+  trace_tests(&trace, (FILE*)0x1234, 1, 100.0);
+  assert_eq(3, m.fprintf.call_count);
+  assert_eq((FILE*)0x5678, m.fprintf.args.arg0);
+  assert_eq(0x1234, m.fgets.args.arg2);
+}
+
+/*****************************************************************************
+ * add_to_trace()
+ */
+test(add_to_trace_shall_do_nothing_without_a_trace)
+{
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  add_to_trace(&trace, &report_item, 1, 0.0, 1.0, 0);
+  assert_eq(0, m.fprintf.call_count);
+  assert_eq(0, m.open_junit_report.call_count);
+}
+
+test(add_to_trace_shall_add_a_span_for_the_runner_on_its_worker)
+{
+  cutest_work_trace_t trace = {(FILE*)0x5678, 0.0, 0};
+  add_to_trace(&trace, &report_item, 2, 0.0, 1.0, 0);
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq((FILE*)0x5678, m.fprintf.args.arg0);
+  assert_eq(2, trace.last_worker);
+  assert_eq(0, m.trace_tests.call_count);
+}
+
+test(add_to_trace_shall_add_the_tests_of_the_runner)
+{
+  cutest_work_trace_t trace = {(FILE*)0x5678, 10.0, 0};
+  m.get_trace_time.func = get_trace_time;
+  m.open_junit_report.retval = (FILE*)0x1234;
+  add_to_trace(&trace, &report_item, 2, 12.0, 1.0, 0);
+  assert_eq(1, m.trace_tests.call_count);
+  assert_eq((FILE*)0x1234, m.trace_tests.args.arg1);
+  assert_eq(2, m.trace_tests.args.arg2);
+  assert_eq(2000000.0, m.trace_tests.args.arg3);
+  assert_eq(1, m.fclose.call_count);
+}
+
+/*****************************************************************************
+ * close_trace()
+ */
+test(close_trace_shall_do_nothing_without_a_trace)
+{
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  close_trace(&trace, 4);
+  assert_eq(0, m.fclose.call_count);
+}
+
+test(close_trace_shall_name_the_track_of_every_worker)
+{
+  cutest_work_trace_t trace = {(FILE*)0x5678, 0.0, 3};
+  close_trace(&trace, 4);
+  assert_eq(4, m.fprintf.call_count);
+  assert_eq(1, m.fclose.call_count);
+  assert_eq((FILE*)0x5678, m.fclose.args.arg0);
+  assert_eq(NULL, trace.fd);
+}
+
+/*****************************************************************************
+ * read_oom_kills()
+ */
+test(read_oom_kills_shall_open_the_memory_events_of_the_worker)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  assert_eq(0, read_oom_kills(&opts, 2));
+  assert_eq("/memory.events", m.get_cgroup_path.args.arg3);
+  assert_eq(2, m.get_cgroup_path.args.arg2);
+  assert_eq("r", m.fopen.args.arg1);
+}
+
+static char* fgets_memory_events_stub(char* s, int size, FILE *stream)
+{
+  const char* rows[] = {"low 0\n",
+                        "high 0\n",
+                        "max 12\n",
+                        "oom 1\n",
+                        "oom_kill 1\n"};
+  (void)stream;
+  if (m.fgets.call_count > 5) {
+    return NULL;
+  }
+  snprintf(s, size, "%s", rows[m.fgets.call_count - 1]);
+  return s;
+}
+
+test(read_oom_kills_shall_return_the_number_of_oom_kills)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  m.fopen.retval = (FILE*)0x1234;
+  m.fgets.func = fgets_memory_events_stub;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.strtol.func = strtol;
+  assert_eq(1, read_oom_kills(&opts, 0));
+  assert_eq(1, m.fclose.call_count);
+}
+
+/*****************************************************************************
+ * get_exceeded_limit()
+ */
+test(get_exceeded_limit_shall_tell_if_the_cgroup_memory_limit_was_hit)
+{
+  char buf[LIMIT_NAME_LEN];
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  opts.limit_memory = 512;
+  m.read_oom_kills.retval = 1;
+  m.sprintf.func = sprintf;
+  assert_eq(1, get_exceeded_limit(buf, &opts, 2, SIGKILL));
+  assert_eq(2, m.read_oom_kills.args.arg1);
+  assert_eq("memory limit of 512 MB", buf);
+}
+
+test(get_exceeded_limit_shall_tell_if_the_cpu_time_limit_was_hit)
+{
+  char buf[LIMIT_NAME_LEN];
+  cutest_work_opts_t opts = {0};
+  opts.limit_cpu = 60;
+  m.sprintf.func = sprintf;
+  assert_eq(1, get_exceeded_limit(buf, &opts, 0, SIGXCPU));
+  assert_eq("CPU time limit of 60 s", buf);
+  assert_eq(0, m.read_oom_kills.call_count);
+}
+
+test(get_exceeded_limit_shall_return_0_for_an_ordinary_failure)
+{
+  char buf[LIMIT_NAME_LEN];
+  cutest_work_opts_t opts = {0};
+  opts.cgroup = "/cg";
+  opts.limit_memory = 512;
+  opts.limit_cpu = 60;
+  assert_eq(0, get_exceeded_limit(buf, &opts, 0, EXIT_FAILURE << 8));
+  assert_eq(0, m.sprintf.call_count);
+}
+
+/*****************************************************************************
+ * report_killed_suite()
+ */
+test(report_killed_suite_shall_leave_failing_tests_to_the_runner)
+{
+  cutest_work_report_t report = {NULL, 0, 0, 0, 0, 0, 0.0};
+  cutest_work_opts_t opts = {0};
+  report_killed_suite(&report, &report_item, &opts, 0, EXIT_FAILURE << 8);
+  assert_eq(0, report.errors);
+  assert_eq(0, m.fprintf.call_count);
+}
+
+test(report_killed_suite_shall_count_a_killed_runner_as_an_error)
+{
+  cutest_work_report_t report = {NULL, 0, 0, 0, 0, 0, 0.0};
+  cutest_work_opts_t opts = {0};
+  report_killed_suite(&report, &report_item, &opts, 0, SIGSEGV);
+  assert_eq(1, report.tests);
+  assert_eq(1, report.errors);
+  assert_eq(stderr, m.fprintf.args.arg0);
+}
+
+static int get_exceeded_limit_stub(char* buf, const cutest_work_opts_t* opts,
+                                   int slot, int status)
+{
+  (void)opts;
+  (void)slot;
+  (void)status;
+  strcpy(buf, "CPU time limit of 60 s");
+  return 1;
+}
+
+test(report_killed_suite_shall_tell_the_limit_in_the_merged_report)
+{
+  cutest_work_report_t report = {(FILE*)0x5678, 0, 0, 0, 0, 0, 0.0};
+  cutest_work_opts_t opts = {0};
+  m.sprintf.func = sprintf;
+  m.get_exceeded_limit.func = get_exceeded_limit_stub;
+  report_killed_suite(&report, &report_item, &opts, 1, SIGXCPU);
+  assert_eq("killed for exceeding the CPU time limit of 60 s",
+            (char*)m.sprintf.args.arg0);
+  assert_eq(1, m.fflush.call_count);
+  assert_eq((FILE*)0x5678, m.fflush.args.arg0);
+}
+
+/*****************************************************************************
+ * close_report()
+ */
+test(close_report_shall_end_and_close_the_merged_report)
+{
+  cutest_work_report_t report = {(FILE*)0x5678, 0, 0, 0, 0, 0, 0.0};
+  close_report(&report, 4);
+  assert_eq(1, m.fclose.call_count);
+  assert_eq((FILE*)0x5678, m.fclose.args.arg0);
+  assert_eq(NULL, report.junit);
+}
+
+test(close_report_shall_print_a_line_with_the_totals)
+{
+  cutest_work_report_t report = {NULL, 0, 0, 0, 0, 0, 0.0};
+  close_report(&report, 4);
+  assert_eq(0, m.fclose.call_count);
+  assert_eq(1, m.printf.call_count);
+}
+
+/*****************************************************************************
+ * get_progress_mode()
+ */
+test(get_progress_mode_shall_let_verbose_runners_print_their_verdicts)
+{
+  cutest_work_opts_t opts = {0};
+  opts.verbose = 1;
+  m.isatty.retval = 1;
+  assert_eq(CUTEST_WORK_PROGRESS_NONE, get_progress_mode(&opts, 4));
+}
+
+test(get_progress_mode_shall_show_a_live_display_on_a_terminal)
+{
+  cutest_work_opts_t opts = {0};
+  opts.verbose = -1;
+  m.isatty.retval = 1;
+  assert_eq(CUTEST_WORK_PROGRESS_LIVE, get_progress_mode(&opts, 1));
+  assert_eq(STDOUT_FILENO, m.isatty.args.arg0);
+}
+
+test(get_progress_mode_shall_print_a_line_per_runner_if_not_a_terminal)
+{
+  cutest_work_opts_t opts = {0};
+  opts.verbose = -1;
+  assert_eq(CUTEST_WORK_PROGRESS_LINES, get_progress_mode(&opts, 4));
+  assert_eq(CUTEST_WORK_PROGRESS_NONE, get_progress_mode(&opts, 1));
+}
+
+/*****************************************************************************
+ * get_test_weight()
+ */
+test(get_test_weight_shall_be_the_average_duration_of_a_test)
+{
+  cutest_work_suite_t suite = {.name = "a", .duration = 10.0,
+                               .duration_tests = 5};
+  assert_eq(2.0, get_test_weight(&suite));
+}
+
+test(get_test_weight_shall_be_0_if_the_suite_is_not_in_the_history)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 5};
+  assert_eq(0.0, get_test_weight(&suite));
+}
+
+/*****************************************************************************
+ * open_progress()
+ */
+test(open_progress_shall_count_the_tests_of_all_items)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 10,
+                                   .duration = 10.0, .duration_tests = 10},
+                                  {.name = "b", .test_cnt = 3,
+                                   .duration = 6.0, .duration_tests = 2}};
+  cutest_work_item_t items[3] = {{&suite[0], 0, 0, 4, 0, 0},
+                                 {&suite[0], 1, 4, 6, 0, 0},
+                                 {&suite[1], -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {3, items};
+  cutest_work_progress_t progress;
+  m.memset.func = memset;
+  m.get_item_test_cnt.func = get_item_test_cnt;
+  m.get_test_weight.func = get_test_weight;
+  m.get_time.retval = 12.5;
+  open_progress(&progress, CUTEST_WORK_PROGRESS_LIVE, &queue);
+  assert_eq(CUTEST_WORK_PROGRESS_LIVE, progress.mode);
+  assert_eq(13, progress.tests);
+  assert_eq(19.0, progress.expected);
+  assert_eq(12.5, progress.started);
+  assert_eq(0, progress.lines);
+}
+
+test(open_progress_shall_not_expect_a_duration_if_a_suite_is_unknown)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a", .test_cnt = 10,
+                                   .duration = 10.0, .duration_tests = 10},
+                                  {.name = "b", .test_cnt = 3}};
+  cutest_work_item_t items[2] = {{&suite[0], -1, 0, 0, 0, 0},
+                                 {&suite[1], -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_progress_t progress;
+  m.memset.func = memset;
+  m.get_item_test_cnt.func = get_item_test_cnt;
+  m.get_test_weight.func = get_test_weight;
+  open_progress(&progress, CUTEST_WORK_PROGRESS_LINES, &queue);
+  assert_eq(13, progress.tests);
+  assert_eq(0.0, progress.expected);
+}
+
+/*****************************************************************************
+ * watch_worker_pool()
+ */
+test(watch_worker_pool_shall_return_negative_1_if_out_of_memory)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  assert_eq(-1, watch_worker_pool(&pool));
+#ifdef CUTEST_GCC
+  assert_eq(stderr, m.fwrite.args.arg3);
+#else
+  assert_eq(stderr, m.fprintf.args.arg0);
+#endif
+}
+
+module_test(watch_worker_pool_shall_not_have_any_output_to_read_yet)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  assert_eq(0, watch_worker_pool(&pool));
+  assert_eq(-1, pool.out[0]);
+  assert_eq(-1, pool.out[1]);
+  assert_eq(0, pool.done[1]);
+  assert_eq(0, pool.failed[1]);
+  free(pool.out);
+  free(pool.done);
+  free(pool.failed);
+}
+
+/*****************************************************************************
+ * open_output()
+ */
+test(open_output_shall_not_create_a_pipe_if_not_watched)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  int out = 0;
+  assert_eq(0, open_output(&pool, 0, &out));
+  assert_eq(-1, out);
+  assert_eq(0, m.pipe.call_count);
+}
+
+test(open_output_shall_return_negative_1_if_the_pipe_fails)
+{
+  int fd[1] = {-1};
+  int done[1] = {0};
+  int failed[1] = {0};
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL, fd, done, failed};
+  int out = 0;
+  m.pipe.retval = -1;
+  assert_eq(-1, open_output(&pool, 0, &out));
+  assert_eq(-1, out);
+  assert_eq(-1, fd[0]);
+}
+
+test(open_output_shall_read_the_runner_without_blocking)
+{
+  int fd[1] = {-1};
+  int done[1] = {0};
+  int failed[1] = {0};
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL, fd, done, failed};
+  int out = 0;
+  m.pipe.func = pipe_stub;
+  assert_eq(0, open_output(&pool, 0, &out));
+  assert_eq(6, out);
+  assert_eq(5, fd[0]);
+  assert_eq(2, m.fcntl.call_count);
+  assert_eq(5, m.fcntl.args.arg0);
+}
+
+/*****************************************************************************
+ * close_output()
+ */
+test(close_output_shall_close_the_output_of_the_slot)
+{
+  int fd[2] = {-1, 5};
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL, fd, NULL, NULL};
+  close_output(&pool, 0);
+  assert_eq(0, m.close.call_count);
+  close_output(&pool, 1);
+  assert_eq(1, m.close.call_count);
+  assert_eq(5, m.close.args.arg0);
+  assert_eq(-1, fd[1]);
+}
+
+/*****************************************************************************
+ * read_verdicts()
+ */
+module_test(read_verdicts_shall_count_the_tests_that_did_not_pass)
+{
+  cutest_work_suite_t suite = {.name = "a", .test_cnt = 5, .duration = 4.0,
+                               .duration_tests = 2};
+  cutest_work_item_t items[1] = {{&suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  pid_t pid[1] = {1234};
+  int item[1] = {0};
+  int out[1];
+  int done[1] = {0};
+  int failed[1] = {0};
+  cutest_work_pool_t pool = {1, 1, pid, item, NULL, NULL, out, done, failed};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE, 5};
+  int fd[2];
+  assert_eq(0, pipe(fd));
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  out[0] = fd[0];
+  assert_eq(2, write(fd[1], ".F", 2));
+  m.strchr.func = strchr;
+  m.get_test_weight.func = get_test_weight;
+  assert_eq(0, read_verdicts(&progress, &pool, &queue, 0));
+  assert_eq(2, done[0]);
+  assert_eq(1, failed[0]);
+  assert_eq(4, write(fd[1], "fSE\n", 4));
+  close(fd[1]);
+  assert_eq(1, read_verdicts(&progress, &pool, &queue, 0));
+  assert_eq(5, done[0]);
+  assert_eq(2, failed[0]);
+  assert_eq(5, progress.done);
+  assert_eq(2, progress.failed);
+  assert_eq(10.0, progress.expected_done);
+  assert_eq(-1, out[0]);
+}
+
+/*****************************************************************************
+ * format_duration()
+ */
+test(format_duration_shall_print_minutes_and_seconds)
+{
+  char buf[32];
+  m.sprintf.func = sprintf;
+  format_duration(buf, 125.6);
+  assert_eq("2:06", buf);
+}
+
+/*****************************************************************************
+ * get_eta()
+ */
+test(get_eta_shall_be_unknown_before_the_first_test)
+{
+  char buf[32];
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE, 4};
+  m.strcpy.func = strcpy;
+  get_eta(buf, &progress, 10.0);
+  assert_eq("-:--", buf);
+}
+
+test(get_eta_shall_be_based_on_the_tests_run_without_a_history)
+{
+  char buf[32];
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE, 4, 1};
+  m.format_duration.func = format_duration;
+  m.sprintf.func = sprintf;
+  get_eta(buf, &progress, 10.0);
+  assert_eq("0:30", buf);
+}
+
+test(get_eta_shall_be_based_on_the_history)
+{
+  char buf[32];
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE, 4, 3, 0,
+                                     20.0, 5.0};
+  m.format_duration.func = format_duration;
+  m.sprintf.func = sprintf;
+  get_eta(buf, &progress, 10.0);
+  assert_eq("0:30", buf);
+}
+
+/*****************************************************************************
+ * clear_progress()
+ */
+test(clear_progress_shall_do_nothing_if_nothing_is_drawn)
+{
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE};
+  clear_progress(&progress);
+  assert_eq(0, m.printf.call_count);
+}
+
+test(clear_progress_shall_erase_the_display)
+{
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE};
+  progress.lines = 3;
+  clear_progress(&progress);
+  assert_eq(1, m.printf.call_count);
+  assert_eq(0, progress.lines);
+}
+
+/*****************************************************************************
+ * draw_progress()
+ */
+static char progress_line[3][128];
+
+static void print_progress_line_stub(const char* line)
+{
+  strcpy(progress_line[m.print_progress_line.call_count - 1], line);
+}
+
+test(draw_progress_shall_show_the_test_run_by_every_worker)
+{
+  char* test[3] = {"t0", "t1", "t2"};
+  cutest_work_suite_t suite = {.name = "/src/a_test", .test_cnt = 3,
+                               .test = test};
+  cutest_work_item_t items[1] = {{&suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  pid_t pid[2] = {1234, 0};
+  int item[2] = {0, 0};
+  int done[2] = {1, 0};
+  cutest_work_pool_t pool = {2, 1, pid, item, NULL, NULL, NULL, done, NULL};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE, 3, 1, 1};
+  m.print_progress_line.func = print_progress_line_stub;
+  m.get_suite_name.func = get_suite_name;
+  m.get_item_test_cnt.func = get_item_test_cnt;
+  m.format_duration.func = format_duration;
+  m.get_eta.func = get_eta;
+  m.strrchr.func = strrchr;
+  m.strcpy.func = strcpy;
+  m.sprintf.func = sprintf;
+  draw_progress(&progress, &pool, &queue);
+  assert_eq(3, m.print_progress_line.call_count);
+  assert_eq("worker 0: a_test t1", progress_line[0]);
+  assert_eq("worker 1: -", progress_line[1]);
+  assert_eq("1/3 tests, 1 failed, 0:00 elapsed, ETA 0:00", progress_line[2]);
+  assert_eq(3, progress.lines);
+}
+
+test(draw_progress_shall_move_up_to_the_display_drawn_before)
+{
+  cutest_work_item_t items[1] = {{&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  int done[1] = {0};
+  cutest_work_pool_t pool = {1, 0, pid, item, NULL, NULL, NULL, done, NULL};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE};
+  progress.lines = 2;
+  draw_progress(&progress, &pool, &queue);
+  assert_eq(1, m.printf.call_count);
+  assert_eq(2, m.print_progress_line.call_count);
+}
+
+/*****************************************************************************
+ * watch_test_suites()
+ */
+test(watch_test_suites_shall_return_when_a_runner_is_done)
+{
+  cutest_work_item_t items[1] = {{&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  struct pollfd fd[2];
+  pid_t pid[2] = {1234, 0};
+  int item[2] = {0, 0};
+  int out[2] = {5, -1};
+  cutest_work_pool_t pool = {2, 1, pid, item, NULL, NULL, out, NULL, NULL};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE};
+  m.malloc.retval = fd;
+  m.read_verdicts.retval = 1;
+  watch_test_suites(&progress, &pool, &queue, 0);
+  assert_eq(1, m.poll.call_count);
+  assert_eq(1, m.poll.args.arg1);
+  assert_eq(5, fd[0].fd);
+  assert_eq(1, m.read_verdicts.call_count);
+  assert_eq(1, m.draw_progress.call_count);
+  assert_eq(fd, m.free.args.arg0);
+}
+
+test(watch_test_suites_shall_not_draw_anything_when_printing_lines)
+{
+  cutest_work_item_t items[1] = {{&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  struct pollfd fd[1];
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  int out[1] = {-1};
+  cutest_work_pool_t pool = {1, 0, pid, item, NULL, NULL, out, NULL, NULL};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LINES};
+  m.malloc.retval = fd;
+  watch_test_suites(&progress, &pool, &queue, 0);
+  assert_eq(1, m.poll.call_count);
+  assert_eq(0, m.read_verdicts.call_count);
+  assert_eq(0, m.draw_progress.call_count);
+}
+
+/*****************************************************************************
+ * finish_progress()
+ */
+test(finish_progress_shall_do_nothing_if_not_watched)
+{
+  cutest_work_item_t items[1] = {{&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  int item[1] = {0};
+  cutest_work_pool_t pool = {1, 0, NULL, item, NULL, NULL};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_NONE};
+  finish_progress(&progress, &pool, &queue, 0, 0, 1.0);
+  assert_eq(0, m.read_verdicts.call_count);
+  assert_eq(0, m.printf.call_count);
+}
+
+test(finish_progress_shall_print_a_line_per_finished_runner)
+{
+  cutest_work_item_t items[1] = {{&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  int item[1] = {0};
+  int out[1] = {5};
+  int done[1] = {3};
+  int failed[1] = {1};
+  cutest_work_pool_t pool = {1, 0, NULL, item, NULL, NULL, out, done, failed};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LINES};
+  finish_progress(&progress, &pool, &queue, 0, 1, 1.0);
+  assert_eq(1, m.read_verdicts.call_count);
+  assert_eq(1, m.close_output.call_count);
+  assert_eq(1, m.print_verdict_line.call_count);
+  assert_eq(1, m.print_verdict_line.args.arg1);
+  assert_eq(3, m.print_verdict_line.args.arg2);
+  assert_eq(1, m.print_verdict_line.args.arg3);
+  assert_eq(0, m.clear_progress.call_count);
+}
+
+test(finish_progress_shall_leave_the_lines_of_a_unity_group_to_the_caller)
+{
+  cutest_work_item_t items[2] = {{&runner_suite, -1, 0, 0, 0, 1},
+                                 {&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {2, items};
+  int item[1] = {0};
+  int out[1] = {5};
+  int done[1] = {3};
+  int failed[1] = {1};
+  cutest_work_pool_t pool = {1, 0, NULL, item, NULL, NULL, out, done, failed};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LINES};
+  finish_progress(&progress, &pool, &queue, 0, 1, 1.0);
+  assert_eq(1, m.close_output.call_count);
+  assert_eq(0, m.print_verdict_line.call_count);
+}
+
+test(finish_progress_shall_take_down_the_live_display)
+{
+  cutest_work_item_t items[1] = {{&runner_suite, -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {1, items};
+  int item[1] = {0};
+  int out[1] = {5};
+  int done[1] = {3};
+  int failed[1] = {1};
+  cutest_work_pool_t pool = {1, 0, NULL, item, NULL, NULL, out, done, failed};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LIVE};
+  finish_progress(&progress, &pool, &queue, 0, 0, 1.0);
+  assert_eq(1, m.clear_progress.call_count);
+  assert_eq(0, m.printf.call_count);
+}
+
+/*****************************************************************************
+ * count_failed_tests()
+ */
+test(count_failed_tests_shall_return_negative_1_if_there_is_no_report)
+{
+  int tests = 5;
+  assert_eq(-1, count_failed_tests(&runner_item, &tests));
+  assert_eq(&runner_item, m.open_junit_report.args.arg0);
+  assert_eq(0, tests);
+}
+
+/*****************************************************************************
+ * finish_unity_group()
+ */
+static int count_failed_tests_stub(const cutest_work_item_t* item, int* tests)
+{
+  static const int failed[] = {0, 2, -1};
+  (void)item;
+  *tests = 4;
+  return failed[(m.count_failed_tests.call_count - 1) % 3];
+}
+
+test(finish_unity_group_shall_report_every_test_suite_of_the_group)
+{
+  cutest_work_suite_t suite[3] = {{.name = "a"}, {.name = "b"},
+                                  {.name = "c"}};
+  cutest_work_item_t items[3] = {{&suite[0], -1, 0, 0, 0, 2},
+                                 {&suite[1], -1, 0, 0, 0, 0},
+                                 {&suite[2], -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {3, items};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, NULL, item, started, NULL};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_NONE};
+  m.get_time.retval = 3.0;
+  m.count_failed_tests.func = count_failed_tests_stub;
+  assert_eq(1, finish_unity_group(&pool, &queue, 0, EXIT_FAILURE << 8, &opts,
+                                  &report, &trace, &progress));
+  assert_eq(3, m.add_to_report.call_count);
+  assert_eq(&items[2], m.add_to_report.args.arg1);
+  assert_eq(1.0, m.add_to_report.args.arg3);
+  assert_eq(3, m.add_to_trace.call_count);
+  assert_eq(0, suite[0].failed);
+  assert_eq(1, suite[1].failed);
+  assert_eq(1, suite[2].failed);
+  assert_eq(4, suite[2].elapsed_tests);
+  assert_eq(0, m.report_killed_suite.call_count);
+}
+
+test(finish_unity_group_shall_blame_a_killed_runner_on_the_suite_it_was_in)
+{
+  cutest_work_suite_t suite[3] = {{.name = "a"}, {.name = "b"},
+                                  {.name = "c"}};
+  cutest_work_item_t items[3] = {{&suite[0], -1, 0, 0, 0, 2},
+                                 {&suite[1], -1, 0, 0, 0, 0},
+                                 {&suite[2], -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {3, items};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, NULL, item, started, NULL};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_NONE};
+  m.count_failed_tests.func = count_failed_tests_stub;
+  finish_unity_group(&pool, &queue, 0, SIGKILL, &opts, &report, &trace,
+                     &progress);
+  assert_eq(1, m.report_killed_suite.call_count);
+  assert_eq(&items[2], m.report_killed_suite.args.arg1);
+  assert_eq(SIGKILL, m.report_killed_suite.args.arg4);
+}
+
+test(finish_unity_group_shall_print_a_line_per_test_suite)
+{
+  cutest_work_suite_t suite[2] = {{.name = "a"}, {.name = "b"}};
+  cutest_work_item_t items[2] = {{&suite[0], -1, 0, 0, 0, 1},
+                                 {&suite[1], -1, 0, 0, 0, 0}};
+  cutest_work_queue_t queue = {2, items};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  int out[1] = {5};
+  cutest_work_pool_t pool = {1, 0, NULL, item, started, NULL, out, NULL,
+                             NULL};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  cutest_work_progress_t progress = {CUTEST_WORK_PROGRESS_LINES};
+  assert_eq(-1, finish_unity_group(&pool, &queue, 0, 0, &opts, &report,
+                                   &trace, &progress));
+  assert_eq(1, m.finish_progress.call_count);
+  assert_eq(2, m.print_verdict_line.call_count);
+  assert_eq(&items[1], m.print_verdict_line.args.arg0);
+}
+
+/*****************************************************************************
+ * run_test_suites()
+ */
+static cutest_work_suite_t run_suite = {.name = "suite_runner"};
+static cutest_work_progress_t run_progress;
+
+test(run_test_suites_shall_launch_every_item)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 2;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(2, m.launch_test_suite.call_count);
+  assert_eq(&queue, m.launch_test_suite.args.arg1);
+  assert_eq(1, m.launch_test_suite.args.arg2);
+  assert_eq(&opts, m.launch_test_suite.args.arg3);
+}
+
+static int launch_test_suite_stub(cutest_work_pool_t* pool,
+                                  const cutest_work_queue_t* queue,
+                                  int item_idx,
+                                  const cutest_work_opts_t* opts)
+{
+  (void)queue;
+  (void)item_idx;
+  (void)opts;
+  pool->running++;
+  return 0;
+}
+
+static int wait_for_test_suite_stub(cutest_work_pool_t* pool, int* status,
+                                    int block)
+{
+  (void)block;
+  *status = (2 == m.wait_for_test_suite.call_count);
+  pool->running--;
+  return 0;
+}
+
+test(run_test_suites_shall_not_launch_more_items_than_the_limit)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[3] = {{&run_suite}, {&run_suite},
+                                  {&run_suite}};
+  cutest_work_queue_t queue = {3, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 1;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(3, m.launch_test_suite.call_count);
+  assert_eq(3, m.wait_for_test_suite.call_count);
+}
+
+test(run_test_suites_shall_wait_for_all_items_to_finish)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 2;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(2, m.wait_for_test_suite.call_count);
+  assert_eq(1, m.wait_for_test_suite.args.arg2);
+  assert_eq(0, pool.running);
+}
+
+static int wait_for_test_suite_first_block = -1;
+static int wait_for_test_suite_block_stub(cutest_work_pool_t* pool,
+                                          int* status, int block)
+{
+  if (1 == m.wait_for_test_suite.call_count) {
+    wait_for_test_suite_first_block = block;
+  }
+  return wait_for_test_suite_stub(pool, status, block);
+}
+
+static int wait_for_watched_test_suite_stub(cutest_work_pool_t* pool,
+                                            int* status, int block)
+{
+  (void)block;
+  *status = 0;
+  if (1 == m.wait_for_test_suite.call_count) {
+    return -1;
+  }
+  pool->running--;
+  return 0;
+}
+
+test(run_test_suites_shall_watch_the_runners_until_one_is_done)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  int out[1] = {-1};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL, out, NULL, NULL};
+  cutest_work_item_t items[1] = {{&run_suite}};
+  cutest_work_queue_t queue = {1, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 1;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_watched_test_suite_stub;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(0, m.wait_for_test_suite.args.arg2); /* Never block */
+  assert_eq(1, m.watch_test_suites.call_count);
+  assert_eq(&run_progress, m.watch_test_suites.args.arg0);
+  assert_eq(1, m.finish_progress.call_count);
+  assert_eq(0, m.sleep.call_count);
+}
+
+test(run_test_suites_shall_poll_if_throttled)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 1;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_block_stub;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(0, wait_for_test_suite_first_block);
+}
+
+test(run_test_suites_shall_return_1_if_an_item_fails)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 2;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  run_suite.failed = 0;
+  assert_eq(1, run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress));
+  assert_eq(1, run_suite.failed);
+}
+
+test(run_test_suites_shall_print_the_log_of_the_first_failure_if_fail_fast)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {1, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  opts.fail_fast = 1;
+  m.get_worker_limit.retval = 2;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  assert_eq(1, run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress));
+  assert_eq(1, m.print_log.call_count);
+  assert_eq(&items[1], m.print_log.args.arg0);
+  assert_eq(1, m.stop_test_suites.call_count);
+  assert_eq(&pool, m.stop_test_suites.args.arg0);
+}
+
+test(run_test_suites_shall_stop_launching_items_on_failure_if_fail_fast)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_item_t items[3] = {{&run_suite}, {&run_suite},
+                                  {&run_suite}};
+  cutest_work_queue_t queue = {3, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  opts.fail_fast = 1;
+  m.get_worker_limit.retval = 1;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  assert_eq(1, run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress));
+  assert_eq(2, m.launch_test_suite.call_count);
+}
+
+test(run_test_suites_shall_not_stop_items_on_failure_by_default)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_item_t items[3] = {{&run_suite}, {&run_suite},
+                                  {&run_suite}};
+  cutest_work_queue_t queue = {3, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 1;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  assert_eq(1, run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress));
+  assert_eq(3, m.launch_test_suite.call_count);
+  assert_eq(0, m.print_log.call_count);
+  assert_eq(0, m.stop_test_suites.call_count);
+}
+
+test(run_test_suites_shall_add_every_finished_item_to_the_report)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {1, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 2;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  m.record_duration.retval = 1.5;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(2, m.add_to_report.call_count);
+  assert_eq(&report, m.add_to_report.args.arg0);
+  assert_eq(&items[1], m.add_to_report.args.arg1);
+  assert_eq(0, m.add_to_report.args.arg2);
+  assert_eq(1.5, m.add_to_report.args.arg3);
+}
+
+test(run_test_suites_shall_trace_every_finished_item)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {1, 0};
+  double started[2] = {3.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 2;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  m.record_duration.retval = 1.5;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(2, m.add_to_trace.call_count);
+  assert_eq(&trace, m.add_to_trace.args.arg0);
+  assert_eq(&items[1], m.add_to_trace.args.arg1);
+  assert_eq(0, m.add_to_trace.args.arg2);
+  assert_eq(3.0, m.add_to_trace.args.arg3);
+  assert_eq(1.5, m.add_to_trace.args.arg4);
+  assert_eq(1, m.add_to_trace.args.arg5);
+  assert_eq(&trace, m.trace_workers.args.arg0);
+  assert_eq(0, m.trace_workers.args.arg1);
+  assert_eq(0, m.trace_workers.args.arg2);
+}
+
+test(run_test_suites_shall_report_items_that_did_not_pass)
+{
+  pid_t pid[1] = {0};
+  int item[1] = {0};
+  double started[1] = {0.0};
+  cutest_work_pool_t pool = {1, 0, pid, item, started, NULL};
+  cutest_work_item_t items[3] = {{&run_suite}, {&run_suite},
+                                  {&run_suite}};
+  cutest_work_queue_t queue = {3, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 1;
+  m.launch_test_suite.func = launch_test_suite_stub;
+  m.wait_for_test_suite.func = wait_for_test_suite_stub;
+  run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress);
+  assert_eq(1, m.report_killed_suite.call_count);
+  assert_eq(&report, m.report_killed_suite.args.arg0);
+  assert_eq(1, m.report_killed_suite.args.arg4);
+}
+
+test(run_test_suites_shall_return_negative_1_if_launch_fails)
+{
+  pid_t pid[2] = {0, 0};
+  int item[2] = {0, 0};
+  double started[2] = {0.0, 0.0};
+  cutest_work_pool_t pool = {2, 0, pid, item, started, NULL};
+  cutest_work_item_t items[2] = {{&run_suite}, {&run_suite}};
+  cutest_work_queue_t queue = {2, items};
+  cutest_work_opts_t opts = {0};
+  cutest_work_report_t report;
+  cutest_work_trace_t trace = {NULL, 0.0, 0};
+  m.get_worker_limit.retval = 2;
+  m.launch_test_suite.retval = -1;
+  assert_eq(-1, run_test_suites(&pool, &queue, &opts, 8, &report, &trace, &run_progress));
+  assert_eq(1, m.launch_test_suite.call_count);
+}
+
+/*****************************************************************************
+ * print_log()
+ */
+static cutest_work_suite_t log_suite = {.name = "suite_name"};
+static cutest_work_item_t log_item = {&log_suite, -1, 0, 0, 0, 0};
+
+test(print_log_shall_allocate_room_for_the_log_file_name)
+{
+  m.strlen.func = strlen;
+  print_log(&log_item);
+  assert_eq(1, m.malloc.call_count);
+  assert_eq(strlen("suite_name") + 32 + strlen("..log") + 1,
+            m.malloc.args.arg0);
+}
+
+test(print_log_shall_output_an_error_message_if_allocation_failed)
+{
+  print_log(&log_item);
+#ifdef CUTEST_GCC
+  assert_eq(1, m.fwrite.call_count);
+  assert_eq(stderr, m.fwrite.args.arg3);
+#else
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq(stderr, m.fprintf.args.arg0);
+#endif
+}
+
+test(print_log_shall_append_log_suffix_to_suite_name)
+{
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.malloc.retval = buf;
+  print_log(&log_item);
+  assert_eq("suite_name.log", buf);
+}
+
+test(print_log_shall_append_the_batch_number_to_suite_name)
+{
+  cutest_work_item_t item = {&log_suite, 3, 0, 0, 0, 0};
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.format_batch_name.func = format_batch_name;
+  m.malloc.retval = buf;
+  print_log(&item);
+  assert_eq("suite_name.3.log", buf);
+}
+
+test(print_log_shall_open_the_correct_file_for_reading)
+{
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.malloc.retval = buf;
+  print_log(&log_item);
+  assert_eq(1, m.fopen.call_count);
+  assert_eq(buf, m.fopen.args.arg0);
+  assert_eq("r", m.fopen.args.arg1);
+}
+
+test(print_log_shall_free_the_memory_if_a_file_could_not_be_opened)
+{
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.malloc.retval = buf;
+  print_log(&log_item);
+  assert_eq(1, m.free.call_count);
+  assert_eq(buf, m.free.args.arg0);
+}
+
+static char* fgets_stub(char* s, int size, FILE *stream)
+{
+  (void)stream;
+  (void)size;
+  if (m.fgets.call_count >= 2) {
+    return NULL;
+  }
+  return s;
+}
+
+test(print_log_shall_fgets_all_lines_in_a_file_to_fputs)
+{
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.malloc.retval = buf;
+  m.fopen.retval = 0x1234;
+  m.fgets.func = fgets_stub;
+  print_log(&log_item);
+  assert_eq(2, m.fgets.call_count);
+  assert_eq(0x1234, m.fgets.args.arg2);
+}
+
+test(print_log_shall_fputs_all_lines_in_a_file_to_stderr)
+{
+  char buf[128];
+  m.sprintf.func = sprintf;
+  m.malloc.retval = buf;
+  m.fopen.retval = 0x1234;
+  m.fgets.func = fgets_stub;
+  print_log(&log_item);
+  assert_eq(1, m.fputs.call_count);
+  assert_eq(stderr, m.fputs.args.arg1);
+}
+
+/*****************************************************************************
+ * print_logs()
+ */
+test(print_logs_shall_call_print_log_for_every_item)
+{
+  cutest_work_item_t items[3];
+  cutest_work_queue_t queue = {3, items};
+  print_logs(&queue);
+  assert_eq(3, m.print_log.call_count);
+  assert_eq(&items[2], m.print_log.args.arg0);
+}
+
+/*****************************************************************************
+ * free_args()
+ */
+test(free_args_shall_free_all_arguments_and_the_list)
+{
+  char* args[3] = {(char*)0x1234, (char*)0x5678, NULL};
+  free_args(args);
+  assert_eq(3, m.free.call_count);
+  assert_eq(args, m.free.args.arg0);
+}
+
+/*****************************************************************************
+ * add_arg()
+ */
+test(add_arg_shall_return_negative_1_if_out_of_memory)
+{
+  char* args[2] = {NULL, NULL};
+  int cnt = 0;
+  assert_eq(-1, add_arg(args, &cnt, "-v"));
+  assert_eq(0, cnt);
+}
+
+module_test(add_arg_shall_add_a_copy_of_the_argument)
+{
+  char* args[2] = {NULL, NULL};
+  char arg[] = "-v";
+  int cnt = 0;
+  assert_eq(0, add_arg(args, &cnt, arg));
+  assert_eq(1, cnt);
+  assert_eq("-v", args[0]);
+  assert_eq(1, args[0] != arg);
+  free(args[0]);
+}
+
+/*****************************************************************************
+ * read_run_request()
+ */
+test(read_run_request_shall_return_null_when_the_coordinator_is_done)
+{
+  char runner[RUNNER_PATH_LEN];
+  assert_eq(NULL, read_run_request((FILE*)0x1234, runner));
+  assert_eq(0, m.calloc.call_count);
+}
+
+test(read_run_request_shall_refuse_a_runner_that_is_not_a_hash)
+{
+  const char* rows[] = {"RUN ../../bin/rm 1\n", NULL};
+  char runner[RUNNER_PATH_LEN];
+  agent_rows = rows;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  m.strspn.func = strspn;
+  assert_eq(NULL, read_run_request((FILE*)0x1234, runner));
+#ifdef CUTEST_GCC
+  assert_eq(stderr, m.fwrite.args.arg3);
+#else
+  assert_eq(stderr, m.fprintf.args.arg0);
+#endif
+  assert_eq(0, m.calloc.call_count);
+}
+
+test(read_run_request_shall_refuse_a_bad_number_of_arguments)
+{
+  const char* rows[] = {"RUN 0123456789abcdef 0\n", NULL};
+  char runner[RUNNER_PATH_LEN];
+  agent_rows = rows;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  m.strspn.func = strspn;
+  m.strtol.func = strtol;
+  assert_eq(NULL, read_run_request((FILE*)0x1234, runner));
+  assert_eq(0, m.calloc.call_count);
+}
+
+module_test(read_run_request_shall_run_the_runner_from_the_cache)
+{
+  const char* rows[] = {"RUN 0123456789abcdef 3\n", "valgrind\n", "@\n",
+                        "-v\n", NULL};
+  char runner[RUNNER_PATH_LEN];
+  char** args = NULL;
+  agent_rows = rows;
+  m.fgets.func = fgets_agent_stub;
+  args = read_run_request((FILE*)0x1234, runner);
+  assert_eq("../0123456789abcdef", runner);
+  assert_eq("valgrind", args[0]);
+  assert_eq("../0123456789abcdef", args[1]);
+  assert_eq("--output-dir", args[2]);
+  assert_eq(".", args[3]);
+  assert_eq("-v", args[4]);
+  assert_eq(NULL, args[5]);
+  free_args(args);
+}
+
+module_test(read_run_request_shall_write_the_valgrind_errors_in_scratch)
+{
+  const char* rows[] = {"RUN 0123456789abcdef 3\n", "valgrind\n",
+                        "--xml-file=/src/a_test.valgrind.xml\n", "@\n",
+                        NULL};
+  char runner[RUNNER_PATH_LEN];
+  char** args = NULL;
+  agent_rows = rows;
+  m.fgets.func = fgets_agent_stub;
+  args = read_run_request((FILE*)0x1234, runner);
+  assert_eq("--xml-file=a_test.valgrind.xml", args[1]);
+  free_args(args);
+}
+
+module_test(read_run_request_shall_return_null_if_arguments_are_missing)
+{
+  const char* rows[] = {"RUN 0123456789abcdef 3\n", "@\n", NULL};
+  char runner[RUNNER_PATH_LEN];
+  agent_rows = rows;
+  m.fgets.func = fgets_agent_stub;
+  assert_eq(NULL, read_run_request((FILE*)0x1234, runner));
+}
+
+/*****************************************************************************
+ * fetch_runner()
+ */
+test(fetch_runner_shall_not_fetch_a_runner_in_the_cache)
+{
+  assert_eq(0, fetch_runner((FILE*)0x1234, (FILE*)0x5678,
+                            "../0123456789abcdef"));
+  assert_eq("../0123456789abcdef", m.access.args.arg0);
+  assert_eq(0, m.fgets.call_count);
+}
+
+test(fetch_runner_shall_return_negative_1_if_the_runner_is_not_sent)
+{
+  m.access.retval = -1;
+  assert_eq(-1, fetch_runner((FILE*)0x1234, (FILE*)0x5678,
+                             "../0123456789abcdef"));
+  assert_eq(0, m.fopen.call_count);
+}
+
+test(fetch_runner_shall_put_the_runner_in_the_cache)
+{
+  const char* rows[] = {"BLOB 42\n", NULL};
+  agent_rows = rows;
+  m.access.retval = -1;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  m.strtol.func = strtol;
+  m.sprintf.func = sprintf;
+  m.fopen.retval = (FILE*)0x9abc;
+  assert_eq(0, fetch_runner((FILE*)0x1234, (FILE*)0x5678,
+                            "../0123456789abcdef"));
+  assert_eq(0x1234, m.copy_bytes.args.arg0);
+  assert_eq(0x9abc, m.copy_bytes.args.arg1);
+  assert_eq(42, m.copy_bytes.args.arg2);
+  assert_eq(0755, m.chmod.args.arg1);
+  assert_eq(1, m.rename.call_count);
+  assert_eq("../0123456789abcdef", m.rename.args.arg1);
+  assert_eq(0, m.unlink.call_count);
+}
+
+test(fetch_runner_shall_remove_a_runner_that_is_not_complete)
+{
+  const char* rows[] = {"BLOB 42\n", NULL};
+  agent_rows = rows;
+  m.access.retval = -1;
+  m.fgets.func = fgets_agent_stub;
+  m.strncmp.func = strncmp;
+  m.sprintf.func = sprintf;
+  m.fopen.retval = (FILE*)0x9abc;
+  m.copy_bytes.retval = -1;
+  assert_eq(-1, fetch_runner((FILE*)0x1234, (FILE*)0x5678,
+                             "../0123456789abcdef"));
+  assert_eq(0, m.rename.call_count);
+  assert_eq(1, m.unlink.call_count);
+}
+
+/*****************************************************************************
+ * run_runner()
+ */
+test(run_runner_shall_return_negative_1_if_the_cgroup_fails)
+{
+  char* args[] = {"../0123456789abcdef", NULL};
+  cutest_work_opts_t opts = {0};
+  m.prepare_cgroup.retval = -1;
+  assert_eq(-1, run_runner(args, &opts, 1));
+  assert_eq(0, m.fork.call_count);
+}
+
+test(run_runner_shall_wait_for_the_runner)
+{
+  char* args[] = {"../0123456789abcdef", NULL};
+  cutest_work_opts_t opts = {0};
+  m.fork.retval = 1234;
+  m.waitpid.retval = 1234;
+  assert_eq(0, run_runner(args, &opts, 1));
+  assert_eq(1234, m.waitpid.args.arg0);
+  assert_eq(0, m.execvp.call_count);
+}
+
+test(run_runner_shall_run_the_runner_with_its_output_in_a_file)
+{
+  char* args[] = {"../0123456789abcdef", NULL};
+  cutest_work_opts_t opts = {0};
+  m.freopen.retval = stdout;
+  m.dup2.retval = STDERR_FILENO;
+  run_runner(args, &opts, 1);
+  assert_eq(OUTPUT_NAME, m.freopen.args.arg0);
+  assert_eq(STDOUT_FILENO, m.dup2.args.arg0);
+  assert_eq(STDERR_FILENO, m.dup2.args.arg1);
+  assert_eq(1, m.apply_limits.args.arg1);
+  assert_eq(args, m.execvp.args.arg1);
+}
+
+test(run_runner_shall_exit_the_child_if_the_output_can_not_be_saved)
+{
+  char* args[] = {"../0123456789abcdef", NULL};
+  cutest_work_opts_t opts = {0};
+  run_runner(args, &opts, 1);
+  assert_eq(EXIT_FAILURE, m._exit.args.arg0);
+}
+
+/*****************************************************************************
+ * send_results()
+ */
+static struct dirent result_entry[3];
+
+static struct dirent* readdir_stub(DIR* dir)
+{
+  (void)dir;
+  strcpy(result_entry[0].d_name, ".");
+  strcpy(result_entry[1].d_name, "suite_test.junit_report.xml");
+  if (m.readdir.call_count > 2) {
+    return NULL;
+  }
+  return &result_entry[m.readdir.call_count - 1];
+}
+
+test(send_results_shall_send_the_output_of_the_runner)
+{
+  send_results((FILE*)0x1234, 0);
+  assert_eq(1, m.send_file.call_count);
+  assert_eq(0x1234, m.send_file.args.arg0);
+  assert_eq("OUTPUT", m.send_file.args.arg1);
+  assert_eq(OUTPUT_NAME, m.send_file.args.arg2);
+  assert_eq(OUTPUT_NAME, m.unlink.args.arg0);
+}
+
+test(send_results_shall_send_and_remove_the_files_of_the_runner)
+{
+  m.opendir.retval = (DIR*)0x5678;
+  m.readdir.func = readdir_stub;
+  m.is_safe_file_name.func = is_safe_file_name;
+  m.strchr.func = strchr;
+  m.sprintf.func = sprintf;
+  send_results((FILE*)0x1234, 0);
+  assert_eq(2, m.send_file.call_count);
+  assert_eq("FILE suite_test.junit_report.xml", m.send_file.args.arg1);
+  assert_eq("suite_test.junit_report.xml", m.send_file.args.arg2);
+  assert_eq("suite_test.junit_report.xml", m.unlink.args.arg0);
+  assert_eq(0x5678, m.closedir.args.arg0);
+}
+
+test(send_results_shall_tell_when_the_runner_is_done)
+{
+  send_results((FILE*)0x1234, -1);
+  assert_eq(0x1234, m.fprintf.args.arg0);
+  assert_eq("DONE %d 0\n", m.fprintf.args.arg1);
+  assert_eq(0x1234, m.fflush.args.arg0);
+}
+
+/*****************************************************************************
+ * serve_coordinator()
+ */
+static char* served_args[] = {"../0123456789abcdef", NULL};
+
+static char** read_run_request_stub(FILE* in, char* runner)
+{
+  (void)in;
+  (void)runner;
+  if (m.read_run_request.call_count > 1) {
+    return NULL;
+  }
+  return served_args;
+}
+
+test(serve_coordinator_shall_return_negative_1_if_it_can_not_connect)
+{
+  cutest_work_opts_t opts = {0};
+  m.net_connect.retval = -1;
+  assert_eq(-1, serve_coordinator(&opts, "cutest_cache", 0, 2));
+  assert_eq(0, m.mkdir.call_count);
+}
+
+test(serve_coordinator_shall_return_negative_1_without_a_scratch_directory)
+{
+  cutest_work_opts_t opts = {0};
+  m.net_connect.retval = 5;
+  m.mkdir.retval = -1;
+  assert_eq(-1, serve_coordinator(&opts, "cutest_cache", 0, 2));
+  assert_eq(0, m.read_run_request.call_count);
+  assert_eq(5, m.close.args.arg0);
+}
+
+test(serve_coordinator_shall_tell_the_coordinator_about_the_slot)
+{
+  cutest_work_opts_t opts = {0};
+  m.net_connect.retval = 5;
+  m.fdopen.retval = (FILE*)0x1234;
+  assert_eq(0, serve_coordinator(&opts, "cutest_cache", 1, 2));
+  assert_eq("HELLO %d %d\n", m.fprintf.args.arg1);
+  assert_eq(1, m.read_run_request.call_count);
+}
+
+test(serve_coordinator_shall_run_every_requested_runner)
+{
+  cutest_work_opts_t opts = {0};
+  m.net_connect.retval = 5;
+  m.fdopen.retval = (FILE*)0x1234;
+  m.read_run_request.func = read_run_request_stub;
+  m.run_runner.retval = 256;
+  assert_eq(0, serve_coordinator(&opts, "cutest_cache", 1, 2));
+  assert_eq(served_args, m.run_runner.args.arg0);
+  assert_eq(1, m.run_runner.args.arg2);
+  assert_eq(256, m.send_results.args.arg1);
+  assert_eq(served_args, m.free_args.args.arg0);
+}
+
+test(serve_coordinator_shall_return_negative_1_if_a_runner_is_not_fetched)
+{
+  cutest_work_opts_t opts = {0};
+  m.net_connect.retval = 5;
+  m.fdopen.retval = (FILE*)0x1234;
+  m.read_run_request.func = read_run_request_stub;
+  m.fetch_runner.retval = -1;
+  assert_eq(-1, serve_coordinator(&opts, "cutest_cache", 1, 2));
+  assert_eq(0, m.run_runner.call_count);
+}
+
+/*****************************************************************************
+ * run_agent()
+ */
+static pid_t wait_failed_stub(int* status)
+{
+  if (m.wait.call_count > 1) {
+    return -1;
+  }
+  *status = EXIT_FAILURE << 8;
+  return 1234;
+}
+
+test(run_agent_shall_return_negative_1_without_a_cache)
+{
+  cutest_work_opts_t opts = {0};
+  m.mkdir.retval = -1;
+  m.access.retval = -1;
+  assert_eq(-1, run_agent(&opts, 4));
+  assert_eq(DEFAULT_CACHE, m.mkdir.args.arg0);
+  assert_eq(0, m.fork.call_count);
+}
+
+test(run_agent_shall_start_one_connection_per_worker)
+{
+  cutest_work_opts_t opts = {0};
+  m.get_number_of_workers.retval = 3;
+  m.fork.retval = 1234;
+  assert_eq(0, run_agent(&opts, 4));
+  assert_eq(3, m.fork.call_count);
+  assert_eq(0, m.serve_coordinator.call_count);
+  assert_eq(3, m.remove_cgroups.args.arg1);
+}
+
+test(run_agent_shall_serve_the_coordinator_in_every_child)
+{
+  cutest_work_opts_t opts = {0};
+  opts.cache = "/tmp/cache";
+  m.get_number_of_workers.retval = 2;
+  run_agent(&opts, 4);
+  assert_eq(2, m.serve_coordinator.call_count);
+  assert_eq("/tmp/cache", m.serve_coordinator.args.arg1);
+  assert_eq(1, m.serve_coordinator.args.arg2);
+  assert_eq(2, m.serve_coordinator.args.arg3);
+  assert_eq(EXIT_SUCCESS, m._exit.args.arg0);
+}
+
+test(run_agent_shall_return_negative_1_if_a_worker_fails)
+{
+  cutest_work_opts_t opts = {0};
+  m.get_number_of_workers.retval = 1;
+  m.fork.retval = 1234;
+  m.wait.func = wait_failed_stub;
+  assert_eq(-1, run_agent(&opts, 4));
+}
+
+/*****************************************************************************
+ * main()
+ */
+static void handle_args_stub(cutest_work_opts_t* opts, int argc,
+                             char* argv[])
+{
+  (void)argc;
+  (void)argv;
+  opts->verbose = -1;
+  opts->first_suite = 2;
+}
+
+static cutest_work_suite_t main_suites[3];
+static cutest_work_item_t main_items[3];
+static cutest_work_queue_t main_queue = {3, main_items};
+
+test(main_shall_call_handle_args_correctly)
 {
-  m.get_number_of_cores.retval = 4;
-  m.handle_args.retval = 3;
   main(1, 0x2);
-  assert_eq(0, m.launch_child_processes.call_count);
+  assert_eq(1, m.handle_args.call_count);
+  assert_eq(1, m.handle_args.args.arg1);
+  assert_eq(0x2, m.handle_args.args.arg2);
+}
+
+test(main_shall_get_the_number_of_cores_using_get_number_of_cores)
+{
+  main(1, 0x2);
+  assert_eq(1, m.get_number_of_cores.call_count);
+}
+
+test(main_shall_get_the_number_of_workers_for_the_cores)
+{
+  m.get_number_of_cores.retval = 4;
+  main(5, 0x2);
+  assert_eq(1, m.get_number_of_workers.call_count);
+  assert_eq(4, m.get_number_of_workers.args.arg1);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_no_test_suites)
+{
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.new_work_queue.call_count);
+}
+
+test(main_shall_list_the_tests_if_more_than_one_worker)
+{
+  m.get_number_of_workers.retval = 2;
+  main(5, 0x2);
+  assert_eq(1, m.new_test_suites.call_count);
+  assert_eq(1, m.new_test_suites.args.arg1);
+}
+
+test(main_shall_not_list_the_tests_for_a_single_worker)
+{
+  m.get_number_of_workers.retval = 1;
+  main(5, 0x2);
+  assert_eq(0, m.new_test_suites.args.arg1);
+}
+
+test(main_shall_queue_all_test_suites_in_batches)
+{
+  m.handle_args.func = handle_args_stub;
+  m.new_test_suites.retval = main_suites;
+  m.get_tests_per_batch.retval = 10;
+  main(5, 0x2);
+  assert_eq(1, m.new_work_queue.call_count);
+  assert_eq(main_suites, m.new_work_queue.args.arg0);
+  assert_eq(3, m.new_work_queue.args.arg1);
+  assert_eq(10, m.new_work_queue.args.arg2);
+}
+
+test(main_shall_shard_the_test_suites_after_reading_the_history)
+{
+  m.handle_args.func = handle_args_stub;
+  m.new_test_suites.retval = main_suites;
+  main(5, 0x2);
+  assert_eq(1, m.read_history.call_count);
+  assert_eq(main_suites, m.read_history.args.arg1);
+  assert_eq(3, m.read_history.args.arg2);
+  assert_eq(1, m.shard_test_suites.call_count);
+  assert_eq(main_suites, m.shard_test_suites.args.arg1);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_sharding_fails)
+{
+  m.new_test_suites.retval = main_suites;
+  m.shard_test_suites.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.new_work_queue.call_count);
+}
+
+static void handle_args_history_stub(cutest_work_opts_t* opts, int argc,
+                                     char* argv[])
+{
+  handle_args_stub(opts, argc, argv);
+  opts->history = "ci.history";
+}
+
+test(main_shall_write_the_history_if_told_to)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_history_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.new_test_suites.args.arg1);
+  assert_eq(1, m.write_history.call_count);
+  assert_eq(main_suites, m.write_history.args.arg1);
+}
+
+static void handle_args_changed_only_stub(cutest_work_opts_t* opts,
+                                         int argc, char* argv[])
+{
+  handle_args_history_stub(opts, argc, argv);
+  opts->changed_only = "clean.txt";
+}
+
+test(main_shall_only_run_the_changed_suites_if_told_to)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_changed_only_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.skip_unchanged_suites.call_count);
+  assert_eq("clean.txt", m.skip_unchanged_suites.args.arg0);
+  assert_eq(1, m.write_clean_suites.call_count);
+  assert_eq(main_suites, m.write_clean_suites.args.arg1);
+  assert_eq(0, m.write_history.call_count);
+}
+
+static void handle_args_results_stub(cutest_work_opts_t* opts, int argc,
+                                     char* argv[])
+{
+  handle_args_stub(opts, argc, argv);
+  opts->results = "cutest_results";
+}
+
+test(main_shall_not_run_the_cached_suites_if_told_to)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_results_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.skip_cached_suites.call_count);
+  assert_eq(main_suites, m.skip_cached_suites.args.arg1);
+  assert_eq(1, m.write_cached_suites.call_count);
+  assert_eq(main_suites, m.write_cached_suites.args.arg1);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_results_can_not_be_read)
+{
+  m.handle_args.func = handle_args_results_stub;
+  m.new_test_suites.retval = main_suites;
+  m.skip_cached_suites.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.new_work_queue.call_count);
+}
+
+static void handle_args_watch_stub(cutest_work_opts_t* opts, int argc,
+                                   char* argv[])
+{
+  handle_args_stub(opts, argc, argv);
+  opts->watch = "src";
+}
+
+test(main_shall_only_watch_the_sources_if_told_to)
+{
+  m.handle_args.func = handle_args_watch_stub;
+  m.watch_sources.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(1, m.watch_sources.call_count);
+  assert_eq(0, m.new_test_suites.call_count);
+}
+
+static void handle_args_rerun_stub(cutest_work_opts_t* opts, int argc,
+                                   char* argv[])
+{
+  handle_args_history_stub(opts, argc, argv);
+  opts->junit = "all.xml";
+  opts->rerun_failed = 1;
+}
+
+test(main_shall_only_keep_the_failed_tests_if_rerunning)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_rerun_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.new_test_suites.args.arg1);
+  assert_eq(1, m.keep_failed_tests.call_count);
+  assert_eq("all.xml", m.keep_failed_tests.args.arg0);
+  assert_eq(main_suites, m.keep_failed_tests.args.arg1);
+  assert_eq(0, m.write_history.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_last_run_can_not_be_read)
+{
+  m.handle_args.func = handle_args_rerun_stub;
+  m.new_test_suites.retval = main_suites;
+  m.keep_failed_tests.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.new_work_queue.call_count);
+}
+
+test(main_shall_not_write_the_history_if_not_told_to)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(0, m.write_history.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_no_work_queue)
+{
+  m.new_test_suites.retval = main_suites;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.new_worker_pool.call_count);
+  assert_eq(1, m.delete_test_suites.call_count);
+}
 
-  assert_eq(1, m.launch_process.call_count);
-  assert_eq(1, m.launch_process.args.arg0);
-  assert_eq(0x2, m.launch_process.args.arg1);
-  assert_eq(3, m.launch_process.args.arg2);
+test(main_shall_not_create_more_workers_than_work_items)
+{
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.get_number_of_workers.retval = 8;
+  main(5, 0x2);
+  assert_eq(1, m.new_worker_pool.call_count);
+  assert_eq(3, m.new_worker_pool.args.arg0);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_no_worker_pool)
+{
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.run_test_suites.call_count);
+  assert_eq(1, m.delete_work_queue.call_count);
 }
 
-test(main_shall_return_EXIT_FAILURE_if_launch_process_fails)
+test(main_shall_run_all_work_items_in_the_pool)
 {
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
   m.get_number_of_cores.retval = 4;
-  m.handle_args.retval = 3;
-  m.launch_process.retval = -1;
-  assert_eq(EXIT_FAILURE, main(1, 0x2));
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.run_test_suites.call_count);
+  assert_eq(&pool, m.run_test_suites.args.arg0);
+  assert_eq(&main_queue, m.run_test_suites.args.arg1);
+  assert_eq(4, m.run_test_suites.args.arg3);
+  assert_eq(1, m.delete_worker_pool.call_count);
+  assert_eq(1, m.delete_work_queue.call_count);
+  assert_eq(1, m.delete_test_suites.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_report_can_not_be_opened)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  m.open_report.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.run_test_suites.call_count);
+  assert_eq(1, m.delete_worker_pool.call_count);
+}
+
+test(main_shall_close_the_report_when_all_work_items_are_run)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.open_report.call_count);
+  assert_eq(m.open_report.args.arg0, m.run_test_suites.args.arg4);
+  assert_eq(1, m.close_report.call_count);
+  assert_eq(m.open_report.args.arg0, m.close_report.args.arg0);
+  assert_eq(2, m.close_report.args.arg1);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_trace_can_not_be_opened)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  m.open_trace.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.run_test_suites.call_count);
+}
+
+test(main_shall_close_the_trace_when_all_work_items_are_run)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.open_trace.call_count);
+  assert_eq(m.open_trace.args.arg0, m.run_test_suites.args.arg5);
+  assert_eq(1, m.close_trace.call_count);
+  assert_eq(m.open_trace.args.arg0, m.close_trace.args.arg0);
+  assert_eq(2, m.close_trace.args.arg1);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_cgroups_can_not_be_set_up)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  m.setup_cgroups.retval = -1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(0, m.run_test_suites.call_count);
+}
+
+test(main_shall_remove_the_cgroups_when_all_work_items_are_run)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.remove_cgroups.call_count);
+  assert_eq(2, m.remove_cgroups.args.arg1);
+}
+
+test(main_shall_add_a_line_feed_if_no_line_feed)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.puts.call_count);
+}
+
+test(main_shall_watch_the_runners_if_showing_the_progress)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_stub;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  m.get_progress_mode.retval = CUTEST_WORK_PROGRESS_LIVE;
+  main(5, 0x2);
+  assert_eq(1, m.new_test_suites.args.arg1); /* To show the current test */
+  assert_eq(1, m.watch_worker_pool.call_count);
+  assert_eq(&pool, m.watch_worker_pool.args.arg0);
+  assert_eq(CUTEST_WORK_PROGRESS_LIVE, m.open_progress.args.arg1);
+  assert_eq(0, m.puts.call_count);
+}
+
+test(main_shall_not_watch_the_runners_by_default)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(0, m.watch_worker_pool.call_count);
+}
+
+test(main_shall_print_logs_if_more_than_one_worker)
+{
+  cutest_work_pool_t pool = {2, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(1, m.print_logs.call_count);
+  assert_eq(&main_queue, m.print_logs.args.arg0);
+}
+
+test(main_shall_not_print_logs_if_only_one_worker)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(0, m.print_logs.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_a_test_suite_fails)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  m.run_test_suites.retval = 1;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+}
+
+test(main_shall_return_EXIT_SUCCESS_if_all_test_suites_pass)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  m.run_test_suites.retval = 0;
+  assert_eq(EXIT_SUCCESS, main(5, 0x2));
+}
+
+static void handle_args_agent_stub(cutest_work_opts_t* opts, int argc,
+                                   char* argv[])
+{
+  (void)argc;
+  (void)argv;
+  opts->coordinator = "build1:4711";
+}
+
+static void handle_args_listen_stub(cutest_work_opts_t* opts, int argc,
+                                    char* argv[])
+{
+  handle_args_stub(opts, argc, argv);
+  opts->listen_address = ":4711";
+  opts->agents = 1;
+}
+
+static int main_agents[2] = {7, 8};
+
+static int* accept_agents_stub(const cutest_work_opts_t* opts, int* cnt)
+{
+  (void)opts;
+  *cnt = 2;
+  return main_agents;
 }
 
-test(main_shall_return_EXIT_SUCCESS_if_launch_process_fails)
+test(main_shall_run_as_an_agent_if_told_to)
 {
+  m.handle_args.func = handle_args_agent_stub;
   m.get_number_of_cores.retval = 4;
-  m.handle_args.retval = 3;
-  m.launch_process.retval = 0;
-  assert_eq(EXIT_SUCCESS, main(1, 0x2));
+  assert_eq(EXIT_SUCCESS, main(5, 0x2));
+  assert_eq(1, m.run_agent.call_count);
+  assert_eq(4, m.run_agent.args.arg1);
+  assert_eq(0, m.new_test_suites.call_count);
+}
+
+test(main_shall_return_EXIT_FAILURE_if_the_agents_can_not_be_accepted)
+{
+  m.handle_args.func = handle_args_listen_stub;
+  assert_eq(EXIT_FAILURE, main(5, 0x2));
+  assert_eq(1, m.accept_agents.call_count);
+  assert_eq(0, m.new_test_suites.call_count);
+}
+
+test(main_shall_add_the_agents_to_the_worker_pool)
+{
+  cutest_work_pool_t pool = {1, 0, NULL, NULL, NULL, NULL};
+  m.handle_args.func = handle_args_listen_stub;
+  m.accept_agents.func = accept_agents_stub;
+  m.get_number_of_workers.retval = 1;
+  m.new_test_suites.retval = main_suites;
+  m.new_work_queue.retval = &main_queue;
+  m.new_worker_pool.retval = &pool;
+  main(5, 0x2);
+  assert_eq(3, m.new_worker_pool.args.arg0);
+  assert_eq(&pool, m.assign_agents.args.arg0);
+  assert_eq(main_agents, m.assign_agents.args.arg1);
+  assert_eq(2, m.assign_agents.args.arg2);
+  assert_eq(1, m.assign_agents.args.arg3);
+  assert_eq(main_agents, m.close_agents.args.arg0);
+  assert_eq(2, m.close_agents.args.arg1);
+}
+
+/*****************************************************************************
+ * find_changed_suite()
+ */
+test(find_changed_suite_shall_find_the_suite_of_a_source_or_test)
+{
+  char* argv[] = {"program_name", "-n", "/src/a_test", "/src/ab_test"};
+  m.strrchr.func = strrchr;
+  m.strcmp.func = strcmp;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.get_suite_name.func = get_suite_name;
+  assert_eq(2, find_changed_suite("a.c", 4, argv, 2));
+  assert_eq(2, find_changed_suite("a.h", 4, argv, 2));
+  assert_eq(3, find_changed_suite("ab_test.c", 4, argv, 2));
+  assert_eq(-1, find_changed_suite("b.c", 4, argv, 2));
+}
+
+test(find_changed_suite_shall_ignore_generated_files)
+{
+  char* argv[] = {"program_name", "-n", "/src/a_test"};
+  m.strrchr.func = strrchr;
+  m.strcmp.func = strcmp;
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.get_suite_name.func = get_suite_name;
+  assert_eq(-1, find_changed_suite("a_test_run.c", 3, argv, 2));
+  assert_eq(-1, find_changed_suite("a_mocks.h", 3, argv, 2));
+  assert_eq(-1, find_changed_suite("a_proxified.s", 3, argv, 2));
+  assert_eq(-1, find_changed_suite("a_test", 3, argv, 2));
+}
+
+/*****************************************************************************
+ * mark_changed_suites()
+ */
+test(mark_changed_suites_shall_mark_every_suite_once)
+{
+  char buf[3 * (sizeof(struct inotify_event) + 16)];
+  const char* name[3] = {"a.c", "a_test.c", "b.c"};
+  struct inotify_event event = {0};
+  int changed[2] = {0, 0};
+  size_t len = 0;
+  int i;
+  for (i = 0; i < 3; i++) {
+    event.len = 16;
+    memcpy(&buf[len], &event, sizeof(event));
+    strcpy(&buf[len + sizeof(event)], name[i]);
+    len += sizeof(event) + event.len;
+  }
+  m.find_changed_suite.retval = 1;
+  assert_eq(1, mark_changed_suites(changed, buf, len, 2, NULL, 1));
+  assert_eq(3, m.find_changed_suite.call_count);
+  assert_eq("b.c", m.find_changed_suite.args.arg0);
+  assert_eq(1, changed[1]);
+}
+
+/*****************************************************************************
+ * rerun_test_suite()
+ */
+test(rerun_test_suite_shall_rebuild_the_suite_first)
+{
+  char command[64];
+  cutest_work_opts_t opts = {0};
+  opts.rebuild = "make -s";
+  m.malloc.retval = command;
+  m.sprintf.func = sprintf;
+  m.spawn_test_suite.retval = 1234;
+  m.waitpid.retval = 1234;
+  assert_eq(0, rerun_test_suite(&opts, "/src/a_test"));
+  assert_eq("make -s /src/a_test", m.system.args.arg0);
+  assert_eq(1, m.spawn_test_suite.call_count);
+  assert_eq(-1, m.spawn_test_suite.args.arg5);
+}
+
+test(rerun_test_suite_shall_not_run_the_suite_if_the_rebuild_fails)
+{
+  char command[64];
+  cutest_work_opts_t opts = {0};
+  opts.rebuild = "make -s";
+  m.malloc.retval = command;
+  m.system.retval = 2;
+  assert_eq(-1, rerun_test_suite(&opts, "/src/a_test"));
+  assert_eq(0, m.spawn_test_suite.call_count);
+}
+
+test(rerun_test_suite_shall_just_run_the_suite_without_a_rebuild_command)
+{
+  cutest_work_opts_t opts = {0};
+  opts.verbose = -1;
+  m.spawn_test_suite.retval = 1234;
+  m.waitpid.retval = 1234;
+  rerun_test_suite(&opts, "/src/a_test");
+  assert_eq(0, m.system.call_count);
+  assert_eq(1, m.waitpid.call_count);
+  assert_eq(1, m.puts.call_count); /* After the dots */
+}
+
+/*****************************************************************************
+ * watch_sources()
+ */
+test(watch_sources_shall_watch_the_sources_and_the_tests)
+{
+  char* argv[] = {"program_name", "-n", "/build/a_test"};
+  cutest_work_opts_t opts = {0};
+  opts.watch = "/src";
+  opts.watch_tests = "/test";
+  opts.first_suite = 2;
+  m.inotify_init.retval = 3;
+  m.calloc.func = calloc;
+  m.free.func = free;
+  watch_sources(&opts, 3, argv);
+  assert_eq(2, m.inotify_add_watch.call_count);
+  assert_eq(3, m.inotify_add_watch.args.arg0);
+  assert_eq("/test", m.inotify_add_watch.args.arg1);
+  assert_eq(1, m.read.call_count);
+  assert_eq(1, m.close.call_count);
+}
+
+test(watch_sources_shall_find_the_tests_among_the_sources_by_default)
+{
+  char* argv[] = {"program_name", "-n", "/build/a_test"};
+  cutest_work_opts_t opts = {0};
+  opts.watch = "/src";
+  opts.first_suite = 2;
+  m.inotify_init.retval = 3;
+  m.calloc.func = calloc;
+  m.free.func = free;
+  watch_sources(&opts, 3, argv);
+  assert_eq("/src", m.inotify_add_watch.args.arg1);
+}
+
+test(watch_sources_shall_return_negative_1_if_it_can_not_watch)
+{
+  char* argv[] = {"program_name", "-n", "/test/a_test"};
+  cutest_work_opts_t opts = {0};
+  opts.watch = "/src";
+  opts.first_suite = 2;
+  m.inotify_init.retval = -1;
+  assert_eq(-1, watch_sources(&opts, 3, argv));
+  assert_eq(0, m.read.call_count);
+}
+
+static ssize_t read_event_stub(int fd, void* buf, size_t count)
+{
+  (void)fd;
+  (void)buf;
+  (void)count;
+  return (1 == m.read.call_count) ? 16 : -1;
+}
+
+static int mark_changed_suites_stub(int* changed, const char* buf,
+                                    ssize_t len, int argc, char* argv[],
+                                    int first_suite)
+{
+  (void)buf;
+  (void)len;
+  (void)argc;
+  (void)argv;
+  changed[first_suite] = 1;
+  return 1;
+}
+
+test(watch_sources_shall_rerun_the_changed_suites)
+{
+  char* argv[] = {"program_name", "-n", "/test/a_test", "/test/b_test"};
+  cutest_work_opts_t opts = {0};
+  opts.watch = "/src";
+  opts.first_suite = 2;
+  m.inotify_init.retval = 3;
+  m.calloc.func = calloc;
+  m.free.func = free;
+  m.read.func = read_event_stub;
+  m.mark_changed_suites.func = mark_changed_suites_stub;
+  watch_sources(&opts, 4, argv);
+  assert_eq(1, m.poll.call_count); /* Until quiet */
+  assert_eq(1, m.rerun_test_suite.call_count);
+  assert_eq("/test/a_test", m.rerun_test_suite.args.arg1);
 }
 
 #undef main
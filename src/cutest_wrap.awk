@@ -0,0 +1,51 @@
+#
+# cutest_wrap.awk
+#
+#    CUTest link backend - objcopy options to call mock-ups in an object
+#    Copyright (C) 2017 Joakim Ekblad - AiO Secure Teletronics
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage: objdump -t dut_mockables.o | awk -f cutest_wrap.awk mocked.lst -
+#
+# The first file lists the functions that have mock-ups, one per line, and
+# the second is the symbol table of the object file of the design under
+# test. The objcopy options printed make every call in the object file go
+# to cutest_<function> instead, just like cutest_prox does to the assembler
+# file.
+#
+# A function that is only called is renamed. A function that is defined in
+# the object file is renamed too, since the calls of it refer to the very
+# same symbol, but the definition is made weak so that the mock-up replaces
+# it, and a new symbol under the old name is added at the same place, so
+# that the test cases can still call the real function.
+#
+
+FILENAME == ARGV[1] {
+	mocked[$1] = 1
+	next
+}
+
+# 0000000000000000         *UND*	0000000000000000 puts
+$2 == "*UND*" && ($NF in mocked) {
+	print "--redefine-sym " $NF "=cutest_" $NF
+	next
+}
+
+# 0000000000000000 g     F .text	000000000000000f .hidden helper
+$2 == "g" && $3 == "F" && ($NF in mocked) {
+	print "--redefine-sym " $NF "=cutest_" $NF
+	print "--weaken-symbol=cutest_" $NF
+	print "--add-symbol " $NF "=" $4 ":0x" $1 ",global,function"
+}
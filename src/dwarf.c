@@ -0,0 +1,1084 @@
+/*
+ * Function prototypes from the DWARF debug information of an object file.
+ *
+ * The compiler writes the exact type of every function that a design
+ * under test defines or calls to the object file, when compiling with
+ * ``-g``. They are written back as C prototypes, in the form ``cproto``
+ * writes them, so that ``cutest_mock`` parses them the very same way
+ * without running ``cproto`` on the design under test and its headers.
+ *
+ * Only 64-bit little-endian ELF objects with DWARF version 2 to 5 are
+ * read. A relocatable object is relocated from x86-64 or AArch64 only,
+ * since the debug information refers to its strings by relocations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#include "dwarf.h"
+
+#define DW_TAG_array_type 0x01
+#define DW_TAG_enumeration_type 0x04
+#define DW_TAG_formal_parameter 0x05
+#define DW_TAG_pointer_type 0x0f
+#define DW_TAG_structure_type 0x13
+#define DW_TAG_subroutine_type 0x15
+#define DW_TAG_typedef 0x16
+#define DW_TAG_union_type 0x17
+#define DW_TAG_unspecified_parameters 0x18
+#define DW_TAG_subrange_type 0x21
+#define DW_TAG_base_type 0x24
+#define DW_TAG_const_type 0x26
+#define DW_TAG_subprogram 0x2e
+#define DW_TAG_volatile_type 0x35
+#define DW_TAG_restrict_type 0x37
+#define DW_TAG_unspecified_type 0x3b
+#define DW_TAG_atomic_type 0x47
+
+#define DW_AT_name 0x03
+#define DW_AT_prototyped 0x27
+#define DW_AT_upper_bound 0x2f
+#define DW_AT_abstract_origin 0x31
+#define DW_AT_artificial 0x34
+#define DW_AT_count 0x37
+#define DW_AT_specification 0x47
+#define DW_AT_type 0x49
+#define DW_AT_linkage_name 0x6e
+#define DW_AT_str_offsets_base 0x72
+#define DW_AT_MIPS_linkage_name 0x2007
+
+#define DW_FORM_addr 0x01
+#define DW_FORM_block2 0x03
+#define DW_FORM_block4 0x04
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_data8 0x07
+#define DW_FORM_string 0x08
+#define DW_FORM_block 0x09
+#define DW_FORM_block1 0x0a
+#define DW_FORM_data1 0x0b
+#define DW_FORM_flag 0x0c
+#define DW_FORM_sdata 0x0d
+#define DW_FORM_strp 0x0e
+#define DW_FORM_udata 0x0f
+#define DW_FORM_ref_addr 0x10
+#define DW_FORM_ref1 0x11
+#define DW_FORM_ref2 0x12
+#define DW_FORM_ref4 0x13
+#define DW_FORM_ref8 0x14
+#define DW_FORM_ref_udata 0x15
+#define DW_FORM_indirect 0x16
+#define DW_FORM_sec_offset 0x17
+#define DW_FORM_exprloc 0x18
+#define DW_FORM_flag_present 0x19
+#define DW_FORM_strx 0x1a
+#define DW_FORM_addrx 0x1b
+#define DW_FORM_ref_sup4 0x1c
+#define DW_FORM_strp_sup 0x1d
+#define DW_FORM_data16 0x1e
+#define DW_FORM_line_strp 0x1f
+#define DW_FORM_ref_sig8 0x20
+#define DW_FORM_implicit_const 0x21
+#define DW_FORM_loclistx 0x22
+#define DW_FORM_rnglistx 0x23
+#define DW_FORM_ref_sup8 0x24
+#define DW_FORM_strx1 0x25
+#define DW_FORM_strx2 0x26
+#define DW_FORM_strx3 0x27
+#define DW_FORM_strx4 0x28
+#define DW_FORM_addrx1 0x29
+#define DW_FORM_addrx2 0x2a
+#define DW_FORM_addrx3 0x2b
+#define DW_FORM_addrx4 0x2c
+#define DW_FORM_GNU_addr_index 0x1f01
+#define DW_FORM_GNU_str_index 0x1f02
+#define DW_FORM_GNU_ref_alt 0x1f20
+#define DW_FORM_GNU_strp_alt 0x1f21
+
+#define DW_UT_compile 0x01
+#define DW_UT_partial 0x03
+
+/* What an attribute value is */
+#define VALUE_NONE 0
+#define VALUE_NUM 1
+#define VALUE_REF 2 /* The offset of a DIE in the section */
+#define VALUE_STR 3
+#define VALUE_STRX 4 /* The index of a string in the string offsets */
+
+/* Types nested deeper than this are not written */
+#define DWARF_MAX_DEPTH 16
+
+static unsigned long long read_fixed(dwarf_cursor_t* c, int size)
+{
+  /* Little-endian, since only such objects are read */
+  unsigned long long value = 0;
+  int i;
+
+  if (c->end - c->pos < size) {
+    c->pos = c->end;
+    c->error = 1;
+    return 0;
+  }
+  for (i = 0; i < size; i++) {
+    value |= (unsigned long long)c->pos[i] << (8 * i);
+  }
+  c->pos += size;
+  return value;
+}
+
+static unsigned long long read_uleb(dwarf_cursor_t* c)
+{
+  unsigned long long value = 0;
+  int shift = 0;
+
+  while (c->pos < c->end) {
+    const unsigned char byte = *c->pos++;
+
+    if (shift < 64) {
+      value |= (unsigned long long)(byte & 0x7f) << shift;
+    }
+    shift += 7;
+    if (0 == (byte & 0x80)) {
+      return value;
+    }
+  }
+  c->error = 1;
+  return 0;
+}
+
+static long long read_sleb(dwarf_cursor_t* c)
+{
+  unsigned long long value = 0;
+  unsigned char byte = 0;
+  int shift = 0;
+
+  do {
+    if (c->pos >= c->end) {
+      c->error = 1;
+      return 0;
+    }
+    byte = *c->pos++;
+    if (shift < 64) {
+      value |= (unsigned long long)(byte & 0x7f) << shift;
+    }
+    shift += 7;
+  } while (byte & 0x80);
+  if ((shift < 64) && (byte & 0x40)) {
+    value |= ~0ULL << shift;
+  }
+  return (long long)value;
+}
+
+static void skip_bytes(dwarf_cursor_t* c, unsigned long long size)
+{
+  if ((unsigned long long)(c->end - c->pos) < size) {
+    c->pos = c->end;
+    c->error = 1;
+    return;
+  }
+  c->pos += size;
+}
+
+static const char* read_string(dwarf_cursor_t* c)
+{
+  const char* s = (const char*)c->pos;
+  const unsigned char* nul = memchr(c->pos, 0, c->end - c->pos);
+
+  if (NULL == nul) {
+    c->pos = c->end;
+    c->error = 1;
+    return NULL;
+  }
+  c->pos = nul + 1;
+  return s;
+}
+
+static const char* section_string(const dwarf_section_t* s,
+                                  unsigned long long offset)
+{
+  if ((NULL == s->data) || (offset >= s->size) ||
+      (NULL == memchr(s->data + offset, 0, s->size - offset))) {
+    return NULL;
+  }
+  return (const char*)s->data + offset;
+}
+
+static int read_value(dwarf_cursor_t* c, const dwarf_t* d,
+                      const dwarf_unit_t* u, unsigned long long form,
+                      long long implicit, dwarf_value_t* v)
+{
+  v->kind = VALUE_NUM;
+  v->num = 0;
+  v->str = NULL;
+
+  switch (form) {
+  case DW_FORM_data1:
+  case DW_FORM_flag:
+    v->num = read_fixed(c, 1);
+    break;
+  case DW_FORM_data2:
+    v->num = read_fixed(c, 2);
+    break;
+  case DW_FORM_data4:
+    v->num = read_fixed(c, 4);
+    break;
+  case DW_FORM_data8:
+    v->num = read_fixed(c, 8);
+    break;
+  case DW_FORM_sdata:
+    v->num = (unsigned long long)read_sleb(c);
+    break;
+  case DW_FORM_udata:
+    v->num = read_uleb(c);
+    break;
+  case DW_FORM_implicit_const:
+    v->num = (unsigned long long)implicit;
+    break;
+  case DW_FORM_flag_present:
+    v->num = 1;
+    break;
+  case DW_FORM_sec_offset:
+    v->num = read_fixed(c, u->offset_size);
+    break;
+  case DW_FORM_string:
+    v->kind = VALUE_STR;
+    v->str = read_string(c);
+    break;
+  case DW_FORM_strp:
+    v->kind = VALUE_STR;
+    v->str = section_string(&d->str, read_fixed(c, u->offset_size));
+    break;
+  case DW_FORM_line_strp:
+    v->kind = VALUE_STR;
+    v->str = section_string(&d->line_str, read_fixed(c, u->offset_size));
+    break;
+  case DW_FORM_strx:
+  case DW_FORM_GNU_str_index:
+    v->kind = VALUE_STRX;
+    v->num = read_uleb(c);
+    break;
+  case DW_FORM_strx1:
+  case DW_FORM_strx2:
+  case DW_FORM_strx3:
+  case DW_FORM_strx4:
+    v->kind = VALUE_STRX;
+    v->num = read_fixed(c, (int)(form - DW_FORM_strx1) + 1);
+    break;
+  case DW_FORM_ref1:
+    v->kind = VALUE_REF;
+    v->num = u->offset + read_fixed(c, 1);
+    break;
+  case DW_FORM_ref2:
+    v->kind = VALUE_REF;
+    v->num = u->offset + read_fixed(c, 2);
+    break;
+  case DW_FORM_ref4:
+    v->kind = VALUE_REF;
+    v->num = u->offset + read_fixed(c, 4);
+    break;
+  case DW_FORM_ref8:
+    v->kind = VALUE_REF;
+    v->num = u->offset + read_fixed(c, 8);
+    break;
+  case DW_FORM_ref_udata:
+    v->kind = VALUE_REF;
+    v->num = u->offset + read_uleb(c);
+    break;
+  case DW_FORM_ref_addr:
+    v->kind = VALUE_REF;
+    v->num = read_fixed(c, (2 == u->version) ? u->addr_size : u->offset_size);
+    break;
+  case DW_FORM_indirect:
+    return read_value(c, d, u, read_uleb(c), implicit, v);
+  default:
+    /* Everything else is only skipped */
+    v->kind = VALUE_NONE;
+    switch (form) {
+    case DW_FORM_addr:
+      skip_bytes(c, u->addr_size);
+      break;
+    case DW_FORM_block1:
+      skip_bytes(c, read_fixed(c, 1));
+      break;
+    case DW_FORM_block2:
+      skip_bytes(c, read_fixed(c, 2));
+      break;
+    case DW_FORM_block4:
+      skip_bytes(c, read_fixed(c, 4));
+      break;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+      skip_bytes(c, read_uleb(c));
+      break;
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+    case DW_FORM_GNU_addr_index:
+      read_uleb(c);
+      break;
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+      skip_bytes(c, form - DW_FORM_addrx1 + 1);
+      break;
+    case DW_FORM_data16:
+      skip_bytes(c, 16);
+      break;
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+      skip_bytes(c, 8);
+      break;
+    case DW_FORM_ref_sup4:
+      skip_bytes(c, 4);
+      break;
+    case DW_FORM_strp_sup:
+    case DW_FORM_GNU_ref_alt:
+    case DW_FORM_GNU_strp_alt:
+      skip_bytes(c, u->offset_size);
+      break;
+    default:
+      return -1;
+    }
+  }
+  return c->error ? -1 : 0;
+}
+
+static int read_abbrevs(dwarf_t* d, unsigned long long offset)
+{
+  dwarf_cursor_t c;
+
+  d->abbrev_cnt = 0;
+  if (offset >= d->abbrev.size) {
+    return -1;
+  }
+  c.pos = d->abbrev.data + offset;
+  c.end = d->abbrev.data + d->abbrev.size;
+  c.error = 0;
+
+  for (;;) {
+    dwarf_abbrev_t a;
+    unsigned long long attr = 0;
+    unsigned long long form = 0;
+
+    a.code = read_uleb(&c);
+    if ((0 == a.code) || c.error) {
+      break;
+    }
+    a.tag = read_uleb(&c);
+    a.children = (int)read_fixed(&c, 1);
+    a.attr = c.pos;
+    do {
+      attr = read_uleb(&c);
+      form = read_uleb(&c);
+      if (DW_FORM_implicit_const == form) {
+        read_sleb(&c);
+      }
+    } while (!c.error && ((0 != attr) || (0 != form)));
+
+    if (d->abbrev_cnt == d->abbrev_size) {
+      const int size = (0 == d->abbrev_size) ? 64 : 2 * d->abbrev_size;
+      dwarf_abbrev_t* table = realloc(d->abbrev_table, size * sizeof(a));
+      if (NULL == table) {
+        return -1;
+      }
+      d->abbrev_table = table;
+      d->abbrev_size = size;
+    }
+    d->abbrev_table[d->abbrev_cnt++] = a;
+  }
+  return c.error ? -1 : 0;
+}
+
+static const dwarf_abbrev_t* find_abbrev(const dwarf_t* d,
+                                         unsigned long long code)
+{
+  /* The codes are most often numbered from 1 in order */
+  int i;
+
+  if ((code <= (unsigned long long)d->abbrev_cnt) &&
+      (code == d->abbrev_table[code - 1].code)) {
+    return &d->abbrev_table[code - 1];
+  }
+  for (i = 0; i < d->abbrev_cnt; i++) {
+    if (code == d->abbrev_table[i].code) {
+      return &d->abbrev_table[i];
+    }
+  }
+  return NULL;
+}
+
+static const dwarf_die_t* find_die(const dwarf_t* d, long long offset)
+{
+  int first = 0;
+  int last = d->die_cnt - 1;
+
+  while (first <= last) {
+    const int i = (first + last) / 2;
+
+    if (d->die[i].offset == offset) {
+      return &d->die[i];
+    }
+    if (d->die[i].offset < offset) {
+      first = i + 1;
+    }
+    else {
+      last = i - 1;
+    }
+  }
+  return NULL;
+}
+
+static void set_attribute(dwarf_die_t* die, dwarf_unit_t* u,
+                          unsigned long long attr, const dwarf_value_t* v)
+{
+  switch (attr) {
+  case DW_AT_name:
+    if (VALUE_STR == v->kind) {
+      die->name = v->str;
+    }
+    else if (VALUE_STRX == v->kind) {
+      die->strx = (long long)v->num;
+    }
+    break;
+  case DW_AT_linkage_name:
+  case DW_AT_MIPS_linkage_name:
+    if (VALUE_STR == v->kind) {
+      die->symbol = v->str;
+    }
+    break;
+  case DW_AT_type:
+    if (VALUE_REF == v->kind) {
+      die->type = (long long)v->num;
+    }
+    break;
+  case DW_AT_specification:
+  case DW_AT_abstract_origin:
+    if (VALUE_REF == v->kind) {
+      die->spec = (long long)v->num;
+    }
+    break;
+  case DW_AT_upper_bound:
+    if (VALUE_NUM == v->kind) {
+      die->count = (long long)v->num + 1;
+    }
+    break;
+  case DW_AT_count:
+    if (VALUE_NUM == v->kind) {
+      die->count = (long long)v->num;
+    }
+    break;
+  case DW_AT_prototyped:
+    die->prototyped = (0 != v->num);
+    break;
+  case DW_AT_artificial:
+    die->artificial = (0 != v->num);
+    break;
+  case DW_AT_str_offsets_base:
+    u->str_offsets_base = v->num;
+    break;
+  default:
+    break;
+  }
+}
+
+static dwarf_die_t* new_die(dwarf_t* d)
+{
+  dwarf_die_t* die = NULL;
+
+  if (d->die_cnt == d->die_size) {
+    const int size = (0 == d->die_size) ? 1024 : 2 * d->die_size;
+    dwarf_die_t* dies = realloc(d->die, size * sizeof(*dies));
+    if (NULL == dies) {
+      return NULL;
+    }
+    d->die = dies;
+    d->die_size = size;
+  }
+  die = &d->die[d->die_cnt++];
+  memset(die, 0, sizeof(*die));
+  die->strx = -1;
+  die->type = -1;
+  die->spec = -1;
+  die->count = -1;
+  return die;
+}
+
+static int read_dies(dwarf_t* d, dwarf_unit_t* u, dwarf_cursor_t* c)
+{
+  int parent = -1;
+
+  d->die_cnt = 0;
+  while (c->pos < c->end) {
+    const long long offset = c->pos - d->info.data;
+    const unsigned long long code = read_uleb(c);
+    const dwarf_abbrev_t* a = NULL;
+    dwarf_die_t* die = NULL;
+    dwarf_cursor_t attr;
+
+    if (c->error) {
+      return -1;
+    }
+    if (0 == code) { /* The end of the children of the parent */
+      if (0 <= parent) {
+        parent = d->die[parent].parent;
+      }
+      continue;
+    }
+    if ((NULL == (a = find_abbrev(d, code))) || (NULL == (die = new_die(d)))) {
+      return -1;
+    }
+    die->offset = offset;
+    die->tag = a->tag;
+    die->parent = parent;
+    die->depth = (0 <= parent) ? d->die[parent].depth + 1 : 0;
+
+    attr.pos = a->attr;
+    attr.end = d->abbrev.data + d->abbrev.size;
+    attr.error = 0;
+    for (;;) {
+      const unsigned long long name = read_uleb(&attr);
+      const unsigned long long form = read_uleb(&attr);
+      long long implicit = 0;
+      dwarf_value_t v;
+
+      if (DW_FORM_implicit_const == form) {
+        implicit = read_sleb(&attr);
+      }
+      if (attr.error) {
+        return -1;
+      }
+      if ((0 == name) && (0 == form)) {
+        break;
+      }
+      if (0 != read_value(c, d, u, form, implicit, &v)) {
+        return -1;
+      }
+      set_attribute(die, u, name, &v);
+    }
+    if (a->children) {
+      parent = d->die_cnt - 1;
+    }
+  }
+  return 0;
+}
+
+static void resolve_names(dwarf_t* d, const dwarf_unit_t* u)
+{
+  /*
+   * The base of the string offsets of a unit may come after the names that
+   * need it, so the names given by index are looked up once all is read.
+   */
+  int i;
+
+  for (i = 0; i < d->die_cnt; i++) {
+    dwarf_die_t* die = &d->die[i];
+    const unsigned long long pos = u->str_offsets_base +
+      (unsigned long long)die->strx * u->offset_size;
+    dwarf_cursor_t c;
+
+    if ((0 > die->strx) || (NULL == d->str_offsets.data) ||
+        (pos >= d->str_offsets.size)) {
+      continue;
+    }
+    c.pos = d->str_offsets.data + pos;
+    c.end = d->str_offsets.data + d->str_offsets.size;
+    c.error = 0;
+    die->name = section_string(&d->str, read_fixed(&c, u->offset_size));
+  }
+}
+
+static int concat(char* dst, const char* a, const char* b, const char* c)
+{
+  /* The destination must not be any of the strings */
+  const size_t a_len = strlen(a);
+  const size_t b_len = strlen(b);
+  const size_t c_len = strlen(c);
+
+  if (a_len + b_len + c_len >= DWARF_PROTOTYPE_LEN) {
+    return -1;
+  }
+  memcpy(dst, a, a_len);
+  memcpy(dst + a_len, b, b_len);
+  memcpy(dst + a_len + b_len, c, c_len + 1);
+  return 0;
+}
+
+static int declare(char* dst, const char* specifier, const char* declarator)
+{
+  /* Written as cproto does, e.g. "char *arg0" or "char *" */
+  return concat(dst, specifier, ('\0' == declarator[0]) ? "" : " ",
+                declarator);
+}
+
+static int is_tag(const dwarf_t* d, long long type, unsigned long long tag)
+{
+  const dwarf_die_t* die = (0 > type) ? NULL : find_die(d, type);
+
+  return ((NULL != die) && (tag == die->tag));
+}
+
+static int format_type(const dwarf_t* d, char* dst, long long type,
+                       const char* declarator, int depth);
+
+static int format_params(const dwarf_t* d, char* dst, int idx, int named,
+                         int depth)
+{
+  /*
+   * The parameters are the children of a function, named after themselves
+   * if they are named, or after their position, as the cproto output.
+   */
+  char buf[DWARF_PROTOTYPE_LEN];
+  char name[32];
+  size_t len = 0;
+  int cnt = 0;
+  int i;
+
+  dst[0] = 0;
+  for (i = idx + 1; (i < d->die_cnt) && (d->die[i].depth > d->die[idx].depth);
+       i++) {
+    const dwarf_die_t* param = &d->die[i];
+
+    if (param->parent != idx) {
+      continue;
+    }
+    if (DW_TAG_formal_parameter == param->tag) {
+      sprintf(name, "arg%d", cnt);
+      if (0 != format_type(d, buf, param->type,
+                           !named ? "" :
+                           (NULL != param->name) ? param->name : name,
+                           depth + 1)) {
+        return -1;
+      }
+    }
+    else if ((DW_TAG_unspecified_parameters == param->tag) &&
+             d->die[idx].prototyped) {
+      /* Or a function declared without a prototype */
+      strcpy(buf, "...");
+    }
+    else {
+      continue;
+    }
+    len += strlen(buf) + ((0 == cnt) ? 0 : 2);
+    if (len >= DWARF_PROTOTYPE_LEN) {
+      return -1;
+    }
+    if (0 != cnt) {
+      strcat(dst, ", ");
+    }
+    strcat(dst, buf);
+    cnt++;
+  }
+  if ((0 == cnt) && (named || d->die[idx].prototyped)) {
+    strcpy(dst, "void");
+  }
+  return 0;
+}
+
+static int format_type(const dwarf_t* d, char* dst, long long type,
+                       const char* declarator, int depth)
+{
+  /*
+   * A C declaration is written inside out. The declarator grows from the
+   * name out through pointers, arrays and functions, until a type that
+   * has a name of its own is reached.
+   */
+  char buf[DWARF_PROTOTYPE_LEN];
+  char params[DWARF_PROTOTYPE_LEN];
+  const dwarf_die_t* die = NULL;
+  const char* keyword = NULL;
+  int i;
+
+  if (depth > DWARF_MAX_DEPTH) {
+    return -1;
+  }
+  if (0 > type) {
+    return declare(dst, "void", declarator);
+  }
+  if (NULL == (die = find_die(d, type))) {
+    return -1;
+  }
+
+  switch (die->tag) {
+  case DW_TAG_base_type:
+  case DW_TAG_typedef:
+  case DW_TAG_unspecified_type:
+    if (NULL == die->name) {
+      return -1;
+    }
+    /* GCC names the complex types as they are spelled in C++ */
+    if (0 == strncmp(die->name, "complex ", 8)) {
+      return (concat(buf, "_Complex ", &die->name[8], "") ||
+              declare(dst, buf, declarator));
+    }
+    return declare(dst, die->name, declarator);
+  case DW_TAG_structure_type:
+    keyword = "struct ";
+    break;
+  case DW_TAG_union_type:
+    keyword = "union ";
+    break;
+  case DW_TAG_enumeration_type:
+    keyword = "enum ";
+    break;
+  case DW_TAG_const_type:
+  case DW_TAG_volatile_type:
+    keyword = (DW_TAG_const_type == die->tag) ? "const" : "volatile";
+    if (is_tag(d, die->type, DW_TAG_pointer_type)) {
+      return (concat(buf, keyword, ('\0' == declarator[0]) ? "" : " ",
+                     declarator) ||
+              format_type(d, dst, die->type, buf, depth + 1));
+    }
+    return (format_type(d, buf, die->type, declarator, depth + 1) ||
+            concat(dst, keyword, " ", buf));
+  case DW_TAG_restrict_type:
+  case DW_TAG_atomic_type:
+    /* Not in every C standard, and not part of the type of a parameter */
+    return format_type(d, dst, die->type, declarator, depth + 1);
+  case DW_TAG_pointer_type:
+    if (is_tag(d, die->type, DW_TAG_array_type) ||
+        is_tag(d, die->type, DW_TAG_subroutine_type)) {
+      return (concat(buf, "(*", declarator, ")") ||
+              format_type(d, dst, die->type, buf, depth + 1));
+    }
+    return (concat(buf, "*", declarator, "") ||
+            format_type(d, dst, die->type, buf, depth + 1));
+  case DW_TAG_array_type:
+    if (0 != concat(buf, declarator, "", "")) {
+      return -1;
+    }
+    for (i = (int)(die - d->die) + 1;
+         (i < d->die_cnt) && (d->die[i].depth > die->depth); i++) {
+      if ((d->die[i].parent != die - d->die) ||
+          (DW_TAG_subrange_type != d->die[i].tag)) {
+        continue;
+      }
+      if (0 > d->die[i].count) {
+        strcpy(params, "[]");
+      }
+      else {
+        sprintf(params, "[%lld]", d->die[i].count);
+      }
+      if (strlen(buf) + strlen(params) >= DWARF_PROTOTYPE_LEN) {
+        return -1;
+      }
+      strcat(buf, params);
+    }
+    return format_type(d, dst, die->type, buf, depth + 1);
+  case DW_TAG_subroutine_type:
+    if ((0 != format_params(d, params, (int)(die - d->die), 0, depth)) ||
+        (0 != concat(buf, declarator, "(", params)) ||
+        (strlen(buf) + 1 >= DWARF_PROTOTYPE_LEN)) {
+      return -1;
+    }
+    strcat(buf, ")");
+    return format_type(d, dst, die->type, buf, depth + 1);
+  default:
+    return -1;
+  }
+
+  /* A struct, union or enum without a name can not be written */
+  if (NULL == die->name) {
+    return -1;
+  }
+  return (concat(buf, keyword, die->name, "") ||
+          declare(dst, buf, declarator));
+}
+
+static int format_function(const dwarf_t* d, char* dst, int idx)
+{
+  /*
+   * A definition may leave its name, type and parameters to an earlier
+   * declaration of the same function. A function declared with an asm label,
+   * like signal() that glibc links as __sysv_signal, is called by the name
+   * of its symbol, so that is the name the mock-up must have.
+   */
+  const dwarf_die_t* die = &d->die[idx];
+  const dwarf_die_t* spec = (0 > die->spec) ? NULL : find_die(d, die->spec);
+  const char* name = (NULL != die->symbol) ? die->symbol : die->name;
+  long long type = die->type;
+  int params_idx = idx;
+  char params[DWARF_PROTOTYPE_LEN];
+  char declarator[DWARF_PROTOTYPE_LEN];
+  char buf[DWARF_PROTOTYPE_LEN];
+
+  if (NULL != spec) {
+    name = (NULL != name) ? name : spec->symbol;
+    name = (NULL != name) ? name : spec->name;
+    type = (0 <= type) ? type : spec->type;
+    if ((idx + 1 >= d->die_cnt) || (d->die[idx + 1].parent != idx)) {
+      params_idx = (int)(spec - d->die);
+    }
+  }
+  if (NULL == name) {
+    return -1;
+  }
+  if ((0 != format_params(d, params, params_idx, 1, 0)) ||
+      (0 != concat(declarator, name, "(", params)) ||
+      (strlen(declarator) + 1 >= DWARF_PROTOTYPE_LEN)) {
+    return -1;
+  }
+  strcat(declarator, ")");
+  return (format_type(d, buf, type, declarator, 0) ||
+          concat(dst, buf, ";", ""));
+}
+
+static void print_prototypes(const dwarf_t* d, dwarf_prototype_cb_t cb,
+                             void* data)
+{
+  /* Only the functions of the unit itself, not the ones inside them */
+  char prototype[DWARF_PROTOTYPE_LEN];
+  int i;
+
+  for (i = 0; i < d->die_cnt; i++) {
+    if ((DW_TAG_subprogram == d->die[i].tag) && (1 == d->die[i].depth) &&
+        !d->die[i].artificial && (0 == format_function(d, prototype, i))) {
+      cb(data, prototype);
+    }
+  }
+}
+
+static int read_units(dwarf_t* d, dwarf_prototype_cb_t cb, void* data)
+{
+  size_t offset = 0;
+
+  while (offset < d->info.size) {
+    dwarf_cursor_t c;
+    dwarf_unit_t u;
+    unsigned long long len = 0;
+    unsigned long long abbrev_offset = 0;
+    int unit_type = DW_UT_compile;
+
+    c.pos = d->info.data + offset;
+    c.end = d->info.data + d->info.size;
+    c.error = 0;
+    memset(&u, 0, sizeof(u));
+    u.offset = offset;
+    u.offset_size = 4;
+    len = read_fixed(&c, 4);
+    if (0xffffffff == len) {
+      u.offset_size = 8;
+      len = read_fixed(&c, 8);
+    }
+    if (c.error || (len > (unsigned long long)(c.end - c.pos))) {
+      return -1;
+    }
+    c.end = c.pos + len;
+    offset = c.end - d->info.data;
+
+    u.version = (int)read_fixed(&c, 2);
+    if (5 <= u.version) {
+      unit_type = (int)read_fixed(&c, 1);
+      u.addr_size = (int)read_fixed(&c, 1);
+      abbrev_offset = read_fixed(&c, u.offset_size);
+      u.str_offsets_base = 2 * u.offset_size;
+    }
+    else {
+      abbrev_offset = read_fixed(&c, u.offset_size);
+      u.addr_size = (int)read_fixed(&c, 1);
+    }
+    if (c.error || (2 > u.version) || (5 < u.version)) {
+      return -1;
+    }
+    /* Type units and split units have no functions of their own */
+    if ((DW_UT_compile != unit_type) && (DW_UT_partial != unit_type)) {
+      continue;
+    }
+    if ((0 != read_abbrevs(d, abbrev_offset)) || (0 != read_dies(d, &u, &c))) {
+      return -1;
+    }
+    resolve_names(d, &u);
+    print_prototypes(d, cb, data);
+  }
+  return 0;
+}
+
+static int get_section(const unsigned char* elf, size_t size,
+                       const Elf64_Ehdr* eh, int idx, Elf64_Shdr* sh)
+{
+  if ((0 > idx) || (idx >= eh->e_shnum)) {
+    return -1;
+  }
+  memcpy(sh, elf + eh->e_shoff + idx * sizeof(*sh), sizeof(*sh));
+  if ((SHT_NOBITS == sh->sh_type) || (sh->sh_offset > size) ||
+      (sh->sh_size > size - sh->sh_offset)) {
+    return -1;
+  }
+  return 0;
+}
+
+static int relocation_size(int machine, unsigned long type)
+{
+  /*
+   * The size of an absolute relocation, the only ones that the debug
+   * information needs, or 0 for any other relocation.
+   */
+  switch (machine) {
+  case EM_X86_64:
+    if (R_X86_64_64 == type) {
+      return 8;
+    }
+    return ((R_X86_64_32 == type) || (R_X86_64_32S == type)) ? 4 : 0;
+  case EM_AARCH64:
+    if (R_AARCH64_ABS64 == type) {
+      return 8;
+    }
+    return (R_AARCH64_ABS32 == type) ? 4 : 0;
+  default:
+    return -1;
+  }
+}
+
+static int relocate(unsigned char* elf, size_t size, const Elf64_Ehdr* eh,
+                    const Elf64_Shdr* rela, const Elf64_Shdr* target)
+{
+  Elf64_Shdr symtab;
+  size_t i;
+
+  if (0 != get_section(elf, size, eh, rela->sh_link, &symtab)) {
+    return -1;
+  }
+  for (i = 0; i < rela->sh_size / sizeof(Elf64_Rela); i++) {
+    Elf64_Rela r;
+    Elf64_Sym sym;
+    unsigned long long value = 0;
+    int width = 0;
+    int j;
+
+    memcpy(&r, elf + rela->sh_offset + i * sizeof(r), sizeof(r));
+    width = relocation_size(eh->e_machine, ELF64_R_TYPE(r.r_info));
+    if (0 > width) {
+      return -1;
+    }
+    if ((0 == width) || (target->sh_size < (size_t)width) ||
+        (r.r_offset > target->sh_size - width)) {
+      continue;
+    }
+    if ((ELF64_R_SYM(r.r_info) + 1) * sizeof(sym) > symtab.sh_size) {
+      return -1;
+    }
+    memcpy(&sym, elf + symtab.sh_offset + ELF64_R_SYM(r.r_info) * sizeof(sym),
+           sizeof(sym));
+    value = sym.st_value + r.r_addend;
+    for (j = 0; j < width; j++) {
+      elf[target->sh_offset + r.r_offset + j] = (value >> (8 * j)) & 0xff;
+    }
+  }
+  return 0;
+}
+
+static int find_sections(dwarf_t* d, unsigned char* elf, size_t size)
+{
+  Elf64_Ehdr eh;
+  Elf64_Shdr names;
+  Elf64_Shdr sh;
+  Elf64_Shdr target;
+  int i;
+
+  if (size < sizeof(eh)) {
+    return -1;
+  }
+  memcpy(&eh, elf, sizeof(eh));
+  if ((0 != memcmp(eh.e_ident, ELFMAG, SELFMAG)) ||
+      (ELFCLASS64 != eh.e_ident[EI_CLASS]) ||
+      (ELFDATA2LSB != eh.e_ident[EI_DATA]) ||
+      (sizeof(sh) != eh.e_shentsize) || (eh.e_shoff > size) ||
+      (eh.e_shnum > (size - eh.e_shoff) / sizeof(sh)) ||
+      (0 != get_section(elf, size, &eh, eh.e_shstrndx, &names))) {
+    return -1;
+  }
+
+  for (i = 0; i < eh.e_shnum; i++) {
+    dwarf_section_t* section = NULL;
+    const char* name = NULL;
+
+    if ((0 != get_section(elf, size, &eh, i, &sh)) ||
+        (sh.sh_name >= names.sh_size) ||
+        (NULL == memchr(elf + names.sh_offset + sh.sh_name, 0,
+                        names.sh_size - sh.sh_name))) {
+      continue;
+    }
+    name = (const char*)elf + names.sh_offset + sh.sh_name;
+    if (0 == strcmp(name, ".debug_info")) {
+      section = &d->info;
+    }
+    else if (0 == strcmp(name, ".debug_abbrev")) {
+      section = &d->abbrev;
+    }
+    else if (0 == strcmp(name, ".debug_str")) {
+      section = &d->str;
+    }
+    else if (0 == strcmp(name, ".debug_line_str")) {
+      section = &d->line_str;
+    }
+    else if (0 == strcmp(name, ".debug_str_offsets")) {
+      section = &d->str_offsets;
+    }
+    else if ((SHT_RELA == sh.sh_type) &&
+             (0 == strncmp(name, ".rela.debug_", 12)) &&
+             ((0 != get_section(elf, size, &eh, sh.sh_info, &target)) ||
+              (0 != relocate(elf, size, &eh, &sh, &target)))) {
+      return -1;
+    }
+    if (NULL != section) {
+      /* Compressed debug information is not read */
+      if (0 != (sh.sh_flags & SHF_COMPRESSED)) {
+        return -1;
+      }
+      section->data = elf + sh.sh_offset;
+      section->size = sh.sh_size;
+    }
+  }
+
+  if ((NULL == d->info.data) || (NULL == d->abbrev.data)) {
+    return -1;
+  }
+  return 0;
+}
+
+static unsigned char* read_file(const char* file_name, size_t* size)
+{
+  unsigned char* buf = NULL;
+  FILE* fd = fopen(file_name, "rb");
+  long len = 0;
+
+  if (NULL == fd) {
+    return NULL;
+  }
+  if ((0 == fseek(fd, 0, SEEK_END)) && (0 < (len = ftell(fd))) &&
+      (0 == fseek(fd, 0, SEEK_SET)) && (NULL != (buf = malloc(len))) &&
+      (1 != fread(buf, len, 1, fd))) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(fd);
+  *size = (NULL == buf) ? 0 : (size_t)len;
+  return buf;
+}
+
+/*
+ * Call the callback with the prototype of every function in the debug
+ * information of the object file, and return 0, or -1 if it can not be
+ * read.
+ */
+int dwarf_prototypes(const char* file_name, dwarf_prototype_cb_t cb,
+                     void* data)
+{
+  dwarf_t d;
+  size_t size = 0;
+  unsigned char* elf = read_file(file_name, &size);
+  int retval = -1;
+
+  if (NULL == elf) {
+    return -1;
+  }
+  memset(&d, 0, sizeof(d));
+  if (0 == find_sections(&d, elf, size)) {
+    retval = read_units(&d, cb, data);
+  }
+  free(d.abbrev_table);
+  free(d.die);
+  free(elf);
+  return retval;
+}
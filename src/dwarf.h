@@ -0,0 +1,77 @@
+#ifndef _DWARF_H_
+#define _DWARF_H_
+
+#include <stddef.h>
+
+/* The longest prototype, as the longest line read from cproto */
+#define DWARF_PROTOTYPE_LEN 1024
+
+/* What is read of an object file, unit by unit */
+typedef struct dwarf_section_s {
+  unsigned char* data;
+  size_t size;
+} dwarf_section_t;
+
+typedef struct dwarf_cursor_s {
+  const unsigned char* pos;
+  const unsigned char* end;
+  int error;
+} dwarf_cursor_t;
+
+typedef struct dwarf_value_s {
+  int kind;
+  unsigned long long num;
+  const char* str;
+} dwarf_value_t;
+
+typedef struct dwarf_abbrev_s {
+  unsigned long long code;
+  unsigned long long tag;
+  int children;
+  const unsigned char* attr; /* The attribute and form pairs */
+} dwarf_abbrev_t;
+
+typedef struct dwarf_die_s {
+  long long offset;
+  unsigned long long tag;
+  const char* name;
+  const char* symbol; /* The name to link with, if not the name itself */
+  long long strx; /* The index of the name, or -1 */
+  long long type; /* The offset of the type, or -1 for void */
+  long long spec; /* The offset of the declaration, or -1 */
+  long long count; /* The elements of an array dimension, or -1 */
+  int prototyped;
+  int artificial;
+  int parent; /* The index of the parent, or -1 */
+  int depth;
+} dwarf_die_t;
+
+typedef struct dwarf_unit_s {
+  int version;
+  int offset_size;
+  int addr_size;
+  long long offset; /* Where the unit header is in the section */
+  unsigned long long str_offsets_base;
+} dwarf_unit_t;
+
+typedef struct dwarf_s {
+  dwarf_section_t info;
+  dwarf_section_t abbrev;
+  dwarf_section_t str;
+  dwarf_section_t line_str;
+  dwarf_section_t str_offsets;
+  dwarf_abbrev_t* abbrev_table;
+  int abbrev_cnt;
+  int abbrev_size;
+  dwarf_die_t* die; /* The DIEs of the unit, by their offsets */
+  int die_cnt;
+  int die_size;
+} dwarf_t;
+
+/* Called with every prototype, as C without a trailing newline */
+typedef void (*dwarf_prototype_cb_t)(void* data, char* prototype);
+
+int dwarf_prototypes(const char* file_name, dwarf_prototype_cb_t cb,
+                     void* data);
+
+#endif
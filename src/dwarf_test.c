@@ -0,0 +1,257 @@
+#include "cutest.h"
+
+/* For convenience 'm' is shorter to write than 'cutest_mock' */
+#define m cutest_mock
+
+/*****************************************************************************
+ * read_uleb()
+ */
+module_test(read_uleb_shall_read_a_value_of_several_bytes)
+{
+  const unsigned char buf[] = {0xe5, 0x8e, 0x26, 0x01};
+  dwarf_cursor_t c = {buf, buf + sizeof(buf), 0};
+  assert_eq(624485, read_uleb(&c));
+  assert_eq(buf + 3, c.pos);
+  assert_eq(0, c.error);
+}
+
+module_test(read_uleb_shall_set_the_error_if_the_value_is_not_ended)
+{
+  const unsigned char buf[] = {0x80, 0x80};
+  dwarf_cursor_t c = {buf, buf + sizeof(buf), 0};
+  assert_eq(0, read_uleb(&c));
+  assert_eq(1, c.error);
+}
+
+/*****************************************************************************
+ * read_sleb()
+ */
+module_test(read_sleb_shall_read_a_negative_value)
+{
+  const unsigned char buf[] = {0x80, 0x7f};
+  dwarf_cursor_t c = {buf, buf + sizeof(buf), 0};
+  assert_eq(-128, read_sleb(&c));
+  assert_eq(0, c.error);
+}
+
+module_test(read_sleb_shall_read_a_positive_value)
+{
+  const unsigned char buf[] = {0x3f};
+  dwarf_cursor_t c = {buf, buf + sizeof(buf), 0};
+  assert_eq(63, read_sleb(&c));
+}
+
+/*****************************************************************************
+ * read_fixed()
+ */
+module_test(read_fixed_shall_read_little_endian_values)
+{
+  const unsigned char buf[] = {0x34, 0x12};
+  dwarf_cursor_t c = {buf, buf + sizeof(buf), 0};
+  assert_eq(0x1234, read_fixed(&c, 2));
+  assert_eq(0, c.error);
+}
+
+module_test(read_fixed_shall_set_the_error_if_the_value_is_cut)
+{
+  const unsigned char buf[] = {0x34, 0x12};
+  dwarf_cursor_t c = {buf, buf + sizeof(buf), 0};
+  assert_eq(0, read_fixed(&c, 4));
+  assert_eq(1, c.error);
+  assert_eq(buf + 2, c.pos);
+}
+
+/*****************************************************************************
+ * concat()
+ */
+module_test(concat_shall_join_the_strings)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  assert_eq(0, concat(dst, "char", " ", "*arg0"));
+  assert_eq("char *arg0", dst);
+}
+
+module_test(concat_shall_return_negative_1_if_the_result_is_too_long)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  char a[DWARF_PROTOTYPE_LEN];
+  memset(a, 'a', sizeof(a) - 1);
+  a[sizeof(a) - 1] = 0;
+  assert_eq(-1, concat(dst, a, "b", ""));
+}
+
+/*****************************************************************************
+ * format_type() and format_function()
+ */
+static dwarf_die_t dies[16];
+static dwarf_t types = {{0}, {0}, {0}, {0}, {0}, NULL, 0, 0, dies, 0, 0};
+
+static int add_die(unsigned long long tag, const char* name, long long type,
+                   int parent)
+{
+  dwarf_die_t* d = &dies[types.die_cnt];
+  memset(d, 0, sizeof(*d));
+  d->offset = 0x10 * (types.die_cnt + 1);
+  d->tag = tag;
+  d->name = name;
+  d->strx = -1;
+  d->type = type;
+  d->spec = -1;
+  d->count = -1;
+  d->parent = parent;
+  d->depth = (0 > parent) ? 1 : dies[parent].depth + 1;
+  types.die_cnt++;
+  return (int)d->offset;
+}
+
+module_test(format_type_shall_write_void_without_a_type)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  types.die_cnt = 0;
+  assert_eq(0, format_type(&types, dst, -1, "*arg0", 0));
+  assert_eq("void *arg0", dst);
+}
+
+module_test(format_type_shall_write_a_pointer_to_a_const_type)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  int type;
+  types.die_cnt = 0;
+  type = add_die(DW_TAG_base_type, "char", -1, -1);
+  type = add_die(DW_TAG_const_type, NULL, type, -1);
+  type = add_die(DW_TAG_pointer_type, NULL, type, -1);
+  assert_eq(0, format_type(&types, dst, type, "arg0", 0));
+  assert_eq("const char *arg0", dst);
+}
+
+module_test(format_type_shall_write_a_const_pointer_after_the_asterisk)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  int type;
+  types.die_cnt = 0;
+  type = add_die(DW_TAG_base_type, "char", -1, -1);
+  type = add_die(DW_TAG_pointer_type, NULL, type, -1);
+  type = add_die(DW_TAG_const_type, NULL, type, -1);
+  assert_eq(0, format_type(&types, dst, type, "arg0", 0));
+  assert_eq("char *const arg0", dst);
+}
+
+module_test(format_type_shall_write_a_pointer_to_a_function)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  int integer;
+  int type;
+  types.die_cnt = 0;
+  integer = add_die(DW_TAG_base_type, "int", -1, -1);
+  type = add_die(DW_TAG_subroutine_type, NULL, integer, -1);
+  dies[1].prototyped = 1;
+  add_die(DW_TAG_formal_parameter, NULL, integer, 1);
+  add_die(DW_TAG_formal_parameter, NULL, -1, 1);
+  dies[3].type = add_die(DW_TAG_pointer_type, NULL, -1, -1);
+  type = add_die(DW_TAG_pointer_type, NULL, type, -1);
+  assert_eq(0, format_type(&types, dst, type, "cb", 0));
+  assert_eq("int (*cb)(int, void *)", dst);
+}
+
+module_test(format_type_shall_write_the_dimensions_of_an_array)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  int type;
+  types.die_cnt = 0;
+  type = add_die(DW_TAG_base_type, "char", -1, -1);
+  add_die(DW_TAG_array_type, NULL, type, -1);
+  add_die(DW_TAG_subrange_type, NULL, -1, 1);
+  dies[2].count = 8;
+  add_die(DW_TAG_subrange_type, NULL, -1, 1);
+  assert_eq(0, format_type(&types, dst, dies[1].offset, "name", 0));
+  assert_eq("char name[8][]", dst);
+}
+
+module_test(format_type_shall_return_negative_1_for_an_anonymous_struct)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  types.die_cnt = 0;
+  add_die(DW_TAG_structure_type, NULL, -1, -1);
+  assert_eq(-1, format_type(&types, dst, dies[0].offset, "arg0", 0));
+}
+
+module_test(format_function_shall_name_a_function_after_its_symbol)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  types.die_cnt = 0;
+  add_die(DW_TAG_subprogram, "signal", -1, -1);
+  dies[0].symbol = "__sysv_signal";
+  dies[0].prototyped = 1;
+  assert_eq(0, format_function(&types, dst, 0));
+  assert_eq("void __sysv_signal(void);", dst);
+}
+
+module_test(format_function_shall_name_the_parameters_of_a_definition)
+{
+  char dst[DWARF_PROTOTYPE_LEN];
+  int type;
+  types.die_cnt = 0;
+  type = add_die(DW_TAG_base_type, "int", -1, -1);
+  add_die(DW_TAG_subprogram, "foo", type, -1);
+  dies[1].prototyped = 1;
+  add_die(DW_TAG_formal_parameter, "value", type, 1);
+  add_die(DW_TAG_formal_parameter, NULL, type, 1);
+  add_die(DW_TAG_unspecified_parameters, NULL, -1, 1);
+  assert_eq(0, format_function(&types, dst, 1));
+  assert_eq("int foo(int value, int arg1, ...);", dst);
+}
+
+/*****************************************************************************
+ * find_sections()
+ */
+module_test(find_sections_shall_return_negative_1_if_not_an_elf_file)
+{
+  unsigned char buf[sizeof(Elf64_Ehdr)] = "#!/bin/sh";
+  dwarf_t d;
+  memset(&d, 0, sizeof(d));
+  assert_eq(-1, find_sections(&d, buf, sizeof(buf)));
+}
+
+module_test(find_sections_shall_return_negative_1_if_the_file_is_too_short)
+{
+  unsigned char buf[] = ELFMAG;
+  dwarf_t d;
+  memset(&d, 0, sizeof(d));
+  assert_eq(-1, find_sections(&d, buf, sizeof(buf)));
+}
+
+/*****************************************************************************
+ * dwarf_prototypes()
+ */
+static void prototype_cb(void* data, char* prototype)
+{
+  (void)data;
+  (void)prototype;
+}
+
+test(dwarf_prototypes_shall_return_negative_1_if_the_file_can_not_be_read)
+{
+  assert_eq(-1, dwarf_prototypes("dut.o", prototype_cb, NULL));
+  assert_eq("dut.o", m.read_file.args.arg0);
+  assert_eq(0, m.find_sections.call_count);
+}
+
+test(dwarf_prototypes_shall_not_read_the_units_if_there_is_no_dwarf)
+{
+  m.read_file.retval = (unsigned char*)0x1234;
+  m.find_sections.retval = -1;
+  assert_eq(-1, dwarf_prototypes("dut.o", prototype_cb, NULL));
+  assert_eq(0, m.read_units.call_count);
+  assert_eq((unsigned char*)0x1234, m.free.args.arg0);
+}
+
+test(dwarf_prototypes_shall_read_the_units_with_the_callback)
+{
+  int data;
+  m.read_file.retval = (unsigned char*)0x1234;
+  m.read_units.retval = 0;
+  assert_eq(0, dwarf_prototypes("dut.o", prototype_cb, &data));
+  assert_eq(prototype_cb, m.read_units.args.arg1);
+  assert_eq(&data, m.read_units.args.arg2);
+  assert_eq(3, m.free.call_count);
+}
@@ -19,6 +19,7 @@ typedef struct mockable_node_s {
   char* symbol_name;
   arg_list_t* args;
   int legit;
+  int shared; /* Implemented by the shared C library mock-ups */
   struct mockable_node_s* next;
 } mockable_node_t;
 
@@ -0,0 +1,196 @@
+/*
+ * Connections between the cutest_work coordinator and its agents.
+ *
+ * An address is either ``host:port`` for TCP over IPv4, where an empty
+ * host means any interface when listening, or ``unix:<path>`` for a Unix
+ * socket.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* For gethostbyname() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "net.h"
+
+#define UNIX_PREFIX "unix:"
+#define HOST_LEN 256
+#define BACKLOG 64
+
+static int split_address(char* host, const char** port, const char* address)
+{
+  /* The port follows the last colon */
+  const char* colon = strrchr(address, ':');
+
+  if ((NULL == colon) || (colon - address >= HOST_LEN)) {
+    return -1;
+  }
+  memcpy(host, address, colon - address);
+  host[colon - address] = 0;
+  *port = colon + 1;
+  return 0;
+}
+
+static int open_socket(const struct sockaddr* addr, socklen_t len,
+                       int server)
+{
+  const int on = 1;
+  const int fd = socket(addr->sa_family, SOCK_STREAM, 0);
+
+  if (0 > fd) {
+    return -1;
+  }
+  if (1 == server) {
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if ((0 == bind(fd, addr, len)) && (0 == listen(fd, BACKLOG))) {
+      return fd;
+    }
+  }
+  else if (0 == connect(fd, addr, len)) {
+    return fd;
+  }
+  close(fd);
+  return -1;
+}
+
+static int unix_socket(const char* path, int server)
+{
+  struct sockaddr_un addr;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  if (1 == server) {
+    unlink(path); /* Left behind by an earlier coordinator */
+  }
+  return open_socket((struct sockaddr*)&addr, sizeof(addr), server);
+}
+
+static int tcp_socket(const char* address, int server)
+{
+  /* Build boxes are found by name or IPv4 address */
+  struct sockaddr_in addr;
+  struct hostent* entry = NULL;
+  char host[HOST_LEN];
+  const char* port = NULL;
+
+  if (0 != split_address(host, &port, address)) {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((unsigned short)strtol(port, NULL, 10));
+  if ('\0' == host[0]) {
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  }
+  else if ((NULL != (entry = gethostbyname(host))) &&
+           (AF_INET == entry->h_addrtype)) {
+    memcpy(&addr.sin_addr, entry->h_addr_list[0], sizeof(addr.sin_addr));
+  }
+  else {
+    return -1;
+  }
+  return open_socket((struct sockaddr*)&addr, sizeof(addr), server);
+}
+
+static int new_socket(const char* address, int server)
+{
+  int fd = -1;
+
+  if (0 == strncmp(address, UNIX_PREFIX, strlen(UNIX_PREFIX))) {
+    fd = unix_socket(address + strlen(UNIX_PREFIX), server);
+  }
+  else {
+    fd = tcp_socket(address, server);
+  }
+  if (0 > fd) {
+    fprintf(stderr, "ERROR: Could not %s '%s'\n",
+            (1 == server) ? "listen on" : "connect to", address);
+  }
+  return fd;
+}
+
+int net_listen(const char* address)
+{
+  return new_socket(address, 1);
+}
+
+int net_connect(const char* address)
+{
+  return new_socket(address, 0);
+}
+
+int get_file_hash(char* hash, const char* file_name)
+{
+  /*
+   * A 64-bit FNV-1a hash of the file content, plenty to tell the test
+   * suite runners apart in the cache of an agent.
+   */
+  unsigned long long value = 14695981039346656037ULL;
+  unsigned char buf[4096];
+  size_t len = 0;
+  size_t i = 0;
+  FILE* fd = fopen(file_name, "rb");
+
+  if (NULL == fd) {
+    fprintf(stderr, "ERROR: Could not open '%s' for reading\n", file_name);
+    return -1;
+  }
+  while (0 < (len = fread(buf, 1, sizeof(buf), fd))) {
+    for (i = 0; i < len; i++) {
+      value ^= buf[i];
+      value *= 1099511628211ULL;
+    }
+  }
+  fclose(fd);
+  sprintf(hash, "%016llx", value);
+  return 0;
+}
+
+int copy_bytes(FILE* in, FILE* out, long size)
+{
+  char buf[4096];
+
+  while (size > 0) {
+    const size_t len = fread(buf, 1, (size < (long)sizeof(buf)) ?
+                             (size_t)size : sizeof(buf), in);
+    if (0 == len) {
+      return -1;
+    }
+    if (len != fwrite(buf, 1, len, out)) {
+      return -1;
+    }
+    size -= len;
+  }
+  return 0;
+}
+
+int send_file(FILE* out, const char* header, const char* file_name)
+{
+  /* A header line with the size, followed by the content of the file */
+  FILE* fd = fopen(file_name, "rb");
+  long size = 0;
+  int retval = -1;
+
+  if (NULL == fd) {
+    return -1;
+  }
+  if ((0 == fseek(fd, 0, SEEK_END)) && (0 <= (size = ftell(fd))) &&
+      (0 == fseek(fd, 0, SEEK_SET))) {
+    fprintf(out, "%s %ld\n", header, size);
+    retval = copy_bytes(fd, out, size);
+    fflush(out);
+  }
+  fclose(fd);
+  return retval;
+}
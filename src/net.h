@@ -0,0 +1,15 @@
+#ifndef _NET_H_
+#define _NET_H_
+
+#include <stdio.h>
+
+/* 64 bits in hex and a terminator */
+#define NET_HASH_LEN 17
+
+int net_listen(const char* address);
+int net_connect(const char* address);
+int get_file_hash(char* hash, const char* file_name);
+int send_file(FILE* out, const char* header, const char* file_name);
+int copy_bytes(FILE* in, FILE* out, long size);
+
+#endif
@@ -0,0 +1,316 @@
+#include <unistd.h>
+
+#include "cutest.h"
+
+/* For convenience 'm' is shorter to write than 'cutest_mock' */
+#define m cutest_mock
+
+/*****************************************************************************
+ * split_address()
+ */
+module_test(split_address_shall_split_host_and_port)
+{
+  char host[HOST_LEN];
+  const char* port = NULL;
+  assert_eq(0, split_address(host, &port, "build1:4711"));
+  assert_eq("build1", host);
+  assert_eq("4711", port);
+}
+
+module_test(split_address_shall_split_at_the_last_colon)
+{
+  char host[HOST_LEN];
+  const char* port = NULL;
+  assert_eq(0, split_address(host, &port, "::1:4711"));
+  assert_eq("::1", host);
+  assert_eq("4711", port);
+}
+
+module_test(split_address_shall_allow_an_empty_host)
+{
+  char host[HOST_LEN];
+  const char* port = NULL;
+  assert_eq(0, split_address(host, &port, ":4711"));
+  assert_eq("", host);
+}
+
+module_test(split_address_shall_return_negative_1_without_a_port)
+{
+  char host[HOST_LEN];
+  const char* port = NULL;
+  assert_eq(-1, split_address(host, &port, "build1"));
+}
+
+/*****************************************************************************
+ * open_socket()
+ */
+static struct sockaddr socket_addr = {AF_UNIX, {0}};
+
+test(open_socket_shall_return_negative_1_if_there_is_no_socket)
+{
+  m.socket.retval = -1;
+  assert_eq(-1, open_socket(&socket_addr, sizeof(socket_addr), 1));
+  assert_eq(AF_UNIX, m.socket.args.arg0);
+  assert_eq(SOCK_STREAM, m.socket.args.arg1);
+  assert_eq(0, m.bind.call_count);
+}
+
+test(open_socket_shall_listen_if_a_server)
+{
+  m.socket.retval = 3;
+  assert_eq(3, open_socket(&socket_addr, sizeof(socket_addr), 1));
+  assert_eq(1, m.setsockopt.call_count);
+  assert_eq(&socket_addr, m.bind.args.arg1);
+  assert_eq(1, m.listen.call_count);
+  assert_eq(0, m.connect.call_count);
+}
+
+test(open_socket_shall_connect_if_not_a_server)
+{
+  m.socket.retval = 3;
+  assert_eq(3, open_socket(&socket_addr, sizeof(socket_addr), 0));
+  assert_eq(0, m.bind.call_count);
+  assert_eq(3, m.connect.args.arg0);
+}
+
+test(open_socket_shall_close_the_socket_if_it_can_not_connect)
+{
+  m.socket.retval = 3;
+  m.connect.retval = -1;
+  assert_eq(-1, open_socket(&socket_addr, sizeof(socket_addr), 0));
+  assert_eq(1, m.close.call_count);
+  assert_eq(3, m.close.args.arg0);
+}
+
+/*****************************************************************************
+ * unix_socket()
+ */
+test(unix_socket_shall_return_negative_1_if_the_path_is_too_long)
+{
+  char path[256];
+  m.strlen.func = strlen;
+  memset(path, 'a', sizeof(path) - 1);
+  path[sizeof(path) - 1] = 0;
+  assert_eq(-1, unix_socket(path, 1));
+  assert_eq(0, m.open_socket.call_count);
+}
+
+test(unix_socket_shall_remove_an_old_socket_before_listening)
+{
+  m.open_socket.retval = 3;
+  assert_eq(3, unix_socket("/tmp/cutest.sock", 1));
+  assert_eq(1, m.unlink.call_count);
+  assert_eq("/tmp/cutest.sock", m.unlink.args.arg0);
+  assert_eq(1, m.open_socket.args.arg2);
+}
+
+test(unix_socket_shall_not_remove_the_socket_of_the_coordinator)
+{
+  unix_socket("/tmp/cutest.sock", 0);
+  assert_eq(0, m.unlink.call_count);
+  assert_eq(0, m.open_socket.args.arg2);
+}
+
+/*****************************************************************************
+ * tcp_socket()
+ */
+test(tcp_socket_shall_return_negative_1_if_there_is_no_port)
+{
+  m.split_address.retval = -1;
+  assert_eq(-1, tcp_socket("build1", 0));
+  assert_eq(0, m.open_socket.call_count);
+}
+
+test(tcp_socket_shall_return_negative_1_if_the_host_is_unknown)
+{
+  char host[HOST_LEN];
+  const char* port = NULL;
+  m.split_address.func = split_address;
+  m.strrchr.func = strrchr;
+  m.memcpy.func = memcpy;
+  assert_eq(-1, tcp_socket("build1:4711", 0));
+  assert_eq(1, m.gethostbyname.call_count);
+  assert_eq(0, m.open_socket.call_count);
+  (void)host;
+  (void)port;
+}
+
+test(tcp_socket_shall_listen_on_any_interface_without_a_host)
+{
+  m.split_address.func = split_address;
+  m.strrchr.func = strrchr;
+  m.memcpy.func = memcpy;
+  m.strtol.func = strtol;
+  m.open_socket.retval = 3;
+  assert_eq(3, tcp_socket(":4711", 1));
+  assert_eq(0, m.gethostbyname.call_count);
+  assert_eq(1, m.open_socket.args.arg2);
+}
+
+/*****************************************************************************
+ * new_socket()
+ */
+test(new_socket_shall_use_a_unix_socket_for_unix_addresses)
+{
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.unix_socket.retval = 3;
+  assert_eq(3, new_socket("unix:/tmp/cutest.sock", 1));
+  assert_eq("/tmp/cutest.sock", m.unix_socket.args.arg0);
+  assert_eq(1, m.unix_socket.args.arg1);
+  assert_eq(0, m.tcp_socket.call_count);
+}
+
+test(new_socket_shall_use_tcp_for_other_addresses)
+{
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.tcp_socket.retval = 3;
+  assert_eq(3, new_socket("build1:4711", 0));
+  assert_eq("build1:4711", m.tcp_socket.args.arg0);
+  assert_eq(0, m.unix_socket.call_count);
+}
+
+test(new_socket_shall_output_an_error_if_it_fails)
+{
+  m.strncmp.func = strncmp;
+  m.strlen.func = strlen;
+  m.tcp_socket.retval = -1;
+  assert_eq(-1, new_socket("build1:4711", 0));
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq(stderr, m.fprintf.args.arg0);
+}
+
+/*****************************************************************************
+ * net_listen()
+ */
+test(net_listen_shall_create_a_server_socket)
+{
+  m.new_socket.retval = 3;
+  assert_eq(3, net_listen("unix:/tmp/cutest.sock"));
+  assert_eq(1, m.new_socket.args.arg1);
+}
+
+module_test(net_listen_shall_accept_connections_on_a_unix_socket)
+{
+  const char* address = "unix:/tmp/cutest_net_test.sock";
+  const int server = net_listen(address);
+  const int client = net_connect(address);
+  const int peer = accept(server, NULL, NULL);
+  char buf[4] = {0};
+  assert_eq(1, (0 <= server) && (0 <= client) && (0 <= peer));
+  assert_eq(3, write(client, "42\n", 3));
+  assert_eq(3, read(peer, buf, 3));
+  assert_eq("42\n", buf);
+  close(peer);
+  close(client);
+  close(server);
+  unlink("/tmp/cutest_net_test.sock");
+}
+
+/*****************************************************************************
+ * net_connect()
+ */
+test(net_connect_shall_create_a_client_socket)
+{
+  m.new_socket.retval = 3;
+  assert_eq(3, net_connect("build1:4711"));
+  assert_eq(0, m.new_socket.args.arg1);
+}
+
+/*****************************************************************************
+ * get_file_hash()
+ */
+test(get_file_hash_shall_return_negative_1_if_the_file_is_missing)
+{
+  char hash[NET_HASH_LEN];
+  assert_eq(-1, get_file_hash(hash, "foo_test"));
+  assert_eq("foo_test", m.fopen.args.arg0);
+  assert_eq("rb", m.fopen.args.arg1);
+}
+
+module_test(get_file_hash_shall_hash_the_content_of_the_file)
+{
+  char hash[NET_HASH_LEN];
+  FILE* fd = fopen("net_test.hash", "w");
+  fputs("a", fd);
+  fclose(fd);
+  assert_eq(0, get_file_hash(hash, "net_test.hash"));
+  assert_eq("af63dc4c8601ec8c", hash);
+  unlink("net_test.hash");
+}
+
+/*****************************************************************************
+ * copy_bytes()
+ */
+test(copy_bytes_shall_return_negative_1_if_the_input_ends_early)
+{
+  assert_eq(-1, copy_bytes((FILE*)0x1234, (FILE*)0x5678, 10));
+  assert_eq(0, m.fwrite.call_count);
+}
+
+static size_t fread_stub(void* ptr, size_t size, size_t nmemb, FILE* stream)
+{
+  (void)ptr;
+  (void)size;
+  (void)stream;
+  return nmemb;
+}
+
+test(copy_bytes_shall_copy_the_bytes_in_chunks)
+{
+  m.fread.func = fread_stub;
+  m.fwrite.retval = 4096;
+  assert_eq(-1, copy_bytes((FILE*)0x1234, (FILE*)0x5678, 5000));
+  assert_eq(2, m.fread.call_count);
+  assert_eq(904, m.fread.args.arg2);
+}
+
+static size_t fwrite_stub(const void* ptr, size_t size, size_t nmemb,
+                          FILE* stream)
+{
+  (void)ptr;
+  (void)size;
+  (void)stream;
+  return nmemb;
+}
+
+test(copy_bytes_shall_return_0_when_all_bytes_are_copied)
+{
+  m.fread.func = fread_stub;
+  m.fwrite.func = fwrite_stub;
+  assert_eq(0, copy_bytes((FILE*)0x1234, (FILE*)0x5678, 5000));
+  assert_eq((FILE*)0x5678, m.fwrite.args.arg3);
+}
+
+/*****************************************************************************
+ * send_file()
+ */
+test(send_file_shall_return_negative_1_if_the_file_is_missing)
+{
+  assert_eq(-1, send_file((FILE*)0x5678, "BLOB", "foo_test"));
+  assert_eq(0, m.fprintf.call_count);
+}
+
+test(send_file_shall_send_the_size_before_the_content)
+{
+  m.fopen.retval = (FILE*)0x1234;
+  m.ftell.retval = 42;
+  send_file((FILE*)0x5678, "BLOB", "foo_test");
+  assert_eq(1, m.fprintf.call_count);
+  assert_eq((FILE*)0x5678, m.fprintf.args.arg0);
+  assert_eq(1, m.copy_bytes.call_count);
+  assert_eq((FILE*)0x1234, m.copy_bytes.args.arg0);
+  assert_eq(42, m.copy_bytes.args.arg2);
+  assert_eq(1, m.fflush.call_count);
+  assert_eq(1, m.fclose.call_count);
+}
+
+test(send_file_shall_not_send_anything_if_the_size_is_unknown)
+{
+  m.fopen.retval = (FILE*)0x1234;
+  m.ftell.retval = -1;
+  assert_eq(-1, send_file((FILE*)0x5678, "BLOB", "foo_test"));
+  assert_eq(0, m.copy_bytes.call_count);
+  assert_eq(1, m.fclose.call_count);
+}